@@ -0,0 +1,253 @@
+#ifndef __PINATACOMMANDS_H
+#define __PINATACOMMANDS_H
+
+//Pinata board host protocol: command bytes, payload lengths and command parameters.
+//Shared by the firmware (main.h) and the host tools in Code/Tools, so it must not depend on the STM32 headers
+
+#include <stdint.h>
+
+#define RXBUFFERLENGTH 168 //USART rx buffer for rsa plaintext, up to 168 byte
+#define RXRINGLENGTH 1024 //USART3 DMA ring, power of 2: the host may send up to RXRINGLENGTH - 1 bytes ahead of the command being executed
+#define RXIDLETICKS 2 //SysTick periods (1 ms) without a byte that make an idle line, after which an overrun is resynchronized
+
+//Pinata board crypto command bytes definition
+#define CMD_SWDES_ENC 0x44
+#define CMD_SWDES_DEC 0x45
+#define CMD_SWTDES_ENC 0x46
+#define CMD_SWTDES_DEC 0x47
+#define CMD_SWAES128_ENC 0xAE
+#define CMD_SWAES128_DEC 0xEA
+#define CMD_SWAES128SPI_ENC 0xCE
+#define CMD_SWAES256_ENC 0x60
+#define CMD_SWAES256_DEC 0x61
+#define CMD_SWDES_ENC_RND_DELAYS 0x4A
+#define CMD_SWDES_ENC_RND_SBOX 0x4B
+#define CMD_SWAES128_ENC_MASKED 0x73
+#define CMD_SWAES128_DEC_MASKED 0x83
+#define CMD_SWAES128_ENC_RNDDELAYS 0x75
+#define CMD_SWAES128_ENC_RNDSBOX 0x85
+#define CMD_SWSM4_ENC 0x54
+#define CMD_SWSM4_DEC 0x55
+#define CMD_SWSM4OSSL_ENC 0x64
+#define CMD_SWSM4OSSL_DEC 0x65
+
+#define CMD_SWDES_ENC_MISALIGNED 0x14
+#define CMD_SWAES128_ENC_MISALIGNED 0x1E
+
+
+#define CMD_RSACRT1024_DEC 0xAA
+#define CMD_RSASFM_DEC 0xDF
+#define CMD_RSASFM_GET_LAST_KEY 0xDA
+#define CMD_RSASFM_GET_HARDCODED_KEY 0xD8
+#define CMD_RSASFM_SET_D 0xDB
+#define CMD_RSASFM_SET_KEY_GENERATION_METHOD 0xDC
+#define CMD_RSASFM_SET_IMPLEMENTATION 0xD9
+
+#define CMD_SWAES128TTABLES_ENC 0x41
+#define CMD_SWAES128TTABLES_DEC 0x50
+
+#define CMD_HWDES_ENC 0xBE
+#define CMD_HWDES_DEC 0xEF
+#define CMD_HWTDES_ENC 0xC0
+#define CMD_HWTDES_DEC 0x01
+#define CMD_HWAES128_ENC 0xCA
+#define CMD_HWAES128_DEC 0xFE
+#define CMD_HWAES256_ENC 0x7A
+#define CMD_HWAES256_DEC 0x7E
+#define CMD_HMAC_SHA1 0x4C
+#define CMD_SHA1_HASH 0x27
+
+#define CMD_CRYPTOLOOP 0xB1
+
+#define CMD_GET_RANDOM_FROM_TRNG 0x11
+
+#define CMD_TDES_KEYCHANGE 0xC7
+#define CMD_DES_KEYCHANGE 0xD7
+#define CMD_AES128_KEYCHANGE 0xE7
+#define CMD_AES256_KEYCHANGE 0xF7
+#define CMD_SM4_KEYCHANGE 0x57
+
+#define CMD_SOFTWARE_KEY_COPY 0x38
+#define CMD_INFINITE_FI_LOOP 0x99
+#define CMD_LOOP_TEST_FI 0xDD
+#define CMD_SINGLE_PWD_CHECK_FI 0xA2
+#define CMD_DOUBLE_PWD_CHECK_FI 0xA7
+#define CMD_PWD_CHANGE 0xA5
+#define CMD_SWAES128_ENCRYPT_DOUBLECHECK 0x88
+#define CMD_SWDES_ENCRYPT_DOUBLECHECK 0x29
+
+#define CMD_OLED_TEST 0x30
+#define CMD_UID_VIA_IO 0x1D
+#define CMD_GET_CODE_REV 0xF1
+#define CMD_CHANGE_CLK_SPEED 0xF2
+#define CMD_SET_EXTERNAL_CLOCK 0xF3
+
+#define CMD_UNKNOWN 0xFF
+
+// UNAI
+// 0xEA & 0xE7 are busy
+//#define CMD_MEM_COPY_1_BYTE 0xE1  //http://infocenter.arm.com/help/index.jsp?topic=/com.arm.doc.faqs/ka3934.html
+//#define CMD_MEM_COPY_2_BYTE 0xE2
+//#define CMD_MEM_COPY_4_BYTE 0xE3
+//#define CMD_MEM_COPY_32_BIT 0xE4+
+
+// 0xB1 & 0xBE is busy
+#define CMD_SWAES128_ENC_MASKED_FROM_INSPECTOR 0xBA
+#define CMD_SWAES128_ENC_MASKED_FROM_INSPECTOR_SBOX_TRIGGER 0xBB
+#define CMD_SWAES128_ENC_SIMPLE_MASKED_FROM_INSPECTOR 0xBC
+#define CMD_SWAES128_ENC_ASCAD_MASKED_FROM_INSPECTOR 0xBD
+#define CMD_SWAES128_ENC_WEAK_MASKED_FROM_INSPECTOR 0xBF
+
+// MARIANA
+
+// Commands for errors
+#define CMD_SUT00I 0xA0
+#define CMD_SUT00F 0xA1
+#define CMD_E0101 0x00
+#define CMD_E0102 0x02
+#define CMD_E0103 0x03
+#define CMD_E0104 0x04
+#define CMD_E0105 0x05
+#define CMD_E0106 0x06
+#define CMD_E0201 0x07
+#define CMD_E0202 0x08
+#define CMD_E0203 0x09
+#define CMD_E0204 0x0A
+#define CMD_E0205 0x0B
+#define CMD_E0206 0x0C
+#define CMD_E0207 0x0D
+#define CMD_E0208 0x0E
+#define CMD_E0209 0x0F
+#define CMD_E0210 0xA3
+
+// Solver variants: same algorithm as SUT00F with Q15, Q31, single precision FPU and software float arithmetic.
+// The base command runs the baseline; base+1, base+2, base+3 add the overflow, underflow and divide by zero errors
+// (E0101, E0102 and E0106 equivalents)
+#define SOLVER_ERROR_MASK 0x03
+#define SOLVER_NO_ERROR 0x00
+#define SOLVER_OVERFLOW 0x01
+#define SOLVER_UNDERFLOW 0x02
+#define SOLVER_DIV_BY_ZERO 0x03
+
+#define CMD_SUT00Q15 0x90
+#define CMD_E0101Q15 0x91
+#define CMD_E0102Q15 0x92
+#define CMD_E0106Q15 0x93
+#define CMD_SUT00Q31 0x94
+#define CMD_E0101Q31 0x95
+#define CMD_E0102Q31 0x96
+#define CMD_E0106Q31 0x97
+#define CMD_SUT00FPU 0x9C
+#define CMD_E0101FPU 0x9D
+#define CMD_E0102FPU 0x9E
+#define CMD_E0106FPU 0x9F
+#define CMD_SUT00SWF 0x8C
+#define CMD_E0101SWF 0x8D
+#define CMD_E0102SWF 0x8E
+#define CMD_E0106SWF 0x8F
+
+// Out of memory modes for E0207 (size parameter 0 = derived from the linker symbols)
+#define OOM_SINGLE_REQUEST 0x00 //One request larger than the heap (default size: heap + 1 byte)
+#define OOM_HEAP_CEILING 0x01 //Rows of OOM_ROW_SIZE bytes up to a heap ceiling (default ceiling: whole heap)
+#define OOM_ROW_SIZE ((1000+1)*sizeof(float))
+
+//Quiet window mode of a command, see quiet_window_enter()
+#define QUIET_OFF 0 //Opt-out: nothing is gated or masked
+#define QUIET_ON 1
+#define QUIET_ON_KEEP_CRYP 2 //Hardware crypto/hash commands: CRYP stays clocked
+
+#define CMD_SET_QUIET_WINDOW 0xF4 //Payload: command byte, QUIET_* mode
+
+//Payload of each command
+#define PAYLOAD_LEN_PREFIXED 0xFFFF //Payload length is sent by the host as a 2-byte prefix, MSByte first
+
+//cmd_payload_length: number of bytes the host sends after the command byte (PAYLOAD_LEN_PREFIXED for RSA ciphertexts/exponents)
+static inline uint16_t cmd_payload_length(uint8_t cmd) {
+	switch (cmd) {
+		case CMD_RSACRT1024_DEC:
+		case CMD_RSASFM_DEC:
+		case CMD_RSASFM_SET_D:
+			return PAYLOAD_LEN_PREFIXED;
+
+		case CMD_SWAES128_ENC_MASKED_FROM_INSPECTOR:
+		case CMD_SWAES128_ENC_MASKED_FROM_INSPECTOR_SBOX_TRIGGER:
+		case CMD_SWAES128_ENC_ASCAD_MASKED_FROM_INSPECTOR:
+		case CMD_SWAES128_ENC_WEAK_MASKED_FROM_INSPECTOR:
+			return 16 + 16 + 16 + 1 + 1; //Plaintext, key, mask, mask1, mask2
+
+		case CMD_AES256_KEYCHANGE:
+			return 32;
+		case CMD_TDES_KEYCHANGE:
+			return 24;
+		case CMD_HMAC_SHA1:
+			return sizeof(uint32_t) + 20; //Iterations + message
+		case CMD_SHA1_HASH:
+			return sizeof(uint32_t) + 16; //Iterations + message
+
+		case CMD_SWAES128_ENC_SIMPLE_MASKED_FROM_INSPECTOR:
+		case CMD_SWAES128_ENC:
+		case CMD_SWAES128SPI_ENC:
+		case CMD_SWAES128_DEC:
+		case CMD_SWAES256_ENC:
+		case CMD_SWAES256_DEC:
+		case CMD_SWSM4_ENC:
+		case CMD_SWSM4_DEC:
+		case CMD_SWSM4OSSL_ENC:
+		case CMD_SWSM4OSSL_DEC:
+		case CMD_SWAES128_ENC_MISALIGNED:
+		case CMD_SWAES128_ENC_MASKED:
+		case CMD_SWAES128_DEC_MASKED:
+		case CMD_SWAES128_ENC_RNDDELAYS:
+		case CMD_SWAES128_ENC_RNDSBOX:
+		case CMD_SWAES128TTABLES_ENC:
+		case CMD_SWAES128TTABLES_DEC:
+		case CMD_HWAES128_ENC:
+		case CMD_HWAES128_DEC:
+		case CMD_HWAES256_ENC:
+		case CMD_HWAES256_DEC:
+		case CMD_AES128_KEYCHANGE:
+		case CMD_SM4_KEYCHANGE:
+		case CMD_SOFTWARE_KEY_COPY:
+		case CMD_SWAES128_ENCRYPT_DOUBLECHECK:
+			return 16;
+
+		case CMD_SWDES_ENC:
+		case CMD_SWDES_DEC:
+		case CMD_SWTDES_ENC:
+		case CMD_SWTDES_DEC:
+		case CMD_SWDES_ENC_MISALIGNED:
+		case CMD_SWDES_ENC_RND_SBOX:
+		case CMD_SWDES_ENC_RND_DELAYS:
+		case CMD_HWDES_ENC:
+		case CMD_HWDES_DEC:
+		case CMD_HWTDES_ENC:
+		case CMD_HWTDES_DEC:
+		case CMD_DES_KEYCHANGE:
+		case CMD_SWDES_ENCRYPT_DOUBLECHECK:
+			return 8;
+
+		case CMD_PWD_CHANGE:
+		case CMD_SINGLE_PWD_CHECK_FI:
+		case CMD_DOUBLE_PWD_CHECK_FI:
+			return 4;
+		case CMD_E0207:
+			return 1 + sizeof(uint32_t); //Out of memory mode + size
+		case CMD_E0208:
+		case CMD_E0209:
+			return sizeof(uint32_t); //Stack depth in words
+		case CMD_LOOP_TEST_FI:
+			return 2; //16bit loop counter
+		case CMD_SET_QUIET_WINDOW:
+			return 2;
+		case CMD_RSASFM_SET_KEY_GENERATION_METHOD:
+		case CMD_RSASFM_SET_IMPLEMENTATION:
+		case CMD_CHANGE_CLK_SPEED:
+		case CMD_SET_EXTERNAL_CLOCK:
+			return 1;
+
+		default: //Error programs, test commands and unknown command bytes carry no payload
+			return 0;
+	}
+}
+
+#endif
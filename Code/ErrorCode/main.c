@@ -35,6 +35,7 @@
 void get_bytes(uint32_t nbytes, uint8_t* ba);
 void send_bytes(uint32_t nbytes, uint8_t* ba);
 void get_char(uint8_t *ch);
+uint32_t get_uint32();
 void send_char(uint8_t ch);
 void readFromCharArray(uint8_t *ch);
 void readByteFromInputBuffer(uint8_t *ch);
@@ -63,6 +64,14 @@ const uint8_t codeVersion[] = { 'V','e','r',' ','2','.','2',0x00};
 const uint8_t defaultPasswd[] = {0x02,0x06,0x02,0x08};
 
 volatile uint8_t rxBuffer[RXBUFFERLENGTH] = { };
+volatile uint8_t rxRing[RXRINGLENGTH]; //Written by DMA1 Stream1, read by get_command()
+uint16_t rxRingRead = 0; //Next byte of rxRing to parse
+rxFrame_t rxFrame; //Frame of the command being executed
+volatile uint32_t rxOverruns = 0;
+volatile uint8_t currentCmd = 0; //Command being executed, selects the quiet window mode
+uint8_t quietWindowMode[256];
+volatile uint8_t quietActive = QUIET_OFF;
+uint32_t quietSavedAHB1, quietSavedAHB2, quietSavedAPB1, quietSavedSysTick, quietSavedPRIMASK;
 volatile uint32_t ticker, downTicker;
 volatile uint8_t usbSerialEnabled=0;
 volatile int busyWait1;
@@ -204,6 +213,218 @@ void Solve_E0203() {
 
 
 
+/* SOLVER VARIANTS */
+
+// Arithmetic of each variant. Fixed-point matrices hold the values 1..12 scaled by 1/16, so that they fit in [-1, 1);
+// results wrap around like the integer baseline
+static inline int16_t Q15_FromInt(int v) { return (int16_t)(v << 11); }
+static inline int16_t Q15_Add(int16_t a, int16_t b) { return (int16_t)(a + b); }
+static inline int16_t Q15_Sub(int16_t a, int16_t b) { return (int16_t)(a - b); }
+static inline int16_t Q15_Mul(int16_t a, int16_t b) { return (int16_t)(((int32_t)a * b) >> 15); }
+static inline int16_t Q15_Div(int16_t a, int16_t b) { return (int16_t)(((int32_t)a << 15) / b); }
+
+static inline int32_t Q31_FromInt(int v) { return (int32_t)v << 27; }
+static inline int32_t Q31_Add(int32_t a, int32_t b) { return (int32_t)((uint32_t)a + (uint32_t)b); }
+static inline int32_t Q31_Sub(int32_t a, int32_t b) { return (int32_t)((uint32_t)a - (uint32_t)b); }
+static inline int32_t Q31_Mul(int32_t a, int32_t b) { return (int32_t)(((int64_t)a * b) >> 31); }
+static inline int32_t Q31_Div(int32_t a, int32_t b) { return (int32_t)(((int64_t)a << 31) / b); }
+
+// Single precision on the FPU (needs -mfpu=fpv4-sp-d16 with the hard or softfp float ABI)
+static inline float FPU_FromInt(int v) { return (float)v; }
+static inline float FPU_Add(float a, float b) { return a + b; }
+static inline float FPU_Sub(float a, float b) { return a - b; }
+static inline float FPU_Mul(float a, float b) { return a * b; }
+static inline float FPU_Div(float a, float b) { return a / b; }
+
+// Software float: libgcc routines, which take and return the IEEE 754 bits in core registers (base AAPCS). They are
+// declared on uint32_t and the operands are held as bit patterns, so that no float local or constant exists that the
+// compiler could move through the FPU registers with -mfloat-abi=hard
+extern uint32_t __aeabi_i2f(int a);
+extern uint32_t __aeabi_fadd(uint32_t a, uint32_t b);
+extern uint32_t __aeabi_fsub(uint32_t a, uint32_t b);
+extern uint32_t __aeabi_fmul(uint32_t a, uint32_t b);
+extern uint32_t __aeabi_fdiv(uint32_t a, uint32_t b);
+#define SWF_FLT_MAX 0x7F7FFFFFu //Bits of FLT_MAX
+#define SWF_FLT_MIN 0x00800000u //Bits of FLT_MIN
+
+// Generates the matrix, ComputeDeterminant_<NAME> and Solve_<NAME> for one arithmetic path: same Cramer's rule and
+// same malloc'ed matrix as Solve_F, then the requested error (ADD of two maxima, MUL of two tiny values, DIV by zero)
+#define DEFINE_SOLVER(NAME, TYPE, FROMINT, ADD, SUB, MUL, DIV, MAXVAL, TINYVAL) \
+TYPE **Matrix_##NAME; \
+\
+TYPE ComputeDeterminant_##NAME(int index) { \
+	TYPE M[inc][inc]; \
+\
+	for (int f = 0; f < inc; f++) { \
+		for (int c = 0; c < inc; c++) { \
+			if (c != index) { \
+				M[f][c] = Matrix_##NAME[f][c]; \
+			} else { \
+				M[f][c] = Matrix_##NAME[f][inc]; \
+			} \
+		} \
+	} \
+\
+	return ADD(ADD(MUL(M[0][0], SUB(MUL(M[1][1], M[2][2]), MUL(M[2][1], M[1][2]))), \
+	               MUL(M[0][1], SUB(MUL(M[1][2], M[2][0]), MUL(M[1][0], M[2][2])))), \
+	           MUL(M[1][0], SUB(MUL(M[2][1], M[0][2]), MUL(M[0][1], M[2][2])))); \
+} \
+\
+void Solve_##NAME(uint8_t error) { \
+	volatile TYPE x, y, z, e; \
+	volatile TYPE maxVal = MAXVAL, tinyVal = TINYVAL, zero = FROMINT(0); \
+	TYPE d, dx, dy, dz; \
+	int var = 1; \
+\
+	Matrix_##NAME = (TYPE **) malloc(inc*sizeof(TYPE*)); \
+	for (int f = 0; f < inc; f++) { \
+		Matrix_##NAME[f] = (TYPE *) malloc((inc+1)*sizeof(TYPE)); \
+		for (int c = 0; c < inc+1; c++) { \
+			Matrix_##NAME[f][c] = FROMINT(var); \
+			var += 1; \
+		} \
+	} \
+\
+	d = ComputeDeterminant_##NAME(inc); \
+	dx = ComputeDeterminant_##NAME(inc-3); \
+	dy = ComputeDeterminant_##NAME(inc-2); \
+	dz = ComputeDeterminant_##NAME(inc-1); \
+	x = DIV(dx, d); \
+	y = DIV(dy, d); \
+	z = DIV(dz, d); \
+\
+	for (int f = 0; f < inc; f++) { \
+		free(Matrix_##NAME[f]); \
+	} \
+	free(Matrix_##NAME); \
+\
+	switch (error) { \
+		case SOLVER_OVERFLOW: \
+			e = ADD(maxVal, maxVal); \
+			break; \
+		case SOLVER_UNDERFLOW: \
+			e = MUL(tinyVal, tinyVal); \
+			break; \
+		case SOLVER_DIV_BY_ZERO: \
+			e = DIV(x, zero); \
+			break; \
+	} \
+}
+
+DEFINE_SOLVER(Q15, int16_t, Q15_FromInt, Q15_Add, Q15_Sub, Q15_Mul, Q15_Div, INT16_MAX, 1)
+DEFINE_SOLVER(Q31, int32_t, Q31_FromInt, Q31_Add, Q31_Sub, Q31_Mul, Q31_Div, INT32_MAX, 1)
+DEFINE_SOLVER(FPU, float, FPU_FromInt, FPU_Add, FPU_Sub, FPU_Mul, FPU_Div, FLT_MAX, FLT_MIN)
+DEFINE_SOLVER(SWF, uint32_t, __aeabi_i2f, __aeabi_fadd, __aeabi_fsub, __aeabi_fmul, __aeabi_fdiv, SWF_FLT_MAX, SWF_FLT_MIN)
+
+// Runs the variant selected by the command byte, with the error given by its two lowest bits
+void SolveVariant(uint8_t cmd) {
+	uint8_t error = cmd & SOLVER_ERROR_MASK;
+
+	switch (cmd & ~SOLVER_ERROR_MASK) {
+		case CMD_SUT00Q15:
+			Solve_Q15(error);
+			break;
+		case CMD_SUT00Q31:
+			Solve_Q31(error);
+			break;
+		case CMD_SUT00FPU:
+			Solve_FPU(error);
+			break;
+		case CMD_SUT00SWF:
+			Solve_SWF(error);
+			break;
+	}
+}
+
+/* STACK & HEAP ERRORS */
+
+// Out of memory: one oversized request, or rows of OOM_ROW_SIZE bytes up to a heap ceiling.
+// Returns the allocated rows (chained through their first word) for ReleaseMemory_E0207
+void *OutOfMemory_E0207(uint8_t mode, uint32_t size) {
+	uint32_t heapSize = STACK_LIMIT - HEAP_START;
+	uint32_t allocated = 0;
+	void **rows = NULL;
+	void **row;
+
+	if (mode == OOM_HEAP_CEILING) {
+		if (size == 0 || size > heapSize) {
+			size = heapSize;
+		}
+		// At most size/OOM_ROW_SIZE allocations: stops when malloc fails or the next row exceeds the ceiling
+		while (allocated + OOM_ROW_SIZE <= size) {
+			row = (void **) malloc(OOM_ROW_SIZE);
+			if (row == NULL) {
+				break;
+			}
+			*row = rows;
+			rows = row;
+			allocated += OOM_ROW_SIZE;
+		}
+	} else {
+		if (size == 0) {
+			size = heapSize + 1;
+		}
+		rows = (void **) malloc(size);
+		if (rows != NULL) {
+			*rows = NULL;
+		}
+	}
+
+	return rows;
+}
+
+void ReleaseMemory_E0207(void *rows) {
+	void **row = (void **) rows;
+	void **next;
+
+	while (row != NULL) {
+		next = (void **) *row;
+		free(row);
+		row = next;
+	}
+}
+
+// Stack overflow: push the requested number of words, or by default (words = 0) down to the word below the current
+// heap break: past the stack limit, through the free memory between the stack and the heap, and over the last heap word.
+// The loop is in assembly because the compiler addresses locals through SP; SP is restored at the end
+void StackOverflow_E0208(uint32_t words) {
+	if (words == 0) {
+		words = (__get_MSP() - HEAP_BREAK) / 4 + 1;
+	}
+
+	__asm __volatile__(
+		"mov r2, sp\n"
+		"1:\n"
+		"push {r1}\n"
+		"subs %0, %0, #1\n"
+		"bne 1b\n"
+		"mov sp, r2\n"
+		: "+r" (words)
+		:
+		: "r1", "r2", "cc", "memory"
+	);
+}
+
+// Stack underflow: pop words until one word past the top of the stack (words = 0) or the requested number of words
+void StackUnderflow_E0209(uint32_t words) {
+	if (words == 0) {
+		words = (STACK_TOP - __get_MSP()) / 4 + 1;
+	}
+
+	__asm __volatile__(
+		"mov r2, sp\n"
+		"1:\n"
+		"pop {r1}\n"
+		"subs %0, %0, #1\n"
+		"bne 1b\n"
+		"mov sp, r2\n"
+		: "+r" (words)
+		:
+		: "r1", "r2", "cc", "memory"
+	);
+}
+
+
 /********************************************/
 /*				UNAI - END   				*/
 /********************************************/
@@ -246,6 +467,9 @@ int main(void) {
 	oled_init();
 	oled_clear();
 
+	// Default quiet window mode for every command
+	quiet_window_init();
+
 	// Initialize & load default cryptographic keys from FLASH memory
 	// Load RSACRT parameters
 	rsa_crt_init();
@@ -290,6 +514,8 @@ int main(void) {
 
 	int var_I;
 	int var_F;
+	uint32_t errorParam; //E0207/E0208/E0209 parameter, 0 = derived from the linker symbols
+	void *oomBlocks;
 
 	int r;
 	volatile unsigned int* p;
@@ -305,8 +531,9 @@ int main(void) {
 		cmd=0;
 
 		//Main processing section: select and execute cipher&mode
-
-		get_char(&cmd);
+		//With USART3 the command frame is already being received by the DMA in the background while the loop above runs
+		get_command(&cmd);
+		currentCmd = cmd;
 
 		switch (cmd) {
 
@@ -314,7 +541,7 @@ int main(void) {
 		/*				ERRORES - START				*/
 		/********************************************/
 			case CMD_SUT00I:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				var_I = 1;
 				Matrix_I = (int **) malloc(inc*sizeof(int*));
@@ -329,12 +556,12 @@ int main(void) {
 				Solve_I();
 				free(Matrix_I);
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0103:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_I = 1;
@@ -353,12 +580,12 @@ int main(void) {
 				// Integer Overflow
 				var_I = INT_MAX +1;
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0104:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_I = 1;
@@ -377,12 +604,12 @@ int main(void) {
 				// Integer Underflow
 				var_I = INT_MIN -1;
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0105:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_I = 1;
@@ -408,12 +635,12 @@ int main(void) {
 //				);
 
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_SUT00F:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -429,12 +656,12 @@ int main(void) {
 				Solve_F();
 				free(Matrix_F);
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0101:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -453,12 +680,12 @@ int main(void) {
 				//Floating Point Overflow
 				var_F = DBL_MAX + 1.0;
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0102:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -477,12 +704,12 @@ int main(void) {
 				//Floating Point Underflow
 				var_F = DBL_MIN - 1.0;
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0106:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -501,12 +728,12 @@ int main(void) {
 				//Divide by zero Decimal
 				var_F = var_F/0.0;
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0201:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -526,12 +753,12 @@ int main(void) {
 				char *onlyrd = "string";
 				onlyrd[0] = 'n';
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0202:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -552,12 +779,12 @@ int main(void) {
 				char cadena[] = "This solution will overflow the buffer\n";
 				strcpy(buff, cadena);
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0203:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -575,12 +802,12 @@ int main(void) {
 				//Double free
 				free(Matrix_F);
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0204:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -604,12 +831,12 @@ int main(void) {
 			  	int *ptr;
 			  	int val = *ptr;
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0205:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -632,12 +859,12 @@ int main(void) {
 				//p = (unsigned int*)0x00100000;  // 0x00100000-0x07FFFFFF is reserved on STM32F4
 				//*p = 0x00BADA55;
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0206:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -660,12 +887,14 @@ int main(void) {
 				//p = (unsigned int*)0x00100000;        // 0x00100000-0x07FFFFFF is reserved on STM32F4
 				//r = *p;
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0207:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				get_char(&tmp); // Receive out of memory mode
+				errorParam = get_uint32(); // Receive request size or heap ceiling in bytes, MSByte first
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -682,17 +911,16 @@ int main(void) {
 				free(Matrix_F);
 
 				//Out of Memory
-				Matrix_F = (float **) malloc(10000*sizeof(float*));
-				for (int f = 0; f < 10000; f++) {
-					Matrix_F[f]=(float *) malloc((1000+1)*sizeof(float));
-				}
+				oomBlocks = OutOfMemory_E0207(tmp, errorParam);
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
+				ReleaseMemory_E0207(oomBlocks); //Give the heap back so that every trace starts from the same state
 				send_char(cmd);
 				break;
 
 			case CMD_E0208:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				errorParam = get_uint32(); // Receive number of words to push, MSByte first
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -709,22 +937,15 @@ int main(void) {
 				free(Matrix_F);
 
 				//Stack Overflow
-				for(int i=0; i<16116; i++) {
-					__asm __volatile__(
-						"push {r1}\n"
-					);
-				}
+				StackOverflow_E0208(errorParam);
 
-				__asm __volatile__(
-					"push {r1}\n"
-				);
-
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0209:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				errorParam = get_uint32(); // Receive number of words to pop, MSByte first
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -741,27 +962,14 @@ int main(void) {
 				free(Matrix_F);
 
 				//Stack Underflow
+				StackUnderflow_E0209(errorParam);
 
-				//STACK_SIZE = 0x00004000 = 16384
-				//16384/4 bytes = 4096 posiciones de memoria
-
-				for(int i=0; i<4096*3+1452; i++){
-				__asm __volatile__(
-						"pop {r1}\n"
-						);
-				}
-
-				__asm __volatile__(
-						"pop {r1}\n"
-						);
-
-
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
 			case CMD_E0210:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 
 				// Matrix initialization
 				var_F = 1.0;
@@ -795,7 +1003,30 @@ int main(void) {
 						"str r3, [sp]\n"
 						);
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
+				send_char(cmd);
+				break;
+
+			// Solver variants (Q15, Q31, FPU, software float) and their overflow, underflow and divide by zero errors
+			case CMD_SUT00Q15:
+			case CMD_E0101Q15:
+			case CMD_E0102Q15:
+			case CMD_E0106Q15:
+			case CMD_SUT00Q31:
+			case CMD_E0101Q31:
+			case CMD_E0102Q31:
+			case CMD_E0106Q31:
+			case CMD_SUT00FPU:
+			case CMD_E0101FPU:
+			case CMD_E0102FPU:
+			case CMD_E0106FPU:
+			case CMD_SUT00SWF:
+			case CMD_E0101SWF:
+			case CMD_E0102SWF:
+			case CMD_E0106SWF:
+				TRIGGER_ON(); //Trigger on
+				SolveVariant(cmd);
+				TRIGGER_OFF(); //Trigger off
 				send_char(cmd);
 				break;
 
@@ -811,11 +1042,11 @@ int main(void) {
 //				dest8[0]=0x00;
 //				data8[0]=0x00;
 //				get_bytes(1, data8); // Receive DES plaintext
-//				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+//				TRIGGER_ON(); //Trigger on
 //				dummyDelay(751); //1ms = 16797 // 44,94 ms = 751
 //				memcpy(dest8, data8, 1);
 //				dummyDelay(751); //1ms
-//				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+//				TRIGGER_OFF(); //Trigger off
 //				send_bytes(1, dest8); // Transmit back ciphertext via UART
 //				break;
 //
@@ -825,11 +1056,11 @@ int main(void) {
 //				data8[0]=0x00;
 //				data8[1]=0x00;
 //				get_bytes(2, data8); // Receive DES plaintext
-//				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+//				TRIGGER_ON(); //Trigger on
 //				dummyDelay(751); //1ms = 16797 // 44,94 ms = 751
 //				memcpy(dest8, data8, 2);
 //				dummyDelay(751); //1ms
-//				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+//				TRIGGER_OFF(); //Trigger off
 //				send_bytes(2, dest8); // Transmit back ciphertext via UART
 //				break;
 //
@@ -843,11 +1074,11 @@ int main(void) {
 //				data8[2]=0x00;
 //				data8[3]=0x00;
 //				get_bytes(4, data8); // Receive DES plaintext
-//				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+//				TRIGGER_ON(); //Trigger on
 //				dummyDelay(751); //1ms = 16797 // 44,94 ms = 751
 //				memcpy(dest8, data8, 4);
 //				dummyDelay(751); //1ms
-//				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+//				TRIGGER_OFF(); //Trigger off
 //				send_bytes(4, dest8); // Transmit back ciphertext via UART
 //				break;
 //
@@ -855,18 +1086,20 @@ int main(void) {
 //				dest32[0]=0x00000000;
 //				data32[0]=0x00000000;
 //				get_bytes(1, data32); // Receive DES plaintext
-//				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+//				TRIGGER_ON(); //Trigger on
 //				dummyDelay(751); //1ms = 16797 // 44,94 ms = 751
 //				memcpy(dest32, data32, 1);
 //				dummyDelay(751); //1ms
-//				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+//				TRIGGER_OFF(); //Trigger off
 //				send_bytes(1, dest32); // Transmit back ciphertext via UART
 //				break;
 
 			//Software masked AES128 - encrypt (Simple Masking)
 			case CMD_SWAES128_ENC_SIMPLE_MASKED_FROM_INSPECTOR:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
+				quiet_window_enter();
 				simple_mAES128_ECB_encrypt(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function, includes masking process
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
@@ -892,7 +1125,9 @@ int main(void) {
 				get_bytes(1, rxBuffer); // Receive mask2
 				mask2 = *rxBuffer;
 
+				quiet_window_enter();
 				mAES128_ECB_encrypt_masks_from_inspector(aes_plaintext, key, mask, mask1, mask2, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function, includes masking process
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
@@ -918,7 +1153,9 @@ int main(void) {
 				get_bytes(1, rxBuffer); // Receive mask2
 				mask2 = *rxBuffer;
 
+				quiet_window_enter();
 				mAES128_ECB_encrypt_masks_from_inspector_sbox_trigger(aes_plaintext, key, mask, mask1, mask2, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function, includes masking process
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
@@ -944,7 +1181,9 @@ int main(void) {
 				get_bytes(1, rxBuffer); // Receive mask2
 				mask2 = *rxBuffer;
 
+				quiet_window_enter();
 				mAES128_ECB_encrypt_ASCAD_masks_from_inspector(aes_plaintext, key, mask, mask1, mask2, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function, includes masking process
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
@@ -969,7 +1208,9 @@ int main(void) {
 				get_bytes(1, rxBuffer); // Receive mask2
 				mask2 = *rxBuffer;
 
+				quiet_window_enter();
 				mAES128_ECB_encrypt_WEAK_masks_from_inspector(aes_plaintext, key, mask, mask1, mask2, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function, includes masking process
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
@@ -984,47 +1225,49 @@ int main(void) {
 			//Software DES - encrypt
 			case CMD_SWDES_ENC:
 				get_bytes(8, rxBuffer); // Receive DES plaintext
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				des(keyDES, rxBuffer, ENCRYPT); // Perform software DES encryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(8, rxBuffer); // Transmit back ciphertext via UART
 				break;
 
 			//Software DES - decrypt
 			case CMD_SWDES_DEC:
 				get_bytes(8, rxBuffer); // Receive DES ciphertext
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				des(keyDES, rxBuffer, DECRYPT); // Perform software DES decryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(8, rxBuffer); // TransmiDt back plaintext via UART
 				break;
 
 			//Software TDES - encrypt
 			case CMD_SWTDES_ENC:
 				get_bytes(8, rxBuffer); // Receive TDES plaintext
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				des(keyTDES,   rxBuffer, ENCRYPT); // Perform software DES encryption, key1
 				des(keyTDES+8, rxBuffer, DECRYPT); // Perform software DES decryption, key2
 				des(keyTDES+16,rxBuffer, ENCRYPT); // Perform software DES encryption, key3
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(8, rxBuffer); // Transmit back ciphertext via UART
 				break;
 
 			//Software TDES - decrypt
 			case CMD_SWTDES_DEC:
 				get_bytes(8, rxBuffer); // Receive TDES ciphertext
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				des(keyTDES,   rxBuffer, DECRYPT); // Perform software DES decryption, key1
 				des(keyTDES+8, rxBuffer, ENCRYPT); // Perform software DES encryption, key2
 				des(keyTDES+16,rxBuffer, DECRYPT); // Perform software DES decryption, key3
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(8, rxBuffer); // Transmit back plaintext via UART
 				break;
 
 			//Software AES128 - encrypt
 			case CMD_SWAES128_ENC:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
+				quiet_window_enter();
 				AES128_ECB_encrypt(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function after key expansion
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
@@ -1036,32 +1279,36 @@ int main(void) {
 				send_OLEDcmd_SPI(0xCA);
 				send_OLEDcmd_SPI(0xFF);
 				send_OLEDcmd_SPI(0xED);
+				quiet_window_enter();
 				AES128_ECB_encrypt_noTrigger(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES);
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
 			//Software AES128 - decrypt
 			case CMD_SWAES128_DEC:
 				get_bytes(16, rxBuffer); // Receive AES ciphertext
+				quiet_window_enter();
 				AES128_ECB_decrypt(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function after key expansion
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back plaintext via UART
 				break;
 
 			//Software AES256 - encrypt
 			case CMD_SWAES256_ENC:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				aes256_encrypt_ecb(&ctx, rxBuffer); // Perform software AES256 encryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16, rxBuffer); // Transmit back ciphertext via UART
 				break;
 
 			//Software AES256 - decrypt
 			case CMD_SWAES256_DEC:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				aes256_decrypt_ecb(&ctx, rxBuffer); // Perform software AES256 encryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16, rxBuffer); // Transmit back ciphertext via UART
 				break;
 
@@ -1069,9 +1316,9 @@ int main(void) {
 			case CMD_SWSM4_ENC:
 				get_bytes(16, rxBuffer); // Receive SM4 plaintext
 				sm4_setkey(&ctx_sm4, keySM4, SM4_ENCRYPT); //Configure SM4 key schedule for encryption
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				sm4_encrypt(&ctx_sm4,rxBuffer); //Perform SM4 crypto
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16, rxBuffer); // Transmit back ciphertext via UART
 				break;
 
@@ -1079,9 +1326,9 @@ int main(void) {
 			case CMD_SWSM4_DEC:
 				get_bytes(16, rxBuffer); // Receive SM4 ciphertext
 				sm4_setkey(&ctx_sm4, keySM4, SM4_DECRYPT); //Configure SM4 key schedule for decryption
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				sm4_encrypt(&ctx_sm4,rxBuffer); //Perform SM4 crypto
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16, rxBuffer); // Transmit back plaintext via UART
 				break;
 
@@ -1089,9 +1336,9 @@ int main(void) {
 			case CMD_SWSM4OSSL_ENC:
 				get_bytes(16, rxBuffer); // Receive SM4 plaintext
 				SM4_set_key(keySM4, &ctx_sm4_ossl); //Configure SM4 key schedule
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				SM4_encrypt(rxBuffer,rxBuffer+SM4_BLOCK_SIZE,&ctx_sm4_ossl); //Perform SM4 encryption (openSSL code)
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16, rxBuffer+SM4_BLOCK_SIZE); // Transmit back ciphertext via UART
 				break;
 
@@ -1099,24 +1346,26 @@ int main(void) {
 			case CMD_SWSM4OSSL_DEC:
 				get_bytes(16, rxBuffer); // Receive SM4 plaintext
 				SM4_set_key(keySM4, &ctx_sm4_ossl); //Configure SM4 key schedule
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				SM4_decrypt(rxBuffer,rxBuffer+SM4_BLOCK_SIZE,&ctx_sm4_ossl); //Perform SM4 decryption (openSSL code)
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16, rxBuffer+SM4_BLOCK_SIZE); // Transmit back ciphertext via UART
 				break;
 
 			//Software DES - encrypt with misalignment at beginning of trigger (to practice static align)
 			case CMD_SWDES_ENC_MISALIGNED:
 				get_bytes(8, rxBuffer); // Receive DES plaintext
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				desMisaligned(keyDES, rxBuffer, ENCRYPT); // Perform software DES encryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(8, rxBuffer); // Transmit back ciphertext via UART
 				break;
 
 			case CMD_SWAES128_ENC_MISALIGNED:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
+				quiet_window_enter();
 				AES128_ECB_encrypt_misaligned(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function after key expansion
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
@@ -1124,41 +1373,49 @@ int main(void) {
 			//Software DES - encrypt with Random S-box order
 			case CMD_SWDES_ENC_RND_SBOX:
 				get_bytes(8, rxBuffer); // Receive DES plaintext
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				desRandomSboxes(keyDES, rxBuffer, ENCRYPT); // Perform software DES encryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(8, rxBuffer); // Transmit back ciphertext via UART
 				break;
 			//Software DES - encrypt with Random delays
 			case CMD_SWDES_ENC_RND_DELAYS:
 				get_bytes(8, rxBuffer); // Receive DES plaintext
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				desRandomDelays(keyDES, rxBuffer, ENCRYPT,2); // Perform software DES encryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(8, rxBuffer); // Transmit back ciphertext via UART
 				break;
 			//Software masked AES128 - encrypt
 			case CMD_SWAES128_ENC_MASKED:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
+				quiet_window_enter();
 				mAES128_ECB_encrypt(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function, includes masking process
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 			//Software masked AES128 - decrypt
 			case CMD_SWAES128_DEC_MASKED:
 				get_bytes(16, rxBuffer); // Receive AES ciphertext
+				quiet_window_enter();
 				mAES128_ECB_decrypt(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function, includes masking process
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back plaintext via UART
 				break;
 			//Software AES128 - random delays
 			case CMD_SWAES128_ENC_RNDDELAYS:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
+				quiet_window_enter();
 				AES128_ECB_encrypt_rndDelays(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function, includes masking process
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 			//Software AES128 - random sbox order
 			case CMD_SWAES128_ENC_RNDSBOX:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
+				quiet_window_enter();
 				AES128_ECB_encrypt_rndSbox(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function, includes masking process
+				quiet_window_exit();
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
@@ -1178,7 +1435,9 @@ int main(void) {
 				}
 				get_bytes(payload_len, rxBuffer);
 				input_cipher_text(payload_len); // Fill the cipher text buffer "c" with incoming data bytes, assuming MSByte first and 32-bit alignment
+				quiet_window_enter();
 				rsa_crt_decrypt(); // Start RSA CRT procedure, Trigger signal toggling contained within the call
+				quiet_window_exit();
 				send_clear_text(); // Send content of clear text buffer "m" back to Host PC, MSByte first 32-bit alignment
 				break;
 
@@ -1186,9 +1445,9 @@ int main(void) {
 			case CMD_SWAES128TTABLES_ENC:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
 				rijndaelSetupEncrypt(keyScheduleAES, keyAES, 128); //Prepare AES key schedule
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				rijndaelEncrypt(keyScheduleAES, 10, rxBuffer, rxBuffer + AES128LENGTHINBYTES); // Perform software AES encryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back ciphertext via UART
 				break;
 
@@ -1196,9 +1455,9 @@ int main(void) {
 			case CMD_SWAES128TTABLES_DEC:
 				get_bytes(16, rxBuffer); // Receive AES plaintext
 				rijndaelSetupDecrypt(keyScheduleAES, keyAES, 128); //Prepare AES key schedule
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				rijndaelDecrypt(keyScheduleAES, 10, rxBuffer, rxBuffer + AES128LENGTHINBYTES); // Perform software AES decryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16, rxBuffer + AES128LENGTHINBYTES); // Transmit back plaintext via UART
 				break;
 
@@ -1232,7 +1491,9 @@ int main(void) {
 				}
 				get_bytes(payload_len,rxBuffer);
 				input_cipher_text(payload_len);	// Fill the cipher text buffer "c" with incoming data bytes, assuming MSByte first and 32-bit alignment
+				quiet_window_enter();
 				rsa_sfm_decrypt();
+				quiet_window_exit();
 				send_clear_text();
 				break;
 			case CMD_RSASFM_SET_KEY_GENERATION_METHOD:
@@ -1284,7 +1545,9 @@ int main(void) {
 			case CMD_HWAES128_ENC:
 				get_bytes(16, rxBuffer);
 				//Trigger pin handling moved to CRYP_AES_ECB function
+				quiet_window_enter();
 				cryptoCompletedOK = CRYP_AES_ECB(MODE_ENCRYPT, keyAES, 128,	rxBuffer, (uint32_t) AES128LENGTHINBYTES, rxBuffer + AES128LENGTHINBYTES);
+				quiet_window_exit();
 				if (cryptoCompletedOK == SUCCESS) {
 					send_bytes(16, rxBuffer + AES128LENGTHINBYTES);
 				} else {
@@ -1296,7 +1559,9 @@ int main(void) {
 			case CMD_HWAES128_DEC:
 				get_bytes(16, rxBuffer);
 				//Trigger pin handling moved to CRYP_AES_ECB function
+				quiet_window_enter();
 				cryptoCompletedOK = CRYP_AES_ECB(MODE_DECRYPT, keyAES, 128,	rxBuffer, (uint32_t) AES128LENGTHINBYTES, rxBuffer + AES128LENGTHINBYTES);
+				quiet_window_exit();
 				if (cryptoCompletedOK == SUCCESS) {
 					send_bytes(16, rxBuffer + AES128LENGTHINBYTES);
 				} else {
@@ -1308,7 +1573,9 @@ int main(void) {
 			case CMD_HWAES256_ENC:
 				get_bytes(16, rxBuffer);
 				//Trigger pin handling moved to CRYP_AES_ECB function
+				quiet_window_enter();
 				cryptoCompletedOK = CRYP_AES_ECB(MODE_ENCRYPT, keyAES256, 256,	rxBuffer, (uint32_t) 16, rxBuffer + 16);
+				quiet_window_exit();
 				if (cryptoCompletedOK == SUCCESS) {
 					send_bytes(16, rxBuffer + 16);
 				} else {
@@ -1320,7 +1587,9 @@ int main(void) {
 			case CMD_HWAES256_DEC:
 				get_bytes(16, rxBuffer);
 				//Trigger pin handling moved to CRYP_AES_ECB function
+				quiet_window_enter();
 				cryptoCompletedOK = CRYP_AES_ECB(MODE_DECRYPT, keyAES256, 256,	rxBuffer, (uint32_t) 16, rxBuffer + 16);
+				quiet_window_exit();
 				if (cryptoCompletedOK == SUCCESS) {
 					send_bytes(16, rxBuffer + 16);
 				} else {
@@ -1332,7 +1601,9 @@ int main(void) {
 			case CMD_HWDES_ENC:
 				get_bytes(8, rxBuffer);
 				//Trigger pin handling moved to CRYP_DES_ECB function
+				quiet_window_enter();
 				cryptoCompletedOK=CRYP_DES_ECB(MODE_ENCRYPT,keyDES,rxBuffer,(uint32_t)8,rxBuffer+8);
+				quiet_window_exit();
 				if (cryptoCompletedOK == SUCCESS) {
 					send_bytes(8, rxBuffer + 8);
 				} else {
@@ -1344,7 +1615,9 @@ int main(void) {
 			case CMD_HWDES_DEC:
 				get_bytes(8, rxBuffer);
 				//Trigger pin handling moved to CRYP_DES_ECB function
+				quiet_window_enter();
 				cryptoCompletedOK=CRYP_DES_ECB(MODE_DECRYPT,keyDES,rxBuffer,(uint32_t)8,rxBuffer+8);
+				quiet_window_exit();
 				if (cryptoCompletedOK == SUCCESS) {
 					send_bytes(8, rxBuffer + 8);
 				} else {
@@ -1356,7 +1629,9 @@ int main(void) {
 			case CMD_HWTDES_ENC:
 				get_bytes(8, rxBuffer);
 				//Trigger pin handling moved to CRYP_DES_ECB function
+				quiet_window_enter();
 				cryptoCompletedOK=CRYP_TDES_ECB(MODE_ENCRYPT,keyTDES,rxBuffer,(uint32_t)8,rxBuffer+8);
+				quiet_window_exit();
 				if (cryptoCompletedOK == SUCCESS) {
 					send_bytes(8, rxBuffer + 8);
 				} else {
@@ -1368,7 +1643,9 @@ int main(void) {
 			case CMD_HWTDES_DEC:
 				get_bytes(8, rxBuffer);
 				//Trigger pin handling moved to CRYP_DES_ECB function
+				quiet_window_enter();
 				cryptoCompletedOK=CRYP_TDES_ECB(MODE_DECRYPT,keyTDES,rxBuffer,(uint32_t)8,rxBuffer+8);
+				quiet_window_exit();
 				if (cryptoCompletedOK == SUCCESS) {
 					send_bytes(8, rxBuffer + 8);
 				} else {
@@ -1387,7 +1664,9 @@ int main(void) {
 				get_bytes(20, rxBuffer);
 				RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_HASH, ENABLE);
 				// 24 byte key used is the same as the TDES key!!
+				quiet_window_enter();
 				cryptoCompletedOK = HMAC_SHA1(keyTDES, sizeof(keyTDES), rxBuffer+sizeof(uint32_t), 20, rxBuffer+24, iterations);
+				quiet_window_exit();
 				RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_HASH, DISABLE);
 
 				if (cryptoCompletedOK == SUCCESS) {
@@ -1408,9 +1687,9 @@ int main(void) {
 				get_bytes(16, rxBuffer);
 
 				RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_HASH, ENABLE);
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				cryptoCompletedOK = HASH_SHA1(rxBuffer+sizeof(uint32_t), 16, rxBuffer+20, iterations);
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_HASH, DISABLE);
 
 				if (cryptoCompletedOK == SUCCESS) {
@@ -1427,38 +1706,38 @@ int main(void) {
 			//TDES key change
 			case CMD_TDES_KEYCHANGE:
 				get_bytes(24, rxBuffer);
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				for (i = 0; i < 24; i++) keyTDES[i] = rxBuffer[i];
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(24,keyTDES);
 				break;
 
 			//DES key change
 			case CMD_DES_KEYCHANGE:
 				get_bytes(8, rxBuffer);
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				for (i = 0; i < 8; i++) keyDES[i] = rxBuffer[i];
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(8,keyDES);
 				break;
 
 			//AES128 key change
 			case CMD_AES128_KEYCHANGE:
 				get_bytes(16, rxBuffer);
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				for (i = 0; i < 16; i++) keyAES[i] = rxBuffer[i];
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16,keyAES);
 				break;
 
 			//AES256 key change
 			case CMD_AES256_KEYCHANGE:
 				get_bytes(32, rxBuffer);
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				for (i = 0; i < 32; i++) keyAES256[i] = rxBuffer[i];
 				//Recompute again aes256 key schedule
 				aes256_init(&ctx,keyAES256); //Prepare AES key schedule for software AES256
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(32,keyAES256);
 				break;
 
@@ -1466,18 +1745,18 @@ int main(void) {
 			case CMD_PWD_CHANGE:
 				authenticated=0;
 				get_bytes(4, rxBuffer);
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				for (i = 0; i < 4; i++) password[i] = rxBuffer[i];
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(4,password);
 				break;
 
 			//SM4 key change
 			case CMD_SM4_KEYCHANGE:
 				get_bytes(16, rxBuffer);
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				for (i = 0; i < 16; i++) keySM4[i] = rxBuffer[i];
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_bytes(16,keySM4);
 				break;
 
@@ -1488,7 +1767,7 @@ int main(void) {
 			case CMD_SOFTWARE_KEY_COPY:
 				get_bytes(16, rxBuffer); // Receive AES128 key (16 byte)
 				for (i = 0; i < 16; i++) keyLoadingAES[i] = 0; //Initialize key array
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on PC2 for key loading
+				TRIGGER_ON(); //Trigger on PC2 for key loading
 				busyWait1=0;
 				while (busyWait1 < 500) busyWait1++; //For avoiding ringing on GPIO toggling
 
@@ -1527,7 +1806,7 @@ int main(void) {
 				busyWait1++;busyWait1++;busyWait1++;busyWait1++;busyWait1++;busyWait1++;busyWait1++;busyWait1++;busyWait1++;busyWait1++;
 				//End of key-copy
 
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off PC2 end of key loading
+				TRIGGER_OFF(); //Trigger off PC2 end of key loading
 				send_bytes(16, keyLoadingAES); // Transmit back loaded key via UART
 				break;
 
@@ -1536,7 +1815,7 @@ int main(void) {
 
 			//Infinite loop for FI (has a NOP sled after the infinite loop)
 			case CMD_INFINITE_FI_LOOP:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				while (1) {
 					oled_sendchar(".");
 					busyWait1 = 0;
@@ -1602,7 +1881,7 @@ int main(void) {
 						"mov r0,r0\n"
 						"mov r0,r0\n"
 						);
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char('G');send_char('l');send_char('i');send_char('t');send_char('c');send_char('e');send_char('d');send_char('!');
 				break;
 
@@ -1615,12 +1894,12 @@ int main(void) {
 				payload_len <<= 8;
 				get_char(&tmp);
 				payload_len |= tmp;
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				while (payload_len) {
 					payload_len--;
 					upCounter++;
 				}
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char(0xA5);
 				send_char((payload_len>>8)&0x000000FF); //MSB first
 				send_char( payload_len    &0x000000FF);
@@ -1635,7 +1914,7 @@ int main(void) {
 				volatile int charsOK = 0;
 				authenticated = 0;
 				get_bytes(4, rxBuffer);
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				//Small delay to have a bit of time between trigger to glitch
 				__asm __volatile__("mov r0,r0\n"
 						"mov r0,r0\n"
@@ -1667,7 +1946,7 @@ int main(void) {
 						charsOK = charsOK + 1;
 					}
 				}
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				if (charsOK == 4) {
 					authenticated=1;
 					send_char(0x90);send_char(0x00);
@@ -1682,7 +1961,7 @@ int main(void) {
 				volatile int charsOK = 0;
 				authenticated = 0;
 				get_bytes(4, rxBuffer);
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				//Small delay to have a bit of time between trigger to glitch
 				__asm __volatile__("mov r0,r0\n"
 						"mov r0,r0\n"
@@ -1751,7 +2030,7 @@ int main(void) {
 				} else {
 					send_char(0x69);send_char(0x00);
 				}
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				break;
 			}
 
@@ -1762,10 +2041,10 @@ int main(void) {
 				for(i=0;i<8;i++){
 					rxBuffer[8+i]=rxBuffer[i];
 				}
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				des(keyDES, rxBuffer, ENCRYPT); // Perform software DES encryption
 				des(keyDES, rxBuffer+8, ENCRYPT); // Perform second software DES encryption
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				//Compare the two encrypted texts; if same, transmit them, otherwise send nothing
 				if(memcmp(rxBuffer,rxBuffer+8,8)==0){
 					send_bytes(8, rxBuffer); // Transmit back ciphertext via UART
@@ -1782,7 +2061,9 @@ int main(void) {
 				rijndaelSetupDecrypt(keyScheduleAES, keyAES, 128); //Prepare T-Tables AES key schedule for double check
 
 				//Encrypt with textbook AES128 for easing the glitch
+				quiet_window_enter();
 				AES128_ECB_encrypt(rxBuffer, keyAES, rxBuffer + AES128LENGTHINBYTES); //Trigger is coded inside aes function after key expansion
+				quiet_window_exit();
 				//Decrypt with T-Tables AES for speed
 				rijndaelDecrypt(keyScheduleAES, 10, rxBuffer + AES128LENGTHINBYTES, decrypted_input); // Perform software AES decryption
 
@@ -1801,10 +2082,10 @@ int main(void) {
 				volatile uint32_t randomNumber;
 				RNG_Enable();
 				//Get a random number
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				while (RNG_GetFlagStatus(RNG_FLAG_DRDY) == RESET){}
 				randomNumber=RNG_GetRandomNumber();
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				RNG_Disable();
 				send_char((randomNumber>>24)&0x000000FF); //MSB first
 				send_char((randomNumber>>16)&0x000000FF);
@@ -1826,11 +2107,11 @@ int main(void) {
 
 			//Send stm32f4 chip UID via I/O interface
 			case CMD_UID_VIA_IO:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				uint32_t uidBlock1 = STM32F4ID[0];
 				uint32_t uidBlock2 = STM32F4ID[1];
 				uint32_t uidBlock3 = STM32F4ID[2];
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				send_char((uidBlock1>>24)&0x000000FF); //MSB first
 				send_char((uidBlock1>>16)&0x000000FF);
 				send_char((uidBlock1>> 8)&0x000000FF);
@@ -1847,9 +2128,9 @@ int main(void) {
 
 			//Code version command: returns code version string (8 bytes, "Ver x.x" ASCII encoded) on code revision 2.0 or higher, "BadCmd" on code revision 1.0
 			case CMD_GET_CODE_REV:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				send_bytes(8, codeVersion);
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				break;
 
 			//Change clock speed on-the-fly and restart peripherals; predefined speeds are 16, 30, 84 and 168MHz. If parameter is not in this list, speed will be set to 168MHz by default.
@@ -1866,9 +2147,20 @@ int main(void) {
 				send_char(clockSource);
 				break;
 
+			//Select the quiet window mode (QUIET_OFF, QUIET_ON, QUIET_ON_KEEP_CRYP) used while the trigger of a given command is high
+			case CMD_SET_QUIET_WINDOW:
+				get_char(&tmp);
+				get_char(&quietWindowMode[tmp]);
+				if (quietWindowMode[tmp] > QUIET_ON_KEEP_CRYP) {
+					quietWindowMode[tmp] = QUIET_ON;
+				}
+				send_char(tmp);
+				send_char(quietWindowMode[tmp]);
+				break;
+
 			//Unknown command byte: return error or 4 times (0x90 0x00) if board was glitched during boot
 			default:
-				GPIOC->BSRRL = GPIO_Pin_2; //Trigger on
+				TRIGGER_ON(); //Trigger on
 				if (glitchedBoot) {
 					for (i = 0; i < 4; i++){
 						send_char(0x90);
@@ -1888,7 +2180,7 @@ int main(void) {
 				else{
 					send_bytes(8, cmdByteIsWrong);
 				}
-				GPIOC->BSRRH = GPIO_Pin_2; //Trigger off
+				TRIGGER_OFF(); //Trigger off
 				break;
 		}
 	}
@@ -1981,9 +2273,11 @@ void usart_init(void) {
 	 - Hardware flow control disabled (RTS and CTS signals)
 	 - Receive and transmit enabled
 	 - PC10 TX pin, PC11 RX pin
+	 - RX by DMA1 Stream1 channel 4 into the rxRing circular buffer
 	 */
 	GPIO_InitTypeDef GPIO_InitStructure;
 	USART_InitTypeDef USART_InitStructure;
+	DMA_InitTypeDef DMA_InitStructure;
 
 	/* Enable GPIO clock */
 	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOC, ENABLE);
@@ -2022,6 +2316,29 @@ void usart_init(void) {
 	/* USART configuration */
 	USART_Init(USART3, &USART_InitStructure);
 
+	/* Received bytes are copied to rxRing by DMA1 Stream1 in circular mode, without interrupts: the DMA keeps
+	 * receiving while interrupts are masked in the trigger windows, and get_command() reads the ring */
+	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
+	DMA_DeInit(DMA1_Stream1);
+	DMA_InitStructure.DMA_Channel = DMA_Channel_4;
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t) &USART3->DR;
+	DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t) rxRing;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralToMemory;
+	DMA_InitStructure.DMA_BufferSize = RXRINGLENGTH;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+	DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
+	DMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_Full;
+	DMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+	DMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+	DMA_Init(DMA1_Stream1, &DMA_InitStructure);
+	DMA_Cmd(DMA1_Stream1, ENABLE);
+	USART_DMACmd(USART3, USART_DMAReq_Rx, ENABLE);
+
 	/* Enable USART */
 	USART_Cmd(USART3, ENABLE);
 
@@ -2107,6 +2424,13 @@ void send_bytes(uint32_t nbytes, uint8_t* ba) {
 		send_bytes_uart(nbytes,ba);
 	}
 }
+//get_uint32: receive a 32-bit parameter, MSByte first, assembled byte by byte (no unaligned word read of the buffer)
+uint32_t get_uint32() {
+	uint8_t p[4];
+	get_bytes(4, p);
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
 //get_char: receive a byte via IO interface
 void get_char(uint8_t *ch) {
 	if (usbSerialEnabled) {
@@ -2124,14 +2448,97 @@ void send_char(uint8_t ch) {
 	}
 }
 
+//rx_ring_write: position in rxRing of the next byte the DMA writes (NDTR counts down from RXRINGLENGTH and reloads)
+uint16_t rx_ring_write(void) {
+	return (RXRINGLENGTH - DMA1_Stream1->NDTR) & (RXRINGLENGTH - 1);
+}
+
+//rx_ring_get: wait for the next received byte; returns 0 if the USART overran meanwhile (a byte was lost)
+uint8_t rx_ring_get(uint8_t *ch) {
+	while (rx_ring_write() == rxRingRead) {
+		if (USART3->SR & USART_SR_ORE) {
+			return 0;
+		}
+	}
+	if (USART3->SR & USART_SR_ORE) {
+		return 0;
+	}
+	*ch = rxRing[rxRingRead];
+	rxRingRead = (rxRingRead + 1) & (RXRINGLENGTH - 1);
+	return 1;
+}
+
+//rx_resync: after an overrun the lost byte may belong to any frame in the ring, so its bytes are not parsed as commands:
+//everything is dropped until the line has been idle for RXIDLETICKS ms, and the next byte is taken as a command byte
+void rx_resync(void) {
+	uint16_t write;
+	uint8_t idle = 0;
+
+	rxOverruns++;
+	(void) USART3->SR;
+	(void) USART3->DR; //Reading SR then DR clears ORE
+	(void) SysTick->CTRL; //Clears COUNTFLAG
+	write = rx_ring_write();
+	while (idle < RXIDLETICKS) {
+		if (USART3->SR & USART_SR_ORE) {
+			(void) USART3->DR;
+			idle = 0;
+		}
+		if (rx_ring_write() != write) {
+			write = rx_ring_write();
+			idle = 0;
+		}
+		if (SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) {
+			idle++;
+		}
+	}
+	rxRingRead = write;
+}
+
+//get_command: wait for the next command byte. Over USART3 the whole frame (command + payload) is received before the
+//command runs. A frame that lost a byte to a USART overrun is answered with cmdByteIsWrong (CMD_UNKNOWN)
+void get_command(uint8_t *cmd) {
+	uint16_t expected;
+	uint8_t ok;
+
+	if (usbSerialEnabled) {
+		get_char_usb(cmd);
+		return;
+	}
+
+	rxFrame.len = 0;
+	rxFrame.readIdx = 0;
+	ok = rx_ring_get(&rxFrame.cmd);
+	expected = cmd_payload_length(rxFrame.cmd);
+	if (ok && expected == PAYLOAD_LEN_PREFIXED) {
+		ok = rx_ring_get(&rxFrame.data[0]) && rx_ring_get(&rxFrame.data[1]);
+		rxFrame.len = 2;
+		expected = (rxFrame.data[0] << 8) | rxFrame.data[1];
+		//Same truncation as the command handlers; extra bytes are parsed as the next command, as before
+		if (expected > RXBUFFERLENGTH) {
+			expected = RXBUFFERLENGTH;
+		}
+		expected += 2;
+	}
+	while (ok && rxFrame.len < expected) {
+		ok = rx_ring_get(&rxFrame.data[rxFrame.len]);
+		rxFrame.len++;
+	}
+
+	if (!ok) {
+		rx_resync();
+		rxFrame.cmd = CMD_UNKNOWN;
+		rxFrame.len = 0;
+	}
+	*cmd = rxFrame.cmd;
+}
+
 //UART IO
-//get_bytes: get an amount of nbytes bytes from uart into byte array ba
+//get_bytes: get an amount of nbytes bytes of the current command frame into byte array ba
 void get_bytes_uart(uint32_t nbytes, uint8_t* ba) {
 	int i;
 	for (i = 0; i < nbytes; i++) {
-		while ((USART3->SR & USART_SR_RXNE) == 0);
-
-		ba[i] = (uint8_t) USART_ReceiveData(USART3);
+		get_char_uart(&ba[i]);
 	}
 }
 //send_bytes: send an amount of nbytes bytes from byte array ba via uart
@@ -2143,11 +2550,15 @@ void send_bytes_uart(uint32_t nbytes, uint8_t* ba) {
 		USART_SendData(USART3, ba[i]);
 	}
 }
-//get_char: receive a byte via uart
+//get_char: receive the next byte of the current command frame (copied from rxRing by get_command)
 void get_char_uart(uint8_t *ch) {
-	while ((USART3->SR & USART_SR_RXNE) == 0);
+	rxFrame_t *frame = &rxFrame;
 
-	*ch = (uint8_t) USART_ReceiveData(USART3);
+	if (frame->readIdx < frame->len) {
+		*ch = frame->data[frame->readIdx++];
+	} else {
+		*ch = 0; //Handler asked for more bytes than the frame carries
+	}
 }
 //send_char: send a byte via uart
 void send_char_uart(uint8_t ch) {
@@ -2216,6 +2627,7 @@ void readByteFromInputBuffer(uint8_t *ch) {
 }
 void CrashGracefully(void) {
 	//Put anything you would like here to happen on a hard fault
+	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOFEN; //GPIOF clock may be gated by the quiet window of an error program
 	GPIOF->BSRRH = GPIO_Pin_6; //Example handler: PF6 enabled
 }
 
@@ -2356,6 +2768,80 @@ void enable_clocks() {
 	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOC, ENABLE);
 }
 
+//Quiet window for triggered sections
+//Peripherals not needed while PC2 is high: GPIO banks other than GPIOC (trigger and USART3 pins), SPI2 (OLED display).
+//DMA1 stays clocked: it stores the bytes the host sends during the window
+#define QUIET_AHB1_GATED (RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOBEN | RCC_AHB1ENR_GPIOFEN | RCC_AHB1ENR_GPIOHEN)
+#define QUIET_APB1_GATED (RCC_APB1ENR_SPI2EN)
+
+void quiet_window_init() {
+	int c;
+	for (c = 0; c < 256; c++) quietWindowMode[c] = QUIET_ON;
+
+	//Commands that use a gated peripheral around the trigger
+	quietWindowMode[CMD_INFINITE_FI_LOOP] = QUIET_OFF; //Writes to the OLED display with the trigger high
+	quietWindowMode[CMD_SWAES128SPI_ENC] = QUIET_OFF; //Last SPI2 byte may still be shifting out when the crypto starts
+	quietWindowMode[CMD_HWAES128_ENC] = QUIET_ON_KEEP_CRYP;
+	quietWindowMode[CMD_HWAES128_DEC] = QUIET_ON_KEEP_CRYP;
+	quietWindowMode[CMD_HWAES256_ENC] = QUIET_ON_KEEP_CRYP;
+	quietWindowMode[CMD_HWAES256_DEC] = QUIET_ON_KEEP_CRYP;
+	quietWindowMode[CMD_HWDES_ENC] = QUIET_ON_KEEP_CRYP;
+	quietWindowMode[CMD_HWDES_DEC] = QUIET_ON_KEEP_CRYP;
+	quietWindowMode[CMD_HWTDES_ENC] = QUIET_ON_KEEP_CRYP;
+	quietWindowMode[CMD_HWTDES_DEC] = QUIET_ON_KEEP_CRYP;
+	quietWindowMode[CMD_HMAC_SHA1] = QUIET_ON_KEEP_CRYP;
+	quietWindowMode[CMD_SHA1_HASH] = QUIET_ON_KEEP_CRYP;
+}
+
+void quiet_window_enter() {
+	uint32_t ahb1Gated = QUIET_AHB1_GATED;
+	uint32_t ahb2Gated = RCC_AHB2ENR_CRYPEN;
+
+	if (quietActive != QUIET_OFF) {
+		return; //Already inside a quiet window
+	}
+	if (quietWindowMode[currentCmd] == QUIET_OFF) {
+		return;
+	}
+
+	//With serial over USB, the OTG interrupt and its pins on GPIOA are the I/O interface and stay active
+	quietSavedPRIMASK = __get_PRIMASK();
+	if (!usbSerialEnabled) {
+		__disable_irq();
+	} else {
+		ahb1Gated &= ~RCC_AHB1ENR_GPIOAEN;
+	}
+	if (quietWindowMode[currentCmd] == QUIET_ON_KEEP_CRYP) {
+		ahb2Gated = 0;
+	}
+
+	quietSavedSysTick = SysTick->CTRL;
+	SysTick->CTRL = quietSavedSysTick & ~SysTick_CTRL_ENABLE_Msk;
+
+	quietSavedAHB1 = RCC->AHB1ENR;
+	quietSavedAHB2 = RCC->AHB2ENR;
+	quietSavedAPB1 = RCC->APB1ENR;
+	RCC->AHB1ENR = quietSavedAHB1 & ~ahb1Gated;
+	RCC->AHB2ENR = quietSavedAHB2 & ~ahb2Gated;
+	RCC->APB1ENR = quietSavedAPB1 & ~QUIET_APB1_GATED;
+	__DSB();
+
+	quietActive = QUIET_ON;
+}
+
+void quiet_window_exit() {
+	if (quietActive == QUIET_ON) {
+		//Restore the saved state (RSA code may have changed the clocks with disable_clocks/enable_clocks meanwhile)
+		RCC->AHB1ENR = quietSavedAHB1;
+		RCC->AHB2ENR = quietSavedAHB2;
+		RCC->APB1ENR = quietSavedAPB1;
+		__DSB();
+		SysTick->CTRL = quietSavedSysTick;
+		__set_PRIMASK(quietSavedPRIMASK);
+	}
+	quietActive = QUIET_OFF;
+}
+
 //TRNG enable and disable
 void RNG_Enable(void)
 {
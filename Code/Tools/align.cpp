@@ -0,0 +1,178 @@
+//Alignment of the traces on a reference of their program (see align.h)
+
+#include "align.h"
+#include "parallel.h"
+#include "simd.h"
+#include "spectrum.h"
+#include "trace_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+align_options align_window(const align_options &o, size_t n) {
+	align_options w = o;
+	if (w.iterations == 0) throw std::invalid_argument("align: at least one iteration");
+	if (w.start == 0) w.start = w.maxShift;
+	if (w.start < w.maxShift) throw std::invalid_argument("align: the window must start at least maxShift samples into the traces");
+	if (w.length == 0 && w.start + w.maxShift < n) w.length = n - w.maxShift - w.start;
+	if (w.length < 2 || w.start + w.length + w.maxShift > n) {
+		throw std::invalid_argument("align: the window and the shifts do not fit in traces of " + std::to_string(n) + " samples");
+	}
+	return w;
+}
+
+//shifted: x(first + t + shift) for t < count into out, x being a trace of n samples (Catmull-Rom between the samples
+//around every position, the first and last samples repeated beyond the ends)
+static void shifted(const float *x, size_t n, double shift, size_t first, size_t count, double *out) {
+	const double whole = std::floor(shift), f = shift - whole;
+	const double w0 = 0.5 * f * (-1.0 + f * (2.0 - f)), w1 = 0.5 * (2.0 + f * f * (-5.0 + 3.0 * f));
+	const double w2 = 0.5 * f * (1.0 + f * (4.0 - 3.0 * f)), w3 = 0.5 * f * f * (f - 1.0);
+	const long last = (long) n - 1;
+	auto at = [&](long i) { return (double) x[std::min(std::max(i, 0L), last)]; };
+	long i = (long) whole + (long) first - 1; //Sample weighted by w0
+	for (size_t t = 0; t < count; t++, i++) {
+		if (i >= 0 && i + 3 <= last) out[t] = w0 * x[i] + w1 * x[i + 1] + w2 * x[i + 2] + w3 * x[i + 3];
+		else out[t] = w0 * at(i) + w1 * at(i + 1) + w2 * at(i + 2) + w3 * at(i + 3);
+	}
+}
+
+void align_traces(const float *x, size_t count, size_t n, size_t ld, const int32_t *groups, const align_options &o, double *shifts,
+	double *correlations) {
+	const align_options w = align_window(o, n);
+	const size_t W = SIMD_DWIDTH, M = w.maxShift, L = w.length, span = L + 2 * M;
+	//No lag wraps around: the correlation at lag j sums the samples j to j + L - 1 < span of the trace window
+	const rfft_plan plan(rfft_length(span));
+	const size_t bins = plan.bins();
+
+	//Traces of every group in index order, and the batches of up to lanes traces of one group
+	const group_batches grouped(groups, count, W);
+	const auto &members = grouped.members;
+	const auto &batches = grouped.batches;
+
+	std::fill(shifts, shifts + count, 0.0);
+	std::vector<double> refRe(members.size() * bins), refIm(members.size() * bins), refNorm(members.size());
+	for (size_t iteration = 0; iteration < w.iterations; iteration++) {
+		//References: spectrum and norm of the centered window of the mean of the traces of every group, at their shifts
+		parallel_for(members.size(), 1, [&](size_t begin, size_t end) {
+			std::vector<double> sum(L), value(L), work(plan.workspace()), re(bins * W), im(bins * W);
+			std::vector<float> mean(L);
+			for (size_t g = begin; g < end; g++) {
+				std::fill(sum.begin(), sum.end(), 0.0);
+				for (size_t i : members[g]) {
+					shifted(x + i * ld, n, shifts[i], w.start, L, value.data());
+					for (size_t t = 0; t < L; t++) sum[t] += value[t];
+				}
+				double average = 0.0, norm = 0.0;
+				for (size_t t = 0; t < L; t++) {
+					mean[t] = (float) (sum[t] / members[g].size());
+					average += mean[t];
+				}
+				average /= L;
+				for (size_t t = 0; t < L; t++) norm += (mean[t] - average) * (mean[t] - average);
+				const float *row = mean.data();
+				plan.forward(&row, 1, L, nullptr, true, re.data(), im.data(), work.data());
+				for (size_t k = 0; k < bins; k++) {
+					refRe[g * bins + k] = re[k * W];
+					refIm[g * bins + k] = im[k * W];
+				}
+				refNorm[g] = std::sqrt(norm);
+			}
+		});
+
+		//Shifts: correlations of the trace windows with the reference at every lag, by the spectra of the batches
+		parallel_for(batches.size(), 1, [&](size_t begin, size_t end) {
+			std::vector<double> work(plan.workspace()), re(bins * W), im(bins * W), c(plan.size() * W), rho(2 * M + 1);
+			const float *rows[SIMD_DWIDTH];
+			for (size_t b = begin; b < end; b++) {
+				const size_t g = batches[b].first, *trace = members[g].data() + batches[b].second;
+				const size_t nt = std::min(W, members[g].size() - batches[b].second);
+				for (size_t l = 0; l < nt; l++) rows[l] = x + trace[l] * ld + w.start - M;
+				plan.forward(rows, nt, span, nullptr, true, re.data(), im.data(), work.data());
+				//X[k] conj(R[k])
+				for (size_t k = 0; k < bins; k++) {
+					const simd_dvec xr = simd_dload(re.data() + k * W), xi = simd_dload(im.data() + k * W);
+					const simd_dvec rr = simd_dset1(refRe[g * bins + k]), ri = simd_dset1(refIm[g * bins + k]);
+					simd_dstore(re.data() + k * W, simd_dadd(simd_dmul(xr, rr), simd_dmul(xi, ri)));
+					simd_dstore(im.data() + k * W, simd_dsub(simd_dmul(xi, rr), simd_dmul(xr, ri)));
+				}
+				plan.inverse(re.data(), im.data(), c.data(), work.data());
+
+				for (size_t l = 0; l < nt; l++) {
+					//Pearson correlation at every lag j: the reference is centered, so c[j] is the covariance up to L,
+					//and the variance of the samples [j, j + L) comes from sliding sums of the centered window
+					const float *v = rows[l];
+					double mean = 0.0;
+					for (size_t t = 0; t < span; t++) mean += v[t];
+					mean /= span;
+					double s1 = 0.0, s2 = 0.0;
+					for (size_t t = 0; t < L; t++) {
+						s1 += v[t] - mean;
+						s2 += (v[t] - mean) * (v[t] - mean);
+					}
+					size_t best = 0;
+					for (size_t j = 0; j <= 2 * M; j++) {
+						if (j) {
+							const double in = v[j + L - 1] - mean, out = v[j - 1] - mean;
+							s1 += in - out;
+							s2 += in * in - out * out;
+						}
+						const double variance = s2 - s1 * s1 / L;
+						rho[j] = variance > 0.0 && refNorm[g] > 0.0 ? c[j * W + l] / (std::sqrt(variance) * refNorm[g]) : 0.0;
+						if (rho[j] > rho[best]) best = j;
+					}
+					//Vertex of the parabola through the peak and its neighbors
+					double delta = 0.0;
+					if (best > 0 && best < 2 * M) {
+						const double curvature = rho[best - 1] - 2.0 * rho[best] + rho[best + 1];
+						if (curvature < 0.0) delta = 0.5 * (rho[best - 1] - rho[best + 1]) / curvature;
+					}
+					shifts[trace[l]] = (double) best - (double) M + delta;
+					correlations[trace[l]] = rho[best];
+				}
+			}
+		});
+	}
+}
+
+void apply_shifts(const float *x, size_t count, size_t n, size_t ld, const double *shifts, float *out, size_t ldOut) {
+	for (size_t i = 0; i < count; i++) {
+		if (!std::isfinite(shifts[i])) throw std::invalid_argument("align: shift " + std::to_string(i) + " is not finite");
+	}
+	parallel_for(count, 16, [&](size_t begin, size_t end) {
+		std::vector<double> value(n);
+		for (size_t i = begin; i < end; i++) {
+			shifted(x + i * ld, n, shifts[i], 0, n, value.data());
+			for (size_t t = 0; t < n; t++) out[i * ldOut + t] = (float) value[t];
+		}
+	});
+}
+
+void trace_file_add_alignment(const std::string &path, const align_options &o) {
+	const trace_file file(path);
+	const size_t count = file.count(), n = file.length();
+	const align_options w = align_window(o, n);
+
+	//All the traces in physical units (count x length floats), read by blocks
+	std::vector<float> x(count * n);
+	std::vector<int32_t> labels(count);
+	file.for_each_block([&](size_t first, size_t nt) { file.read_traces(first, nt, x.data() + first * n); });
+	for (size_t i = 0; i < count; i++) labels[i] = file.records()[i].label;
+	std::vector<double> shifts(count), correlations(count);
+	align_traces(x.data(), count, n, n, labels.data(), w, shifts.data(), correlations.data());
+
+	trace_shifts_header sh = trace_shifts_header();
+	sh.start = w.start;
+	sh.length = w.length;
+	sh.maxShift = w.maxShift;
+	sh.iterations = w.iterations;
+	std::vector<trace_shift> rows(count);
+	for (size_t i = 0; i < count; i++) rows[i] = { (float) shifts[i], (float) correlations[i] };
+	trace_file_appender out(path);
+	const uint64_t offset = out.reserve(TRACE_SECTION_SHIFTS, sizeof(sh) + count * sizeof(trace_shift));
+	out.write(offset, &sh, sizeof(sh));
+	out.write(offset + sizeof(sh), rows.data(), count * sizeof(trace_shift));
+	out.commit();
+}
@@ -0,0 +1,47 @@
+//Alignment of the traces on a reference of their program. The scope triggers on PC2, but the trigger edge is sampled
+//with jitter and the work before the triggered code varies, so the traces of a program are shifted by up to tens of
+//samples, which the PCA of main.py would take as variance.
+//
+//The shift of a trace is the lag that maximizes its normalized cross-correlation with the reference of its group over a
+//window: the reference on [start, start + length) against the trace on [start - maxShift, start + length + maxShift).
+//All the lags of a trace come from one product of spectra (spectrum.h), several traces at once, and the Pearson
+//correlation of every lag from sliding sums of the trace; the best lag is refined to a fraction of a sample by the
+//parabola through its neighbors. apply_shifts resamples every trace at t + shift (Catmull-Rom cubic interpolation, the
+//first and last samples repeated beyond the ends).
+//
+//The reference of a group is the mean of its traces, summed in trace order; every further iteration recomputes it from
+//the traces aligned by the previous one and aligns the traces again.
+
+#ifndef __ALIGN_H
+#define __ALIGN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+struct align_options {
+	size_t start = 0; //First sample of the reference window, 0 for maxShift
+	size_t length = 0; //Samples of the window, 0 for all up to maxShift before the end of the traces
+	size_t maxShift = 64; //Largest shift searched, in samples
+	size_t iterations = 1; //Passes, each one against the mean of the traces aligned by the previous one
+};
+
+//align_window: o with the defaults resolved for traces of n samples; throws std::invalid_argument if the window and
+//the shifts do not fit in the traces
+align_options align_window(const align_options &o, size_t n);
+
+//align_traces: shift (x[i](t + shift) matches the reference at t) and correlation with the reference at that shift of
+//count traces of n samples (rows ld floats apart), each against the reference of its group (groups[i], e.g. the program
+//label)
+void align_traces(const float *x, size_t count, size_t n, size_t ld, const int32_t *groups, const align_options &o, double *shifts,
+	double *correlations);
+
+//apply_shifts: out[i][t] = x[i](t + shifts[i]), for count traces of n samples (rows ld and ldOut floats apart)
+void apply_shifts(const float *x, size_t count, size_t n, size_t ld, const double *shifts, float *out, size_t ldOut);
+
+//trace_file_add_alignment: aligns the traces of the container at path, in physical units, each on the reference of its
+//program label, and stores the shifts and correlations in it, replacing those it may have
+void trace_file_add_alignment(const std::string &path, const align_options &o);
+
+#endif
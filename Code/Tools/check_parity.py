@@ -0,0 +1,208 @@
+#! /usr/bin/python
+
+#Parity check of ../sca_native.py against scikit-learn and scipy on synthetic data: every replacement is run next to
+#the function it replaces and compared within a tolerance of its precision. Prints one line per check and
+#exits with 1 if any check fails. Build libsca.so first (README.md).
+
+import os
+import sys
+import numpy as np
+import scipy.fft
+import scipy.signal
+import scipy.stats
+import sklearn.cluster
+import sklearn.datasets
+import sklearn.decomposition
+import sklearn.metrics
+import sklearn.neighbors
+import sklearn.preprocessing
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import sca_native
+
+failures = []
+
+
+def check(name, ok, detail=''):
+    print('%-40s %s%s' % (name, 'ok' if ok else 'MISMATCH', '  ' + detail if detail else ''))
+    if not ok:
+        failures.append(name)
+
+
+def close(name, native, reference, rtol, atol=0.0):
+    #Element-wise comparison, the error relative to the largest reference value
+    native = np.asarray(native, dtype=np.float64)
+    reference = np.asarray(reference, dtype=np.float64)
+    if native.shape != reference.shape:
+        check(name, False, 'shape %s, expected %s' % (native.shape, reference.shape))
+        return
+    error = np.max(np.abs(native - reference)) if native.size else 0.0
+    bound = rtol * max(np.max(np.abs(reference)) if reference.size else 0.0, 1e-300) + atol
+    check(name, bool(error <= bound), 'max error %.3g (bound %.3g)' % (error, bound))
+
+
+def equal(name, native, reference):
+    native = np.asarray(native)
+    reference = np.asarray(reference)
+    if native.shape != reference.shape:
+        check(name, False, 'shape %s, expected %s' % (native.shape, reference.shape))
+        return
+    differ = int(np.sum(native != reference))
+    check(name, differ == 0, '%d of %d differ' % (differ, reference.size) if differ else '')
+
+
+#### SYNTHETIC DATA ####----------------
+
+rng = np.random.RandomState(0)
+
+#Traces: a few programs with their own mean trace, a low-rank common part and noise
+TRACES, SAMPLES, PROGRAMS = 600, 1000, 3
+t = np.arange(SAMPLES)
+labels = np.repeat(np.arange(PROGRAMS), TRACES // PROGRAMS)
+templates = np.array([np.sin(2 * np.pi * t * (p + 1) / 97.0) * (1.0 + 0.2 * p) for p in range(PROGRAMS)])
+loadings = rng.randn(TRACES, 4) * np.array([5.0, 3.0, 2.0, 1.0])
+basis = rng.randn(4, SAMPLES)
+X = (templates[labels] + loadings @ basis + 0.1 * rng.randn(TRACES, SAMPLES)).astype(np.float32)
+
+#Points: well separated blobs, as PCA projections of the programs
+points, blobs = sklearn.datasets.make_blobs(n_samples=500, centers=4, n_features=3, cluster_std=0.6, random_state=1)
+
+
+#### STANDARDIZATION AND PCA ####----------------
+
+reference = sklearn.preprocessing.StandardScaler().fit(X)
+native = sca_native.StandardScaler().fit(X)
+close('StandardScaler.mean_', native.mean_, reference.mean_, 1e-6)
+close('StandardScaler.var_', native.var_, reference.var_, 1e-5)
+close('StandardScaler.transform', native.transform(X), reference.transform(X), 1e-5)
+
+scaled = reference.transform(X).astype(np.float32)
+reference = sklearn.decomposition.PCA(n_components=4, svd_solver='full').fit(scaled)
+native = sca_native.PCA(n_components=4, random_state=0).fit(scaled)
+close('PCA.explained_variance_ratio_', native.explained_variance_ratio_, reference.explained_variance_ratio_, 1e-4)
+close('PCA.singular_values_', native.singular_values_, reference.singular_values_, 1e-4)
+#Same subspace: the components of a randomized SVD are equal up to their sign
+close('PCA.components_ (abs)', np.abs(native.components_), np.abs(reference.components_), 1e-3)
+
+
+#### SPECTRA ####----------------
+
+close('magnitude_spectra', sca_native.magnitude_spectra(X), np.abs(scipy.fft.rfft(X.astype(np.float64))), 1e-5)
+for q in (2, 5):
+    close('decimate q=%d' % q, sca_native.decimate(X, q), scipy.signal.decimate(X.astype(np.float64), q, ftype='fir'), 1e-5)
+for window, detrend in (('hann', 'constant'), ('hamming', 'constant'), ('blackman', False), ('boxcar', False)):
+    frequencies, density = sca_native.welch(X, fs=1e9, window=window, nperseg=256, detrend=detrend)
+    f, p = scipy.signal.welch(X.astype(np.float64), fs=1e9, window=window, nperseg=256, detrend=detrend)
+    close('welch %s %s (frequencies)' % (window, detrend), frequencies, f, 1e-12)
+    close('welch %s %s' % (window, detrend), density, p, 1e-5)
+
+
+#### LEAKAGE ASSESSMENT ####----------------
+
+#Fixed and random groups with a leak on a few samples, skipped traces (group 2) in between
+groups = rng.randint(0, 3, TRACES)
+leaky = X + (groups == 0)[:, None] * (np.arange(SAMPLES) % 100 == 0) * 0.5
+fixed, random_ = leaky[groups == 0].astype(np.float64), leaky[groups == 1].astype(np.float64)
+welch_t = scipy.stats.ttest_ind(fixed, random_, equal_var=False).statistic
+tvla = sca_native.TVLA(SAMPLES, order=1)
+for first in range(0, TRACES, 128):
+    tvla.add(leaky[first:first + 128], groups[first:first + 128])
+close('TVLA.t(1)', tvla.t(1), welch_t, 1e-6)
+
+moments = sca_native.ClassMoments(SAMPLES, 2)
+rows = groups < 2
+moments.add(leaky[rows], groups[rows])
+close("ClassMoments.statistic('t')", moments.statistic(1, 0, 't'), welch_t, 1e-6)
+
+
+#### CORRELATION POWER ANALYSIS ####----------------
+
+def aes_sbox():
+    #S-box from its definition: multiplicative inverse in GF(2^8), then the affine map
+    def multiply(a, b):
+        product = 0
+        while b:
+            if b & 1:
+                product ^= a
+            a = ((a << 1) ^ 0x11b) if a & 0x80 else a << 1
+            b >>= 1
+        return product
+    inverse = [0] * 256
+    for a in range(1, 256):
+        inverse[a] = next(b for b in range(1, 256) if multiply(a, b) == 1)
+    rotate = lambda v, s: ((v << s) | (v >> (8 - s))) & 0xff
+    return np.array([v ^ rotate(v, 1) ^ rotate(v, 2) ^ rotate(v, 3) ^ rotate(v, 4) ^ 0x63 for v in inverse], dtype=np.uint8)
+
+
+SBOX = aes_sbox()
+WEIGHT = np.array([bin(v).count('1') for v in range(256)], dtype=np.float64)
+
+CPA_TRACES, CPA_SAMPLES = 2000, 64
+plaintexts = rng.randint(0, 256, (CPA_TRACES, 16)).astype(np.uint8)
+key = np.frombuffer(sca_native.DEFAULT_KEY_AES, dtype=np.uint8)
+leak = WEIGHT[SBOX[plaintexts ^ key]]
+power = rng.randn(CPA_TRACES, CPA_SAMPLES)
+power[:, 10:26] += leak
+power = power.astype(np.float32)
+cpa = sca_native.CPA(CPA_SAMPLES, 'aes', 'hw')
+for first in range(0, CPA_TRACES, 500):
+    cpa.add(power[first:first + 500], plaintexts[first:first + 500])
+for target in (0, 7):
+    hypotheses = WEIGHT[SBOX[plaintexts[:, target, None] ^ np.arange(256, dtype=np.uint8)]]
+    h = hypotheses - hypotheses.mean(axis=0)
+    x = power.astype(np.float64) - power.mean(axis=0, dtype=np.float64)
+    correlation = (h.T @ x) / np.outer(np.sqrt((h * h).sum(axis=0)), np.sqrt((x * x).sum(axis=0)))
+    close('CPA.correlation(%d)' % target, cpa.correlation(target), correlation, 1e-6)
+equal('CPA.ranks', cpa.ranks(sca_native.DEFAULT_KEY_AES), np.zeros(16))
+
+
+#### CLUSTERING ####----------------
+
+distances, indices = sca_native.NeighborGraph(points, n_neighbors=8).kneighbors()
+d, i = sklearn.neighbors.NearestNeighbors(n_neighbors=8).fit(points).kneighbors(points)
+close('NeighborGraph.kneighbors (distances)', distances, d, 1e-12)
+equal('NeighborGraph.kneighbors (indices)', indices, i)
+
+for eps, min_samples in ((0.5, 5), (0.8, 10)):
+    equal('DBSCAN eps=%g' % eps, sca_native.DBSCAN(eps=eps, min_samples=min_samples).fit_predict(points),
+          sklearn.cluster.DBSCAN(eps=eps, min_samples=min_samples).fit_predict(points))
+
+for method, options in (('dbscan', dict(eps=0.5, max_eps=1.0)), ('xi', dict())):
+    native = sca_native.OPTICS(min_samples=10, cluster_method=method, **options).fit(points)
+    reference = sklearn.cluster.OPTICS(min_samples=10, cluster_method=method, **options).fit(points)
+    equal('OPTICS %s ordering_' % method, native.ordering_, reference.ordering_)
+    close('OPTICS %s reachability_' % method, np.nan_to_num(native.reachability_, posinf=-1.0),
+          np.nan_to_num(reference.reachability_, posinf=-1.0), 1e-12)
+    equal('OPTICS %s labels_' % method, native.labels_, reference.labels_)
+
+for n_samples in (None, 200):
+    native = sca_native.estimate_bandwidth(points, quantile=0.3, n_samples=n_samples, random_state=0)
+    reference = sklearn.cluster.estimate_bandwidth(points, quantile=0.3, n_samples=n_samples, random_state=0)
+    close('estimate_bandwidth n_samples=%s' % n_samples, native, reference, 1e-12)
+
+bandwidth = sklearn.cluster.estimate_bandwidth(points, quantile=0.3)
+for bin_seeding in (False, True):
+    native = sca_native.MeanShift(bandwidth=bandwidth, bin_seeding=bin_seeding).fit(points)
+    reference = sklearn.cluster.MeanShift(bandwidth=bandwidth, bin_seeding=bin_seeding).fit(points)
+    equal('MeanShift bin_seeding=%s labels_' % bin_seeding, native.labels_, reference.labels_)
+    close('MeanShift bin_seeding=%s centers' % bin_seeding, native.cluster_centers_, reference.cluster_centers_, 1e-9)
+
+
+#### METRICS ####----------------
+
+predicted = sklearn.cluster.DBSCAN(eps=0.5, min_samples=5).fit_predict(points)
+close('silhouette_score', sca_native.silhouette_score(points, predicted), sklearn.metrics.silhouette_score(points, predicted), 1e-12)
+close('silhouette_samples', sca_native.silhouette_samples(points, predicted),
+      sklearn.metrics.silhouette_samples(points, predicted), 1e-12)
+close('normalized_mutual_info_score', sca_native.normalized_mutual_info_score(blobs, predicted),
+      sklearn.metrics.normalized_mutual_info_score(blobs, predicted), 1e-12)
+binary = (blobs == 0).astype(int)
+scores = points[:, 0] + 0.5 * rng.randn(len(points))
+close('roc_auc_score', sca_native.roc_auc_score(binary, scores), sklearn.metrics.roc_auc_score(binary, scores), 1e-12)
+close('roc_auc_score (labels)', sca_native.roc_auc_score(binary, predicted), sklearn.metrics.roc_auc_score(binary, predicted), 1e-12)
+
+
+if failures:
+    print('%d mismatches: %s' % (len(failures), ', '.join(failures)))
+    sys.exit(1)
+print('all checks passed')
@@ -0,0 +1,466 @@
+//Density clustering of the PCA projections of the traces (see cluster.h)
+
+#include "cluster.h"
+#include "metrics.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+
+/////////////////////
+//  UNION-FIND      //
+/////////////////////
+
+union_find::union_find(size_t n) : parent(n) {
+	std::iota(parent.begin(), parent.end(), 0);
+}
+
+uint32_t union_find::find(uint32_t i) {
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]]; //Path halving
+		i = parent[i];
+	}
+	return i;
+}
+
+void union_find::unite(uint32_t a, uint32_t b) {
+	a = find(a);
+	b = find(b);
+	if (a < b) parent[b] = a;
+	else if (b < a) parent[a] = b;
+}
+
+/////////////////////
+//  DBSCAN          //
+/////////////////////
+
+std::vector<int32_t> dbscan(const neighbor_graph &graph, double eps, size_t minSamples, uint8_t *core) {
+	const size_t n = graph.size();
+	const double r2 = eps * eps; //As scikit-learn: distances compared squared
+	std::vector<std::vector<uint32_t>> neighbors(n);
+	std::vector<uint8_t> isCore(n);
+	parallel_for(n, 64, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; i++) {
+			graph.radius(i, r2, neighbors[i]);
+			isCore[i] = neighbors[i].size() >= minSamples;
+		}
+	});
+
+	//Clusters: connected components of the core points
+	union_find sets(n);
+	for (size_t i = 0; i < n; i++) {
+		if (!isCore[i]) continue;
+		for (uint32_t j : neighbors[i]) {
+			if (j < i && isCore[j]) sets.unite(i, j);
+		}
+	}
+	std::vector<int32_t> labels(n, -1), clusterOf(n, -1);
+	int32_t clusters = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (!isCore[i]) continue;
+		const uint32_t root = sets.find(i); //Smallest core point of the cluster: numbered in order of first core point
+		if (clusterOf[root] < 0) clusterOf[root] = clusters++;
+		labels[i] = clusterOf[root];
+	}
+	//Border points: scikit-learn expands the clusters in order, the first one to reach a point keeps it
+	for (size_t i = 0; i < n; i++) {
+		if (isCore[i]) continue;
+		for (uint32_t j : neighbors[i]) {
+			if (isCore[j] && (labels[i] < 0 || labels[j] < labels[i])) labels[i] = labels[j];
+		}
+	}
+	if (core) std::copy(isCore.begin(), isCore.end(), core);
+	return labels;
+}
+
+/////////////////////
+//  OPTICS          //
+/////////////////////
+
+//Indexed binary heap of points keyed by (reachability, index), with decrease-key
+struct reach_queue {
+	const std::vector<double> &key;
+	std::vector<uint32_t> heap;
+	std::vector<int64_t> slot; //Position in heap, -1 if absent
+
+	reach_queue(const std::vector<double> &key) : key(key), slot(key.size(), -1) {}
+
+	bool before(uint32_t a, uint32_t b) const {
+		return key[a] < key[b] || (key[a] == key[b] && a < b);
+	}
+
+	void place(size_t i, uint32_t p) {
+		heap[i] = p;
+		slot[p] = i;
+	}
+
+	void sift_up(size_t i) {
+		const uint32_t p = heap[i];
+		while (i > 0 && before(p, heap[(i - 1) / 2])) {
+			place(i, heap[(i - 1) / 2]);
+			i = (i - 1) / 2;
+		}
+		place(i, p);
+	}
+
+	void sift_down(size_t i) {
+		const uint32_t p = heap[i];
+		for (;;) {
+			size_t c = 2 * i + 1;
+			if (c >= heap.size()) break;
+			if (c + 1 < heap.size() && before(heap[c + 1], heap[c])) c++;
+			if (!before(heap[c], p)) break;
+			place(i, heap[c]);
+			i = c;
+		}
+		place(i, p);
+	}
+
+	//update: key[p] was lowered
+	void update(uint32_t p) {
+		if (slot[p] < 0) {
+			heap.push_back(p);
+			slot[p] = heap.size() - 1;
+		}
+		sift_up(slot[p]);
+	}
+
+	uint32_t pop() {
+		const uint32_t p = heap[0];
+		slot[p] = -1;
+		if (heap.size() > 1) place(0, heap.back());
+		heap.pop_back();
+		if (!heap.empty()) sift_down(0);
+		return p;
+	}
+};
+
+//round15: np.around(d, 15) of scikit-learn, which scales, rounds to an integer and scales back
+static inline double round15(double d) {
+	return std::nearbyint(d * 1e15) / 1e15;
+}
+
+optics_graph optics(const neighbor_graph &graph, size_t minSamples, double maxEps) {
+	const size_t n = graph.size();
+	if (minSamples < 2 || minSamples > n) throw std::invalid_argument("optics: min_samples must be between 2 and the number of points");
+	const double inf = std::numeric_limits<double>::infinity();
+	const double r2 = maxEps * maxEps;
+	optics_graph g;
+	g.coreDistances.resize(n);
+	g.reachability.assign(n, inf);
+	g.predecessor.assign(n, -1);
+	g.ordering.reserve(n);
+	parallel_for(n, 64, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; i++) {
+			const double d = std::sqrt(graph.kth_rdist(i, minSamples));
+			g.coreDistances[i] = d > maxEps ? inf : round15(d);
+		}
+	});
+
+	//Only the points reached so far are in the queue; when it is empty the next point is the first unprocessed one
+	std::vector<uint8_t> processed(n);
+	reach_queue queue(g.reachability);
+	size_t next = 0;
+	while (g.ordering.size() < n) {
+		uint32_t p;
+		if (!queue.heap.empty()) p = queue.pop();
+		else {
+			while (processed[next]) next++;
+			p = next;
+		}
+		processed[p] = 1;
+		g.ordering.push_back(p);
+		const double core = g.coreDistances[p];
+		if (core == inf) continue;
+		graph.visit_radius(p, r2, [&](uint32_t j, double rdist) {
+			if (processed[j]) return;
+			const double reach = round15(std::max(std::sqrt(rdist), core));
+			if (reach < g.reachability[j]) {
+				g.reachability[j] = reach;
+				g.predecessor[j] = p;
+				queue.update(j);
+			}
+		});
+	}
+	return g;
+}
+
+std::vector<int32_t> optics_dbscan(const optics_graph &graph, double eps) {
+	//A point whose reachability exceeds eps starts a new cluster if it is core at eps, and is noise otherwise
+	const size_t n = graph.ordering.size();
+	std::vector<int32_t> labels(n);
+	int32_t cluster = -1;
+	for (uint32_t p : graph.ordering) {
+		const bool farReach = graph.reachability[p] > eps, nearCore = graph.coreDistances[p] <= eps;
+		if (farReach && nearCore) cluster++;
+		labels[p] = farReach && !nearCore ? -1 : cluster;
+	}
+	return labels;
+}
+
+//extend_region: end of the steep region starting at start, which may be followed by up to minSamples points that are
+//neither steep nor going the other way (xward)
+static size_t extend_region(const std::vector<uint8_t> &steep, const std::vector<uint8_t> &xward, size_t start, size_t minSamples) {
+	size_t nonXward = 0, end = start;
+	for (size_t i = start; i < steep.size(); i++) {
+		if (steep[i]) {
+			nonXward = 0;
+			end = i;
+		} else if (!xward[i]) {
+			if (++nonXward > minSamples) break;
+		} else return end;
+	}
+	return end;
+}
+
+struct steep_down_area {
+	size_t start, end;
+	double mib;
+};
+
+//filter_sdas: keeps the steep down areas still higher than the maximum in between mib
+static void filter_sdas(std::vector<steep_down_area> &sdas, double mib, double xiComplement, const std::vector<double> &plot) {
+	if (std::isinf(mib)) {
+		sdas.clear();
+		return;
+	}
+	size_t kept = 0;
+	for (const steep_down_area &sda : sdas) {
+		if (mib <= plot[sda.start] * xiComplement) {
+			sdas[kept] = sda;
+			sdas[kept].mib = std::max(sdas[kept].mib, mib);
+			kept++;
+		}
+	}
+	sdas.resize(kept);
+}
+
+//correct_predecessor: shrinks the cluster [s, e] of the ordering until its end comes from a point inside it (Schubert
+//and Gertz); false if nothing is left
+static bool correct_predecessor(const std::vector<double> &plot, const std::vector<int32_t> &predecessor, const std::vector<uint32_t> &ordering, size_t &s, size_t &e) {
+	while (s < e) {
+		if (plot[s] > plot[e]) return true;
+		const int32_t pe = predecessor[e];
+		for (size_t i = s; i < e; i++) {
+			if (pe == (int32_t) ordering[i]) return true;
+		}
+		e--;
+	}
+	return false;
+}
+
+std::vector<int32_t> optics_xi(const optics_graph &graph, size_t minSamples, size_t minClusterSize, double xi, bool predecessorCorrection, std::vector<std::pair<size_t, size_t>> *clusters) {
+	//Port of scikit-learn's _xi_cluster, on the reachability plot (reachability in the ordering, ended by inf)
+	const size_t n = graph.ordering.size();
+	if (xi < 0.0 || xi > 1.0) throw std::invalid_argument("optics_xi: xi must be between 0 and 1");
+	std::vector<double> plot(n + 1, std::numeric_limits<double>::infinity());
+	std::vector<int32_t> predecessor(n);
+	for (size_t i = 0; i < n; i++) {
+		plot[i] = graph.reachability[graph.ordering[i]];
+		predecessor[i] = graph.predecessor[graph.ordering[i]];
+	}
+	const double xiComplement = 1.0 - xi;
+	std::vector<uint8_t> steepUp(n), steepDown(n), up(n), down(n);
+	for (size_t i = 0; i < n; i++) {
+		const double ratio = plot[i] / plot[i + 1]; //NaN for inf / inf: neither up nor down
+		steepUp[i] = ratio <= xiComplement;
+		steepDown[i] = ratio >= 1.0 / xiComplement;
+		down[i] = ratio > 1.0;
+		up[i] = ratio < 1.0;
+	}
+
+	std::vector<steep_down_area> sdas;
+	std::vector<std::pair<size_t, size_t>> found;
+	size_t index = 0;
+	double mib = 0.0;
+	for (size_t steep = 0; steep < n; steep++) {
+		if (!(steepUp[steep] || steepDown[steep]) || steep < index) continue;
+		mib = std::max(mib, *std::max_element(plot.begin() + index, plot.begin() + steep + 1));
+		filter_sdas(sdas, mib, xiComplement, plot);
+		if (steepDown[steep]) {
+			const size_t end = extend_region(steepDown, up, steep, minSamples);
+			sdas.push_back({ steep, end, 0.0 });
+			index = end + 1;
+			mib = plot[index];
+			continue;
+		}
+		const size_t upStart = steep, upEnd = extend_region(steepUp, down, steep, minSamples);
+		index = upEnd + 1;
+		mib = plot[index];
+		const size_t first = found.size();
+		for (const steep_down_area &d : sdas) {
+			size_t cStart = d.start, cEnd = upEnd;
+			if (plot[cEnd + 1] * xiComplement < d.mib) continue;
+			const double dMax = plot[d.start];
+			if (dMax * xiComplement >= plot[cEnd + 1]) {
+				while (plot[cStart + 1] > plot[cEnd + 1] && cStart < d.end) cStart++;
+			} else if (plot[cEnd + 1] * xiComplement >= dMax) {
+				while (plot[cEnd - 1] > dMax && cEnd > upStart) cEnd--;
+			}
+			if (predecessorCorrection && !correct_predecessor(plot, predecessor, graph.ordering, cStart, cEnd)) continue;
+			if (cEnd - cStart + 1 < minClusterSize || cStart > d.end || cEnd < upStart) continue;
+			found.push_back({ cStart, cEnd });
+		}
+		std::reverse(found.begin() + first, found.end());
+	}
+
+	//Labels: the clusters in order, each one only if none of its points is taken yet
+	std::vector<int32_t> plotLabels(n, -1), labels(n);
+	int32_t label = 0;
+	for (const auto &c : found) {
+		if (std::any_of(plotLabels.begin() + c.first, plotLabels.begin() + c.second + 1, [](int32_t l) { return l != -1; })) continue;
+		std::fill(plotLabels.begin() + c.first, plotLabels.begin() + c.second + 1, label++);
+	}
+	for (size_t i = 0; i < n; i++) labels[graph.ordering[i]] = plotLabels[i];
+	if (clusters) *clusters = std::move(found);
+	return labels;
+}
+
+/////////////////////
+//  MEAN SHIFT      //
+/////////////////////
+
+double estimate_bandwidth(const neighbor_graph &graph, const uint32_t *sample, size_t m, double quantile) {
+	const size_t n = graph.size();
+	std::vector<uint32_t> all;
+	std::vector<uint8_t> mask;
+	if (!sample) {
+		all.resize(n);
+		std::iota(all.begin(), all.end(), 0);
+		sample = all.data();
+		m = n;
+	} else {
+		mask.resize(n);
+		for (size_t i = 0; i < m; i++) {
+			if (sample[i] >= n) throw std::invalid_argument("estimate_bandwidth: sample index out of range");
+			mask[sample[i]] = 1;
+		}
+	}
+	if (m == 0) throw std::invalid_argument("estimate_bandwidth: no points");
+	const size_t k = std::max<size_t>(1, (size_t) (m * quantile));
+	if (k > m) throw std::invalid_argument("estimate_bandwidth: quantile above 1");
+	std::vector<double> farthest(m);
+	parallel_for(m, 16, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; i++) farthest[i] = std::sqrt(graph.kth_rdist(sample[i], k, mask.empty() ? nullptr : mask.data()));
+	});
+	double bandwidth = 0.0;
+	for (size_t b = 0; b < m; b += BANDWIDTH_BATCH) bandwidth += numpy_sum(farthest.data() + b, std::min<size_t>(BANDWIDTH_BATCH, m - b));
+	return bandwidth / m;
+}
+
+//bin_seeds: centers of the bins of size binSize holding at least minFreq points, in order of first point; the points
+//themselves if every point has its own bin (scikit-learn's get_bin_seeds)
+static std::vector<double> bin_seeds(const kd_tree &tree, double binSize, size_t minFreq) {
+	const size_t n = tree.size(), dim = tree.dims();
+	std::vector<double> seeds;
+	if (binSize > 0.0) {
+		std::map<std::vector<double>, size_t> bins; //Bin -> position in first
+		std::vector<std::vector<double>> first;
+		std::vector<size_t> freq;
+		std::vector<double> bin(dim);
+		for (size_t i = 0; i < n; i++) {
+			for (size_t j = 0; j < dim; j++) bin[j] = std::nearbyint(tree.point(i)[j] / binSize);
+			auto it = bins.emplace(bin, first.size());
+			if (it.second) {
+				first.push_back(bin);
+				freq.push_back(0);
+			}
+			freq[it.first->second]++;
+		}
+		for (size_t b = 0; b < first.size(); b++) {
+			if (freq[b] < minFreq) continue;
+			for (double c : first[b]) seeds.push_back((float) c * (float) binSize); //scikit-learn keeps the seeds in float32
+		}
+		if (seeds.size() != n * dim) return seeds;
+	}
+	seeds.resize(n * dim);
+	for (size_t i = 0; i < n; i++) std::copy(tree.point(i), tree.point(i) + dim, seeds.begin() + i * dim);
+	return seeds;
+}
+
+mean_shift_result mean_shift(const neighbor_graph &graph, double bandwidth, bool binSeeding, size_t minBinFreq, bool clusterAll, size_t maxIter) {
+	//The means are not points: their neighborhoods are searched in the tree
+	const kd_tree &tree = graph.tree();
+	const size_t n = tree.size(), dim = tree.dims();
+	if (!(bandwidth > 0.0)) throw std::invalid_argument("mean_shift: the bandwidth must be positive");
+	const double r2 = bandwidth * bandwidth, stop = 1e-3 * bandwidth;
+	std::vector<double> seeds;
+	if (binSeeding) seeds = bin_seeds(tree, bandwidth, minBinFreq);
+	else {
+		seeds.resize(n * dim);
+		for (size_t i = 0; i < n; i++) std::copy(tree.point(i), tree.point(i) + dim, seeds.begin() + i * dim);
+	}
+	const size_t s = seeds.size() / dim;
+
+	//Every seed climbs to its mode on its own; a seed without points within the bandwidth is dropped (count 0)
+	std::vector<double> modes(seeds);
+	std::vector<size_t> counts(s), iterations(s);
+	parallel_for(s, 4, [&](size_t b, size_t e) {
+		std::vector<double> sum(dim), old(dim);
+		for (size_t i = b; i < e; i++) {
+			double *mean = modes.data() + i * dim;
+			for (size_t it = 0;; it++) {
+				std::fill(sum.begin(), sum.end(), 0.0);
+				size_t count = 0;
+				tree.visit_radius(mean, r2, [&](uint32_t j, double) {
+					const double *p = tree.point(j);
+					for (size_t c = 0; c < dim; c++) sum[c] += p[c];
+					count++;
+				});
+				counts[i] = count;
+				iterations[i] = it;
+				if (!count) break;
+				std::copy(mean, mean + dim, old.begin());
+				for (size_t c = 0; c < dim; c++) mean[c] = sum[c] / count;
+				if (std::sqrt(kd_rdist(mean, old.data(), dim)) <= stop || it == maxIter) break;
+			}
+		}
+	});
+
+	//Distinct modes by decreasing intensity (then decreasing coordinates), as scikit-learn sorts its dictionary of modes
+	std::map<std::vector<double>, size_t> intensity;
+	for (size_t i = 0; i < s; i++) {
+		if (counts[i]) intensity[std::vector<double>(modes.begin() + i * dim, modes.begin() + (i + 1) * dim)] = counts[i];
+	}
+	if (intensity.empty()) throw std::runtime_error("mean_shift: no point within the bandwidth of any seed");
+	std::vector<std::pair<size_t, std::vector<double>>> sorted;
+	for (const auto &m : intensity) sorted.push_back({ m.second, m.first });
+	std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a > b; });
+	std::vector<double> candidates;
+	for (const auto &m : sorted) candidates.insert(candidates.end(), m.second.begin(), m.second.end());
+
+	//A mode removes the weaker modes within the bandwidth, unless it was removed itself
+	const kd_tree candidateTree(candidates.data(), sorted.size(), dim, dim);
+	std::vector<uint8_t> unique(sorted.size(), 1);
+	std::vector<uint32_t> near;
+	for (size_t i = 0; i < sorted.size(); i++) {
+		if (!unique[i]) continue;
+		near.clear();
+		candidateTree.radius(candidateTree.point(i), r2, near);
+		for (uint32_t j : near) unique[j] = 0;
+		unique[i] = 1;
+	}
+	mean_shift_result result;
+	for (size_t i = 0; i < sorted.size(); i++) {
+		if (unique[i]) result.centers.insert(result.centers.end(), sorted[i].second.begin(), sorted[i].second.end());
+	}
+	result.iterations = *std::max_element(iterations.begin(), iterations.end());
+
+	//Labels: nearest center
+	const size_t clusters = result.centers.size() / dim;
+	const kd_tree centerTree(result.centers.data(), clusters, dim, dim);
+	result.labels.resize(n);
+	parallel_for(n, 64, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; i++) {
+			uint32_t c;
+			double d;
+			centerTree.nearest(tree.point(i), 1, &c, &d);
+			result.labels[i] = clusterAll || std::sqrt(d) <= bandwidth ? (int32_t) c : -1;
+		}
+	});
+	return result;
+}
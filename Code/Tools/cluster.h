@@ -0,0 +1,75 @@
+//Density clustering of the PCA projections of the traces
+//
+//The algorithms take the neighbor_graph (neighbors.h) of the points, built once for all of them, and give the labels
+//scikit-learn gives: clusters numbered from 0 in the order scikit-learn finds them, -1 for noise. Neighborhood queries
+//run on all cores (parallel.h).
+
+#ifndef __CLUSTER_H
+#define __CLUSTER_H
+
+#include "neighbors.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+//union_find: disjoint sets of 0..n-1 whose representative is the smallest element
+struct union_find {
+	std::vector<uint32_t> parent;
+
+	explicit union_find(size_t n);
+	uint32_t find(uint32_t i);
+	void unite(uint32_t a, uint32_t b);
+};
+
+//dbscan: labels of DBSCAN(eps, min_samples). Core points have at least minSamples points (themselves included) within
+//eps; clusters are the connected core points, numbered by their first core point, and a border point joins the first
+//cluster with a core point within eps. core[i] is set for the core points if core is given.
+std::vector<int32_t> dbscan(const neighbor_graph &graph, double eps, size_t minSamples, uint8_t *core = nullptr);
+
+#define OPTICS_XI 0.05 //Default steepness of the xi extraction, as scikit-learn
+
+//Result of OPTICS, as scikit-learn's compute_optics_graph. Distances are rounded to 15 decimals as scikit-learn does.
+struct optics_graph {
+	std::vector<uint32_t> ordering; //Points in the order they are processed
+	std::vector<double> coreDistances; //Distance to the minSamples-th neighbor, inf beyond maxEps
+	std::vector<double> reachability; //inf for the first point of every component
+	std::vector<int32_t> predecessor; //Point the reachability comes from, -1 for none
+};
+
+//optics: ordering of OPTICS(min_samples, max_eps). The next point is the unprocessed one of smallest reachability
+//(smallest index on ties), taken from an indexed heap; its neighborhood is a radius query of maxEps.
+optics_graph optics(const neighbor_graph &graph, size_t minSamples, double maxEps);
+
+//optics_dbscan: labels of the DBSCAN extraction at eps (cluster_method='dbscan'; eps <= maxEps)
+std::vector<int32_t> optics_dbscan(const optics_graph &graph, double eps);
+
+//optics_xi: labels of the xi extraction (cluster_method='xi'). clusters receives the cluster hierarchy as (start, end)
+//ranges of the ordering, inclusive, smaller clusters first, if given.
+std::vector<int32_t> optics_xi(const optics_graph &graph, size_t minSamples, size_t minClusterSize, double xi = OPTICS_XI,
+	bool predecessorCorrection = true, std::vector<std::pair<size_t, size_t>> *clusters = nullptr);
+
+#define MEAN_SHIFT_MAX_ITER 300 //Iterations of a seed, as scikit-learn
+#define BANDWIDTH_BATCH 500 //Points of scikit-learn's batches in estimate_bandwidth (sum order)
+
+//estimate_bandwidth: mean distance of the m sample points (indices of the tree points, in order; all the points if
+//sample is null) to their int(m * quantile)-th nearest neighbor among the sample, as scikit-learn's estimate_bandwidth.
+//The sample is a mask on the graph of all the points, so mean_shift can use the same graph.
+double estimate_bandwidth(const neighbor_graph &graph, const uint32_t *sample, size_t m, double quantile);
+
+struct mean_shift_result {
+	std::vector<double> centers; //clusters x dims, by decreasing number of points within the bandwidth
+	std::vector<int32_t> labels; //Nearest center, -1 beyond the bandwidth if not clusterAll
+	size_t iterations; //Most iterations of a seed (n_iter_)
+};
+
+//mean_shift: MeanShift(bandwidth, bin_seeding, min_bin_freq, cluster_all, max_iter) with a flat kernel. The seeds (the
+//points, or the centers of the bins of size bandwidth holding at least minBinFreq points) move to the mean of the
+//points within the bandwidth until they move less than bandwidth / 1000. Seeds run in parallel; each one sums its
+//points in tree order, so the result does not depend on the number of threads.
+mean_shift_result mean_shift(const neighbor_graph &graph, double bandwidth, bool binSeeding = false, size_t minBinFreq = 1, bool clusterAll = true,
+	size_t maxIter = MEAN_SHIFT_MAX_ITER);
+
+#endif
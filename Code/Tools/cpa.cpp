@@ -0,0 +1,309 @@
+//Correlation power analysis of the first round of AES and DES (see cpa.h)
+
+#include "cpa.h"
+#include "parallel.h"
+#include "simd.h"
+#include "trace_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#define CPA_ADD_BLOCK 512 //Samples per task of cpa_engine::add
+
+/////////////////////
+//  AES             //
+/////////////////////
+
+static uint8_t rotl8(uint8_t x, int s) {
+	return (uint8_t) (x << s | x >> (8 - s));
+}
+
+//aes_sbox: the S-box, from the inverse in GF(2^8) followed by the affine map
+static const uint8_t *aes_sbox() {
+	static const std::vector<uint8_t> box = []() {
+		std::vector<uint8_t> s(256);
+		uint8_t p = 1, q = 1;
+		do {
+			//p runs over the powers of 3, q over those of its inverse 0xf6
+			p = (uint8_t) (p ^ (p << 1) ^ (p & 0x80 ? 0x1b : 0));
+			q ^= (uint8_t) (q << 1);
+			q ^= (uint8_t) (q << 2);
+			q ^= (uint8_t) (q << 4);
+			if (q & 0x80) q ^= 0x09;
+			s[p] = (uint8_t) (q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63);
+		} while (p != 1);
+		s[0] = 0x63;
+		return s;
+	}();
+	return box.data();
+}
+
+/////////////////////
+//  DES             //
+/////////////////////
+
+//Tables of FIPS 46-3, bit 1 being the most significant
+static const uint8_t DES_IP[64] = {
+	58, 50, 42, 34, 26, 18, 10, 2, 60, 52, 44, 36, 28, 20, 12, 4, 62, 54, 46, 38, 30, 22, 14, 6, 64, 56, 48, 40, 32, 24, 16, 8,
+	57, 49, 41, 33, 25, 17, 9, 1, 59, 51, 43, 35, 27, 19, 11, 3, 61, 53, 45, 37, 29, 21, 13, 5, 63, 55, 47, 39, 31, 23, 15, 7 };
+static const uint8_t DES_E[48] = {
+	32, 1, 2, 3, 4, 5, 4, 5, 6, 7, 8, 9, 8, 9, 10, 11, 12, 13, 12, 13, 14, 15, 16, 17,
+	16, 17, 18, 19, 20, 21, 20, 21, 22, 23, 24, 25, 24, 25, 26, 27, 28, 29, 28, 29, 30, 31, 32, 1 };
+static const uint8_t DES_P[32] = {
+	16, 7, 20, 21, 29, 12, 28, 17, 1, 15, 23, 26, 5, 18, 31, 10, 2, 8, 24, 14, 32, 27, 3, 9, 19, 13, 30, 6, 22, 11, 4, 25 };
+static const uint8_t DES_PC1[56] = {
+	57, 49, 41, 33, 25, 17, 9, 1, 58, 50, 42, 34, 26, 18, 10, 2, 59, 51, 43, 35, 27, 19, 11, 3, 60, 52, 44, 36,
+	63, 55, 47, 39, 31, 23, 15, 7, 62, 54, 46, 38, 30, 22, 14, 6, 61, 53, 45, 37, 29, 21, 13, 5, 28, 20, 12, 4 };
+static const uint8_t DES_PC2[48] = {
+	14, 17, 11, 24, 1, 5, 3, 28, 15, 6, 21, 10, 23, 19, 12, 4, 26, 8, 16, 7, 27, 20, 13, 2,
+	41, 52, 31, 37, 47, 55, 30, 40, 51, 45, 33, 48, 44, 49, 39, 56, 34, 53, 46, 42, 50, 36, 29, 32 };
+static const uint8_t DES_S[8][64] = {
+	{ 14, 4, 13, 1, 2, 15, 11, 8, 3, 10, 6, 12, 5, 9, 0, 7, 0, 15, 7, 4, 14, 2, 13, 1, 10, 6, 12, 11, 9, 5, 3, 8,
+	  4, 1, 14, 8, 13, 6, 2, 11, 15, 12, 9, 7, 3, 10, 5, 0, 15, 12, 8, 2, 4, 9, 1, 7, 5, 11, 3, 14, 10, 0, 6, 13 },
+	{ 15, 1, 8, 14, 6, 11, 3, 4, 9, 7, 2, 13, 12, 0, 5, 10, 3, 13, 4, 7, 15, 2, 8, 14, 12, 0, 1, 10, 6, 9, 11, 5,
+	  0, 14, 7, 11, 10, 4, 13, 1, 5, 8, 12, 6, 9, 3, 2, 15, 13, 8, 10, 1, 3, 15, 4, 2, 11, 6, 7, 12, 0, 5, 14, 9 },
+	{ 10, 0, 9, 14, 6, 3, 15, 5, 1, 13, 12, 7, 11, 4, 2, 8, 13, 7, 0, 9, 3, 4, 6, 10, 2, 8, 5, 14, 12, 11, 15, 1,
+	  13, 6, 4, 9, 8, 15, 3, 0, 11, 1, 2, 12, 5, 10, 14, 7, 1, 10, 13, 0, 6, 9, 8, 7, 4, 15, 14, 3, 11, 5, 2, 12 },
+	{ 7, 13, 14, 3, 0, 6, 9, 10, 1, 2, 8, 5, 11, 12, 4, 15, 13, 8, 11, 5, 6, 15, 0, 3, 4, 7, 2, 12, 1, 10, 14, 9,
+	  10, 6, 9, 0, 12, 11, 7, 13, 15, 1, 3, 14, 5, 2, 8, 4, 3, 15, 0, 6, 10, 1, 13, 8, 9, 4, 5, 11, 12, 7, 2, 14 },
+	{ 2, 12, 4, 1, 7, 10, 11, 6, 8, 5, 3, 15, 13, 0, 14, 9, 14, 11, 2, 12, 4, 7, 13, 1, 5, 0, 15, 10, 3, 9, 8, 6,
+	  4, 2, 1, 11, 10, 13, 7, 8, 15, 9, 12, 5, 6, 3, 0, 14, 11, 8, 12, 7, 1, 14, 2, 13, 6, 15, 0, 9, 10, 4, 5, 3 },
+	{ 12, 1, 10, 15, 9, 2, 6, 8, 0, 13, 3, 4, 14, 7, 5, 11, 10, 15, 4, 2, 7, 12, 9, 5, 6, 1, 13, 14, 0, 11, 3, 8,
+	  9, 14, 15, 5, 2, 8, 12, 3, 7, 0, 4, 10, 1, 13, 11, 6, 4, 3, 2, 12, 9, 5, 15, 10, 11, 14, 1, 7, 6, 0, 8, 13 },
+	{ 4, 11, 2, 14, 15, 0, 8, 13, 3, 12, 9, 7, 5, 10, 6, 1, 13, 0, 11, 7, 4, 9, 1, 10, 14, 3, 5, 12, 2, 15, 8, 6,
+	  1, 4, 11, 13, 12, 3, 7, 14, 10, 15, 6, 8, 0, 5, 9, 2, 6, 11, 13, 8, 1, 4, 10, 7, 9, 5, 0, 15, 14, 2, 3, 12 },
+	{ 13, 2, 8, 4, 6, 15, 11, 1, 10, 9, 3, 14, 5, 0, 12, 7, 1, 15, 13, 8, 10, 3, 7, 4, 12, 5, 6, 11, 0, 14, 9, 2,
+	  7, 11, 4, 1, 9, 12, 14, 2, 0, 6, 10, 13, 15, 3, 5, 8, 2, 1, 14, 7, 4, 10, 8, 13, 15, 12, 9, 0, 3, 5, 6, 11 } };
+
+//des_permute: the bits of in (inBits wide) picked by the outBits entries of table, the first one most significant
+static uint64_t des_permute(uint64_t in, const uint8_t *table, size_t outBits, size_t inBits) {
+	uint64_t out = 0;
+	for (size_t i = 0; i < outBits; i++) out = out << 1 | ((in >> (inBits - table[i])) & 1);
+	return out;
+}
+
+//des_sbox: output of S-box b for 6 input bits: the outer bits pick the row, the middle ones the column
+static uint8_t des_sbox(size_t b, uint32_t six) {
+	return DES_S[b][(((six >> 4) & 2) | (six & 1)) * 16 + ((six >> 1) & 15)];
+}
+
+static uint64_t load_be64(const uint8_t *p) {
+	uint64_t v = 0;
+	for (size_t i = 0; i < 8; i++) v = v << 8 | p[i];
+	return v;
+}
+
+/////////////////////
+//  ENGINE          //
+/////////////////////
+
+cpa_shape cpa_shape_of(uint32_t cipher, uint32_t model) {
+	if (model != CPA_HW && model != CPA_HD) throw std::invalid_argument("cpa: unknown leakage model");
+	if (cipher == CPA_AES) return { 16, 256, 256, 16 };
+	if (cipher == CPA_DES) return { 8, 64, (size_t) (model == CPA_HD ? 1024 : 64), 8 };
+	throw std::invalid_argument("cpa: unknown cipher");
+}
+
+std::vector<uint32_t> cpa_first_round_key(uint32_t cipher, const uint8_t *key) {
+	if (cipher == CPA_AES) return std::vector<uint32_t>(key, key + 16);
+	if (cipher != CPA_DES) throw std::invalid_argument("cpa: unknown cipher");
+	//K1: PC1, both halves rotated left once, PC2
+	const uint64_t cd = des_permute(load_be64(key), DES_PC1, 56, 64);
+	const uint64_t c = cd >> 28, d = cd & 0xfffffff;
+	const uint64_t k1 = des_permute((((c << 1) | (c >> 27)) & 0xfffffff) << 28 | (((d << 1) | (d >> 27)) & 0xfffffff), DES_PC2, 48, 56);
+	std::vector<uint32_t> right(8);
+	for (size_t b = 0; b < 8; b++) right[b] = (uint32_t) ((k1 >> (42 - 6 * b)) & 63);
+	return right;
+}
+
+//input_classes: the class of every target for the input of a trace
+static void input_classes(uint32_t cipher, uint32_t model, const uint8_t *input, uint16_t *classes) {
+	if (cipher == CPA_AES) {
+		for (size_t b = 0; b < 16; b++) classes[b] = input[b];
+		return;
+	}
+	static const std::vector<uint8_t> pInverse = []() {
+		std::vector<uint8_t> inv(32);
+		for (size_t i = 0; i < 32; i++) inv[DES_P[i] - 1] = (uint8_t) (i + 1);
+		return inv;
+	}();
+	const uint64_t ip = des_permute(load_be64(input), DES_IP, 64, 64);
+	const uint64_t l = ip >> 32, r = ip & 0xffffffff;
+	const uint64_t e = des_permute(r, DES_E, 48, 32);
+	for (size_t b = 0; b < 8; b++) {
+		uint32_t c = (uint32_t) ((e >> (42 - 6 * b)) & 63);
+		if (model == CPA_HD) {
+			//Bits of L0 ^ R0 where P puts the 4 outputs of S-box b, the first output most significant
+			uint32_t y = 0;
+			for (size_t m = 0; m < 4; m++) y = y << 1 | (uint32_t) (((l ^ r) >> (32 - pInverse[4 * b + m])) & 1);
+			c |= y << 6;
+		}
+		classes[b] = (uint16_t) c;
+	}
+}
+
+cpa_engine::cpa_engine(uint32_t cipher, uint32_t model, size_t samples) : cipher(cipher), model(model), s(cpa_shape_of(cipher, model)), d(samples) {
+	if (samples == 0) throw std::invalid_argument("cpa: no samples");
+	//Rows padded to whole blocks: the padding stays 0 and its correlations are never reported
+	stride = (d + CPA_BLOCK - 1) / CPA_BLOCK * CPA_BLOCK;
+	sum.assign(stride, 0.0);
+	sum2.assign(stride, 0.0);
+	classSums.assign(s.targets * s.classes * stride, 0.0);
+	classCounts.assign(s.targets * s.classes, 0);
+	hypotheses.resize(s.targets * s.guesses * s.classes);
+	const uint8_t *sbox = aes_sbox();
+	for (size_t b = 0; b < s.targets; b++) {
+		for (size_t k = 0; k < s.guesses; k++) {
+			double *h = hypotheses.data() + (b * s.guesses + k) * s.classes;
+			for (size_t c = 0; c < s.classes; c++) {
+				uint32_t v;
+				if (cipher == CPA_AES) {
+					const uint32_t x = (uint32_t) (c ^ k);
+					v = model == CPA_HW ? sbox[x] : x ^ sbox[x];
+				} else {
+					const uint32_t out = des_sbox(b, (uint32_t) ((c & 63) ^ k));
+					v = model == CPA_HW ? out : (uint32_t) (c >> 6) ^ out;
+				}
+				h[c] = (double) __builtin_popcount(v);
+			}
+		}
+	}
+}
+
+void cpa_engine::add(const float *x, size_t count, size_t ld, const uint8_t *inputs) {
+	if (count == 0) return;
+	const size_t T = s.targets, C = s.classes, W = SIMD_DWIDTH;
+	std::vector<uint16_t> classes(count * T);
+	for (size_t i = 0; i < count; i++) input_classes(cipher, model, inputs + i * s.inputBytes, classes.data() + i * T);
+	if (n == 0) offset.assign(x, x + d);
+
+	parallel_for((d + CPA_ADD_BLOCK - 1) / CPA_ADD_BLOCK, 1, [&](size_t begin, size_t end) {
+		const size_t j0 = begin * CPA_ADD_BLOCK, j1 = std::min(d, end * CPA_ADD_BLOCK), len = j1 - j0;
+		std::vector<double> v(len);
+		for (size_t i = 0; i < count; i++) {
+			const float *trace = x + i * ld;
+			for (size_t j = j0; j < j1; j++) {
+				const double t = (double) trace[j] - (double) offset[j];
+				v[j - j0] = t;
+				sum[j] += t;
+				sum2[j] += t * t;
+			}
+			//One row per target, that of the class of the trace
+			for (size_t b = 0; b < T; b++) {
+				double *row = classSums.data() + (b * C + classes[i * T + b]) * stride + j0;
+				size_t j = 0;
+				for (; j + W <= len; j += W) simd_dstore(row + j, simd_dadd(simd_dload(row + j), simd_dload(v.data() + j)));
+				for (; j < len; j++) row[j] += v[j];
+			}
+		}
+	});
+	n += count;
+	for (size_t i = 0; i < count; i++) {
+		for (size_t b = 0; b < T; b++) classCounts[b * C + classes[i * T + b]]++;
+	}
+}
+
+void cpa_engine::block(size_t target, size_t j0, double *out) const {
+	const size_t C = s.classes, B = CPA_BLOCK, W = SIMD_DWIDTH;
+	const double *sums = classSums.data() + target * C * stride + j0;
+	const uint64_t *counts = classCounts.data() + target * C;
+	const double traces = (double) n;
+	double ht[CPA_BLOCK];
+	for (size_t k = 0; k < s.guesses; k++) {
+		const double *h = hypotheses.data() + (target * s.guesses + k) * C;
+		//sum h t over the classes, the block of samples in registers
+		simd_dvec acc[CPA_BLOCK / SIMD_DWIDTH];
+		for (size_t r = 0; r < B / W; r++) acc[r] = simd_dset1(0.0);
+		double sh = 0.0, sh2 = 0.0;
+		for (size_t c = 0; c < C; c++) {
+			if (counts[c] == 0 || h[c] == 0.0) continue;
+			sh += (double) counts[c] * h[c];
+			sh2 += (double) counts[c] * h[c] * h[c];
+			const simd_dvec hv = simd_dset1(h[c]);
+			const double *row = sums + c * stride;
+			for (size_t r = 0; r < B / W; r++) acc[r] = simd_dadd(acc[r], simd_dmul(hv, simd_dload(row + r * W)));
+		}
+		for (size_t r = 0; r < B / W; r++) simd_dstore(ht + r * W, acc[r]);
+		const double hvar = traces * sh2 - sh * sh;
+		for (size_t r = 0; r < B; r++) {
+			const double st = sum[j0 + r], den = hvar * (traces * sum2[j0 + r] - st * st);
+			out[k * B + r] = den > 0.0 ? (traces * ht[r] - sh * st) / std::sqrt(den) : 0.0;
+		}
+	}
+}
+
+void cpa_engine::correlation(size_t target, double *out) const {
+	if (target >= s.targets) throw std::invalid_argument("cpa: target out of range");
+	const size_t B = CPA_BLOCK;
+	parallel_for(stride / B, 1, [&](size_t begin, size_t end) {
+		std::vector<double> buf(s.guesses * B);
+		for (size_t c = begin; c < end; c++) {
+			const size_t j0 = c * B, m = std::min(B, d - j0);
+			block(target, j0, buf.data());
+			for (size_t k = 0; k < s.guesses; k++) std::copy(buf.data() + k * B, buf.data() + k * B + m, out + k * d + j0);
+		}
+	});
+}
+
+void cpa_engine::peaks(double *peak, uint32_t *at) const {
+	const size_t B = CPA_BLOCK, G = s.guesses, chunks = stride / B;
+	//Peak of every block, then of the blocks in order, so that the first sample wins the ties
+	std::vector<double> blockPeak(s.targets * chunks * G);
+	std::vector<uint32_t> blockAt(s.targets * chunks * G);
+	parallel_for(s.targets * chunks, 1, [&](size_t begin, size_t end) {
+		std::vector<double> buf(G * B);
+		for (size_t task = begin; task < end; task++) {
+			const size_t target = task / chunks, j0 = (task % chunks) * B, m = std::min(B, d - j0);
+			block(target, j0, buf.data());
+			for (size_t k = 0; k < G; k++) {
+				double best = -1.0;
+				uint32_t where = 0;
+				for (size_t r = 0; r < m; r++) {
+					const double a = std::fabs(buf[k * B + r]);
+					if (a > best) {
+						best = a;
+						where = (uint32_t) (j0 + r);
+					}
+				}
+				blockPeak[task * G + k] = best;
+				blockAt[task * G + k] = where;
+			}
+		}
+	});
+	for (size_t target = 0; target < s.targets; target++) {
+		for (size_t k = 0; k < G; k++) {
+			double best = -1.0;
+			uint32_t where = 0;
+			for (size_t c = 0; c < chunks; c++) {
+				const size_t i = (target * chunks + c) * G + k;
+				if (blockPeak[i] > best) {
+					best = blockPeak[i];
+					where = blockAt[i];
+				}
+			}
+			peak[target * G + k] = best;
+			if (at) at[target * G + k] = where;
+		}
+	}
+}
+
+void cpa_ranks(const double *peaks, size_t targets, size_t guesses, const uint32_t *right, uint32_t *ranks) {
+	for (size_t b = 0; b < targets; b++) {
+		if (right[b] >= guesses) throw std::invalid_argument("cpa: guess out of range");
+		const double *p = peaks + b * guesses;
+		ranks[b] = (uint32_t) std::count_if(p, p + guesses, [&](double v) { return v > p[right[b]]; });
+	}
+}
+
+void trace_file_cpa(const std::string &path, const uint8_t *inputs, size_t start, cpa_engine &engine) {
+	const trace_file file(path);
+	const size_t length = file.length();
+	if (start + engine.samples() > length) throw std::invalid_argument(path + ": the window does not fit in the traces");
+
+	//Blocks of traces read in physical units: the traces of a block are consecutive, from rows[0]
+	file.read_blocks([](size_t) { return true; }, [&](const float *block, const size_t *rows, size_t n) {
+		engine.add(block + start, n, length, inputs + rows[0] * engine.shape().inputBytes);
+	});
+}
@@ -0,0 +1,94 @@
+//Correlation power analysis of the first round of the software ciphers of the firmware: CMD_SWAES128_ENC,
+//CMD_SWAES128TTABLES_ENC and CMD_SWAES256_ENC (whose first round key is the first 16 key bytes) for CPA_AES, and
+//CMD_SWDES_ENC for CPA_DES, all with the fixed keys of Code/ErrorCode/main.c (defaultKeyAES, defaultKeyDES)
+//
+//A target is one part of the first round key: an AES key byte (256 guesses) or the 6-bit subkey of a DES S-box (64
+//guesses). The leakage of a trace depends on the guess and on a class of its input only:
+//  CPA_AES, CPA_HW  HW(S(p ^ k)), the class being the plaintext byte p
+//  CPA_AES, CPA_HD  HW((p ^ k) ^ S(p ^ k)), the S-box output overwriting its input
+//  CPA_DES, CPA_HW  HW(S_b(e ^ k)), e the 6 bits of E(R0) entering S-box b
+//  CPA_DES, CPA_HD  HW(y ^ S_b(e ^ k)), the bits of R0 replaced by those of R1 = L0 ^ P(S(...)) at the 4 outputs of
+//                   S-box b: y are the bits of L0 ^ R0 there, and the class is (e, y)
+//So the engine keeps, per sample, the count and sums of the traces of every class of every target, besides the sums
+//and squared sums of the traces: a trace adds one row per target however many guesses, the traces are streamed and
+//never held, and the correlation of every guess follows from those sums at any time,
+//  sum h t = sum over the classes of h(class, guess) x (sum of the traces of the class),
+//a product of the hypotheses by the class sums computed for blocks of CPA_BLOCK samples, guesses and key parts in
+//parallel, each thread owning a slice of the samples when adding. The traces are summed minus the first trace, against
+//the cancellation of large means.
+//
+//The class sums take targets x classes x samples doubles (16 x 256 for AES, 8 x 64 or 8 x 1024 for DES), about 32 KB
+//per sample: the engine is given the window of the first round, a few thousand samples, rather than whole traces.
+
+#ifndef __CPA_H
+#define __CPA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#define CPA_AES 0 //Ciphers
+#define CPA_DES 1
+#define CPA_HW 0 //Leakage models
+#define CPA_HD 1
+#define CPA_BLOCK 32 //Samples of the correlations computed at once, held in registers over all the classes
+
+struct cpa_shape {
+	size_t targets; //Key parts: 16 AES key bytes, 8 DES S-box subkeys
+	size_t guesses; //Per target: 256, 64
+	size_t classes; //Input classes per target
+	size_t inputBytes; //Per trace: 16 (AES plaintext), 8 (DES plaintext)
+};
+
+//cpa_shape_of: the shape of a cipher and model; throws std::invalid_argument for unknown ones
+cpa_shape cpa_shape_of(uint32_t cipher, uint32_t model);
+
+//cpa_first_round_key: the right guess of every target for a key (16 bytes for AES, 8 for DES)
+std::vector<uint32_t> cpa_first_round_key(uint32_t cipher, const uint8_t *key);
+
+class cpa_engine {
+public:
+	cpa_engine(uint32_t cipher, uint32_t model, size_t samples);
+
+	const cpa_shape &shape() const { return s; }
+	size_t samples() const { return d; }
+	uint64_t count() const { return n; }
+
+	//add: count traces of x (samples() floats each, rows ld floats apart) with their inputs (shape().inputBytes bytes
+	//per trace, the plaintext as the firmware receives it)
+	void add(const float *x, size_t count, size_t ld, const uint8_t *inputs);
+
+	//correlation: of every guess of a target at every sample into out (guesses x samples()); 0 where the traces or the
+	//hypothesis are constant
+	void correlation(size_t target, double *out) const;
+
+	//peaks: the largest |correlation| over the samples of every guess of every target (targets x guesses) and the first
+	//sample where it is reached (may be null)
+	void peaks(double *peak, uint32_t *at) const;
+
+private:
+	uint32_t cipher, model;
+	cpa_shape s;
+	size_t d, stride;
+	uint64_t n = 0;
+	std::vector<float> offset; //First trace added
+	std::vector<double> sum, sum2; //stride each
+	std::vector<double> classSums; //targets x classes rows of stride
+	std::vector<uint64_t> classCounts; //targets x classes
+	std::vector<double> hypotheses; //targets x guesses x classes
+
+	//block: correlations of every guess of a target at samples [j0, j0 + CPA_BLOCK) into out (guesses x CPA_BLOCK)
+	void block(size_t target, size_t j0, double *out) const;
+};
+
+//cpa_ranks: rank of the right guess of every target from the peaks (targets x guesses): the number of guesses with a
+//larger peak, 0 when the key part is recovered
+void cpa_ranks(const double *peaks, size_t targets, size_t guesses, const uint32_t *right, uint32_t *ranks);
+
+//trace_file_cpa: adds the samples [start, start + engine.samples()) of the traces of the container at path, in
+//physical units, with their inputs (engine.shape().inputBytes per trace of the container), to engine by blocks
+void trace_file_cpa(const std::string &path, const uint8_t *inputs, size_t start, cpa_engine &engine);
+
+#endif
@@ -0,0 +1,228 @@
+//Vectorized scanning and float parsing of the scope CSV exports
+//
+//A block of rows is scanned once, CSV_SCAN_WIDTH bytes at a time: the bytes are compared with ',' and '\n' in SIMD
+//registers and the result is turned into a bit mask, whose set bits are flattened into a structural index, the offsets
+//of every separator of the block (AVX-512BW, AVX2 or SSE2, whichever the compiler targets; build with -march=native to
+//get the widest). The values are then parsed between consecutive offsets of the index by csv_parse_float, which handles
+//the fixed and scientific notations of the scope exports directly and falls back to std::from_chars otherwise.
+
+#ifndef __CSVSCAN_H
+#define __CSVSCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <charconv>
+#include <cstring>
+
+#if defined(__AVX512BW__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512BW__)
+#define CSV_SCAN_WIDTH 64
+#elif defined(__AVX2__)
+#define CSV_SCAN_WIDTH 32
+#elif defined(__SSE2__)
+#define CSV_SCAN_WIDTH 16
+#else
+#define CSV_SCAN_WIDTH 8
+#endif
+
+//csv_match: bit i set when p[i] == c, for the CSV_SCAN_WIDTH bytes at p
+static inline uint64_t csv_match(const char *p, char c) {
+#if defined(__AVX512BW__)
+	return _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void *) p), _mm512_set1_epi8(c));
+#elif defined(__AVX2__)
+	__m256i v = _mm256_loadu_si256((const __m256i *) p);
+	return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+#elif defined(__SSE2__)
+	__m128i v = _mm_loadu_si128((const __m128i *) p);
+	return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+#else
+	uint64_t m = 0;
+	for (int i = 0; i < CSV_SCAN_WIDTH; i++) m |= (uint64_t) (p[i] == c) << i;
+	return m;
+#endif
+}
+
+//csv_separators: bit i set when p[i] is ',' or '\n', for the CSV_SCAN_WIDTH bytes at p
+static inline uint64_t csv_separators(const char *p) {
+#if defined(__AVX512BW__)
+	__m512i v = _mm512_loadu_si512((const void *) p);
+	return _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(',')) | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'));
+#elif defined(__AVX2__)
+	__m256i v = _mm256_loadu_si256((const __m256i *) p);
+	return (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+#elif defined(__SSE2__)
+	__m128i v = _mm_loadu_si128((const __m128i *) p);
+	return (uint32_t) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(',')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+#else
+	uint64_t m = 0;
+	for (int i = 0; i < CSV_SCAN_WIDTH; i++) m |= (uint64_t) (p[i] == ',' || p[i] == '\n') << i;
+	return m;
+#endif
+}
+
+#define CSV_INDEX_SLACK 8 //Entries csv_index may write past the last separator
+
+//csv_index: structural index of [b, e), the offsets from b of every ',' and '\n', in order. out needs room for the
+//separators plus CSV_INDEX_SLACK entries (e - b + CSV_INDEX_SLACK always suffices); returns the number of separators.
+//The first 8 separators of every mask are flattened without a branch on their number, which is 5 to 7 for the usual
+//10 to 12 byte values of a 64-byte mask.
+static inline size_t csv_index(const char *b, const char *e, uint32_t *out) {
+	size_t n = 0;
+	const char *p = b;
+	for (; p + CSV_SCAN_WIDTH <= e; p += CSV_SCAN_WIDTH) {
+		uint64_t m = csv_separators(p);
+		const uint32_t off = (uint32_t) (p - b);
+		const size_t count = (size_t) __builtin_popcountll(m);
+		uint32_t *o = out + n;
+		for (int i = 0; i < 8; i++) {
+			o[i] = off + (uint32_t) __builtin_ctzll(m | (1ull << 63)); //Garbage past count, overwritten by the next mask
+			m &= m - 1;
+		}
+		for (size_t i = 8; i < count; i++) {
+			o[i] = off + (uint32_t) __builtin_ctzll(m);
+			m &= m - 1;
+		}
+		n += count;
+	}
+	for (; p < e; p++) {
+		if (*p == ',' || *p == '\n') out[n++] = (uint32_t) (p - b);
+	}
+	return n;
+}
+
+//csv_count: number of c in [b, e)
+static inline size_t csv_count(const char *b, const char *e, char c) {
+	size_t n = 0;
+	const char *p = b;
+	for (; p + CSV_SCAN_WIDTH <= e; p += CSV_SCAN_WIDTH) n += (size_t) __builtin_popcountll(csv_match(p, c));
+	for (; p < e; p++) n += *p == c;
+	return n;
+}
+
+//Exact powers of ten of a double
+static const double CSV_POW10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//csv_is_8digits, csv_parse_8digits: SWAR check and conversion of 8 ASCII digits loaded as a little-endian word
+static inline bool csv_is_8digits(uint64_t v) {
+	return ((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+static inline uint32_t csv_parse_8digits(uint64_t v) {
+	v -= 0x3030303030303030ull;
+	v = v * 10 + (v >> 8); //Pairs of digits
+	v = ((v & 0x000000FF000000FFull) * 0x000F424000000064ull + ((v >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull) >> 32;
+	return (uint32_t) v;
+}
+
+//csv_parse_float_slow: parses [b, e) as a float with std::from_chars, after removing the surrounding spaces and a '+'
+static inline bool csv_parse_float_slow(const char *b, const char *e, float &out) {
+	while (b < e && *b == ' ') b++;
+	while (e > b && (e[-1] == ' ' || e[-1] == '\r')) e--;
+	if (b < e && *b == '+') b++;
+	if (b == e) return false;
+	auto r = std::from_chars(b, e, out);
+	return r.ec == std::errc() && r.ptr == e;
+}
+
+//csv_parse_scaled: out = (neg ? -m : m) * 10^exp10 when this is exact up to one correctly rounded operation (m at most
+//2^53, exp10 within +-22); false otherwise
+static inline bool csv_parse_scaled(uint64_t m, int exp10, bool neg, float &out) {
+	if (m > (1ull << 53) || exp10 < -22 || exp10 > 22) return false;
+	double v = (double) m;
+	v = exp10 < 0 ? v / CSV_POW10[-exp10] : v * CSV_POW10[exp10];
+	uint64_t bits; //Sign set without a branch: the signs of the samples are random
+	memcpy(&bits, &v, 8);
+	bits |= (uint64_t) neg << 63;
+	memcpy(&v, &bits, 8);
+	out = (float) v;
+	return true;
+}
+
+//csv_parse_exponent: rest of csv_parse_float from the 'e' at p, for the scientific notation
+static inline bool csv_parse_exponent(const char *b, const char *p, const char *e, uint64_t m, int exp10, bool neg, float &out) {
+	p++;
+	const bool eneg = p < e && *p == '-';
+	if (p < e) p += (*p == '-') | (*p == '+');
+	const char *x0 = p;
+	int x = 0;
+	while (p < e && (unsigned) (*p - '0') < 10 && x < 100000) {
+		x = x * 10 + (*p - '0');
+		p++;
+	}
+	if (p == x0 || p != e || !csv_parse_scaled(m, exp10 + (eneg ? -x : x), neg, out)) return csv_parse_float_slow(b, e, out);
+	return true;
+}
+
+//csv_parse_float: parses the whole of [b, e) as a float; false if it is not a number. Up to 19 digits with a decimal
+//exponent of at most 22 in magnitude are converted with one exact integer-to-double conversion and one correctly
+//rounded multiplication or division; anything else (surrounding spaces, inf, nan, long mantissas) goes to
+//csv_parse_float_slow. The fixed notation is parsed inline, the scientific one by csv_parse_exponent.
+static inline bool csv_parse_float(const char *b, const char *e, float &out) {
+	const char *p = b;
+	if (p == e) return false;
+	const bool neg = *p == '-';
+	p += neg | (*p == '+');
+
+	uint64_t m = 0;
+	const char *d0 = p;
+	while (p < e && (unsigned) (*p - '0') < 10) {
+		m = m * 10 + (*p - '0');
+		p++;
+	}
+	size_t digits = p - d0;
+	int exp10 = 0;
+	if (p < e && *p == '.') {
+		const char *f0 = ++p;
+		while (e - p >= 8) {
+			uint64_t v;
+			memcpy(&v, p, 8);
+			if (!csv_is_8digits(v)) break;
+			m = m * 100000000 + csv_parse_8digits(v);
+			p += 8;
+		}
+		while (p < e && (unsigned) (*p - '0') < 10) {
+			m = m * 10 + (*p - '0');
+			p++;
+		}
+		exp10 = -(int) (p - f0);
+		digits += p - f0;
+	}
+	if (digits > 0 && digits <= 19) {
+		if (p == e && csv_parse_scaled(m, exp10, neg, out)) return true;
+		if (p < e && (*p | 0x20) == 'e') return csv_parse_exponent(b, p, e, m, exp10, neg, out);
+	}
+	return csv_parse_float_slow(b, e, out);
+}
+
+//csv_find_lines: start and end (without \r and trailing spaces) of every non-blank line of [b, e), where b is the start
+//of a line
+template <typename V>
+static inline void csv_find_lines(const char *b, const char *e, V &starts, V &ends) {
+	const char *line = b;
+	auto add = [&](const char *eol) {
+		const char *end = eol;
+		while (end > line && (end[-1] == '\r' || end[-1] == ' ')) end--;
+		if (end > line) {
+			starts.push_back(line);
+			ends.push_back(end);
+		}
+		line = eol + 1;
+	};
+	const char *p = b;
+	for (; p + CSV_SCAN_WIDTH <= e; p += CSV_SCAN_WIDTH) {
+		for (uint64_t m = csv_match(p, '\n'); m; m &= m - 1) add(p + __builtin_ctzll(m));
+	}
+	for (; p < e; p++) {
+		if (*p == '\n') add(p);
+	}
+	if (line < e) add(e);
+}
+
+#endif
@@ -0,0 +1,132 @@
+//Decimation of the traces behind an anti-aliasing filter (see decimate.h)
+
+#include "decimate.h"
+#include "parallel.h"
+#include "simd.h"
+#include "trace_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#define DECIMATE_OUTPUTS 4 //Registers of outputs summed at once over all the taps
+
+std::vector<double> decimate_filter(size_t q) {
+	if (q == 0) throw std::invalid_argument("decimate: the factor must be positive");
+	const size_t half = DECIMATE_HALF_TAPS * q, taps = 2 * half + 1;
+	//Windowed sinc, scaled to a unit gain at DC (firwin)
+	std::vector<double> h(taps);
+	double sum = 0.0;
+	for (size_t m = 0; m < taps; m++) {
+		const double t = ((double) m - (double) half) / (double) q;
+		const double sinc = m == half ? 1.0 : std::sin(M_PI * t) / (M_PI * t);
+		h[m] = sinc / q * (0.54 - 0.46 * std::cos(2.0 * M_PI * m / (taps - 1)));
+		sum += h[m];
+	}
+	for (double &v : h) v /= sum;
+	return h;
+}
+
+size_t decimated_length(size_t n, size_t q) {
+	return (n + q - 1) / q;
+}
+
+//What the traces of one decimation share: the taps by phase
+struct decimate_setup {
+	size_t q, n, length;
+	size_t pad; //Zeros before and after every phase
+	size_t phaseStride; //Floats per phase: length + 2 pad, rounded to a register
+	std::vector<float> coef;
+	std::vector<size_t> offset; //Of the sample of tap i for output 0 in the phases
+
+	decimate_setup(size_t q, size_t n) : q(q), n(n), length(decimated_length(n, q)), pad(DECIMATE_HALF_TAPS + 1) {
+		phaseStride = (length + 2 * pad + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+		//Tap m weighs sample kq + m - half of output k, that is sample k + a of phase p, with m - half = aq + p
+		const std::vector<double> h = decimate_filter(q);
+		const long half = (long) (DECIMATE_HALF_TAPS * q);
+		for (size_t m = 0; m < h.size(); m++) {
+			const long s = (long) m - half, p = ((s % (long) q) + (long) q) % (long) q, a = (s - p) / (long) q;
+			coef.push_back((float) h[m]);
+			offset.push_back(p * phaseStride + pad + a);
+		}
+	}
+
+	//run: decimates the trace x into out, phases being per-thread scratch
+	void run(const float *x, float *out, std::vector<float> &phases) const {
+		phases.resize(q * phaseStride);
+		for (size_t p = 0; p < q; p++) {
+			float *phase = phases.data() + p * phaseStride;
+			const size_t samples = p < n ? (n - p + q - 1) / q : 0;
+			std::fill(phase, phase + pad, 0.0f);
+			for (size_t r = 0; r < samples; r++) phase[pad + r] = x[r * q + p];
+			std::fill(phase + pad + samples, phase + phaseStride, 0.0f);
+		}
+		const size_t taps = coef.size(), V = SIMD_WIDTH, B = DECIMATE_OUTPUTS * SIMD_WIDTH;
+		const float *ph = phases.data();
+		size_t k = 0;
+		for (; k + B <= length; k += B) {
+			simd_vec acc[DECIMATE_OUTPUTS];
+			for (size_t j = 0; j < DECIMATE_OUTPUTS; j++) acc[j] = simd_zero();
+			for (size_t i = 0; i < taps; i++) {
+				const simd_vec c = simd_set1(coef[i]);
+				const float *s = ph + offset[i] + k;
+				for (size_t j = 0; j < DECIMATE_OUTPUTS; j++) acc[j] = simd_fmadd(c, simd_load(s + j * V), acc[j]);
+			}
+			for (size_t j = 0; j < DECIMATE_OUTPUTS; j++) simd_store(out + k + j * V, acc[j]);
+		}
+		for (; k < length; k++) {
+			float acc = 0.0f;
+			for (size_t i = 0; i < taps; i++) acc += coef[i] * ph[offset[i] + k];
+			out[k] = acc;
+		}
+	}
+};
+
+void decimate(const float *x, size_t count, size_t n, size_t ld, size_t q, float *out, size_t ldOut) {
+	if (q == 0) throw std::invalid_argument("decimate: the factor must be positive");
+	if (q == 1) {
+		for (size_t i = 0; i < count; i++) memcpy(out + i * ldOut, x + i * ld, n * sizeof(float));
+		return;
+	}
+	const decimate_setup s(q, n);
+	parallel_for(count, 16, [&](size_t begin, size_t end) {
+		std::vector<float> phases;
+		for (size_t i = begin; i < end; i++) s.run(x + i * ld, out + i * ldOut, phases);
+	});
+}
+
+void trace_file_add_decimated(const std::string &path, size_t q) {
+	const trace_file file(path);
+	if (q < 2 || q > file.length()) throw std::invalid_argument("decimate: the factor must be between 2 and the trace length");
+	const decimate_setup s(q, file.length());
+	const size_t count = file.count(), length = file.length();
+
+	trace_decimated_header dh = trace_decimated_header();
+	dh.factor = q;
+	dh.samples = s.length;
+	dh.taps = s.coef.size();
+	dh.rowStride = (dh.samples * sizeof(float) + TRACE_FILE_ALIGN - 1) / TRACE_FILE_ALIGN * TRACE_FILE_ALIGN;
+	dh.sampleRate = file.header().sampleRate / q;
+	trace_file_appender out(path);
+	const uint64_t offset = out.reserve(TRACE_SECTION_DECIMATED, TRACE_FILE_ALIGN + count * dh.rowStride);
+	uint8_t first[TRACE_FILE_ALIGN] = {};
+	memcpy(first, &dh, sizeof(dh));
+	out.write(offset, first, sizeof(first));
+
+	//Blocks of traces: read in physical units and decimated in parallel, then written
+	const size_t ld = dh.rowStride / sizeof(float);
+	std::vector<float> block(TRACE_FILE_BLOCK * ld);
+	file.for_each_block([&](size_t b0, size_t nt) {
+		std::fill(block.begin(), block.end(), 0.0f);
+		parallel_for(nt, 16, [&](size_t begin, size_t end) {
+			std::vector<float> physical(length), phases;
+			for (size_t i = begin; i < end; i++) {
+				file.read_trace(b0 + i, physical.data());
+				s.run(physical.data(), block.data() + i * ld, phases);
+			}
+		});
+		out.write(offset + TRACE_FILE_ALIGN + b0 * dh.rowStride, block.data(), nt * dh.rowStride);
+	});
+	out.commit();
+}
@@ -0,0 +1,38 @@
+//Decimation of the traces behind an anti-aliasing filter. The traces are sampled at 1 GS/s but the STM32F4 runs at 168
+//MHz at most, so keeping one sample in 4 to 8 shrinks the scaler, PCA and clustering stages as much.
+//
+//The decimation by q is scipy.signal.decimate(x, q, ftype='fir'): a linear-phase low-pass FIR of 20 q + 1 taps
+//(scipy.signal.firwin, cutoff at 1 / q of the Nyquist frequency, Hamming window) centered on every sample kept, the
+//trace being zero-padded. Only the kept samples are computed, by the polyphase form of the filter: the trace is split
+//into its q phases (samples p, p + q, p + 2q, ... for phase p), and output k sums every tap times one sample of one
+//phase at a fixed offset from k. The products of one tap for consecutive outputs are then one contiguous SIMD
+//multiply-add (simd.h); blocks of outputs keep their sums in registers over all the taps. A trace costs 20 q + 1
+//multiply-adds per output, about 21 per input sample whatever q.
+//
+//trace_file_add_decimated streams the traces of a container through the decimator by blocks and stores the decimated
+//traces in it (TRACE_SECTION_DECIMATED, trace_file.h).
+
+#ifndef __DECIMATE_H
+#define __DECIMATE_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#define DECIMATE_HALF_TAPS 10 //Taps per unit of the factor on each side of the center, scipy's half_len = 10 q
+
+//decimate_filter: the 2 DECIMATE_HALF_TAPS q + 1 taps of the filter of factor q
+std::vector<double> decimate_filter(size_t q);
+//decimated_length: samples of a trace of n samples decimated by q, ceil(n / q)
+size_t decimated_length(size_t n, size_t q);
+
+//decimate: the first n samples of count traces (rows ld floats apart) decimated by q into out (rows ldOut apart); a
+//factor of 1 copies them
+void decimate(const float *x, size_t count, size_t n, size_t ld, size_t q, float *out, size_t ldOut);
+
+//trace_file_add_decimated: adds to the container at path its traces, in physical units, decimated by q, replacing the
+//decimated traces it may have
+void trace_file_add_decimated(const std::string &path, size_t q);
+
+#endif
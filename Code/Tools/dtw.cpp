@@ -0,0 +1,138 @@
+//Elastic alignment of the traces by dynamic time warping (see dtw.h)
+
+#include "dtw.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+dtw_options dtw_window(const dtw_options &o, size_t n) {
+	dtw_options w = o;
+	if (w.iterations == 0) throw std::invalid_argument("dtw: at least one iteration");
+	if (w.length == 0 && w.start < n) w.length = n - w.start;
+	if (w.length == 0 || w.start + w.length > n) {
+		throw std::invalid_argument("dtw: the window does not fit in traces of " + std::to_string(n) + " samples");
+	}
+	w.radius = std::min(w.radius, w.length - 1); //A wider band is the full matrix
+	return w;
+}
+
+//Per-thread buffers of dtw_batch
+struct dtw_buffers {
+	std::vector<double> samples; //length x lanes, sample j of lane l at j * lanes + l
+	std::vector<double> prev, cur; //Rows of the band, one more cell always infinite
+	std::vector<uint8_t> steps; //Per cell, the lanes that came from (i - 1, j) and those that came from (i, j - 1)
+
+	explicit dtw_buffers(const dtw_options &w)
+		: samples(w.length * SIMD_DWIDTH), prev((2 * w.radius + 2) * SIMD_DWIDTH), cur((2 * w.radius + 2) * SIMD_DWIDTH),
+		steps(w.length * (2 * w.radius + 1) * 2) {}
+};
+
+//dtw_batch: warps count <= lanes windows (rows[l], length samples) onto templ into out[l] and their path costs into
+//distances[l]. Cell k of row i of the band is D(i, i + k - radius): template sample i against trace sample j.
+static void dtw_batch(const dtw_options &w, const double *templ, const float *const *rows, size_t count, float *const *out, double *distances,
+	dtw_buffers &buf) {
+	const size_t W = SIMD_DWIDTH, L = w.length, r = w.radius, band = 2 * r + 1;
+	double *xs = buf.samples.data(), *prev = buf.prev.data(), *cur = buf.cur.data();
+	uint8_t *steps = buf.steps.data();
+	for (size_t l = 0; l < W; l++) {
+		for (size_t j = 0; j < L; j++) xs[j * W + l] = l < count ? rows[l][j] : 0.0;
+	}
+
+	const simd_dvec inf = simd_dset1(INFINITY);
+	for (size_t k = 0; k <= band; k++) simd_dstore(prev + k * W, inf);
+	simd_dstore(prev + r * W, simd_dset1(0.0)); //D(-1, -1), the diagonal step into (0, 0)
+	simd_dstore(cur + band * W, inf);
+	for (size_t i = 0; i < L; i++) {
+		const size_t first = i < r ? r - i : 0, last = std::min(band, L + r - i); //Cells with 0 <= j < L
+		const simd_dvec t = simd_dset1(templ[i]);
+		uint8_t *step = steps + i * band * 2;
+		for (size_t k = 0; k < first; k++) simd_dstore(cur + k * W, inf);
+		simd_dvec left = inf;
+		for (size_t k = first; k < last; k++) {
+			const simd_dvec d = simd_dsub(simd_dload(xs + (i + k - r) * W), t);
+			const simd_dvec diag = simd_dload(prev + k * W), up = simd_dload(prev + (k + 1) * W);
+			//Ties go to the diagonal step, then to (i - 1, j)
+			const unsigned fromUp = simd_dless(up, diag);
+			const simd_dvec best = simd_dmin(up, diag);
+			const unsigned fromLeft = simd_dless(left, best);
+			left = simd_dadd(simd_dmul(d, d), simd_dmin(left, best));
+			simd_dstore(cur + k * W, left);
+			step[2 * k] = (uint8_t) fromUp;
+			step[2 * k + 1] = (uint8_t) fromLeft;
+		}
+		for (size_t k = last; k < band; k++) simd_dstore(cur + k * W, inf);
+		std::swap(prev, cur);
+	}
+
+	//Backtracking from (L - 1, L - 1): the trace samples matched to template sample i are averaged into out[l][i]
+	for (size_t l = 0; l < count; l++) {
+		distances[l] = prev[r * W + l];
+		size_t i = L - 1, j = L - 1, matched = 0;
+		double sum = 0.0;
+		for (;;) {
+			sum += xs[j * W + l];
+			matched++;
+			if (i == 0 && j == 0) break;
+			const uint8_t *step = steps + (i * band + j + r - i) * 2;
+			if (step[1] >> l & 1) {
+				j--;
+				continue;
+			}
+			out[l][i] = (float) (sum / matched);
+			sum = 0.0;
+			matched = 0;
+			if (!(step[0] >> l & 1)) j--;
+			i--;
+		}
+		out[l][0] = (float) (sum / matched);
+	}
+}
+
+void dtw_warp(const float *x, size_t count, size_t n, size_t ld, const int32_t *groups, const dtw_options &o, float *out, size_t ldOut,
+	double *distances) {
+	const dtw_options w = dtw_window(o, n);
+	const size_t W = SIMD_DWIDTH, L = w.length;
+
+	//Traces of every group in index order, and the batches of up to lanes traces of one group
+	const group_batches grouped(groups, count, W);
+	const auto &members = grouped.members;
+	const auto &batches = grouped.batches;
+
+	std::vector<double> templates(members.size() * L);
+	for (size_t iteration = 0; iteration < w.iterations; iteration++) {
+		//Templates: mean of the windows of the traces of every group, then of their warps, summed in trace order
+		parallel_for(members.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t g = begin; g < end; g++) {
+				double *t = templates.data() + g * L;
+				std::fill(t, t + L, 0.0);
+				for (size_t i : members[g]) {
+					const float *row = iteration ? out + i * ldOut : x + i * ld + w.start;
+					for (size_t s = 0; s < L; s++) t[s] += row[s];
+				}
+				for (size_t s = 0; s < L; s++) t[s] /= members[g].size();
+			}
+		});
+
+		parallel_for(batches.size(), 1, [&](size_t begin, size_t end) {
+			dtw_buffers buf(w);
+			const float *rows[SIMD_DWIDTH];
+			float *outs[SIMD_DWIDTH];
+			double costs[SIMD_DWIDTH];
+			for (size_t b = begin; b < end; b++) {
+				const size_t g = batches[b].first, *trace = members[g].data() + batches[b].second;
+				const size_t nt = std::min(W, members[g].size() - batches[b].second);
+				for (size_t l = 0; l < nt; l++) {
+					rows[l] = x + trace[l] * ld + w.start;
+					outs[l] = out + trace[l] * ldOut;
+				}
+				dtw_batch(w, templates.data() + g * L, rows, nt, outs, costs, buf);
+				for (size_t l = 0; l < nt && distances; l++) distances[trace[l]] = costs[l];
+			}
+		});
+	}
+}
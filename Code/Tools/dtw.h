@@ -0,0 +1,39 @@
+//Elastic alignment of the traces by dynamic time warping, for the programs whose phases have a data-dependent length
+//(the allocator walk of E0207, the push and pop loops of E0208 and E0209), which a rigid shift (align.h) cannot align
+//
+//A trace is warped onto the template of its group over a window of length samples: the path of least total squared
+//difference from (0, 0) to (length - 1, length - 1), with steps (1, 1), (1, 0) and (0, 1), matches every sample of the
+//trace to samples of the template. The path stays within a Sakoe-Chiba band (|i - j| <= radius), so a trace costs
+//length x (2 radius + 1) cells instead of length^2. The warped trace has the length of the template: every sample is
+//the mean of the samples of the trace matched to it, so all the traces of a group share one time axis.
+//
+//The cells are computed for several traces at once (SIMD_DWIDTH, simd.h), one trace per lane against the same
+//template, so the recurrence along a row stays a chain of vertical SIMD operations; the steps of the lanes are kept as
+//two bit masks per cell (length x (2 radius + 1) x 2 bytes per batch) for the backtracking. The batches run in parallel.
+//The template of a group is the mean of its traces; every further iteration recomputes it as the mean of the traces
+//warped by the previous one (DTW barycenter averaging).
+
+#ifndef __DTW_H
+#define __DTW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct dtw_options {
+	size_t start = 0; //First sample of the window
+	size_t length = 0; //Samples of the window, 0 for all from start
+	size_t radius = 32; //Sakoe-Chiba band, in samples
+	size_t iterations = 1; //Passes, each one against the mean of the traces warped by the previous one
+};
+
+//dtw_window: o with the defaults resolved for traces of n samples; throws std::invalid_argument if the window does not
+//fit in the traces
+dtw_options dtw_window(const dtw_options &o, size_t n);
+
+//dtw_warp: warps the window of count traces of n samples (rows ld floats apart) onto the template of their group
+//(groups[i], e.g. the program label) into out (length floats per row, rows ldOut apart); distances, if not null,
+//receives the squared differences summed along the path of every trace
+void dtw_warp(const float *x, size_t count, size_t n, size_t ld, const int32_t *groups, const dtw_options &o, float *out, size_t ldOut,
+	double *distances);
+
+#endif
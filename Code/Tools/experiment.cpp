@@ -0,0 +1,215 @@
+//Monte-Carlo experiments of main.py (see experiment.h)
+
+#include "experiment.h"
+#include "cluster.h"
+#include "metrics.h"
+#include "neighbors.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+//splitmix64: mixing step of the random streams
+static uint64_t splitmix64(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+//task_seed: seed of the random stream of the execution of a program with a number of components
+static uint64_t task_seed(uint64_t seed, uint32_t program, size_t components, size_t execution) {
+	return splitmix64(splitmix64(splitmix64(seed ^ program) ^ components) ^ execution);
+}
+
+//uniform: uniform integer of [0, bound), by rejection (the same draws with every standard library)
+static uint64_t uniform(std::mt19937_64 &rng, uint64_t bound) {
+	const uint64_t threshold = (0 - bound) % bound;
+	uint64_t v;
+	do v = rng();
+	while (v < threshold);
+	return v % bound;
+}
+
+//legacy_permutation: the first m values of numpy.random.RandomState(seed).permutation(n), the subsample scikit-learn's
+//estimate_bandwidth draws with random_state=seed
+static std::vector<uint32_t> legacy_permutation(uint32_t seed, size_t n, size_t m) {
+	std::mt19937 rng(seed);
+	std::vector<uint32_t> p(n);
+	std::iota(p.begin(), p.end(), 0);
+	for (size_t i = n - 1; i > 0 && i < n; i--) {
+		uint64_t mask = i;
+		for (unsigned s = 1; s < 64; s <<= 1) mask |= mask >> s;
+		uint64_t j;
+		do j = rng() & mask;
+		while (j > i);
+		std::swap(p[i], p[j]);
+	}
+	p.resize(std::min(m, n));
+	return p;
+}
+
+//mean_stdev: mean and sample standard deviation of v, as statistics.mean and statistics.stdev
+static void mean_stdev(const std::vector<double> &v, double &mean, double &stdev) {
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	mean = stdev = nan;
+	if (v.empty()) return;
+	double sum = 0.0;
+	for (double x : v) sum += x;
+	mean = sum / v.size();
+	if (v.size() < 2) return;
+	double ss = 0.0;
+	for (double x : v) ss += (x - mean) * (x - mean);
+	stdev = std::sqrt(ss / (v.size() - 1));
+}
+
+//score: clusters, silhouette, mutual information and AUC of the labels of the points of graph (truth: 0 for the
+//baseline traces, 1 for the error traces)
+static experiment_scores score(const neighbor_graph &graph, const std::vector<int32_t> &labels, const std::vector<double> &truth) {
+	experiment_scores s;
+	std::vector<int32_t> distinct(labels);
+	std::sort(distinct.begin(), distinct.end());
+	distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+	s.clusters = distinct.size() - (distinct[0] == -1 ? 1 : 0);
+	s.silhouette = silhouette_score(graph, labels.data());
+	std::vector<double> pred(labels.begin(), labels.end());
+	s.mutualInfo = normalized_mutual_info(contingency_table(truth.data(), pred.data(), pred.size()));
+	s.auc = std::numeric_limits<double>::quiet_NaN();
+	if (s.clusters == 2) {
+		for (double &p : pred) {
+			if (p == -1) p = 1;
+		}
+		s.auc = roc_auc(contingency_table(truth.data(), pred.data(), pred.size()));
+	}
+	return s;
+}
+
+//project: the baseline rows and the m sampled rows of x (ld elements apart) projected on the k components of the PCA of
+//both, n x k; the scaler is folded into the basis, as BaselinePCA does
+static std::vector<double> project(const baseline_sketch &base, const float *baselineRows, size_t baselineLd, const float *x, size_t ld,
+	const uint64_t *rows, size_t m, size_t k) {
+	const size_t nL = base.rows, d = base.dims;
+	std::vector<float> errors(m * d);
+	for (size_t i = 0; i < m; i++) std::copy(x + rows[i] * ld, x + rows[i] * ld + d, errors.begin() + i * d);
+	std::vector<double> mean(d), var(d);
+	std::vector<float> scale(d), center(d), basis(k * d), projected((nL + m) * k);
+	pca_model model = pca_fit_with_baseline(base, errors.data(), m, d, k, mean.data(), var.data(), scale.data());
+	for (size_t j = 0; j < d; j++) center[j] = (float) mean[j];
+	for (size_t c = 0; c < k; c++) {
+		for (size_t j = 0; j < d; j++) basis[c * d + j] = model.basis[c * d + j] / scale[j];
+	}
+	pca_project(baselineRows, nL, d, baselineLd, center.data(), basis.data(), k, projected.data());
+	pca_project(errors.data(), m, d, d, center.data(), basis.data(), k, projected.data() + nL * k);
+	return std::vector<double>(projected.begin(), projected.end());
+}
+
+//mean_shift_scores: mean shift of the points of graph with the bandwidth of main.py, estimated on nSamples points
+static experiment_scores mean_shift_scores(const neighbor_graph &graph, size_t nSamples, const std::vector<double> &truth) {
+	const std::vector<uint32_t> sample = legacy_permutation(0, graph.size(), nSamples);
+	double bandwidth = estimate_bandwidth(graph, sample.data(), sample.size(), EXPERIMENT_QUANTILE);
+	if (bandwidth == 0) bandwidth = 1;
+	return score(graph, mean_shift(graph, bandwidth, true, 1, true).labels, truth);
+}
+
+//run_execution: one execution of main.py, scores of the algorithms of the setting in out (EXPERIMENT_ALGORITHMS)
+static void run_execution(const float *x, size_t ld, const float *spectra, size_t ldSpectra, const experiment_program &program,
+	const experiment_setting &setting, size_t execution, uint64_t seed, experiment_scores *out) {
+	const baseline_sketch &base = *program.baseline;
+	const size_t nL = base.rows, k = setting.components;
+	const size_t nErrors = (size_t) std::nearbyint(0.01 * nL); //round(0.01 * LB_traces)
+	const size_t m = std::min<size_t>(nErrors, EXPERIMENT_MAX_ERRORS), n = nL + m;
+	if (nErrors < 2) throw std::invalid_argument("experiments: the baseline needs at least 150 traces");
+	if (m > program.errorCount) throw std::invalid_argument("experiments: not enough error traces");
+
+	//Sample of m distinct error traces (partial Fisher-Yates)
+	std::mt19937_64 rng(task_seed(seed, program.id, k, execution));
+	std::vector<uint64_t> rows(program.errorTraces, program.errorTraces + program.errorCount);
+	for (size_t i = 0; i < m; i++) std::swap(rows[i], rows[i + uniform(rng, rows.size() - i)]);
+
+	const std::vector<double> points = project(base, program.baselineTraces, program.baselineLd, x, ld, rows.data(), m, k);
+	neighbor_graph graph(points.data(), n, k, k, nErrors);
+
+	//eps: the (n - nErrors)-th smallest distance of a point to its nearest other point
+	std::vector<double> second(n);
+	for (size_t i = 0; i < n; i++) second[i] = std::sqrt(graph.kth_rdist(i, 2));
+	std::nth_element(second.begin(), second.begin() + (n - nErrors - 1), second.end());
+	const double eps = second[n - nErrors - 1];
+	const size_t minSamples = (size_t) std::nearbyint(nErrors * 0.8);
+	const size_t nSamples = (size_t) std::nearbyint((nL + m) / 2.0 * 0.9); //round(mean(traces_new) * 0.9)
+
+	std::vector<double> truth(n, 0.0);
+	std::fill(truth.begin() + nL, truth.end(), 1.0);
+	for (size_t a = 0; a < EXPERIMENT_ALGORITHMS; a++) {
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		out[a] = { 0, nan, nan, nan };
+	}
+	if (setting.algorithms & (1u << EXPERIMENT_OPTICS)) {
+		const double maxEps = eps * 1.5;
+		out[EXPERIMENT_OPTICS] = score(graph, optics_dbscan(optics(graph, minSamples, maxEps), maxEps), truth);
+	}
+	if (setting.algorithms & (1u << EXPERIMENT_DBSCAN)) out[EXPERIMENT_DBSCAN] = score(graph, dbscan(graph, eps, minSamples), truth);
+	if (setting.algorithms & (1u << EXPERIMENT_MEAN_SHIFT)) {
+		if (program.spectralBaseline) {
+			//Frequency domain: PCA of the spectra of the same traces
+			const std::vector<double> spectral = project(*program.spectralBaseline, program.baselineSpectra, program.baselineSpectraLd, spectra,
+				ldSpectra, rows.data(), m, k);
+			out[EXPERIMENT_MEAN_SHIFT] = mean_shift_scores(neighbor_graph(spectral.data(), n, k, k, 0), nSamples, truth);
+		} else {
+			out[EXPERIMENT_MEAN_SHIFT] = mean_shift_scores(graph, nSamples, truth);
+		}
+	}
+}
+
+//summarize: summaries of the executions of one (program, setting)
+static void summarize(const experiment_scores *scores, size_t executions, unsigned algorithms, experiment_summary *out) {
+	for (size_t a = 0; a < EXPERIMENT_ALGORITHMS; a++) {
+		std::vector<double> silhouette, mutualInfo, auc;
+		if (algorithms & (1u << a)) {
+			for (size_t e = 0; e < executions; e++) {
+				const experiment_scores &s = scores[e * EXPERIMENT_ALGORITHMS + a];
+				silhouette.push_back(s.silhouette);
+				mutualInfo.push_back(s.mutualInfo);
+				if (s.clusters == 2) auc.push_back(s.auc);
+			}
+		}
+		experiment_summary &r = out[a];
+		r.runs = silhouette.size();
+		r.aucRuns = auc.size();
+		mean_stdev(silhouette, r.silhouetteMean, r.silhouetteStdev);
+		mean_stdev(mutualInfo, r.mutualInfoMean, r.mutualInfoStdev);
+		mean_stdev(auc, r.aucMean, r.aucStdev);
+	}
+}
+
+void run_experiments(const float *x, size_t ld, const float *spectra, size_t ldSpectra, const std::vector<experiment_program> &programs,
+	const std::vector<experiment_setting> &settings, size_t executions, uint64_t seed, experiment_scores *scores, experiment_summary *summaries) {
+	if (executions == 0) throw std::invalid_argument("experiments: no executions");
+	for (const experiment_program &p : programs) {
+		if (p.spectralBaseline && !spectra) throw std::invalid_argument("experiments: spectral baselines without spectra");
+	}
+	const size_t groups = programs.size() * settings.size();
+	std::vector<std::atomic<size_t>> done(groups);
+	for (auto &c : done) c = 0;
+	parallel_tasks(groups * executions, [&](size_t task) {
+		const size_t group = task / executions, execution = task % executions;
+		const experiment_program &program = programs[group / settings.size()];
+		const experiment_setting &setting = settings[group % settings.size()];
+		experiment_scores *slots = scores + group * executions * EXPERIMENT_ALGORITHMS;
+		try {
+			run_execution(x, ld, spectra, ldSpectra, program, setting, execution, seed, slots + execution * EXPERIMENT_ALGORITHMS);
+		} catch (const std::exception &e) {
+			throw std::runtime_error("experiments: program " + std::to_string(program.id) + ", " + std::to_string(setting.components) +
+				" components, execution " + std::to_string(execution) + ": " + e.what());
+		}
+		//The last execution of the group to finish sees the slots of the others (acquire-release)
+		if (done[group].fetch_add(1, std::memory_order_acq_rel) + 1 == executions) {
+			summarize(slots, executions, setting.algorithms, summaries + group * EXPERIMENT_ALGORITHMS);
+		}
+	});
+}
@@ -0,0 +1,73 @@
+//Monte-Carlo experiments of main.py, run natively: for every program, number of PCA components and execution, a random
+//sample of the error traces of the program is stacked with its baseline program, projected with the PCA fitted on both
+//(pca.h, baseline_sketch), clustered (cluster.h) on one neighbor graph (neighbors.h) and scored (metrics.h), with the
+//same parameters main.py derives from the sizes.
+//
+//The (program, components, execution) tasks are independent and run on the work-stealing pool of parallel.h. Every
+//task draws its sample from its own random stream, seeded from the seed and that triple, so the results do not depend
+//on the number of threads or on the order the tasks run in. A task writes its scores to its own slots; the last
+//execution of a (program, components) pair to finish reduces the slots, in execution order, into the summaries.
+//
+//Mean shift runs in the frequency domain, as main.py: on the PCA of the magnitude spectra (spectrum.h) of the same
+//traces, fitted with the sketch of the baseline spectra, when the programs have one.
+
+#ifndef __EXPERIMENT_H
+#define __EXPERIMENT_H
+
+#include "pca.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#define EXPERIMENT_OPTICS 0 //Algorithm indices; a setting runs the algorithms whose bit (1 << index) is set
+#define EXPERIMENT_DBSCAN 1
+#define EXPERIMENT_MEAN_SHIFT 2
+#define EXPERIMENT_ALGORITHMS 3
+#define EXPERIMENT_MAX_ERRORS 30 //Error traces of a sample: 1% of the baseline traces, at most this many (main.py)
+#define EXPERIMENT_QUANTILE 0.3 //Quantile of estimate_bandwidth
+
+struct experiment_program {
+	uint32_t id; //Label of the program, for the random streams
+	const baseline_sketch *baseline; //Of the baseline program
+	const float *baselineTraces; //baseline->rows traces of baseline->dims samples, rows baselineLd elements apart
+	size_t baselineLd;
+	const uint64_t *errorTraces; //Rows of the trace matrix holding the traces of the program
+	size_t errorCount;
+	const baseline_sketch *spectralBaseline; //Of the spectra of the baseline program, null to run mean shift on the traces
+	const float *baselineSpectra; //spectralBaseline->rows spectra, rows baselineSpectraLd elements apart
+	size_t baselineSpectraLd;
+};
+
+struct experiment_setting {
+	size_t components; //PCA components
+	unsigned algorithms; //Bits of the algorithms
+};
+
+//Scores of one algorithm in one execution (NaN if the algorithm is not run)
+struct experiment_scores {
+	uint32_t clusters; //Clusters found, noise excluded
+	double silhouette;
+	double mutualInfo; //Normalized mutual information with the baseline / error labels
+	double auc; //ROC AUC of the labels (noise counted as 1), NaN unless there are two clusters
+};
+
+//Scores of one algorithm over the executions of a (program, setting): mean and sample standard deviation (NaN for
+//fewer than two values); the AUC is over the executions that found two clusters
+struct experiment_summary {
+	size_t runs;
+	double silhouetteMean, silhouetteStdev;
+	double mutualInfoMean, mutualInfoStdev;
+	size_t aucRuns;
+	double aucMean, aucStdev;
+};
+
+//run_experiments: every execution of every setting of every program. x holds the error traces (rows ld elements apart,
+//baseline->dims samples each) and spectra their spectra (rows ldSpectra apart, null if no program has a spectral
+//baseline). scores: programs x settings x executions x EXPERIMENT_ALGORITHMS; summaries: programs x settings x
+//EXPERIMENT_ALGORITHMS.
+void run_experiments(const float *x, size_t ld, const float *spectra, size_t ldSpectra, const std::vector<experiment_program> &programs,
+	const std::vector<experiment_setting> &settings, size_t executions, uint64_t seed, experiment_scores *scores, experiment_summary *summaries);
+
+#endif
@@ -0,0 +1,115 @@
+//KD-tree over the low-dimensional points of the clustering stage (see kdtree.h)
+
+#include "kdtree.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+kd_tree::kd_tree(const double *x, size_t n, size_t dim, size_t ld, size_t leafSize) : n(n), dim(dim) {
+	if (dim == 0) throw std::invalid_argument("kd_tree: points without dimensions");
+	if (n > UINT32_MAX) throw std::invalid_argument("kd_tree: too many points");
+	points.resize(n * dim);
+	for (size_t i = 0; i < n; i++) std::copy(x + i * ld, x + i * ld + dim, points.begin() + i * dim);
+	order.resize(n);
+	std::iota(order.begin(), order.end(), 0);
+	nodes.reserve(2 * (n / std::max<size_t>(leafSize, 1) + 1));
+	build(0, n, std::max<size_t>(leafSize, 1));
+	sorted.resize(n * dim);
+	for (size_t i = 0; i < n; i++) std::copy(point(order[i]), point(order[i]) + dim, sorted.begin() + i * dim);
+}
+
+uint32_t kd_tree::build(uint32_t begin, uint32_t end, size_t leafSize) {
+	const uint32_t id = nodes.size();
+	nodes.push_back({ begin, end, 0, 0 });
+	lo.resize(nodes.size() * dim);
+	hi.resize(nodes.size() * dim);
+	double *l = lo.data() + id * dim, *h = hi.data() + id * dim;
+	for (size_t j = 0; j < dim; j++) {
+		l[j] = h[j] = begin < end ? point(order[begin])[j] : 0.0;
+		for (uint32_t i = begin + 1; i < end; i++) {
+			l[j] = std::min(l[j], point(order[i])[j]);
+			h[j] = std::max(h[j], point(order[i])[j]);
+		}
+	}
+	if (end - begin <= leafSize) return id;
+
+	//Split the widest dimension at the median
+	size_t axis = 0;
+	for (size_t j = 1; j < dim; j++) {
+		if (h[j] - l[j] > h[axis] - l[axis]) axis = j;
+	}
+	const uint32_t mid = begin + (end - begin) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t a, uint32_t b) {
+		return point(a)[axis] < point(b)[axis];
+	});
+	const uint32_t left = build(begin, mid, leafSize);
+	const uint32_t right = build(mid, end, leafSize);
+	nodes[id].left = left;
+	nodes[id].right = right;
+	return id;
+}
+
+double kd_tree::min_rdist(uint32_t node, const double *q) const {
+	const double *l = lo.data() + node * dim, *h = hi.data() + node * dim;
+	double d = 0.0;
+	for (size_t j = 0; j < dim; j++) {
+		const double t = q[j] < l[j] ? l[j] - q[j] : q[j] > h[j] ? q[j] - h[j] : 0.0;
+		d += t * t;
+	}
+	return d;
+}
+
+void kd_tree::radius(const double *q, double r2, std::vector<uint32_t> &out) const {
+	visit_radius(q, r2, [&](uint32_t i, double) { out.push_back(i); });
+}
+
+size_t kd_tree::radius_count(const double *q, double r2) const {
+	size_t count = 0;
+	visit_radius(q, r2, [&](uint32_t, double) { count++; });
+	return count;
+}
+
+void kd_tree::nearest(const double *q, size_t k, uint32_t *index, double *rdist, const uint8_t *mask) const {
+	if (k > n) throw std::invalid_argument("kd_tree: more neighbors than points");
+	if (k == 0) return;
+	//Max-heap of the k best candidates, the worst on top; nodes are visited nearest child first
+	std::vector<std::pair<double, uint32_t>> best;
+	best.reserve(k + 1);
+	std::pair<double, uint32_t> stack[64];
+	size_t top = 0;
+	stack[top++] = { min_rdist(0, q), 0 };
+	while (top) {
+		const std::pair<double, uint32_t> s = stack[--top];
+		if (best.size() == k && s.first > best.front().first) continue;
+		const kd_node &nd = nodes[s.second];
+		if (!nd.left) {
+			for (uint32_t i = nd.begin; i < nd.end; i++) {
+				if (mask && !mask[order[i]]) continue;
+				const double d = kd_rdist(q, sorted.data() + (size_t) i * dim, dim);
+				if (best.size() == k && d >= best.front().first) continue;
+				best.push_back({ d, order[i] });
+				std::push_heap(best.begin(), best.end());
+				if (best.size() > k) {
+					std::pop_heap(best.begin(), best.end());
+					best.pop_back();
+				}
+			}
+			continue;
+		}
+		const double dl = min_rdist(nd.left, q), dr = min_rdist(nd.right, q);
+		if (dl <= dr) {
+			stack[top++] = { dr, nd.right };
+			stack[top++] = { dl, nd.left };
+		} else {
+			stack[top++] = { dl, nd.left };
+			stack[top++] = { dr, nd.right };
+		}
+	}
+	if (best.size() < k) throw std::invalid_argument("kd_tree: more neighbors than points");
+	std::sort_heap(best.begin(), best.end());
+	for (size_t i = 0; i < k; i++) {
+		index[i] = best[i].second;
+		rdist[i] = best[i].first;
+	}
+}
@@ -0,0 +1,86 @@
+//KD-tree over the low-dimensional points of the clustering stage (PCA projections of the traces)
+//
+//Squared distances are computed in double, dimension by dimension in order, exactly as scikit-learn's KD-tree does,
+//so points at exactly the query radius (main.py picks eps among the neighbor distances) fall on the same side. Build
+//with -ffp-contract=off: fused multiply-adds would round differently.
+
+#ifndef __KDTREE_H
+#define __KDTREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#define KD_LEAF_SIZE 16 //Points per leaf
+
+//kd_rdist: squared euclidean distance
+static inline double kd_rdist(const double *a, const double *b, size_t dim) {
+	double d = 0.0;
+	for (size_t j = 0; j < dim; j++) {
+		const double t = a[j] - b[j];
+		d += t * t;
+	}
+	return d;
+}
+
+class kd_tree {
+public:
+	//The n points of x (dim doubles each, rows ld apart) are copied
+	kd_tree(const double *x, size_t n, size_t dim, size_t ld, size_t leafSize = KD_LEAF_SIZE);
+
+	size_t size() const { return n; }
+	size_t dims() const { return dim; }
+	const double *point(size_t i) const { return points.data() + i * dim; }
+
+	//radius: appends to out the points within squared distance r2 (<=) of q, in no particular order
+	void radius(const double *q, double r2, std::vector<uint32_t> &out) const;
+	//radius_count: number of points within squared distance r2 of q
+	size_t radius_count(const double *q, double r2) const;
+	//visit_radius: calls fn(index, squared distance) for every point within squared distance r2 of q
+	template <typename F>
+	void visit_radius(const double *q, double r2, F fn) const;
+	//nearest: the k nearest points of q (q itself included if it is a point), by increasing squared distance; only the
+	//points i with mask[i] set are candidates if mask is given
+	void nearest(const double *q, size_t k, uint32_t *index, double *rdist, const uint8_t *mask = nullptr) const;
+
+private:
+	struct kd_node {
+		uint32_t begin, end; //Range of order
+		uint32_t left, right; //Children, 0 for a leaf
+	};
+
+	//min_rdist: squared distance from q to the bounding box of a node (a lower bound of the distance of its points)
+	double min_rdist(uint32_t node, const double *q) const;
+	uint32_t build(uint32_t begin, uint32_t end, size_t leafSize);
+
+	size_t n, dim;
+	std::vector<double> points; //n x dim, in the order of x
+	std::vector<double> sorted; //n x dim, in tree order
+	std::vector<uint32_t> order; //Tree order -> index in x
+	std::vector<kd_node> nodes;
+	std::vector<double> lo, hi; //Bounding box of every node, nodes x dim
+};
+
+template <typename F>
+void kd_tree::visit_radius(const double *q, double r2, F fn) const {
+	if (n == 0) return;
+	uint32_t stack[64];
+	size_t top = 0;
+	stack[top++] = 0;
+	while (top) {
+		const kd_node &nd = nodes[stack[--top]];
+		if (min_rdist(&nd - nodes.data(), q) > r2) continue;
+		if (!nd.left) {
+			for (uint32_t i = nd.begin; i < nd.end; i++) {
+				const double d = kd_rdist(q, sorted.data() + (size_t) i * dim, dim);
+				if (d <= r2) fn(order[i], d);
+			}
+			continue;
+		}
+		stack[top++] = nd.right;
+		stack[top++] = nd.left;
+	}
+}
+
+#endif
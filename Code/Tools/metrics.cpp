@@ -0,0 +1,163 @@
+//Scores of the clusterings (see metrics.h)
+
+#include "metrics.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+/////////////////////
+//  SILHOUETTE      //
+/////////////////////
+
+void silhouette_samples(const neighbor_graph &graph, const int32_t *labels, double *out) {
+	const size_t n = graph.size(), dim = graph.dims();
+	std::vector<int32_t> values(labels, labels + n);
+	std::sort(values.begin(), values.end());
+	values.erase(std::unique(values.begin(), values.end()), values.end());
+	const size_t clusters = values.size();
+	if (clusters < 2 || clusters > n - 1) throw std::invalid_argument("silhouette: the number of labels must be between 2 and the number of points - 1");
+
+	//Points in cluster order (counting sort): cluster c is [start[c], start[c + 1]) of order
+	std::vector<uint32_t> cluster(n), order(n);
+	std::vector<size_t> start(clusters + 1);
+	for (size_t i = 0; i < n; i++) {
+		cluster[i] = std::lower_bound(values.begin(), values.end(), labels[i]) - values.begin();
+		start[cluster[i] + 1]++;
+	}
+	for (size_t c = 0; c < clusters; c++) start[c + 1] += start[c];
+	std::vector<size_t> next(start.begin(), start.end() - 1);
+	for (size_t i = 0; i < n; i++) order[next[cluster[i]]++] = i;
+
+	//Without the distance matrix, coordinates by dimension in cluster order for the tiles
+	std::vector<double> columns;
+	if (!graph.matrix_row(0)) {
+		columns.resize(dim * n);
+		for (size_t k = 0; k < n; k++) {
+			for (size_t j = 0; j < dim; j++) columns[j * n + k] = graph.tree().point(order[k])[j];
+		}
+	}
+
+	parallel_for(n, 16, [&](size_t b, size_t e) {
+		std::vector<double> tile(SILHOUETTE_BLOCK), sums(clusters);
+		for (size_t i = b; i < e; i++) {
+			std::fill(sums.begin(), sums.end(), 0.0);
+			const double *row = graph.matrix_row(i);
+			const double *p = graph.tree().point(i);
+			size_t c = 0;
+			for (size_t t = 0; t < n; t += SILHOUETTE_BLOCK) {
+				const size_t w = std::min<size_t>(SILHOUETTE_BLOCK, n - t);
+				if (row) {
+					for (size_t k = 0; k < w; k++) tile[k] = row[order[t + k]];
+				} else {
+					std::fill(tile.begin(), tile.begin() + w, 0.0);
+					for (size_t j = 0; j < dim; j++) simd_add_sqdiff_to_double(p[j], columns.data() + j * n + t, tile.data(), w);
+				}
+				simd_sqrt_double(tile.data(), w);
+				for (size_t k = 0; k < w; k++) {
+					while (t + k >= start[c + 1]) c++;
+					sums[c] += tile[k];
+				}
+			}
+			const size_t own = cluster[i], size = start[own + 1] - start[own];
+			if (size == 1) {
+				out[i] = 0.0;
+				continue;
+			}
+			const double a = sums[own] / (size - 1);
+			double nearest = std::numeric_limits<double>::infinity();
+			for (size_t k = 0; k < clusters; k++) {
+				if (k != own) nearest = std::min(nearest, sums[k] / (start[k + 1] - start[k]));
+			}
+			const double s = (nearest - a) / std::max(a, nearest);
+			out[i] = std::isnan(s) ? 0.0 : s; //Both means 0 (duplicated points)
+		}
+	});
+}
+
+double silhouette_score(const neighbor_graph &graph, const int32_t *labels) {
+	std::vector<double> samples(graph.size());
+	silhouette_samples(graph, labels, samples.data());
+	return numpy_sum(samples.data(), samples.size()) / samples.size();
+}
+
+/////////////////////
+//  LABEL SCORES    //
+/////////////////////
+
+label_contingency contingency_table(const double *truth, const double *pred, size_t n) {
+	label_contingency table;
+	table.n = n;
+	table.classes.assign(truth, truth + n);
+	table.clusters.assign(pred, pred + n);
+	for (std::vector<double> *v : { &table.classes, &table.clusters }) {
+		std::sort(v->begin(), v->end());
+		v->erase(std::unique(v->begin(), v->end()), v->end());
+	}
+	const size_t k = table.clusters.size();
+	table.counts.assign(table.classes.size() * k, 0);
+	for (size_t i = 0; i < n; i++) {
+		const size_t r = std::lower_bound(table.classes.begin(), table.classes.end(), truth[i]) - table.classes.begin();
+		const size_t c = std::lower_bound(table.clusters.begin(), table.clusters.end(), pred[i]) - table.clusters.begin();
+		table.counts[r * k + c]++;
+	}
+	return table;
+}
+
+//entropy: of the distribution of the counts c (natural logarithm, as scikit-learn's _entropy)
+static double entropy(const std::vector<double> &c) {
+	if (c.size() <= 1) return 0.0;
+	const double total = numpy_sum(c.data(), c.size());
+	std::vector<double> terms(c.size());
+	for (size_t i = 0; i < c.size(); i++) terms[i] = (c[i] / total) * (std::log(c[i]) - std::log(total));
+	return -numpy_sum(terms.data(), terms.size());
+}
+
+double normalized_mutual_info(const label_contingency &table) {
+	const size_t rows = table.classes.size(), cols = table.clusters.size();
+	if ((rows == 1 && cols == 1) || table.n == 0) return 1.0;
+	if (rows == 1 || cols == 1) return 0.0;
+
+	//Mutual information over the nonzero cells in row order, term by term as scikit-learn's mutual_info_score
+	std::vector<double> pi(rows, 0.0), pj(cols, 0.0);
+	for (size_t r = 0; r < rows; r++) {
+		for (size_t c = 0; c < cols; c++) {
+			pi[r] += table.counts[r * cols + c];
+			pj[c] += table.counts[r * cols + c];
+		}
+	}
+	const double total = table.n, logTotal = std::log(total);
+	std::vector<double> terms;
+	for (size_t r = 0; r < rows; r++) {
+		for (size_t c = 0; c < cols; c++) {
+			const double v = table.counts[r * cols + c];
+			if (v == 0.0) continue;
+			const double nm = v / total;
+			const double logOuter = -std::log((double) ((int64_t) pi[r] * (int64_t) pj[c])) + logTotal + logTotal;
+			const double t = nm * (std::log(v) - logTotal) + nm * logOuter;
+			terms.push_back(std::fabs(t) < DBL_EPSILON ? 0.0 : t);
+		}
+	}
+	const double mi = std::max(numpy_sum(terms.data(), terms.size()), 0.0);
+	if (mi == 0.0) return 0.0;
+	return mi / ((entropy(pi) + entropy(pj)) / 2.0);
+}
+
+double roc_auc(const label_contingency &table) {
+	if (table.classes.size() != 2) return std::numeric_limits<double>::quiet_NaN();
+	//Scores by increasing value: a positive gets one point per negative below its score and half a point per tie
+	const size_t cols = table.clusters.size();
+	const uint64_t *neg = table.counts.data(), *pos = table.counts.data() + cols;
+	uint64_t below = 0, twice = 0, negatives = 0, positives = 0;
+	for (size_t c = 0; c < cols; c++) {
+		twice += pos[c] * (2 * below + neg[c]);
+		below += neg[c];
+		negatives += neg[c];
+		positives += pos[c];
+	}
+	return twice / (2.0 * positives * negatives);
+}
@@ -0,0 +1,66 @@
+//Scores of the clusterings, as scikit-learn computes them: silhouette, normalized mutual information and ROC AUC
+//
+//The silhouette takes the neighbor_graph (neighbors.h) the clustering used: its distance matrix, if kept, is read
+//instead of computing the distances again; otherwise the distances are computed in SIMD tiles of SILHOUETTE_BLOCK
+//points. Points are scanned in cluster order, so the distances to a cluster are one range of a tile. The label scores
+//share one contingency table of the true and predicted labels, built in one pass.
+
+#ifndef __METRICS_H
+#define __METRICS_H
+
+#include "neighbors.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#define SILHOUETTE_BLOCK 1024 //Points of a distance tile
+
+//numpy_sum: sum of a as numpy adds float64 arrays (pairwise, 8 accumulators in blocks of up to 128)
+inline double numpy_sum(const double *a, size_t n) {
+	if (n < 8) {
+		double res = 0.0;
+		for (size_t i = 0; i < n; i++) res += a[i];
+		return res;
+	}
+	if (n <= 128) {
+		double r[8];
+		for (size_t j = 0; j < 8; j++) r[j] = a[j];
+		size_t i = 8;
+		for (; i < n - n % 8; i += 8) {
+			for (size_t j = 0; j < 8; j++) r[j] += a[i + j];
+		}
+		double res = ((r[0] + r[1]) + (r[2] + r[3])) + ((r[4] + r[5]) + (r[6] + r[7]));
+		for (; i < n; i++) res += a[i];
+		return res;
+	}
+	size_t n2 = n / 2;
+	n2 -= n2 % 8;
+	return numpy_sum(a, n2) + numpy_sum(a + n2, n - n2);
+}
+
+//silhouette_samples: silhouette coefficient of every point, (b - a) / max(a, b) with a the mean distance to the other
+//points of its cluster and b the smallest mean distance to another cluster; 0 for a point alone in its cluster. Every
+//label is a cluster (noise, -1, too). Throws std::invalid_argument unless there are 2 to n - 1 labels.
+void silhouette_samples(const neighbor_graph &graph, const int32_t *labels, double *out);
+//silhouette_score: mean of silhouette_samples
+double silhouette_score(const neighbor_graph &graph, const int32_t *labels);
+
+//Counts of the pairs (true label, predicted label or score) of n points
+struct label_contingency {
+	size_t n;
+	std::vector<double> classes; //Distinct true labels, increasing
+	std::vector<double> clusters; //Distinct predicted labels, increasing
+	std::vector<uint64_t> counts; //classes x clusters
+};
+
+label_contingency contingency_table(const double *truth, const double *pred, size_t n);
+
+//normalized_mutual_info: mutual information over the arithmetic mean of the entropies (normalized_mutual_info_score)
+double normalized_mutual_info(const label_contingency &table);
+//roc_auc: area under the ROC curve of the predicted values as scores of the larger true label (roc_auc_score), with
+//half credit for ties; NaN unless there are exactly two true labels
+double roc_auc(const label_contingency &table);
+
+#endif
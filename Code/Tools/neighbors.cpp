@@ -0,0 +1,82 @@
+//Neighbor graph of the points of the clustering stage (see neighbors.h)
+
+#include "neighbors.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+neighbor_graph::neighbor_graph(const double *x, size_t n, size_t dim, size_t ld, size_t k) : points(x, n, dim, ld), k(k) {
+	if (k > n) throw std::invalid_argument("neighbor_graph: more neighbors than points");
+	if (n <= NEIGHBOR_BRUTE_POINTS) {
+		//Coordinates by dimension, so that a row is the sum of dim vectorized passes
+		std::vector<double> columns(dim * n);
+		for (size_t i = 0; i < n; i++) {
+			for (size_t j = 0; j < dim; j++) columns[j * n + i] = points.point(i)[j];
+		}
+		matrix.resize(n * n);
+		parallel_for(n, 16, [&](size_t b, size_t e) {
+			for (size_t i = b; i < e; i++) {
+				double *row = matrix.data() + i * n;
+				std::fill(row, row + n, 0.0);
+				for (size_t j = 0; j < dim; j++) simd_add_sqdiff_to_double(points.point(i)[j], columns.data() + j * n, row, n);
+			}
+		});
+	}
+	knnIndex.resize(n * k);
+	knnRdist.resize(n * k);
+	parallel_for(n, 64, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; i++) {
+			if (matrix.empty()) points.nearest(points.point(i), k, knnIndex.data() + i * k, knnRdist.data() + i * k);
+			else nearest(i, k, knnIndex.data() + i * k, knnRdist.data() + i * k);
+		}
+	});
+}
+
+void neighbor_graph::nearest(size_t i, size_t k, uint32_t *index, double *rdist) const {
+	const size_t n = size();
+	if (k > n) throw std::invalid_argument("neighbor_graph: more neighbors than points");
+	if (matrix.empty()) {
+		if (k > this->k) {
+			points.nearest(points.point(i), k, index, rdist);
+			return;
+		}
+		std::copy(knnIndex.data() + i * this->k, knnIndex.data() + i * this->k + k, index);
+		std::copy(knnRdist.data() + i * this->k, knnRdist.data() + i * this->k + k, rdist);
+		return;
+	}
+	const double *row = matrix.data() + i * n;
+	std::vector<std::pair<double, uint32_t>> best(n);
+	for (size_t j = 0; j < n; j++) best[j] = { row[j], (uint32_t) j };
+	std::partial_sort(best.begin(), best.begin() + k, best.end());
+	for (size_t j = 0; j < k; j++) {
+		index[j] = best[j].second;
+		rdist[j] = best[j].first;
+	}
+}
+
+double neighbor_graph::kth_rdist(size_t i, size_t k, const uint8_t *mask) const {
+	const size_t n = size();
+	if (k == 0 || k > n) throw std::invalid_argument("neighbor_graph: neighbor rank out of range");
+	if (!mask && k <= this->k) return knnRdist[i * this->k + k - 1];
+	if (matrix.empty() && k <= NEIGHBOR_TREE_RANK) {
+		std::vector<uint32_t> index(k);
+		std::vector<double> rdist(k);
+		points.nearest(points.point(i), k, index.data(), rdist.data(), mask);
+		return rdist[k - 1];
+	}
+	std::vector<double> rdist;
+	rdist.reserve(n);
+	for (size_t j = 0; j < n; j++) {
+		if (mask && !mask[j]) continue;
+		rdist.push_back(matrix.empty() ? kd_rdist(points.point(i), points.point(j), dims()) : matrix[i * n + j]);
+	}
+	if (k > rdist.size()) throw std::invalid_argument("neighbor_graph: more neighbors than points");
+	std::nth_element(rdist.begin(), rdist.begin() + k - 1, rdist.end());
+	return rdist[k - 1];
+}
+
+void neighbor_graph::radius(size_t i, double r2, std::vector<uint32_t> &out) const {
+	visit_radius(i, r2, [&](uint32_t j, double) { out.push_back(j); });
+}
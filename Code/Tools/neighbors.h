@@ -0,0 +1,71 @@
+//Neighbor graph of the points of the clustering stage, computed once and shared by the eps heuristic of main.py and
+//all the clustering algorithms (cluster.h)
+//
+//Up to NEIGHBOR_BRUTE_POINTS points, all the squared distances are computed at once with SIMD (simd.h) and kept:
+//radius and k-th neighbor queries of the points are then scans of a row. Beyond, the k nearest neighbors of every point
+//are searched in the KD-tree once; a radius query that the k neighbors cover is answered from them, others go to the
+//tree. Distances are rounded exactly as kd_rdist in both cases, so the results do not depend on the path.
+
+#ifndef __NEIGHBORS_H
+#define __NEIGHBORS_H
+
+#include "kdtree.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#define NEIGHBOR_BRUTE_POINTS 2048 //Up to this many points, the distance matrix is kept (8 * n^2 bytes)
+#define NEIGHBOR_TREE_RANK 32 //Up to this rank, a k-th neighbor the graph does not hold is searched in the tree; beyond, it is selected among all the distances
+
+class neighbor_graph {
+public:
+	//The n points of x (dim doubles each, rows ld elements apart) with their k nearest neighbors (themselves included)
+	neighbor_graph(const double *x, size_t n, size_t dim, size_t ld, size_t k);
+
+	size_t size() const { return points.size(); }
+	size_t dims() const { return points.dims(); }
+	size_t neighbors() const { return k; }
+	const kd_tree &tree() const { return points; }
+	//matrix_row: squared distances of point i to all the points, null if the matrix is not kept
+	const double *matrix_row(size_t i) const { return matrix.empty() ? nullptr : matrix.data() + i * size(); }
+
+	//nearest: the k nearest points of point i, by increasing squared distance (ties by index up to NEIGHBOR_BRUTE_POINTS)
+	void nearest(size_t i, size_t k, uint32_t *index, double *rdist) const;
+	//kth_rdist: squared distance of point i to its k-th nearest point, among the points with mask set if mask is given
+	double kth_rdist(size_t i, size_t k, const uint8_t *mask = nullptr) const;
+	//radius: appends to out the points within squared distance r2 (<=) of point i
+	void radius(size_t i, double r2, std::vector<uint32_t> &out) const;
+	//visit_radius: calls fn(index, squared distance) for every point within squared distance r2 of point i
+	template <typename F>
+	void visit_radius(size_t i, double r2, F fn) const;
+
+private:
+	kd_tree points;
+	size_t k;
+	std::vector<double> matrix; //n x n squared distances, up to NEIGHBOR_BRUTE_POINTS points
+	std::vector<uint32_t> knnIndex; //n x k, by increasing distance
+	std::vector<double> knnRdist; //n x k
+};
+
+template <typename F>
+void neighbor_graph::visit_radius(size_t i, double r2, F fn) const {
+	const size_t n = size();
+	if (!matrix.empty()) {
+		const double *row = matrix.data() + i * n;
+		for (size_t j = 0; j < n; j++) {
+			if (row[j] <= r2) fn((uint32_t) j, row[j]);
+		}
+		return;
+	}
+	const double *rdist = knnRdist.data() + i * k;
+	if (k == n || (k && rdist[k - 1] > r2)) {
+		const uint32_t *index = knnIndex.data() + i * k;
+		for (size_t j = 0; j < k && rdist[j] <= r2; j++) fn(index[j], rdist[j]);
+		return;
+	}
+	points.visit_radius(points.point(i), r2, fn);
+}
+
+#endif
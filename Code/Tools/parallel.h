@@ -0,0 +1,138 @@
+//Data-parallel loops and task pool of the analysis engines
+//
+//parallel_tasks runs independent tasks of uneven cost (the Monte-Carlo executions of experiment.h) on a work-stealing
+//pool. Inside a task, parallel_for runs on the calling thread: the pool already keeps every core busy.
+//
+//The engines split their work so that every sum is accumulated in the same order whatever the number of threads (every
+//thread owns a slice of the samples, or sums its items in index order), so their results do not depend on it.
+
+#ifndef __PARALLEL_H
+#define __PARALLEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+inline thread_local bool parallelTask = false; //Set on the threads of parallel_tasks
+
+//parallel_threads: number of worker threads (all cores)
+static inline unsigned parallel_threads() {
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+//parallel_for: calls fn(begin, end) on contiguous ranges covering [0, n), one range per thread, ranges of at least
+//minGrain items (small loops stay on the calling thread). The first exception thrown by fn is rethrown.
+template <typename F>
+static void parallel_for(size_t n, size_t minGrain, F fn) {
+	const size_t threads = std::min<size_t>(parallel_threads(), minGrain ? (n + minGrain - 1) / minGrain : n);
+	if (threads <= 1 || parallelTask) {
+		if (n) fn((size_t) 0, n);
+		return;
+	}
+	std::vector<std::thread> pool;
+	std::vector<std::exception_ptr> errors(threads);
+	for (size_t t = 0; t < threads; t++) {
+		const size_t b = n * t / threads, e = n * (t + 1) / threads;
+		pool.emplace_back([&, t, b, e]() {
+			try {
+				fn(b, e);
+			} catch (...) {
+				errors[t] = std::current_exception();
+			}
+		});
+	}
+	for (auto &th : pool) th.join();
+	for (auto &e : errors) {
+		if (e) std::rethrow_exception(e);
+	}
+}
+
+//parallel_tasks: calls fn(task) for every task of [0, n), on one worker per thread. Every worker owns a range of tasks,
+//packed in one atomic word (begin in the low half, end in the high half), and takes tasks from its front; a worker
+//whose range is empty steals the back half of the range of another one. No lock is taken. After the first exception
+//thrown by fn, the workers stop taking tasks and it is rethrown.
+template <typename F>
+static void parallel_tasks(size_t n, F fn) {
+	if (n > UINT32_MAX) throw std::invalid_argument("parallel_tasks: too many tasks");
+	const size_t threads = std::min<size_t>(parallel_threads(), n);
+	if (threads <= 1 || parallelTask) {
+		for (size_t t = 0; t < n; t++) fn(t);
+		return;
+	}
+	auto pack = [](uint64_t b, uint64_t e) { return b | e << 32; };
+	std::vector<std::atomic<uint64_t>> ranges(threads);
+	for (size_t w = 0; w < threads; w++) ranges[w] = pack(n * w / threads, n * (w + 1) / threads);
+	std::atomic<bool> failed(false);
+	std::vector<std::exception_ptr> errors(threads);
+	std::vector<std::thread> pool;
+	for (size_t w = 0; w < threads; w++) {
+		pool.emplace_back([&, w]() {
+			parallelTask = true;
+			try {
+				while (!failed.load(std::memory_order_relaxed)) {
+					//Own range first
+					uint64_t r = ranges[w].load();
+					const uint64_t b = r & UINT32_MAX, e = r >> 32;
+					if (b < e) {
+						if (ranges[w].compare_exchange_weak(r, pack(b + 1, e))) fn((size_t) b);
+						continue;
+					}
+					//Empty: steal the back half of the first non-empty range after it
+					bool stolen = false;
+					for (size_t k = 1; k < threads && !stolen; k++) {
+						std::atomic<uint64_t> &victim = ranges[(w + k) % threads];
+						uint64_t v = victim.load();
+						while (!stolen) {
+							const uint64_t vb = v & UINT32_MAX, ve = v >> 32;
+							if (vb >= ve) break;
+							const uint64_t mid = vb + (ve - vb) / 2;
+							if (victim.compare_exchange_weak(v, pack(vb, mid))) {
+								//Only the owner writes to its empty range, thieves skip it
+								ranges[w].store(pack(mid, ve));
+								stolen = true;
+							}
+						}
+					}
+					if (!stolen) break;
+				}
+			} catch (...) {
+				errors[w] = std::current_exception();
+				failed = true;
+			}
+		});
+	}
+	for (auto &th : pool) th.join();
+	for (auto &e : errors) {
+		if (e) std::rethrow_exception(e);
+	}
+}
+
+//group_batches: the items of [0, n) by group (keys[i], e.g. the program label; groups in order of first appearance,
+//members in index order), and the batches of up to width members of one group, the work items of the engines that
+//process several traces of a group at once, one per SIMD lane (align.h, dtw.h)
+struct group_batches {
+	std::vector<std::vector<size_t>> members;
+	std::vector<std::pair<size_t, size_t>> batches; //(group, first member)
+
+	group_batches(const int32_t *keys, size_t n, size_t width) {
+		std::map<int32_t, size_t> index;
+		for (size_t i = 0; i < n; i++) {
+			const auto it = index.emplace(keys[i], members.size()).first;
+			if (it->second == members.size()) members.emplace_back();
+			members[it->second].push_back(i);
+		}
+		for (size_t g = 0; g < members.size(); g++) {
+			for (size_t k = 0; k < members[g].size(); k += width) batches.push_back({ g, k });
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,349 @@
+//Standardization and principal component analysis of trace matrices (see pca.h)
+
+#include "pca.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#define PCA_STATS_BLOCK 512 //Columns per block of column_stats: the block of all the rows stays in L2 between the two passes
+#define PCA_BLOCK 2048 //Samples per block of project: the block of the sketch stays in L2, the 4 scratch rows in L1
+#define PCA_COMBINE_BLOCK 512 //Samples per block of combine: 2 KB sequential reads of every row
+#define PCA_COMBINE_ROWS 32 //Rows per block of combine: the 64 KB block of rows stays in cache while the output is updated
+
+/////////////////////
+//  STANDARDIZATION //
+/////////////////////
+
+void column_stats(const float *x, size_t n, size_t d, size_t ld, double *mean, double *var) {
+	const size_t blocks = (d + PCA_STATS_BLOCK - 1) / PCA_STATS_BLOCK;
+	parallel_for(blocks, 1, [&](size_t b, size_t e) {
+		for (size_t blk = b; blk < e; blk++) {
+			const size_t j0 = blk * PCA_STATS_BLOCK, w = std::min<size_t>(PCA_STATS_BLOCK, d - j0);
+			std::fill(mean + j0, mean + j0 + w, 0.0);
+			std::fill(var + j0, var + j0 + w, 0.0);
+			for (size_t i = 0; i < n; i++) simd_add_to_double(x + i * ld + j0, mean + j0, w);
+			for (size_t j = j0; j < j0 + w; j++) mean[j] /= n;
+			//Second pass on the centered values: no cancellation with the large offsets of the scope channels
+			for (size_t i = 0; i < n; i++) simd_add_sqdev_to_double(x + i * ld + j0, mean + j0, var + j0, w);
+			for (size_t j = j0; j < j0 + w; j++) var[j] /= n;
+		}
+	});
+}
+
+void standard_scale(const double *mean, const double *var, size_t n, size_t d, float *scale) {
+	for (size_t j = 0; j < d; j++) {
+		//Variance within the rounding error of its computation: constant column
+		const double bound = n * DBL_EPSILON * var[j] + (n * mean[j] * DBL_EPSILON) * (n * mean[j] * DBL_EPSILON);
+		scale[j] = var[j] <= bound ? 1.0f : (float) std::sqrt(var[j]);
+	}
+}
+
+void standardize(const float *x, size_t n, size_t d, size_t ld, const float *mean, const float *scale, float *out, size_t ldOut) {
+	std::vector<float> inv(d);
+	for (size_t j = 0; j < d; j++) inv[j] = 1.0f / scale[j];
+	parallel_for(n, 16, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; i++) simd_standardize(x + i * ld, mean, inv.data(), out + i * ldOut, d);
+	});
+}
+
+/////////////////////
+//  PRODUCTS        //
+/////////////////////
+
+//project: out[i][c] = (x[i] - mean) . m[c] for the l rows of m, in tiles of 4 x 4 on blocks of 4 centered rows
+static void project(const float *x, size_t n, size_t d, size_t ld, const float *mean, const float *m, size_t l, double *out) {
+	parallel_for((n + 3) / 4, 1, [&](size_t b, size_t e) {
+		std::vector<float> rows(4 * PCA_BLOCK);
+		const size_t i1 = std::min(4 * e, n);
+		std::fill(out + 4 * b * l, out + i1 * l, 0.0);
+		for (size_t j0 = 0; j0 < d; j0 += PCA_BLOCK) {
+			const size_t w = std::min<size_t>(PCA_BLOCK, d - j0);
+			for (size_t i = 4 * b; i < i1; i += 4) {
+				const size_t r = std::min<size_t>(4, i1 - i);
+				for (size_t k = 0; k < r; k++) simd_sub(x + (i + k) * ld + j0, mean + j0, rows.data() + k * PCA_BLOCK, w);
+				for (size_t c = 0; c < l; c += 4) {
+					const float *mc = m + c * d + j0;
+					double *o = out + i * l + c;
+					if (r == 4 && c + 4 <= l) {
+						simd_dot_tile<4, 4>(rows.data(), PCA_BLOCK, mc, d, w, o, l);
+						continue;
+					}
+					for (size_t k = 0; k < r; k++) {
+						for (size_t cc = 0; cc < 4 && c + cc < l; cc++) simd_dot_tile<1, 1>(rows.data() + k * PCA_BLOCK, PCA_BLOCK, mc + cc * d, d, w, o + k * l + cc, l);
+					}
+				}
+			}
+		}
+	});
+}
+
+//combine: out[c] = sum over i of coef[i][c] * (x[i] - mean), for c < l, on blocks of PCA_COMBINE_ROWS rows of
+//PCA_COMBINE_BLOCK samples, 8 output rows at a time in registers
+static void combine(const float *x, size_t n, size_t d, size_t ld, const float *mean, const double *coef, size_t l, float *out) {
+	std::vector<float> cf(coef, coef + n * l);
+	const size_t blocks = (d + PCA_COMBINE_BLOCK - 1) / PCA_COMBINE_BLOCK;
+	parallel_for(blocks, 1, [&](size_t b, size_t e) {
+		for (size_t blk = b; blk < e; blk++) {
+			const size_t j0 = blk * PCA_COMBINE_BLOCK, w = std::min<size_t>(PCA_COMBINE_BLOCK, d - j0);
+			for (size_t c = 0; c < l; c++) std::fill(out + c * d + j0, out + c * d + j0 + w, 0.0f);
+			for (size_t i0 = 0; i0 < n; i0 += PCA_COMBINE_ROWS) {
+				const size_t r = std::min<size_t>(PCA_COMBINE_ROWS, n - i0);
+				const float *xb = x + i0 * ld + j0, *cb = cf.data() + i0 * l;
+				size_t c = 0;
+				for (; c + 8 <= l; c += 8) simd_combine_tile<8, 2>(xb, ld, r, mean + j0, cb + c, l, w, out + c * d + j0, d);
+				for (; c + 4 <= l; c += 4) simd_combine_tile<4, 4>(xb, ld, r, mean + j0, cb + c, l, w, out + c * d + j0, d);
+				for (; c < l; c++) simd_combine_tile<1, 4>(xb, ld, r, mean + j0, cb + c, l, w, out + c * d + j0, d);
+			}
+		}
+	});
+}
+
+//gram: out[p][q] = a[p] . a[q] for the rows p, q < r of a (d floats each), in 4 x 4 tiles on blocks of samples
+static void gram(const float *a, size_t r, size_t d, double *out) {
+	std::fill(out, out + r * r, 0.0);
+	const size_t tiles = (r + 3) / 4;
+	parallel_for(tiles, 1, [&](size_t b, size_t e) {
+		for (size_t j0 = 0; j0 < d; j0 += PCA_BLOCK) {
+			const size_t w = std::min<size_t>(PCA_BLOCK, d - j0);
+			for (size_t p = 4 * b; p < std::min(4 * e, r); p += 4) {
+				for (size_t q = p; q < r; q += 4) {
+					if (p + 4 <= r && q + 4 <= r) {
+						simd_dot_tile<4, 4>(a + p * d + j0, d, a + q * d + j0, d, w, out + p * r + q, r);
+						continue;
+					}
+					for (size_t pp = p; pp < std::min(p + 4, r); pp++) {
+						for (size_t qq = q; qq < std::min(q + 4, r); qq++) simd_dot_tile<1, 1>(a + pp * d + j0, d, a + qq * d + j0, d, w, out + pp * r + qq, r);
+					}
+				}
+			}
+		}
+	});
+	//Only the tiles on and above the diagonal were computed
+	for (size_t p = 0; p < r; p++) {
+		for (size_t q = 0; q < p; q++) out[p * r + q] = out[q * r + p];
+	}
+}
+
+//principal_axes: the top k components of the rows of a, rows r of d floats whose Gram matrix is the covariance
+//times n - 1 (basis, singular values and explained variances of model, which has its totalVariance set)
+static void principal_axes(const float *a, size_t r, size_t d, size_t k, size_t n, pca_model &model) {
+	std::vector<double> g(r * r), values(r), vectors(r * r);
+	gram(a, r, d, g.data());
+	symmetric_eigen(g.data(), r, values.data(), vectors.data());
+
+	model.basis.assign(k * d, 0.0f);
+	model.singularValues.resize(k);
+	model.explainedVariance.resize(k);
+	model.explainedVarianceRatio.resize(k);
+	for (size_t c = 0; c < k; c++) {
+		const double sigma = std::sqrt(std::max(values[c], 0.0));
+		float *v = model.basis.data() + c * d;
+		if (sigma > 0.0) {
+			for (size_t p = 0; p < r; p++) simd_axpy((float) (vectors[p * r + c] / sigma), a + p * d, v, d);
+		}
+		//Sign: largest coefficient positive
+		const size_t jmax = std::max_element(v, v + d, [](float p, float q) { return std::fabs(p) < std::fabs(q); }) - v;
+		if (v[jmax] < 0.0f) {
+			for (size_t j = 0; j < d; j++) v[j] = -v[j];
+		}
+		model.singularValues[c] = sigma;
+		model.explainedVariance[c] = sigma * sigma / (n - 1);
+		model.explainedVarianceRatio[c] = model.totalVariance > 0.0 ? model.explainedVariance[c] / model.totalVariance : 0.0;
+	}
+}
+
+//orthonormalize: Gram-Schmidt on the l columns of the n x l matrix y, twice to stay orthogonal to rounding
+static void orthonormalize(double *y, size_t n, size_t l) {
+	for (size_t c = 0; c < l; c++) {
+		for (int pass = 0; pass < 2; pass++) {
+			for (size_t p = 0; p < c; p++) {
+				double dot = 0.0;
+				for (size_t i = 0; i < n; i++) dot += y[i * l + p] * y[i * l + c];
+				for (size_t i = 0; i < n; i++) y[i * l + c] -= dot * y[i * l + p];
+			}
+		}
+		double norm = 0.0;
+		for (size_t i = 0; i < n; i++) norm += y[i * l + c] * y[i * l + c];
+		norm = std::sqrt(norm);
+		const double inv = norm > 0.0 ? 1.0 / norm : 0.0;
+		for (size_t i = 0; i < n; i++) y[i * l + c] *= inv;
+	}
+}
+
+void symmetric_eigen(double *a, size_t m, double *values, double *vectors) {
+	std::vector<double> v(m * m, 0.0);
+	for (size_t i = 0; i < m; i++) v[i * m + i] = 1.0;
+	for (int sweep = 0; sweep < 100; sweep++) {
+		double off = 0.0, diag = 0.0;
+		for (size_t p = 0; p < m; p++) {
+			diag += a[p * m + p] * a[p * m + p];
+			for (size_t q = p + 1; q < m; q++) off += a[p * m + q] * a[p * m + q];
+		}
+		if (off <= DBL_EPSILON * DBL_EPSILON * diag || off == 0.0) break;
+		for (size_t p = 0; p < m; p++) {
+			for (size_t q = p + 1; q < m; q++) {
+				const double apq = a[p * m + q];
+				if (apq == 0.0) continue;
+				//Rotation zeroing a[p][q]: A = J^T A J
+				const double theta = (a[q * m + q] - a[p * m + p]) / (2.0 * apq);
+				const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+				const double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+				for (size_t k = 0; k < m; k++) {
+					const double akp = a[k * m + p], akq = a[k * m + q];
+					a[k * m + p] = c * akp - s * akq;
+					a[k * m + q] = s * akp + c * akq;
+				}
+				for (size_t k = 0; k < m; k++) {
+					const double apk = a[p * m + k], aqk = a[q * m + k];
+					a[p * m + k] = c * apk - s * aqk;
+					a[q * m + k] = s * apk + c * aqk;
+				}
+				a[p * m + q] = a[q * m + p] = 0.0;
+				for (size_t k = 0; k < m; k++) {
+					const double vkp = v[k * m + p], vkq = v[k * m + q];
+					v[k * m + p] = c * vkp - s * vkq;
+					v[k * m + q] = s * vkp + c * vkq;
+				}
+			}
+		}
+	}
+	std::vector<size_t> order(m);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t i, size_t j) { return a[i * m + i] > a[j * m + j]; });
+	for (size_t r = 0; r < m; r++) {
+		values[r] = a[order[r] * m + order[r]];
+		for (size_t k = 0; k < m; k++) vectors[k * m + r] = v[k * m + order[r]];
+	}
+}
+
+/////////////////////
+//  PCA             //
+/////////////////////
+
+pca_model pca_fit(const float *x, size_t n, size_t d, size_t ld, size_t k, uint64_t seed, int iterations, size_t oversamples) {
+	if (n < 2 || k == 0 || k > std::min(n, d)) {
+		throw std::invalid_argument("pca: cannot compute " + std::to_string(k) + " components of a " + std::to_string(n) + " x " + std::to_string(d) + " matrix");
+	}
+	const size_t l = std::min(k + oversamples, std::min(n, d));
+	if (iterations < 0) iterations = k < 0.1 * std::min(n, d) ? 7 : 4;
+
+	pca_model model;
+	model.dims = d;
+	model.components = k;
+	std::vector<double> mean(d), var(d);
+	column_stats(x, n, d, ld, mean.data(), var.data());
+	model.mean.assign(mean.begin(), mean.end());
+	model.totalVariance = std::accumulate(var.begin(), var.end(), 0.0) * n / (n - 1);
+	const float *mu = model.mean.data();
+
+	//Range of the centered matrix: Gaussian sketch, then power iterations y = A A^T y
+	std::vector<float> sketch(l * d);
+	std::mt19937_64 rng(seed);
+	std::normal_distribution<float> normal;
+	for (float &v : sketch) v = normal(rng);
+	std::vector<double> y(n * l);
+	project(x, n, d, ld, mu, sketch.data(), l, y.data());
+	for (int it = 0; it < iterations; it++) {
+		orthonormalize(y.data(), n, l);
+		combine(x, n, d, ld, mu, y.data(), l, sketch.data());
+		project(x, n, d, ld, mu, sketch.data(), l, y.data());
+	}
+	orthonormalize(y.data(), n, l);
+
+	//B = Q^T A (l x d), whose SVD gives the components
+	combine(x, n, d, ld, mu, y.data(), l, sketch.data());
+	principal_axes(sketch.data(), l, d, k, n, model);
+	return model;
+}
+
+void pca_transform(const pca_model &model, const float *x, size_t n, size_t ld, float *out) {
+	pca_project(x, n, model.dims, ld, model.mean.data(), model.basis.data(), model.components, out);
+}
+
+void pca_project(const float *x, size_t n, size_t d, size_t ld, const float *mean, const float *basis, size_t k, float *out) {
+	std::vector<double> t(n * k);
+	project(x, n, d, ld, mean, basis, k, t.data());
+	for (size_t i = 0; i < n * k; i++) out[i] = (float) t[i];
+}
+
+/////////////////////
+//  BASELINE        //
+/////////////////////
+
+baseline_sketch baseline_sketch_fit(const float *x, size_t n, size_t d, size_t ld, size_t rank, uint64_t seed) {
+	if (n < 2) throw std::invalid_argument("pca: a baseline needs at least 2 rows");
+	baseline_sketch base;
+	base.rows = n;
+	base.dims = d;
+	base.rank = std::min(rank, std::min(n - 1, d));
+	std::vector<double> var(d);
+	base.mean.resize(d);
+	base.scale.resize(d);
+	column_stats(x, n, d, ld, base.mean.data(), var.data());
+	standard_scale(base.mean.data(), var.data(), n, d, base.scale.data());
+	base.m2.resize(d);
+	for (size_t j = 0; j < d; j++) base.m2[j] = var[j] * n;
+
+	std::vector<float> mean(base.mean.begin(), base.mean.end()), z(n * d);
+	standardize(x, n, d, ld, mean.data(), base.scale.data(), z.data(), d);
+	pca_model model = pca_fit(z.data(), n, d, d, base.rank, seed);
+	base.singularValues = model.singularValues;
+	base.basis = std::move(model.basis);
+	return base;
+}
+
+pca_model pca_fit_with_baseline(const baseline_sketch &base, const float *e, size_t m, size_t lde, size_t k, double *mean, double *var, float *scale) {
+	const size_t d = base.dims, nl = base.rows, n = nl + m, r = base.rank;
+	if (k == 0 || k > std::min(r + 1 + m, d)) {
+		throw std::invalid_argument("pca: cannot compute " + std::to_string(k) + " components from a rank " + std::to_string(r) + " baseline and " + std::to_string(m) + " rows");
+	}
+
+	//Scaler: Chan's merge of the baseline and extra statistics
+	std::vector<double> em(d, 0.0), ev(d, 0.0);
+	if (m) column_stats(e, m, d, lde, em.data(), ev.data());
+	for (size_t j = 0; j < d; j++) {
+		const double delta = em[j] - base.mean[j];
+		mean[j] = base.mean[j] + delta * m / n;
+		var[j] = (base.m2[j] + ev[j] * m + delta * delta * ((double) nl * m / n)) / n;
+	}
+	standard_scale(mean, var, n, d, scale);
+
+	pca_model model;
+	model.dims = d;
+	model.components = k;
+	model.mean.assign(d, 0.0f);
+	model.totalVariance = 0.0;
+	for (size_t j = 0; j < d; j++) model.totalVariance += var[j] / ((double) scale[j] * scale[j]);
+	model.totalVariance *= (double) n / (n - 1);
+
+	//Rows whose Gram matrix is the covariance of the standardized stacked matrix: the baseline rows are
+	//(z - 0) * scaleL / scale + (meanL - mean) / scale for z standardized with the baseline statistics
+	std::vector<float> a((r + 1 + m) * d), ratio(d), shift(d), mf(mean, mean + d);
+	for (size_t j = 0; j < d; j++) {
+		ratio[j] = base.scale[j] / scale[j];
+		shift[j] = (float) ((base.mean[j] - mean[j]) / scale[j]);
+	}
+	parallel_for(r + 1 + m, 1, [&](size_t b, size_t end) {
+		for (size_t p = b; p < end; p++) {
+			float *row = a.data() + p * d;
+			if (p < r) {
+				const float sigma = (float) base.singularValues[p], *v = base.basis.data() + p * d;
+				for (size_t j = 0; j < d; j++) row[j] = sigma * v[j] * ratio[j];
+			} else if (p == r) {
+				const float w = (float) std::sqrt((double) nl);
+				for (size_t j = 0; j < d; j++) row[j] = w * shift[j];
+			} else {
+				standardize(e + (p - r - 1) * lde, 1, d, lde, mf.data(), scale, row, d);
+			}
+		}
+	});
+	principal_axes(a.data(), r + 1 + m, d, k, n, model);
+	return model;
+}
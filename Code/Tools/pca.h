@@ -0,0 +1,83 @@
+//Standardization and principal component analysis of trace matrices
+//
+//A matrix is n traces (rows) of d samples in float, rows ld elements apart, so a strided view of a container
+//(trace_file.h) is used as it is. Statistics are accumulated in double.
+//
+//pca_fit computes only the top k components with a randomized truncated SVD (Halko, Martinsson and Tropp), the method
+//scikit-learn's PCA picks for these shapes: a Gaussian sketch of k + oversamples columns, a few power iterations with
+//re-orthonormalization, and the exact SVD of the small projected matrix. The products are blocked over the samples so
+//that a block of the sketch stays in cache while the traces stream through it, and the traces are centered block by
+//block in a scratch row, never copied. The signs of the components follow scikit-learn (the
+//largest coefficient of every component is positive).
+
+#ifndef __PCA_H
+#define __PCA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#define PCA_OVERSAMPLES 10 //Extra sketch columns, as scikit-learn
+#define PCA_BASELINE_RANK 64 //Default rank of the baseline sketches
+#define PCA_AUTO_ITERATIONS -1 //7 power iterations if k < 0.1 * min(n, d), 4 otherwise, as scikit-learn
+
+//column_stats: mean and population variance (ddof 0) of every column of x
+void column_stats(const float *x, size_t n, size_t d, size_t ld, double *mean, double *var);
+
+//standard_scale: standard deviation of every column, 1 for constant columns (same test as scikit-learn's StandardScaler)
+void standard_scale(const double *mean, const double *var, size_t n, size_t d, float *scale);
+
+//standardize: out[i][j] = (x[i][j] - mean[j]) / scale[j], out rows ldOut elements apart (out may be x)
+void standardize(const float *x, size_t n, size_t d, size_t ld, const float *mean, const float *scale, float *out, size_t ldOut);
+
+struct pca_model {
+	size_t dims; //d
+	size_t components; //k
+	std::vector<float> mean; //d
+	std::vector<float> basis; //k rows of d: the components, by decreasing variance
+	std::vector<double> singularValues; //k
+	std::vector<double> explainedVariance; //k, singular value^2 / (n - 1)
+	std::vector<double> explainedVarianceRatio; //k, share of the total variance
+	double totalVariance;
+};
+
+//pca_fit: top k components of the n x d matrix x. Throws std::invalid_argument if k > min(n, d) or n < 2.
+pca_model pca_fit(const float *x, size_t n, size_t d, size_t ld, size_t k, uint64_t seed = 0, int iterations = PCA_AUTO_ITERATIONS, size_t oversamples = PCA_OVERSAMPLES);
+
+//pca_transform: out[i][c] = (x[i] - mean) . basis[c], out rows of k floats
+void pca_transform(const pca_model &model, const float *x, size_t n, size_t ld, float *out);
+
+//pca_project: pca_transform with the mean (d) and the basis (k rows of d) given directly
+void pca_project(const float *x, size_t n, size_t d, size_t ld, const float *mean, const float *basis, size_t k, float *out);
+
+//Statistics of a fixed baseline matrix L, to fit the scaler and the PCA of L stacked with a few other rows many times
+//(the Monte-Carlo executions of main.py add about 1% of error traces to the same baseline program). The scaler
+//statistics are exact; the covariance of L, standardized with its own statistics, is kept as its top rank singular
+//values and right singular vectors.
+struct baseline_sketch {
+	size_t rows; //nL
+	size_t dims; //d
+	size_t rank; //r
+	std::vector<double> mean; //d
+	std::vector<double> m2; //d, sum of squared deviations from the mean
+	std::vector<float> scale; //d, standard deviation, 1 for constant columns
+	std::vector<double> singularValues; //r, of the standardized and centered L
+	std::vector<float> basis; //r rows of d, the corresponding right singular vectors
+};
+
+//baseline_sketch_fit: statistics of the n x d baseline x, with a sketch of rank min(rank, n - 1)
+baseline_sketch baseline_sketch_fit(const float *x, size_t n, size_t d, size_t ld, size_t rank = PCA_BASELINE_RANK, uint64_t seed = 0);
+
+//pca_fit_with_baseline: scaler and PCA of the baseline stacked with the m x d matrix e, computed from the sketch and e
+//only. The scaler (mean, var, scale; d each) is exact, by merging the statistics. The covariance of the stacked matrix,
+//standardized with that scaler, is rebuilt from the sketch rescaled to the new scale, the shift of the baseline mean
+//and the rows of e (a rank r + 1 + m update), so only the baseline spectrum beyond rank r is lost. The model works on
+//standardized rows (its mean is 0).
+pca_model pca_fit_with_baseline(const baseline_sketch &base, const float *e, size_t m, size_t lde, size_t k, double *mean, double *var, float *scale);
+
+//symmetric_eigen: eigenvalues (decreasing) and eigenvectors (columns of vectors, m x m row-major) of the symmetric
+//m x m matrix a, by cyclic Jacobi rotations; a is destroyed
+void symmetric_eigen(double *a, size_t m, double *values, double *vectors);
+
+#endif
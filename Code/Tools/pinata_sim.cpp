@@ -0,0 +1,538 @@
+//Pinata board protocol simulator for load testing the acquisition host software without a board.
+//
+//Opens a pseudo-terminal and answers like Code/ErrorCode/main.c: command bytes and payload lengths come from
+//commands.h (the same header the firmware uses), replies follow the firmware handlers. Crypto commands return the
+//received block unchanged (no real encryption) with the same length as the firmware.
+//
+//Reception model: the bytes arrive at the configured baud rate into a ring of RXRINGLENGTH bytes, as the USART3 DMA of
+//the firmware stores them, and are cut into frames only when the previous command has been answered. A host more than
+//RXRINGLENGTH - 1 bytes ahead overwrites bytes not parsed yet, as on the board (reported on stderr). Overruns can be
+//injected; they are answered like the firmware: BadCmd once the line has been idle for RXIDLETICKS ms.
+//
+//Timing model: a command starts when its frame is in and the previous reply is out; its reply starts after a fixed
+//latency, the execution time of the command and a uniform random jitter drawn once per command, and its bytes leave
+//at the configured baud rate.
+//
+//Usage: pinata_sim [--link PATH] [--baud N] [--latency-us US] [--jitter-us US] [--exec-us CMD=US]... [--overrun-every N]
+//                  [--glitched] [--seed N]
+
+#include "../ErrorCode/commands.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock sim_clock;
+
+//Sizes of the replies that are not derived from the payload
+#define RSACRT1024_CLEARTEXT_LENGTH 128 //send_clear_text() after RSA-1024 CRT
+#define RSASFM_CLEARTEXT_LENGTH 64 //send_clear_text() after RSA-512 SFM
+#define RSASFM_KEY_LENGTH 64 //rsa_sfm_send_hardcoded_key(), 512-bit key
+#define SHA1_DIGEST_LENGTH 20
+
+struct sim_options {
+	std::string link;
+	double baud = 115200; //0 = unlimited
+	double latencyUs = 20;
+	double jitterUs = 0;
+	double execUs[256] = { };
+	bool glitched = false; //Reply like a board glitched during boot: 4 times (0x90 0x00) to unknown commands
+	unsigned long overrunEvery = 0; //Every Nth received byte is lost to a USART overrun (0 = never)
+	unsigned seed = 1;
+};
+
+struct sim_frame {
+	uint8_t cmd = 0;
+	std::vector<uint8_t> data;
+};
+
+//USART3 reception of the firmware: the DMA ring, written as the bytes come off the line, and its read position
+struct sim_rx {
+	uint8_t ring[RXRINGLENGTH];
+	uint64_t written = 0; //Bytes written by the DMA
+	uint64_t unread = 0; //Bytes written and not parsed, to report the host running more than RXRINGLENGTH - 1 bytes ahead
+	uint16_t read = 0; //rxRingRead
+	bool overrun = false; //USART_SR_ORE
+	sim_clock::time_point lastByte;
+
+	void store(uint8_t ch, sim_clock::time_point t) {
+		ring[written++ & (RXRINGLENGTH - 1)] = ch;
+		lastByte = t;
+		if (++unread == RXRINGLENGTH) {
+			fprintf(stderr, "pinata_sim: the host is %d bytes ahead, the ring overwrites bytes not parsed yet\n", RXRINGLENGTH);
+			unread = 0; //The board sees the ring as empty again
+		}
+	}
+	//pending: bytes the firmware sees in the ring
+	size_t pending() const { return (uint16_t) (written - read) & (RXRINGLENGTH - 1); }
+	uint8_t get() {
+		const uint8_t ch = ring[read];
+		read = (read + 1) & (RXRINGLENGTH - 1);
+		if (unread > 0) unread--;
+		return ch;
+	}
+	//drop: rx_resync, every byte received so far is discarded
+	void drop() {
+		read = written & (RXRINGLENGTH - 1);
+		unread = 0;
+	}
+};
+
+//State kept by the firmware between commands
+struct sim_board {
+	uint8_t password[4] = { 0x02, 0x06, 0x02, 0x08 };
+	bool authenticated = false;
+	uint8_t clockspeed = 168;
+	uint8_t clockSource = 2; //RCC_CFGR_SWS >> 2: 0 HSI, 1 HSE, 2 PLL
+	uint8_t quietWindowMode[256];
+	bool hung = false; //CMD_INFINITE_FI_LOOP never returns
+	bool glitched = false;
+
+	sim_board() { std::fill(quietWindowMode, quietWindowMode + 256, (uint8_t) QUIET_ON); }
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void on_signal(int) {
+	stopRequested = 1;
+}
+
+static bool is_error_program(uint8_t cmd) {
+	switch (cmd) {
+		case CMD_SUT00I: case CMD_SUT00F:
+		case CMD_E0101: case CMD_E0102: case CMD_E0103: case CMD_E0104: case CMD_E0105: case CMD_E0106:
+		case CMD_E0201: case CMD_E0202: case CMD_E0203: case CMD_E0204: case CMD_E0205:
+		case CMD_E0206: case CMD_E0207: case CMD_E0208: case CMD_E0209: case CMD_E0210:
+			return true;
+		case CMD_SUT00Q15: case CMD_E0101Q15: case CMD_E0102Q15: case CMD_E0106Q15:
+		case CMD_SUT00Q31: case CMD_E0101Q31: case CMD_E0102Q31: case CMD_E0106Q31:
+		case CMD_SUT00FPU: case CMD_E0101FPU: case CMD_E0102FPU: case CMD_E0106FPU:
+		case CMD_SUT00SWF: case CMD_E0101SWF: case CMD_E0102SWF: case CMD_E0106SWF:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//build_reply: bytes the firmware sends back for a complete command frame; rng draws the TRNG replies
+static std::vector<uint8_t> build_reply(sim_board &board, const sim_frame &frame, std::mt19937 &rng) {
+	const std::vector<uint8_t> &p = frame.data;
+	const uint8_t cmd = frame.cmd;
+	std::vector<uint8_t> r;
+
+	if (is_error_program(cmd)) {
+		r.push_back(cmd); //Error programs echo the command byte
+		return r;
+	}
+
+	switch (cmd) {
+		//Block ciphers and key copies: same length as the received block
+		case CMD_SWDES_ENC: case CMD_SWDES_DEC: case CMD_SWTDES_ENC: case CMD_SWTDES_DEC:
+		case CMD_SWDES_ENC_MISALIGNED: case CMD_SWDES_ENC_RND_SBOX: case CMD_SWDES_ENC_RND_DELAYS:
+		case CMD_HWDES_ENC: case CMD_HWDES_DEC: case CMD_HWTDES_ENC: case CMD_HWTDES_DEC:
+		case CMD_SWDES_ENCRYPT_DOUBLECHECK:
+		case CMD_SWAES128_ENC: case CMD_SWAES128SPI_ENC: case CMD_SWAES128_DEC:
+		case CMD_SWAES256_ENC: case CMD_SWAES256_DEC:
+		case CMD_SWSM4_ENC: case CMD_SWSM4_DEC: case CMD_SWSM4OSSL_ENC: case CMD_SWSM4OSSL_DEC:
+		case CMD_SWAES128_ENC_MISALIGNED: case CMD_SWAES128_ENC_MASKED: case CMD_SWAES128_DEC_MASKED:
+		case CMD_SWAES128_ENC_RNDDELAYS: case CMD_SWAES128_ENC_RNDSBOX:
+		case CMD_SWAES128TTABLES_ENC: case CMD_SWAES128TTABLES_DEC:
+		case CMD_HWAES128_ENC: case CMD_HWAES128_DEC: case CMD_HWAES256_ENC: case CMD_HWAES256_DEC:
+		case CMD_SWAES128_ENCRYPT_DOUBLECHECK:
+		case CMD_SWAES128_ENC_SIMPLE_MASKED_FROM_INSPECTOR:
+		case CMD_SOFTWARE_KEY_COPY:
+		case CMD_TDES_KEYCHANGE: case CMD_DES_KEYCHANGE: case CMD_AES128_KEYCHANGE:
+		case CMD_AES256_KEYCHANGE: case CMD_SM4_KEYCHANGE:
+			r = p;
+			break;
+
+		case CMD_SWAES128_ENC_MASKED_FROM_INSPECTOR:
+		case CMD_SWAES128_ENC_MASKED_FROM_INSPECTOR_SBOX_TRIGGER:
+		case CMD_SWAES128_ENC_ASCAD_MASKED_FROM_INSPECTOR:
+		case CMD_SWAES128_ENC_WEAK_MASKED_FROM_INSPECTOR:
+			r.assign(p.begin(), p.begin() + 16); //Ciphertext of the plaintext block
+			break;
+
+		case CMD_SHA1_HASH:
+		case CMD_HMAC_SHA1:
+			r.assign(SHA1_DIGEST_LENGTH, 0);
+			break;
+
+		case CMD_RSACRT1024_DEC:
+			r.assign(RSACRT1024_CLEARTEXT_LENGTH, 0);
+			break;
+		case CMD_RSASFM_DEC:
+			r.assign(RSASFM_CLEARTEXT_LENGTH, 0);
+			break;
+		case CMD_RSASFM_GET_HARDCODED_KEY:
+			r.assign(RSASFM_KEY_LENGTH, 0);
+			break;
+		case CMD_RSASFM_SET_D:
+			r.push_back(cmd);
+			break;
+		case CMD_RSASFM_SET_KEY_GENERATION_METHOD:
+		case CMD_RSASFM_SET_IMPLEMENTATION:
+			r.push_back(p[0]);
+			break;
+
+		case CMD_PWD_CHANGE:
+			board.authenticated = false;
+			std::copy(p.begin(), p.end(), board.password);
+			r = p;
+			break;
+		case CMD_SINGLE_PWD_CHECK_FI:
+			board.authenticated = std::equal(p.begin(), p.end(), board.password);
+			r = board.authenticated ? std::vector<uint8_t>{ 0x90, 0x00 } : std::vector<uint8_t>{ 0x69, 0x86 };
+			break;
+		case CMD_DOUBLE_PWD_CHECK_FI:
+			board.authenticated = std::equal(p.begin(), p.end(), board.password);
+			r = board.authenticated ? std::vector<uint8_t>{ 0x90, 0x00 } : std::vector<uint8_t>{ 0x69, 0x00 };
+			break;
+
+		case CMD_LOOP_TEST_FI:
+			r = { 0xA5, 0x00, 0x00, p[0], p[1], 0xA5 }; //Remaining count, then loop iterations
+			break;
+
+		case CMD_GET_RANDOM_FROM_TRNG:
+			for (int i = 0; i < 4; i++) r.push_back((uint8_t) rng());
+			break;
+		case CMD_UID_VIA_IO:
+			for (int i = 0; i < 12; i++) r.push_back((uint8_t) (0x10 + i));
+			break;
+		case CMD_GET_CODE_REV:
+			r = { 'V', 'e', 'r', ' ', '2', '.', '2', 0x00 };
+			break;
+		case CMD_CHANGE_CLK_SPEED:
+			board.clockspeed = (p[0] == 30 || p[0] == 84) ? p[0] : 168;
+			board.clockSource = 2;
+			r.push_back(board.clockspeed);
+			break;
+		case CMD_SET_EXTERNAL_CLOCK:
+			board.clockspeed = p[0] ? 168 : 8;
+			board.clockSource = p[0] ? 2 : 1;
+			r.push_back(board.clockSource);
+			break;
+		case CMD_SET_QUIET_WINDOW:
+			board.quietWindowMode[p[0]] = p[1] > QUIET_ON_KEEP_CRYP ? QUIET_ON : p[1];
+			r = { p[0], board.quietWindowMode[p[0]] };
+			break;
+
+		case CMD_OLED_TEST:
+			break;
+		case CMD_INFINITE_FI_LOOP:
+			board.hung = true;
+			break;
+
+		default:
+			if (board.glitched) {
+				for (int i = 0; i < 4; i++) {
+					r.push_back(0x90);
+					r.push_back(0x00);
+				}
+			} else if (board.authenticated) {
+				r = { 0xC0, 0xBF, 0xEF, 0xEE, 0xBA, 0xDB, 0xAB, 0xEE };
+			} else {
+				r = { 'B', 'a', 'd', 'C', 'm', 'd', '\n', 0x00 }; //cmdByteIsWrong
+			}
+			break;
+	}
+	return r;
+}
+
+//Frame parser: same frames as get_command() cuts from the ring
+class frame_parser {
+public:
+	//push: returns true when byte ch completes a frame, which is then moved to out
+	bool push(uint8_t ch, sim_frame &out) {
+		switch (state) {
+			case WAIT_CMD:
+				cur = sim_frame();
+				cur.cmd = ch;
+				expected = cmd_payload_length(ch);
+				if (expected == PAYLOAD_LEN_PREFIXED) {
+					expected = 2;
+					state = WAIT_LEN;
+				} else {
+					state = WAIT_PAYLOAD;
+				}
+				break;
+			case WAIT_LEN:
+				cur.data.push_back(ch);
+				if (cur.data.size() == 2) {
+					expected = std::min<unsigned>((cur.data[0] << 8) | cur.data[1], RXBUFFERLENGTH) + 2;
+					state = WAIT_PAYLOAD;
+				}
+				break;
+			case WAIT_PAYLOAD:
+				cur.data.push_back(ch);
+				break;
+		}
+		if (state == WAIT_PAYLOAD && cur.data.size() == expected) {
+			state = WAIT_CMD;
+			//Length-prefixed payloads: the handlers read the prefix with get_char, drop it here
+			if (cmd_payload_length(cur.cmd) == PAYLOAD_LEN_PREFIXED) {
+				cur.data.erase(cur.data.begin(), cur.data.begin() + 2);
+			}
+			out = std::move(cur);
+			return true;
+		}
+		return false;
+	}
+
+	void reset() { state = WAIT_CMD; }
+
+private:
+	enum { WAIT_CMD, WAIT_LEN, WAIT_PAYLOAD } state = WAIT_CMD;
+	unsigned expected = 0;
+	sim_frame cur;
+};
+
+static uint8_t parse_byte(const char *s) {
+	unsigned long v = strtoul(s, NULL, 0);
+	if (v > 0xFF) throw std::runtime_error(std::string("not a command byte: ") + s);
+	return (uint8_t) v;
+}
+
+static sim_options parse_options(int argc, char **argv) {
+	sim_options o;
+	for (int i = 1; i < argc; i++) {
+		std::string a = argv[i];
+		auto value = [&]() -> const char * {
+			if (i + 1 >= argc) throw std::runtime_error("missing value for " + a);
+			return argv[++i];
+		};
+		if (a == "--link") o.link = value();
+		else if (a == "--baud") o.baud = atof(value());
+		else if (a == "--latency-us") o.latencyUs = atof(value());
+		else if (a == "--jitter-us") o.jitterUs = atof(value());
+		else if (a == "--glitched") o.glitched = true;
+		else if (a == "--overrun-every") o.overrunEvery = strtoul(value(), NULL, 0);
+		else if (a == "--seed") o.seed = (unsigned) strtoul(value(), NULL, 0);
+		else if (a == "--exec-us") {
+			//CMD=US sets one command, default=US sets all commands
+			std::string v = value();
+			size_t eq = v.find('=');
+			if (eq == std::string::npos) throw std::runtime_error("expected CMD=US: " + v);
+			double us = atof(v.c_str() + eq + 1);
+			if (v.compare(0, eq, "default") == 0) std::fill(o.execUs, o.execUs + 256, us);
+			else o.execUs[parse_byte(v.substr(0, eq).c_str())] = us;
+		} else {
+			throw std::runtime_error("unknown option " + a);
+		}
+	}
+	return o;
+}
+
+//open_pty: master side of a new pseudo-terminal; the slave is set to raw mode and returned in slaveName
+static int open_pty(std::string &slaveName) {
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		throw std::runtime_error(std::string("cannot open pseudo-terminal: ") + strerror(errno));
+	}
+	slaveName = ptsname(master);
+
+	int slave = open(slaveName.c_str(), O_RDWR | O_NOCTTY);
+	if (slave < 0) throw std::runtime_error("cannot open " + slaveName);
+	struct termios tio;
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+	close(slave);
+
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+	return master;
+}
+
+int main(int argc, char **argv) {
+	sim_options opt;
+	try {
+		opt = parse_options(argc, argv);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "pinata_sim: %s\n", e.what());
+		fprintf(stderr, "usage: pinata_sim [--link PATH] [--baud N] [--latency-us US] [--jitter-us US] [--exec-us CMD=US]... [--overrun-every N] [--glitched] [--seed N]\n");
+		return 2;
+	}
+
+	std::string slaveName;
+	int master;
+	try {
+		master = open_pty(slaveName);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "pinata_sim: %s\n", e.what());
+		return 1;
+	}
+	if (!opt.link.empty()) {
+		unlink(opt.link.c_str());
+		if (symlink(slaveName.c_str(), opt.link.c_str()) != 0) {
+			fprintf(stderr, "pinata_sim: cannot create link %s\n", opt.link.c_str());
+		}
+	}
+	printf("Pinata simulator on %s%s%s\n", slaveName.c_str(), opt.link.empty() ? "" : " -> ", opt.link.c_str());
+	fflush(stdout);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	//Time a byte occupies the line: start bit + 8 data bits + stop bit
+	const sim_clock::duration byteTime = opt.baud > 0
+		? std::chrono::duration_cast<sim_clock::duration>(std::chrono::duration<double>(10.0 / opt.baud))
+		: sim_clock::duration::zero();
+	const sim_clock::duration idleTime = std::chrono::milliseconds(RXIDLETICKS);
+	//Separate streams, so that the TRNG replies of a seed do not depend on the timing
+	std::mt19937 trngRng(opt.seed);
+	std::seed_seq latencySeed = { opt.seed, 1u };
+	std::mt19937 latencyRng(latencySeed);
+	std::uniform_real_distribution<double> jitter(-opt.jitterUs, opt.jitterUs);
+	auto microseconds = [](double us) {
+		return std::chrono::duration_cast<sim_clock::duration>(std::chrono::duration<double, std::micro>(std::max(us, 0.0)));
+	};
+
+	//Board: cutting the next frame from the ring (get_command), dropping bytes after an overrun (rx_resync), executing a
+	//command until its reply is due, or sending the reply
+	enum { BOARD_PARSE, BOARD_RESYNC, BOARD_EXEC, BOARD_REPLY } state = BOARD_PARSE;
+	sim_board board;
+	board.glitched = opt.glitched;
+	sim_rx rx;
+	frame_parser parser;
+	sim_frame frame;
+	std::deque<std::pair<uint8_t, sim_clock::time_point>> line; //Bytes read from the pty, with the end of their time on the line
+	std::vector<uint8_t> reply;
+	size_t replySent = 0;
+	sim_clock::time_point rxLineFree = sim_clock::now(); //End of the last received byte on the line
+	sim_clock::time_point due, resyncFrom, txStart;
+	unsigned long long commands = 0, bytesIn = 0, bytesOut = 0, overruns = 0;
+	const sim_clock::time_point start = sim_clock::now();
+	bool connected = false;
+	uint8_t buf[4096];
+
+	while (!stopRequested) {
+		sim_clock::time_point now = sim_clock::now();
+
+		//Bytes whose time on the line is over are stored by the DMA, or lost to an injected overrun
+		while (!line.empty() && line.front().second <= now) {
+			if (opt.overrunEvery > 0 && (bytesIn - line.size() + 1) % opt.overrunEvery == 0) {
+				rx.overrun = true;
+				rx.lastByte = line.front().second;
+			} else {
+				rx.store(line.front().first, line.front().second);
+			}
+			line.pop_front();
+		}
+
+		//Board, until it waits for time to pass
+		for (bool progress = true; progress && !board.hung; ) {
+			progress = false;
+			if (state == BOARD_PARSE) {
+				if (rx.overrun) {
+					rx.overrun = false;
+					parser.reset();
+					resyncFrom = now;
+					state = BOARD_RESYNC;
+					overruns++;
+					progress = true;
+				} else if (rx.pending() > 0) {
+					if (parser.push(rx.get(), frame)) {
+						due = now + microseconds(opt.latencyUs + opt.execUs[frame.cmd] + (opt.jitterUs > 0 ? jitter(latencyRng) : 0.0));
+						state = BOARD_EXEC;
+					}
+					progress = true;
+				}
+			} else if (state == BOARD_RESYNC) {
+				rx.overrun = false;
+				if (now >= std::max(resyncFrom, rx.lastByte) + idleTime) {
+					rx.drop();
+					frame = sim_frame();
+					frame.cmd = CMD_UNKNOWN;
+					due = now + microseconds(opt.latencyUs + opt.execUs[frame.cmd] + (opt.jitterUs > 0 ? jitter(latencyRng) : 0.0));
+					state = BOARD_EXEC;
+					progress = true;
+				}
+			} else if (state == BOARD_EXEC) {
+				if (now >= due) {
+					reply = build_reply(board, frame, trngRng);
+					replySent = 0;
+					txStart = due;
+					state = BOARD_REPLY;
+					commands++;
+					progress = true;
+				}
+			} else {
+				//The firmware hands the bytes to the USART one at a time: byte i leaves at txStart + i byteTime
+				size_t ready = reply.size();
+				if (byteTime > sim_clock::duration::zero()) {
+					ready = std::min<size_t>(reply.size(), (size_t) ((now - txStart) / byteTime) + 1);
+				}
+				while (replySent < ready) {
+					ssize_t w = write(master, reply.data() + replySent, ready - replySent);
+					if (w > 0) replySent += w;
+					else std::this_thread::sleep_for(std::chrono::microseconds(100));
+				}
+				if (replySent == reply.size()) {
+					bytesOut += reply.size();
+					state = BOARD_PARSE;
+					progress = true;
+				}
+			}
+		}
+
+		//Wait for the next byte from the host or the next event of the line or the board
+		sim_clock::time_point next = now + std::chrono::milliseconds(100);
+		if (!line.empty()) next = std::min(next, line.front().second);
+		if (!board.hung) {
+			if (state == BOARD_RESYNC) next = std::min(next, std::max(resyncFrom, rx.lastByte) + idleTime);
+			else if (state == BOARD_EXEC) next = std::min(next, due);
+			else if (state == BOARD_REPLY) next = std::min(next, txStart + byteTime * (long) replySent);
+		}
+		const auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(next - sim_clock::now(), sim_clock::duration::zero()));
+		struct timespec timeout = { (time_t) (wait.count() / 1000000000), (long) (wait.count() % 1000000000) };
+		struct pollfd pfd = { master, POLLIN, 0 };
+		int ready = ppoll(&pfd, 1, &timeout, NULL);
+
+		if (ready > 0 && (pfd.revents & POLLHUP)) {
+			//Host closed the port: behave like a board reset and wait for it to reopen
+			if (connected) {
+				connected = false;
+				parser.reset();
+				line.clear();
+				rx = sim_rx();
+				state = BOARD_PARSE;
+				board = sim_board();
+				board.glitched = opt.glitched;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+		connected = true;
+
+		if (ready > 0 && (pfd.revents & POLLIN)) {
+			ssize_t n = read(master, buf, sizeof(buf));
+			now = sim_clock::now();
+			for (ssize_t i = 0; i < n; i++) {
+				rxLineFree = std::max(now, rxLineFree) + byteTime;
+				line.emplace_back(buf[i], rxLineFree);
+			}
+			bytesIn += n > 0 ? n : 0;
+		}
+	}
+
+	double elapsed = std::chrono::duration<double>(sim_clock::now() - start).count();
+	printf("%llu commands, %llu bytes in, %llu bytes out, %llu overruns in %.1f s (%.0f commands/s)\n",
+		commands, bytesIn, bytesOut, overruns, elapsed, elapsed > 0 ? commands / elapsed : 0.0);
+	if (!opt.link.empty()) unlink(opt.link.c_str());
+	close(master);
+	return 0;
+}
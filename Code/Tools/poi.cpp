@@ -0,0 +1,149 @@
+//Points of interest of the error programs against their baseline (see poi.h)
+
+#include "poi.h"
+#include "parallel.h"
+#include "simd.h"
+#include "trace_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+class_moments::class_moments(size_t samples, size_t classes) : d(samples), n(classes, 0), means(classes * samples, 0.0), m2s(classes * samples, 0.0) {
+	if (samples == 0 || classes == 0) throw std::invalid_argument("poi: no samples or no classes");
+}
+
+void class_moments::add(const float *x, size_t count, size_t ld, const uint32_t *classes) {
+	for (size_t i = 0; i < count; i++) {
+		if (classes[i] >= n.size()) throw std::invalid_argument("poi: class " + std::to_string(classes[i]) + " out of range");
+	}
+	const size_t W = SIMD_DWIDTH;
+	parallel_for((d + POI_BLOCK - 1) / POI_BLOCK, 1, [&](size_t begin, size_t end) {
+		std::vector<uint64_t> seen(n);
+		const size_t j0 = begin * POI_BLOCK, j1 = std::min(d, end * POI_BLOCK);
+		for (size_t i = 0; i < count; i++) {
+			//Welford: mean += (v - mean) / n, m2 += (v - old mean) (v - new mean)
+			const size_t c = classes[i];
+			const double inv = 1.0 / (double) ++seen[c];
+			const simd_dvec vinv = simd_dset1(inv);
+			const float *row = x + i * ld;
+			double *mean = means.data() + c * d, *m2 = m2s.data() + c * d;
+			size_t j = j0;
+			for (; j + W <= j1; j += W) {
+				const simd_dvec v = simd_dloadf(row + j), old = simd_dload(mean + j);
+				const simd_dvec delta = simd_dsub(v, old), updated = simd_dadd(old, simd_dmul(delta, vinv));
+				simd_dstore(mean + j, updated);
+				simd_dstore(m2 + j, simd_dadd(simd_dload(m2 + j), simd_dmul(delta, simd_dsub(v, updated))));
+			}
+			for (; j < j1; j++) {
+				const double v = row[j], delta = v - mean[j];
+				mean[j] += delta * inv;
+				m2[j] += delta * (v - mean[j]);
+			}
+		}
+	});
+	for (size_t i = 0; i < count; i++) n[classes[i]]++;
+}
+
+void poi_statistic(const class_moments &m, size_t a, size_t b, uint32_t statistic, double *out) {
+	if (statistic > POI_TTEST) throw std::invalid_argument("poi: unknown statistic");
+	if (a >= m.classes() || b >= m.classes()) throw std::invalid_argument("poi: class out of range");
+	if (m.count(a) < 2 || m.count(b) < 2) throw std::invalid_argument("poi: a class has fewer than 2 traces");
+	const double na = (double) m.count(a), nb = (double) m.count(b);
+	const double *ma = m.mean(a), *mb = m.mean(b), *sa = m.m2(a), *sb = m.m2(b);
+	for (size_t j = 0; j < m.samples(); j++) {
+		const double va = sa[j] / (na - 1.0), vb = sb[j] / (nb - 1.0), diff = mb[j] - ma[j];
+		const double noise = statistic == POI_SNR ? 2.0 * (va + vb) : va / na + vb / nb;
+		if (!(noise > 0.0)) out[j] = 0.0;
+		else if (statistic == POI_TTEST) out[j] = diff / std::sqrt(noise);
+		else out[j] = diff * diff / noise;
+	}
+}
+
+std::vector<uint32_t> poi_select(const double *score, size_t d, size_t points, size_t window) {
+	if (window == 0) window = 1;
+	if (window > d) throw std::invalid_argument("poi: the windows are longer than the traces");
+	//Candidates: the samples, or the starts of the windows, by decreasing absolute score
+	const size_t candidates = d - window + 1;
+	std::vector<double> sum(candidates);
+	for (size_t s = 0; s < candidates; s++) {
+		//Summed in full rather than as a running sum, whose rounding would break the ties differently
+		double w = 0.0;
+		for (size_t j = s; j < s + window; j++) w += std::fabs(score[j]);
+		sum[s] = w;
+	}
+	std::vector<uint32_t> order(candidates);
+	for (size_t s = 0; s < candidates; s++) order[s] = (uint32_t) s;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t p, uint32_t q) { return sum[p] > sum[q]; });
+
+	std::vector<uint32_t> selected;
+	std::vector<uint8_t> used(d, 0);
+	const size_t windows = std::max<size_t>(1, points / window);
+	for (size_t k = 0; k < candidates && selected.size() < windows * window; k++) {
+		const uint32_t s = order[k];
+		//Windows of the same length overlap when one holds an end of the other
+		if (used[s] || used[s + window - 1]) continue;
+		for (size_t j = s; j < s + window; j++) {
+			used[j] = 1;
+			selected.push_back((uint32_t) j);
+		}
+	}
+	std::sort(selected.begin(), selected.end());
+	return selected;
+}
+
+void trace_file_add_poi(const std::string &path, const poi_pair *pairs, size_t pairCount, uint32_t statistic, size_t points, size_t window) {
+	const trace_file file(path);
+	const size_t count = file.count(), length = file.length();
+	if (pairCount == 0) throw std::invalid_argument("poi: no programs");
+	if (points == 0) throw std::invalid_argument("poi: no points");
+
+	//Classes: the labels of the pairs; the traces of other labels are skipped
+	std::map<int32_t, uint32_t> classOf;
+	for (size_t p = 0; p < pairCount; p++) {
+		for (int32_t label : { pairs[p].baseline, pairs[p].program }) {
+			if (file.program_traces(label).size() < 2) throw std::invalid_argument(path + ": fewer than 2 traces of label " + std::to_string(label));
+			classOf.emplace(label, (uint32_t) classOf.size());
+		}
+	}
+
+	//One pass over the traces of these classes, by blocks read in physical units
+	std::vector<uint32_t> traceClass(count, UINT32_MAX);
+	for (size_t i = 0; i < count; i++) {
+		const auto c = classOf.find(file.records()[i].label);
+		if (c != classOf.end()) traceClass[i] = c->second;
+	}
+	class_moments moments(length, classOf.size());
+	std::vector<uint32_t> classes;
+	file.read_blocks([&](size_t i) { return traceClass[i] != UINT32_MAX; }, [&](const float *block, const size_t *rows, size_t n) {
+		classes.resize(n);
+		for (size_t r = 0; r < n; r++) classes[r] = traceClass[rows[r]];
+		moments.add(block, n, length, classes.data());
+	});
+
+	std::vector<trace_poi_program> programs(pairCount);
+	std::vector<uint32_t> indices;
+	std::vector<double> score(length);
+	for (size_t p = 0; p < pairCount; p++) {
+		poi_statistic(moments, classOf[pairs[p].baseline], classOf[pairs[p].program], statistic, score.data());
+		const std::vector<uint32_t> selected = poi_select(score.data(), length, points, window);
+		programs[p] = { pairs[p].baseline, pairs[p].program, (uint32_t) indices.size(), (uint32_t) selected.size() };
+		indices.insert(indices.end(), selected.begin(), selected.end());
+	}
+
+	trace_poi_header ph = trace_poi_header();
+	ph.programs = pairCount;
+	ph.statistic = statistic;
+	ph.points = points;
+	ph.window = std::max<size_t>(window, 1);
+	ph.samples = length;
+	trace_file_appender out(path);
+	const size_t programsSize = pairCount * sizeof(trace_poi_program);
+	const uint64_t offset = out.reserve(TRACE_SECTION_POI, sizeof(ph) + programsSize + indices.size() * sizeof(uint32_t));
+	out.write(offset, &ph, sizeof(ph));
+	out.write(offset + sizeof(ph), programs.data(), programsSize);
+	out.write(offset + sizeof(ph) + programsSize, indices.data(), indices.size() * sizeof(uint32_t));
+	out.commit();
+}
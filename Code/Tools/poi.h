@@ -0,0 +1,72 @@
+//Points of interest: the samples where an error program differs from its baseline program (SUT00F or SUT00I), so that
+//the scaler and the PCA of main.py run on a few hundred samples instead of the 50,000 of a trace
+//
+//class_moments accumulates the count, mean and sum of squared deviations of every sample for every class of traces
+//(the program labels) in one pass, trace after trace, by Welford's updates in double: the traces can be streamed and
+//are never held. The samples are split into blocks updated in parallel, SIMD_DWIDTH consecutive samples at once
+//(simd.h), each one seeing the traces in order.
+//
+//From the moments of two classes a (the baseline) and b (the program), with unbiased variances v and counts n, at
+//every sample:
+//  POI_SNR    (mean_b - mean_a)^2 / (2 (v_a + v_b)), the variance of the class means over the mean class variance
+//  POI_SOST   (mean_b - mean_a)^2 / (v_a / n_a + v_b / n_b), the sum of squared pairwise t-differences of Gierlichs et
+//             al., which for two classes is the square of the Welch t
+//  POI_TTEST  the Welch t, (mean_b - mean_a) / sqrt(v_a / n_a + v_b / n_b)
+//poi_select keeps the samples of largest statistic (absolute value for the t), or the non-overlapping windows of
+//largest summed statistic. trace_file_add_poi stores the points of every program of a container in it
+//(TRACE_SECTION_POI, trace_file.h).
+
+#ifndef __POI_H
+#define __POI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#define POI_SNR 0 //Statistics
+#define POI_SOST 1
+#define POI_TTEST 2
+#define POI_BLOCK 2048 //Samples per task of class_moments::add
+
+class class_moments {
+public:
+	class_moments(size_t samples, size_t classes);
+
+	size_t samples() const { return d; }
+	size_t classes() const { return n.size(); }
+	uint64_t count(size_t c) const { return n[c]; }
+	const double *mean(size_t c) const { return means.data() + c * d; }
+	const double *m2(size_t c) const { return m2s.data() + c * d; } //Sums of squared deviations
+
+	//add: the count traces of x (samples() floats each, rows ld floats apart) to the moments of their class
+	//(classes[i] < classes())
+	void add(const float *x, size_t count, size_t ld, const uint32_t *classes);
+
+private:
+	size_t d;
+	std::vector<uint64_t> n;
+	std::vector<double> means, m2s; //classes x samples
+};
+
+//poi_statistic: the statistic of class b against class a at every sample into out (samples() values); throws
+//std::invalid_argument if a class has fewer than 2 traces. A sample where both classes are constant has a statistic of
+//0.
+void poi_statistic(const class_moments &m, size_t a, size_t b, uint32_t statistic, double *out);
+
+//poi_select: the samples, in increasing order, of the points largest scores (of d), or of the points / window windows
+//of window samples of largest summed score that do not overlap (window > 1); ties go to the first samples
+std::vector<uint32_t> poi_select(const double *score, size_t d, size_t points, size_t window);
+
+//A program and its baseline, by label
+struct poi_pair {
+	int32_t baseline;
+	int32_t program;
+};
+
+//trace_file_add_poi: the points of interest of every pair of the container at path (statistic of the program against
+//the baseline over all their traces, in physical units, in one pass), stored in it, replacing those it may have
+void trace_file_add_poi(const std::string &path, const poi_pair *pairs, size_t pairCount, uint32_t statistic, size_t points, size_t window);
+
+#endif
@@ -0,0 +1,56 @@
+//Programs of the error campaign and their labels
+//
+//The label of a trace is the index of its program in PROGRAMS, the order used by add_cluster_to_traces.py and by the
+//names list of main.py. The command byte is the one the acquisition sends to the Pinata board (commands.h).
+
+#ifndef __PINATAPROGRAMS_H
+#define __PINATAPROGRAMS_H
+
+#include "../ErrorCode/commands.h"
+
+#include <cstring>
+
+struct program_info {
+	const char *name;
+	uint8_t cmd;
+};
+
+static const program_info PROGRAMS[] = {
+	{ "SUT00F", CMD_SUT00F },
+	{ "SUT00I", CMD_SUT00I },
+	{ "E0101", CMD_E0101 },
+	{ "E0102", CMD_E0102 },
+	{ "E0103", CMD_E0103 },
+	{ "E0104", CMD_E0104 },
+	{ "E0105", CMD_E0105 },
+	{ "E0106", CMD_E0106 },
+	{ "E0201", CMD_E0201 },
+	{ "E0202", CMD_E0202 },
+	{ "E0203", CMD_E0203 },
+	{ "E0204", CMD_E0204 },
+	{ "E0205", CMD_E0205 },
+	{ "E0206", CMD_E0206 },
+	{ "E0207", CMD_E0207 },
+	{ "E0208_1st", CMD_E0208 }, //E0208 and E0209 were captured twice
+	{ "E0208_2nd", CMD_E0208 },
+	{ "E0209_1st", CMD_E0209 },
+	{ "E0209_2nd", CMD_E0209 },
+	{ "E0210", CMD_E0210 },
+};
+
+#define PROGRAM_COUNT ((int) (sizeof(PROGRAMS) / sizeof(PROGRAMS[0])))
+
+//program_cmd: command byte of a label, CMD_UNKNOWN if the label is not in the table
+static inline uint8_t program_cmd(int label) {
+	return label >= 0 && label < PROGRAM_COUNT ? PROGRAMS[label].cmd : CMD_UNKNOWN;
+}
+
+//program_label: label of a program name, -1 if the name is not in the table
+static inline int program_label(const char *name) {
+	for (int i = 0; i < PROGRAM_COUNT; i++) {
+		if (strcmp(PROGRAMS[i].name, name) == 0) return i;
+	}
+	return -1;
+}
+
+#endif
@@ -0,0 +1,212 @@
+//Welch power spectral densities and short-time band powers of the traces (see psd.h)
+
+#include "psd.h"
+#include "parallel.h"
+#include "simd.h"
+#include "spectrum.h"
+#include "trace_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+std::vector<double> psd_window(uint32_t window, size_t n) {
+	if (window > PSD_BLACKMAN) throw std::invalid_argument("psd: unknown window");
+	std::vector<double> w(n, 1.0);
+	if (n == 1) return w;
+	for (size_t i = 0; i < n; i++) {
+		const double a = 2.0 * M_PI * (double) i / (double) n;
+		if (window == PSD_HANN) w[i] = 0.5 - 0.5 * std::cos(a);
+		else if (window == PSD_HAMMING) w[i] = 0.54 - 0.46 * std::cos(a);
+		else if (window == PSD_BLACKMAN) w[i] = 0.42 - 0.5 * std::cos(a) + 0.08 * std::cos(2.0 * a);
+	}
+	return w;
+}
+
+size_t psd_segments(const psd_options &o, size_t n) {
+	if (o.segment == 0 || o.segment > n) throw std::invalid_argument("psd: the segments must have between 1 and " + std::to_string(n) + " samples");
+	if (o.overlap >= o.segment) throw std::invalid_argument("psd: the overlap must be shorter than the segments");
+	return (n - o.overlap) / (o.segment - o.overlap);
+}
+
+//What the batches of traces of one analysis share
+struct psd_setup {
+	psd_options o;
+	size_t segments;
+	rfft_plan plan;
+	std::vector<double> window;
+	std::vector<double> scale; //Density scale of every bin, doubled for the bins folded from negative frequencies
+	double binWidth;
+	std::vector<std::pair<size_t, size_t>> bands; //Bins [first, last) of every band
+
+	psd_setup(const psd_options &o, size_t n, const psd_band *b, size_t bandCount)
+		: o(o), segments(psd_segments(o, n)), plan(o.segment), window(psd_window(o.window, o.segment)) {
+		if (!(o.sampleRate > 0)) throw std::invalid_argument("psd: the sample rate must be positive");
+		double sum = 0.0;
+		for (double w : window) sum += w * w;
+		const size_t bins = plan.bins();
+		scale.assign(bins, 2.0 / (o.sampleRate * sum));
+		scale[0] /= 2.0;
+		if (o.segment % 2 == 0) scale[bins - 1] /= 2.0;
+		binWidth = o.sampleRate / o.segment;
+		for (size_t i = 0; i < bandCount; i++) {
+			if (!(b[i].low < b[i].high) || b[i].low < 0 || b[i].low > o.sampleRate / 2) {
+				throw std::invalid_argument("psd: invalid band " + std::to_string(b[i].low) + " - " + std::to_string(b[i].high) + " Hz");
+			}
+			//Bins of frequency k * binWidth in [low, high); a band narrower than the bins takes the bin nearest its center
+			size_t first = (size_t) std::min<double>(bins, std::ceil(b[i].low / binWidth));
+			size_t last = (size_t) std::min<double>(bins, std::ceil(b[i].high / binWidth));
+			if (first >= last) {
+				first = std::min<size_t>(bins - 1, (size_t) std::nearbyint((b[i].low + b[i].high) / 2 / binWidth));
+				last = first + 1;
+			}
+			bands.push_back({ first, last });
+		}
+	}
+};
+
+//Per-thread buffers of psd_batch
+struct psd_buffers {
+	std::vector<double> work, power, sum;
+
+	explicit psd_buffers(const psd_setup &s)
+		: work(s.plan.workspace()), power(s.plan.bins() * SIMD_DWIDTH), sum(std::max(s.plan.bins(), s.bands.size()) * SIMD_DWIDTH) {}
+};
+
+//band_value: band power as stored, in decibels if asked
+static inline float band_value(double power, const band_options &b) {
+	return (float) (b.decibels ? 10.0 * std::log10(std::max(power, PSD_FLOOR)) : power);
+}
+
+//psd_batch: Welch PSD of count <= lanes traces (bins of the plan, no bands in s) or their band features into out[i]
+static void psd_batch(const psd_setup &s, const band_options &b, const float *const *rows, size_t count, float *const *out, psd_buffers &buf) {
+	const size_t W = SIMD_DWIDTH, bins = s.plan.bins(), nb = s.bands.size();
+	const size_t step = s.o.segment - s.o.overlap;
+	const bool spectrogram = nb && b.spectrogram;
+	double *power = buf.power.data(), *sum = buf.sum.data();
+	std::fill(buf.sum.begin(), buf.sum.end(), 0.0);
+	const float *segment[SIMD_DWIDTH];
+	double values[SIMD_DWIDTH];
+	for (size_t j = 0; j < s.segments; j++) {
+		for (size_t l = 0; l < count; l++) segment[l] = rows[l] + j * step;
+		s.plan.power(segment, count, s.window.data(), s.o.detrend, power, buf.work.data());
+		if (!spectrogram) {
+			//Welch: densities summed over the segments
+			for (size_t k = 0; k < bins; k++) {
+				const simd_dvec d = simd_dmul(simd_dload(power + k * W), simd_dset1(s.scale[k]));
+				simd_dstore(sum + k * W, simd_dadd(simd_dload(sum + k * W), d));
+			}
+			continue;
+		}
+		for (size_t i = 0; i < nb; i++) {
+			simd_dvec v = simd_dset1(0.0);
+			for (size_t k = s.bands[i].first; k < s.bands[i].second; k++) v = simd_dadd(v, simd_dmul(simd_dload(power + k * W), simd_dset1(s.scale[k])));
+			simd_dstore(values, simd_dmul(v, simd_dset1(s.binWidth)));
+			for (size_t l = 0; l < count; l++) out[l][j * nb + i] = band_value(values[l], b);
+		}
+	}
+	if (spectrogram) return;
+
+	const double mean = 1.0 / s.segments;
+	if (!nb) {
+		for (size_t l = 0; l < count; l++) {
+			for (size_t k = 0; k < bins; k++) out[l][k] = (float) (sum[k * W + l] * mean);
+		}
+		return;
+	}
+	for (size_t i = 0; i < nb; i++) {
+		simd_dvec v = simd_dset1(0.0);
+		for (size_t k = s.bands[i].first; k < s.bands[i].second; k++) v = simd_dadd(v, simd_dload(sum + k * W));
+		simd_dstore(values, simd_dmul(v, simd_dset1(mean * s.binWidth)));
+		for (size_t l = 0; l < count; l++) out[l][i] = band_value(values[l], b);
+	}
+}
+
+//psd_rows: psd_batch over count traces of x (rows ld floats apart) into out (rows ldOut apart), batches in parallel
+static void psd_rows(const psd_setup &s, const band_options &b, const float *x, size_t count, size_t ld, float *out, size_t ldOut) {
+	const size_t W = SIMD_DWIDTH;
+	parallel_for((count + W - 1) / W, 1, [&](size_t begin, size_t end) {
+		psd_buffers buf(s);
+		const float *rows[SIMD_DWIDTH];
+		float *outs[SIMD_DWIDTH];
+		for (size_t t = begin; t < end; t++) {
+			const size_t c = std::min(W, count - t * W);
+			for (size_t l = 0; l < c; l++) {
+				rows[l] = x + (t * W + l) * ld;
+				outs[l] = out + (t * W + l) * ldOut;
+			}
+			psd_batch(s, b, rows, c, outs, buf);
+		}
+	});
+}
+
+void welch_psd(const float *x, size_t count, size_t n, size_t ld, const psd_options &o, float *out, size_t ldOut) {
+	const psd_setup s(o, n, nullptr, 0);
+	psd_rows(s, band_options(), x, count, ld, out, ldOut);
+}
+
+void band_features(const float *x, size_t count, size_t n, size_t ld, const psd_options &o, const psd_band *bands, size_t bandCount,
+	const band_options &b, float *out, size_t ldOut) {
+	if (bandCount == 0) throw std::invalid_argument("psd: no bands");
+	const psd_setup s(o, n, bands, bandCount);
+	psd_rows(s, b, x, count, ld, out, ldOut);
+}
+
+void trace_file_add_band_features(const std::string &path, size_t samples, const psd_options &o, const psd_band *bands, size_t bandCount,
+	const band_options &b) {
+	const trace_file file(path);
+	if (samples == 0) samples = file.length();
+	if (samples > file.length()) throw std::invalid_argument(path + ": the traces have fewer samples than the features");
+	if (bandCount == 0) throw std::invalid_argument("psd: no bands");
+	psd_options po = o;
+	po.sampleRate = file.header().sampleRate;
+	const psd_setup s(po, samples, bands, bandCount);
+	const size_t count = file.count(), length = file.length(), W = SIMD_DWIDTH;
+
+	trace_features_header fh = trace_features_header();
+	fh.segments = b.spectrogram ? s.segments : 1;
+	fh.bands = bandCount;
+	fh.features = fh.segments * fh.bands;
+	fh.rowStride = (fh.features * sizeof(float) + TRACE_FILE_ALIGN - 1) / TRACE_FILE_ALIGN * TRACE_FILE_ALIGN;
+	fh.samples = samples;
+	fh.segment = po.segment;
+	fh.overlap = po.overlap;
+	fh.window = po.window;
+	fh.flags = (b.spectrogram ? TRACE_FEATURES_SPECTROGRAM : 0) | (b.decibels ? TRACE_FEATURES_DECIBELS : 0) | (po.detrend ? TRACE_FEATURES_DETRENDED : 0);
+	fh.sampleRate = po.sampleRate;
+	fh.rowsOffset = (sizeof(fh) + bandCount * 2 * sizeof(double) + TRACE_FILE_ALIGN - 1) / TRACE_FILE_ALIGN * TRACE_FILE_ALIGN;
+	trace_file_appender out(path);
+	const uint64_t offset = out.reserve(TRACE_SECTION_FEATURES, fh.rowsOffset + count * fh.rowStride);
+	std::vector<uint8_t> head(fh.rowsOffset, 0);
+	memcpy(head.data(), &fh, sizeof(fh));
+	for (size_t i = 0; i < bandCount; i++) {
+		const double band[2] = { bands[i].low, bands[i].high };
+		memcpy(head.data() + sizeof(fh) + i * sizeof(band), band, sizeof(band));
+	}
+	out.write(offset, head.data(), head.size());
+
+	//Blocks of traces: read in physical units, the batches of a block in parallel, then written
+	const size_t ld = fh.rowStride / sizeof(float);
+	std::vector<float> block(TRACE_FILE_BLOCK * ld);
+	file.for_each_block([&](size_t b0, size_t nt) {
+		std::fill(block.begin(), block.end(), 0.0f);
+		parallel_for((nt + W - 1) / W, 1, [&](size_t begin, size_t end) {
+			psd_buffers buf(s);
+			std::vector<float> physical(W * length);
+			const float *rows[SIMD_DWIDTH];
+			float *outs[SIMD_DWIDTH];
+			for (size_t t = begin; t < end; t++) {
+				const size_t c = std::min(W, nt - t * W);
+				for (size_t l = 0; l < c; l++) {
+					file.read_trace(b0 + t * W + l, physical.data() + l * length);
+					rows[l] = physical.data() + l * length;
+					outs[l] = block.data() + (t * W + l) * ld;
+				}
+				psd_batch(s, b, rows, c, outs, buf);
+			}
+		});
+		out.write(offset + fh.rowsOffset + b0 * fh.rowStride, block.data(), nt * fh.rowStride);
+	});
+	out.commit();
+}
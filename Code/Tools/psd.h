@@ -0,0 +1,67 @@
+//Welch power spectral densities and short-time band powers of the traces, for the EM analysis, where the energy of a
+//few bands (the 30, 84 and 168 MHz clocks of setClockSpeed in ../ErrorCode/main.c) matters more than the full spectrum
+//
+//A trace is cut into segments of psd_options.segment samples, overlap samples apart from the previous one; every
+//segment is centered on its mean (detrend), windowed, and transformed with the real FFT of spectrum.h, several traces at
+//once. The one-sided densities are scaled as scipy.signal.welch and scipy.signal.spectrogram do (scaling='density'):
+//|X[k]|^2 / (sampleRate * sum(window^2)), doubled except for the DC and Nyquist bins. welch_psd averages them over the
+//segments. band_features integrates them over frequency bands: the band powers of the Welch PSD (one value per band),
+//or of every segment (a spectrogram pooled into segments x bands values), optionally in decibels. Only one segment of
+//every trace is transformed at a time, so traces of any length take bins x lanes doubles of accumulators.
+//
+//trace_file_add_band_features stores the band features of all the traces of a container in it (TRACE_SECTION_FEATURES,
+//trace_file.h), for the PCA and clustering stages to run on a few hundred features instead of the samples.
+
+#ifndef __PSD_H
+#define __PSD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#define PSD_BOXCAR 0 //Windows, as scipy.signal.get_window (periodic)
+#define PSD_HANN 1
+#define PSD_HAMMING 2
+#define PSD_BLACKMAN 3
+#define PSD_FLOOR 1e-30 //Smallest power converted to decibels
+
+struct psd_options {
+	size_t segment = 256; //Samples per segment (nperseg)
+	size_t overlap = 128; //Samples shared by consecutive segments (noverlap)
+	uint32_t window = PSD_HANN;
+	bool detrend = true; //Center every segment on its mean (detrend='constant')
+	double sampleRate = 1e9; //Hz
+};
+
+//A frequency band [low, high) in Hz; a band narrower than the bins takes the bin nearest its center
+struct psd_band {
+	double low, high;
+};
+
+struct band_options {
+	bool spectrogram = false; //Band powers of every segment instead of the Welch PSD
+	bool decibels = false; //10 log10 of the band powers (at least PSD_FLOOR)
+};
+
+//psd_window: the periodic window of n samples (scipy.signal.get_window(name, n))
+std::vector<double> psd_window(uint32_t window, size_t n);
+//psd_segments: segments of a trace of n samples
+size_t psd_segments(const psd_options &o, size_t n);
+
+//welch_psd: Welch PSD of the first n samples of count traces (rows ld floats apart) into out (segment / 2 + 1 bins per
+//row, rows ldOut apart)
+void welch_psd(const float *x, size_t count, size_t n, size_t ld, const psd_options &o, float *out, size_t ldOut);
+//band_features: band powers of the first n samples of count traces into out (rows ldOut apart): bandCount values per
+//trace, or psd_segments x bandCount (segment-major) with a spectrogram
+void band_features(const float *x, size_t count, size_t n, size_t ld, const psd_options &o, const psd_band *bands, size_t bandCount,
+	const band_options &b, float *out, size_t ldOut);
+
+//trace_file_add_band_features: adds to the container at path the band features of the first samples samples (0 for
+//all) of all its traces, in physical units, at the sample rate of the container (o.sampleRate is ignored), replacing
+//the features it may have
+void trace_file_add_band_features(const std::string &path, size_t samples, const psd_options &o, const psd_band *bands, size_t bandCount,
+	const band_options &b);
+
+#endif
@@ -0,0 +1,589 @@
+//C interface of the native tools (see sca_capi.h)
+
+#include "sca_capi.h"
+#include "trace_file.h"
+#include "spectrum.h"
+#include "psd.h"
+#include "decimate.h"
+#include "align.h"
+#include "dtw.h"
+#include "poi.h"
+#include "tvla.h"
+#include "cpa.h"
+#include "pca.h"
+#include "cluster.h"
+#include "metrics.h"
+#include "experiment.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+static thread_local std::string lastError;
+
+//guarded: runs fn, turning exceptions into the -1 / sca_last_error convention
+template <typename F>
+static int guarded(F fn) {
+	try {
+		fn();
+		return 0;
+	} catch (const std::exception &e) {
+		lastError = e.what();
+	} catch (...) {
+		lastError = "unknown error";
+	}
+	return -1;
+}
+
+extern "C" const char *sca_last_error(void) {
+	return lastError.c_str();
+}
+
+/////////////////////
+//  TRACE CONTAINER //
+/////////////////////
+
+extern "C" int sca_trace_open(const char *path, void **file) {
+	return guarded([&]() {
+		*file = nullptr;
+		*file = new trace_file(path);
+	});
+}
+
+extern "C" void sca_trace_close(void *file) {
+	delete (trace_file *) file;
+}
+
+extern "C" int sca_trace_get_info(void *file, sca_trace_info *info) {
+	return guarded([&]() {
+		const trace_file &f = *(const trace_file *) file;
+		const trace_file_header &h = f.header();
+		memset(info, 0, sizeof(*info));
+		info->traceCount = h.traceCount;
+		info->traceLength = h.traceLength;
+		info->traceStride = h.traceStride;
+		info->chunkTraces = h.chunkTraces;
+		info->dtype = h.dtype;
+		info->sampleRate = h.sampleRate;
+		info->scale = h.scale;
+		info->offset = h.offset;
+		info->data = f.data();
+		info->records = f.records();
+		size_t ranges;
+		info->programIndex = f.program_index(&ranges);
+		info->programCount = ranges;
+		memcpy(info->description, h.description, sizeof(info->description) - 1);
+		if (const trace_spectra_header *s = f.spectra()) {
+			info->spectra = f.spectrum(0);
+			info->spectraBins = s->bins;
+			info->spectraStride = s->rowStride;
+			info->spectraSamples = s->samples;
+			info->binWidth = s->binWidth;
+		}
+		if (const trace_features_header *h = f.features()) {
+			info->features = f.feature_row(0);
+			info->featureBands = f.feature_bands();
+			info->featureCount = h->features;
+			info->featureStride = h->rowStride;
+			info->featureSegments = h->segments;
+			info->featureBandCount = h->bands;
+			info->featureFlags = h->flags;
+			info->featureSamples = h->samples;
+			info->featureSegment = h->segment;
+			info->featureOverlap = h->overlap;
+			info->featureWindow = h->window;
+			info->featureSampleRate = h->sampleRate;
+		}
+		if (const trace_shifts_header *h = f.shifts()) {
+			info->shifts = f.shift_rows();
+			info->alignStart = h->start;
+			info->alignLength = h->length;
+			info->alignMaxShift = h->maxShift;
+			info->alignIterations = h->iterations;
+		}
+		if (const trace_decimated_header *h = f.decimated()) {
+			info->decimated = f.decimated_trace(0);
+			info->decimatedFactor = h->factor;
+			info->decimatedSamples = h->samples;
+			info->decimatedStride = h->rowStride;
+			info->decimatedTaps = h->taps;
+			info->decimatedSampleRate = h->sampleRate;
+		}
+		if (const trace_poi_header *h = f.poi()) {
+			info->poiPrograms = f.poi_programs();
+			info->poiIndices = f.poi_indices();
+			info->poiProgramCount = h->programs;
+			info->poiStatistic = h->statistic;
+			info->poiPoints = h->points;
+			info->poiWindow = h->window;
+			info->poiSamples = h->samples;
+		}
+	});
+}
+
+extern "C" int sca_trace_prefetch(void *file, uint64_t first, uint64_t count) {
+	return guarded([&]() {
+		((const trace_file *) file)->prefetch(first, count);
+	});
+}
+
+extern "C" int sca_trace_add_spectra(const char *path, uint32_t samples) {
+	return guarded([&]() {
+		trace_file_add_spectra(path, samples);
+	});
+}
+
+extern "C" int sca_magnitude_spectra(const float *x, uint64_t n, uint32_t samples, uint64_t ld, float *out) {
+	return guarded([&]() {
+		magnitude_spectra(x, n, samples, ld, out, samples / 2 + 1);
+	});
+}
+
+extern "C" int sca_decimate(const float *x, uint64_t n, uint64_t d, uint64_t ld, uint32_t q, float *out) {
+	return guarded([&]() {
+		decimate(x, n, d, ld, q, out, decimated_length(d, q));
+	});
+}
+
+extern "C" int sca_trace_add_decimated(const char *path, uint32_t q) {
+	return guarded([&]() {
+		trace_file_add_decimated(path, q);
+	});
+}
+
+//psd_from, bands_from: the options of psd.h
+static psd_options psd_from(const sca_psd_options *options) {
+	psd_options o;
+	o.segment = options->segment;
+	o.overlap = options->overlap;
+	o.window = options->window;
+	o.detrend = options->detrend != 0;
+	o.sampleRate = options->sampleRate;
+	return o;
+}
+
+static band_options bands_from(uint32_t flags) {
+	band_options b;
+	b.spectrogram = (flags & TRACE_FEATURES_SPECTROGRAM) != 0;
+	b.decibels = (flags & TRACE_FEATURES_DECIBELS) != 0;
+	return b;
+}
+
+extern "C" int sca_welch(const float *x, uint64_t n, uint64_t d, uint64_t ld, const sca_psd_options *options, float *out) {
+	return guarded([&]() {
+		welch_psd(x, n, d, ld, psd_from(options), out, options->segment / 2 + 1);
+	});
+}
+
+extern "C" int sca_band_features(const float *x, uint64_t n, uint64_t d, uint64_t ld, const sca_psd_options *options, const double *bands,
+	uint32_t bandCount, uint32_t flags, float *out) {
+	return guarded([&]() {
+		const psd_options o = psd_from(options);
+		const size_t features = (flags & TRACE_FEATURES_SPECTROGRAM ? psd_segments(o, d) : 1) * bandCount;
+		static_assert(sizeof(psd_band) == 2 * sizeof(double), "bands are given as (low, high) pairs");
+		band_features(x, n, d, ld, o, (const psd_band *) bands, bandCount, bands_from(flags), out, features);
+	});
+}
+
+extern "C" int sca_trace_add_band_features(const char *path, uint32_t samples, const sca_psd_options *options, const double *bands, uint32_t bandCount,
+	uint32_t flags) {
+	return guarded([&]() {
+		trace_file_add_band_features(path, samples, psd_from(options), (const psd_band *) bands, bandCount, bands_from(flags));
+	});
+}
+
+//align_from: the options of align.h, defaults where options has 0
+static align_options align_from(const sca_align_options *options) {
+	align_options o;
+	o.start = options->start;
+	o.length = options->length;
+	if (options->maxShift) o.maxShift = options->maxShift;
+	if (options->iterations) o.iterations = options->iterations;
+	return o;
+}
+
+extern "C" int sca_align(const float *x, uint64_t n, uint64_t d, uint64_t ld, const int32_t *groups, const sca_align_options *options, double *shifts,
+	double *correlations) {
+	return guarded([&]() {
+		align_traces(x, n, d, ld, groups, align_from(options), shifts, correlations);
+	});
+}
+
+extern "C" int sca_apply_shifts(const float *x, uint64_t n, uint64_t d, uint64_t ld, const double *shifts, float *out) {
+	return guarded([&]() {
+		apply_shifts(x, n, d, ld, shifts, out, d);
+	});
+}
+
+extern "C" int sca_trace_add_alignment(const char *path, const sca_align_options *options) {
+	return guarded([&]() {
+		trace_file_add_alignment(path, align_from(options));
+	});
+}
+
+extern "C" int sca_dtw_warp(const float *x, uint64_t n, uint64_t d, uint64_t ld, const int32_t *groups, const sca_dtw_options *options, float *out,
+	double *distances) {
+	return guarded([&]() {
+		dtw_options o;
+		o.start = options->start;
+		o.length = options->length;
+		o.radius = options->radius;
+		if (options->iterations) o.iterations = options->iterations;
+		const dtw_options w = dtw_window(o, d);
+		dtw_warp(x, n, d, ld, groups, w, out, w.length, distances);
+	});
+}
+
+/////////////////////
+//  POI             //
+/////////////////////
+
+extern "C" int sca_moments_create(uint64_t d, uint32_t classCount, void **moments) {
+	return guarded([&]() {
+		*moments = nullptr;
+		*moments = new class_moments(d, classCount);
+	});
+}
+
+extern "C" void sca_moments_close(void *moments) {
+	delete (class_moments *) moments;
+}
+
+extern "C" int sca_moments_add(void *moments, const float *x, uint64_t n, uint64_t ld, const uint32_t *classes) {
+	return guarded([&]() {
+		((class_moments *) moments)->add(x, n, ld, classes);
+	});
+}
+
+extern "C" int sca_moments_count(void *moments, uint32_t c, uint64_t *count) {
+	return guarded([&]() {
+		const class_moments &m = *(const class_moments *) moments;
+		if (c >= m.classes()) throw std::invalid_argument("poi: class out of range");
+		*count = m.count(c);
+	});
+}
+
+extern "C" int sca_poi_statistic(void *moments, uint32_t a, uint32_t b, uint32_t statistic, double *out) {
+	return guarded([&]() {
+		poi_statistic(*(const class_moments *) moments, a, b, statistic, out);
+	});
+}
+
+extern "C" int sca_poi_select(const double *score, uint64_t d, uint32_t points, uint32_t window, uint32_t *indices, uint32_t *count) {
+	return guarded([&]() {
+		const std::vector<uint32_t> selected = poi_select(score, d, points, window);
+		std::copy(selected.begin(), selected.end(), indices);
+		*count = selected.size();
+	});
+}
+
+extern "C" int sca_trace_add_poi(const char *path, const int32_t *pairs, uint32_t pairCount, uint32_t statistic, uint32_t points, uint32_t window) {
+	return guarded([&]() {
+		static_assert(sizeof(poi_pair) == 2 * sizeof(int32_t), "pairs are given as (baseline, program) pairs");
+		trace_file_add_poi(path, (const poi_pair *) pairs, pairCount, statistic, points, window);
+	});
+}
+
+/////////////////////
+//  TVLA            //
+/////////////////////
+
+extern "C" int sca_tvla_create(uint64_t d, uint32_t order, void **tvla) {
+	return guarded([&]() {
+		*tvla = nullptr;
+		*tvla = new tvla_accumulator(d, order);
+	});
+}
+
+extern "C" void sca_tvla_close(void *tvla) {
+	delete (tvla_accumulator *) tvla;
+}
+
+extern "C" int sca_tvla_add(void *tvla, const float *x, uint64_t n, uint64_t ld, const uint8_t *groups) {
+	return guarded([&]() {
+		((tvla_accumulator *) tvla)->add(x, n, ld, groups);
+	});
+}
+
+extern "C" int sca_tvla_add_trace_file(void *tvla, const char *path, const uint8_t *groups) {
+	return guarded([&]() {
+		trace_file_tvla(path, groups, *(tvla_accumulator *) tvla);
+	});
+}
+
+extern "C" int sca_tvla_merge(void *tvla, void *other) {
+	return guarded([&]() {
+		((tvla_accumulator *) tvla)->merge(*(const tvla_accumulator *) other);
+	});
+}
+
+extern "C" int sca_tvla_count(void *tvla, uint32_t group, uint64_t *count) {
+	return guarded([&]() {
+		if (group > TVLA_RANDOM) throw std::invalid_argument("tvla: unknown group");
+		*count = ((const tvla_accumulator *) tvla)->count(group);
+	});
+}
+
+extern "C" int sca_tvla_t(void *tvla, uint32_t order, double *out) {
+	return guarded([&]() {
+		((const tvla_accumulator *) tvla)->t(order, out);
+	});
+}
+
+/////////////////////
+//  CPA             //
+/////////////////////
+
+extern "C" int sca_cpa_create(uint32_t cipher, uint32_t model, uint64_t d, void **cpa) {
+	return guarded([&]() {
+		*cpa = nullptr;
+		*cpa = new cpa_engine(cipher, model, d);
+	});
+}
+
+extern "C" void sca_cpa_close(void *cpa) {
+	delete (cpa_engine *) cpa;
+}
+
+extern "C" int sca_cpa_info(void *cpa, uint32_t *targets, uint32_t *guesses, uint32_t *inputBytes, uint64_t *count) {
+	return guarded([&]() {
+		const cpa_engine &e = *(const cpa_engine *) cpa;
+		*targets = e.shape().targets;
+		*guesses = e.shape().guesses;
+		*inputBytes = e.shape().inputBytes;
+		*count = e.count();
+	});
+}
+
+extern "C" int sca_cpa_add(void *cpa, const float *x, uint64_t n, uint64_t ld, const uint8_t *inputs) {
+	return guarded([&]() {
+		((cpa_engine *) cpa)->add(x, n, ld, inputs);
+	});
+}
+
+extern "C" int sca_cpa_add_trace_file(void *cpa, const char *path, const uint8_t *inputs, uint64_t start) {
+	return guarded([&]() {
+		trace_file_cpa(path, inputs, start, *(cpa_engine *) cpa);
+	});
+}
+
+extern "C" int sca_cpa_correlation(void *cpa, uint32_t target, double *out) {
+	return guarded([&]() {
+		((const cpa_engine *) cpa)->correlation(target, out);
+	});
+}
+
+extern "C" int sca_cpa_peaks(void *cpa, double *peaks, uint32_t *at) {
+	return guarded([&]() {
+		((const cpa_engine *) cpa)->peaks(peaks, at);
+	});
+}
+
+extern "C" int sca_cpa_first_round_key(uint32_t cipher, const uint8_t *key, uint32_t *right) {
+	return guarded([&]() {
+		const std::vector<uint32_t> r = cpa_first_round_key(cipher, key);
+		std::copy(r.begin(), r.end(), right);
+	});
+}
+
+extern "C" int sca_cpa_ranks(const double *peaks, uint32_t targets, uint32_t guesses, const uint32_t *right, uint32_t *ranks) {
+	return guarded([&]() {
+		cpa_ranks(peaks, targets, guesses, right, ranks);
+	});
+}
+
+/////////////////////
+//  PCA             //
+/////////////////////
+
+extern "C" int sca_scaler_fit(const float *x, uint64_t n, uint64_t d, uint64_t ld, double *mean, double *var, float *scale) {
+	return guarded([&]() {
+		column_stats(x, n, d, ld, mean, var);
+		standard_scale(mean, var, n, d, scale);
+	});
+}
+
+extern "C" int sca_standardize(const float *x, uint64_t n, uint64_t d, uint64_t ld, const float *mean, const float *scale, float *out) {
+	return guarded([&]() {
+		standardize(x, n, d, ld, mean, scale, out, d);
+	});
+}
+
+extern "C" int sca_pca_fit(const float *x, uint64_t n, uint64_t d, uint64_t ld, uint32_t k, int32_t iterations, uint32_t oversamples,
+	uint64_t seed, float *mean, float *components, double *singularValues, double *explainedVariance, double *explainedVarianceRatio) {
+	return guarded([&]() {
+		pca_model model = pca_fit(x, n, d, ld, k, seed, iterations, oversamples);
+		std::copy(model.mean.begin(), model.mean.end(), mean);
+		std::copy(model.basis.begin(), model.basis.end(), components);
+		std::copy(model.singularValues.begin(), model.singularValues.end(), singularValues);
+		std::copy(model.explainedVariance.begin(), model.explainedVariance.end(), explainedVariance);
+		std::copy(model.explainedVarianceRatio.begin(), model.explainedVarianceRatio.end(), explainedVarianceRatio);
+	});
+}
+
+extern "C" int sca_pca_transform(const float *x, uint64_t n, uint64_t d, uint64_t ld, uint32_t k, const float *mean, const float *components, float *out) {
+	return guarded([&]() {
+		pca_project(x, n, d, ld, mean, components, k, out);
+	});
+}
+
+extern "C" int sca_baseline_create(const float *x, uint64_t n, uint64_t d, uint64_t ld, uint32_t rank, uint64_t seed, void **baseline) {
+	return guarded([&]() {
+		*baseline = nullptr;
+		*baseline = new baseline_sketch(baseline_sketch_fit(x, n, d, ld, rank, seed));
+	});
+}
+
+extern "C" void sca_baseline_close(void *baseline) {
+	delete (baseline_sketch *) baseline;
+}
+
+extern "C" int sca_baseline_pca_fit(void *baseline, const float *e, uint64_t m, uint64_t lde, uint32_t k, double *mean, double *var, float *scale,
+	float *components, double *singularValues, double *explainedVariance, double *explainedVarianceRatio) {
+	return guarded([&]() {
+		pca_model model = pca_fit_with_baseline(*(const baseline_sketch *) baseline, e, m, lde, k, mean, var, scale);
+		std::copy(model.basis.begin(), model.basis.end(), components);
+		std::copy(model.singularValues.begin(), model.singularValues.end(), singularValues);
+		std::copy(model.explainedVariance.begin(), model.explainedVariance.end(), explainedVariance);
+		std::copy(model.explainedVarianceRatio.begin(), model.explainedVarianceRatio.end(), explainedVarianceRatio);
+	});
+}
+
+/////////////////////
+//  CLUSTERING      //
+/////////////////////
+
+extern "C" int sca_neighbors_create(const double *x, uint64_t n, uint32_t dim, uint64_t ld, uint32_t k, void **graph) {
+	return guarded([&]() {
+		*graph = nullptr;
+		*graph = new neighbor_graph(x, n, dim, ld, k);
+	});
+}
+
+extern "C" void sca_neighbors_close(void *graph) {
+	delete (neighbor_graph *) graph;
+}
+
+extern "C" int sca_neighbors_kneighbors(void *graph, uint32_t k, double *distances, int64_t *indices) {
+	return guarded([&]() {
+		const neighbor_graph &g = *(const neighbor_graph *) graph;
+		if (k > g.size()) throw std::invalid_argument("kneighbors: more neighbors than points");
+		parallel_for(g.size(), 64, [&](size_t b, size_t e) {
+			std::vector<uint32_t> index(k);
+			for (size_t i = b; i < e; i++) {
+				g.nearest(i, k, index.data(), distances + i * k);
+				for (size_t j = 0; j < k; j++) {
+					distances[i * k + j] = std::sqrt(distances[i * k + j]);
+					indices[i * k + j] = index[j];
+				}
+			}
+		});
+	});
+}
+
+extern "C" int sca_dbscan(void *graph, double eps, uint32_t minSamples, int32_t *labels, uint8_t *core) {
+	return guarded([&]() {
+		std::vector<int32_t> l = dbscan(*(const neighbor_graph *) graph, eps, minSamples, core);
+		std::copy(l.begin(), l.end(), labels);
+	});
+}
+
+//optics_view: graph of the arrays of the caller; the arrays an extraction does not use may be null
+static optics_graph optics_view(uint64_t n, const int32_t *ordering, const double *coreDistances, const double *reachability, const int32_t *predecessor) {
+	optics_graph g;
+	g.ordering.resize(n);
+	for (uint64_t i = 0; i < n; i++) {
+		if (ordering[i] < 0 || (uint64_t) ordering[i] >= n) throw std::invalid_argument("optics: invalid ordering");
+		g.ordering[i] = ordering[i];
+	}
+	if (coreDistances) g.coreDistances.assign(coreDistances, coreDistances + n);
+	g.reachability.assign(reachability, reachability + n);
+	if (predecessor) g.predecessor.assign(predecessor, predecessor + n);
+	return g;
+}
+
+extern "C" int sca_optics(void *graph, uint32_t minSamples, double maxEps, int32_t *ordering, double *coreDistances, double *reachability, int32_t *predecessor) {
+	return guarded([&]() {
+		optics_graph g = optics(*(const neighbor_graph *) graph, minSamples, maxEps);
+		std::copy(g.ordering.begin(), g.ordering.end(), ordering);
+		std::copy(g.coreDistances.begin(), g.coreDistances.end(), coreDistances);
+		std::copy(g.reachability.begin(), g.reachability.end(), reachability);
+		std::copy(g.predecessor.begin(), g.predecessor.end(), predecessor);
+	});
+}
+
+extern "C" int sca_optics_dbscan(uint64_t n, const int32_t *ordering, const double *coreDistances, const double *reachability, double eps, int32_t *labels) {
+	return guarded([&]() {
+		std::vector<int32_t> l = optics_dbscan(optics_view(n, ordering, coreDistances, reachability, nullptr), eps);
+		std::copy(l.begin(), l.end(), labels);
+	});
+}
+
+extern "C" int sca_optics_xi(uint64_t n, const int32_t *ordering, const double *reachability, const int32_t *predecessor, uint32_t minSamples,
+	uint32_t minClusterSize, double xi, int predecessorCorrection, int32_t *labels, uint64_t *clusters, uint64_t capacity, uint64_t *clusterCount) {
+	return guarded([&]() {
+		std::vector<std::pair<size_t, size_t>> c;
+		std::vector<int32_t> l = optics_xi(optics_view(n, ordering, nullptr, reachability, predecessor), minSamples, minClusterSize, xi, predecessorCorrection, &c);
+		std::copy(l.begin(), l.end(), labels);
+		for (size_t i = 0; i < c.size() && i < capacity; i++) {
+			clusters[2 * i] = c[i].first;
+			clusters[2 * i + 1] = c[i].second;
+		}
+		*clusterCount = c.size();
+	});
+}
+
+extern "C" int sca_estimate_bandwidth(void *graph, const uint32_t *sample, uint64_t m, double quantile, double *bandwidth) {
+	return guarded([&]() {
+		*bandwidth = estimate_bandwidth(*(const neighbor_graph *) graph, sample, m, quantile);
+	});
+}
+
+extern "C" int sca_mean_shift(void *graph, double bandwidth, int binSeeding, uint32_t minBinFreq, int clusterAll, uint32_t maxIter, double *centers,
+	uint64_t *clusterCount, int32_t *labels, uint32_t *iterations) {
+	return guarded([&]() {
+		const neighbor_graph &g = *(const neighbor_graph *) graph;
+		mean_shift_result r = mean_shift(g, bandwidth, binSeeding, minBinFreq, clusterAll, maxIter);
+		std::copy(r.centers.begin(), r.centers.end(), centers);
+		*clusterCount = r.centers.size() / g.dims();
+		std::copy(r.labels.begin(), r.labels.end(), labels);
+		*iterations = r.iterations;
+	});
+}
+
+extern "C" int sca_silhouette(void *graph, const int32_t *labels, double *samples, double *score) {
+	return guarded([&]() {
+		const neighbor_graph &g = *(const neighbor_graph *) graph;
+		std::vector<double> s(g.size());
+		silhouette_samples(g, labels, s.data());
+		if (samples) std::copy(s.begin(), s.end(), samples);
+		*score = numpy_sum(s.data(), s.size()) / s.size();
+	});
+}
+
+extern "C" int sca_label_scores(uint64_t n, const double *truth, const double *pred, double *nmi, double *auc) {
+	return guarded([&]() {
+		label_contingency table = contingency_table(truth, pred, n);
+		*nmi = normalized_mutual_info(table);
+		*auc = roc_auc(table);
+	});
+}
+
+extern "C" int sca_experiments_run(const float *x, uint64_t ld, const float *spectra, uint64_t ldSpectra, const sca_experiment_program *programs,
+	uint32_t programCount, const uint32_t *settings, uint32_t settingCount, uint32_t executions, uint64_t seed, void *scores, void *summaries) {
+	return guarded([&]() {
+		std::vector<experiment_program> p(programCount);
+		for (size_t i = 0; i < programCount; i++) {
+			p[i] = { programs[i].id, (const baseline_sketch *) programs[i].baseline, programs[i].baselineTraces, programs[i].baselineLd,
+				programs[i].errorTraces, programs[i].errorCount, (const baseline_sketch *) programs[i].spectralBaseline,
+				programs[i].baselineSpectra, programs[i].baselineSpectraLd };
+		}
+		std::vector<experiment_setting> s(settingCount);
+		for (size_t i = 0; i < settingCount; i++) s[i] = { settings[2 * i], settings[2 * i + 1] };
+		run_experiments(x, ld, spectra, ldSpectra, p, s, executions, seed, (experiment_scores *) scores, (experiment_summary *) summaries);
+	});
+}
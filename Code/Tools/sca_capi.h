@@ -0,0 +1,241 @@
+//C interface of the native tools, built as the shared library libsca.so and used from Python by sca_native.py
+//
+//Functions return 0 on success and -1 on error; sca_last_error gives the message of the last error of the calling thread.
+//Handles are opaque pointers released with the matching close function.
+
+#ifndef __SCACAPI_H
+#define __SCACAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const char *sca_last_error(void);
+
+//Trace container (trace_file.h)
+typedef struct {
+	uint64_t traceCount;
+	uint32_t traceLength;
+	uint32_t traceStride; //Bytes
+	uint32_t chunkTraces;
+	uint32_t dtype; //TRACE_INT8, TRACE_INT16, TRACE_FLOAT32
+	double sampleRate;
+	float scale;
+	float offset;
+	const void *data; //traceCount traces, traceStride bytes apart
+	const void *records; //traceCount trace_record
+	const void *programIndex; //programCount trace_program_range, sorted by label
+	uint64_t programCount;
+	char description[128];
+	const void *spectra; //traceCount magnitude spectra of spectraBins floats, spectraStride bytes apart; null if absent
+	uint32_t spectraBins;
+	uint32_t spectraStride; //Bytes
+	uint32_t spectraSamples; //Samples of the traces transformed
+	double binWidth; //Hz
+	const void *features; //traceCount band feature vectors of featureCount floats, featureStride bytes apart; null if absent
+	const void *featureBands; //featureBandCount (low, high) pairs of doubles, Hz
+	uint32_t featureCount; //featureSegments x featureBandCount, segment-major
+	uint32_t featureStride; //Bytes
+	uint32_t featureSegments;
+	uint32_t featureBandCount;
+	uint32_t featureFlags; //TRACE_FEATURES_SPECTROGRAM, TRACE_FEATURES_DECIBELS, TRACE_FEATURES_DETRENDED
+	uint32_t featureSamples; //Samples of the traces analyzed
+	uint32_t featureSegment; //PSD options of the features: samples per segment, overlap, window (PSD_HANN, ...)
+	uint32_t featureOverlap;
+	uint32_t featureWindow;
+	double featureSampleRate; //Hz
+	const void *shifts; //traceCount trace_shift (shift, correlation) pairs of floats; null if absent
+	uint32_t alignStart; //Reference window of the shifts
+	uint32_t alignLength;
+	uint32_t alignMaxShift;
+	uint32_t alignIterations;
+	const void *decimated; //traceCount decimated traces of decimatedSamples floats, decimatedStride bytes apart; null if absent
+	uint32_t decimatedFactor;
+	uint32_t decimatedSamples;
+	uint32_t decimatedStride; //Bytes
+	uint32_t decimatedTaps;
+	double decimatedSampleRate; //Hz
+	const void *poiPrograms; //poiProgramCount trace_poi_program (baseline, program, first, count); null if absent
+	const void *poiIndices; //Samples of the points of interest of all the programs, uint32
+	uint32_t poiProgramCount;
+	uint32_t poiStatistic; //POI_SNR, POI_SOST, POI_TTEST
+	uint32_t poiPoints;
+	uint32_t poiWindow;
+	uint32_t poiSamples;
+} sca_trace_info;
+
+int sca_trace_open(const char *path, void **file);
+void sca_trace_close(void *file);
+int sca_trace_get_info(void *file, sca_trace_info *info);
+int sca_trace_prefetch(void *file, uint64_t first, uint64_t count);
+
+//Magnitude spectra (spectrum.h). add_spectra: stores in the container the spectra of the first samples samples (0: all)
+//of its traces. magnitude_spectra: spectra of the first samples samples of n rows of x (ld elements apart) into out
+//(samples / 2 + 1 floats per row, contiguous).
+int sca_trace_add_spectra(const char *path, uint32_t samples);
+int sca_magnitude_spectra(const float *x, uint64_t n, uint32_t samples, uint64_t ld, float *out);
+
+//Decimation by q behind the anti-aliasing filter (decimate.h): n rows of d samples (ld elements apart) into out
+//(ceil(d / q) floats per row, contiguous). The container version adds the decimated traces to the container.
+int sca_decimate(const float *x, uint64_t n, uint64_t d, uint64_t ld, uint32_t q, float *out);
+int sca_trace_add_decimated(const char *path, uint32_t q);
+
+//Power spectral densities (psd.h) of segments of segment samples, overlap shared with the previous one, centered if
+//detrend is set and windowed (PSD_BOXCAR, PSD_HANN, PSD_HAMMING, PSD_BLACKMAN). welch: n rows of segment / 2 + 1 bins.
+//band_features: bands are bandCount (low, high) pairs in Hz and flags TRACE_FEATURES_SPECTROGRAM and
+//TRACE_FEATURES_DECIBELS; n rows of bandCount features, or psd_segments x bandCount with a spectrogram. The container
+//version uses the sample rate of the container.
+typedef struct {
+	uint32_t segment;
+	uint32_t overlap;
+	uint32_t window;
+	uint32_t detrend;
+	double sampleRate;
+} sca_psd_options;
+
+int sca_welch(const float *x, uint64_t n, uint64_t d, uint64_t ld, const sca_psd_options *options, float *out);
+int sca_band_features(const float *x, uint64_t n, uint64_t d, uint64_t ld, const sca_psd_options *options, const double *bands,
+	uint32_t bandCount, uint32_t flags, float *out);
+int sca_trace_add_band_features(const char *path, uint32_t samples, const sca_psd_options *options, const double *bands, uint32_t bandCount,
+	uint32_t flags);
+
+//Alignment (align.h) on the reference window [start, start + length) with shifts up to maxShift (0 for the defaults of
+//align_options). align: shifts and correlations of n rows of d samples (ld elements apart), each on the reference of
+//its group. apply_shifts: the n rows resampled at their shifts into out (d floats per row, contiguous). The container
+//version aligns every trace on the reference of its program label and stores the shifts in the container.
+typedef struct {
+	uint32_t start;
+	uint32_t length;
+	uint32_t maxShift;
+	uint32_t iterations;
+} sca_align_options;
+
+int sca_align(const float *x, uint64_t n, uint64_t d, uint64_t ld, const int32_t *groups, const sca_align_options *options, double *shifts,
+	double *correlations);
+int sca_apply_shifts(const float *x, uint64_t n, uint64_t d, uint64_t ld, const double *shifts, float *out);
+int sca_trace_add_alignment(const char *path, const sca_align_options *options);
+
+//Dynamic time warping (dtw.h) of the window [start, start + length) (length 0: to the end) of n rows of d samples (ld
+//elements apart) onto the template of their group, within radius samples of the diagonal, into out (length floats per
+//row, contiguous); distances (may be null) receives the cost of every path.
+typedef struct {
+	uint32_t start;
+	uint32_t length;
+	uint32_t radius;
+	uint32_t iterations;
+} sca_dtw_options;
+
+int sca_dtw_warp(const float *x, uint64_t n, uint64_t d, uint64_t ld, const int32_t *groups, const sca_dtw_options *options, float *out,
+	double *distances);
+
+//Points of interest (poi.h). moments: per-class moments of rows of d samples, updated by n rows of x (ld elements
+//apart) of classes classes[i] < classCount at a time. poi_statistic: POI_SNR, POI_SOST or POI_TTEST of class b against
+//class a at every sample (d doubles). poi_select: the samples of the points largest absolute scores, or of the
+//points / window windows of largest summed score, in increasing order into indices (room for max(points, window)),
+//count of them. The container version stores the points of pairCount (baseline, program) label pairs in the container.
+int sca_moments_create(uint64_t d, uint32_t classCount, void **moments);
+void sca_moments_close(void *moments);
+int sca_moments_add(void *moments, const float *x, uint64_t n, uint64_t ld, const uint32_t *classes);
+int sca_moments_count(void *moments, uint32_t c, uint64_t *count);
+int sca_poi_statistic(void *moments, uint32_t a, uint32_t b, uint32_t statistic, double *out);
+int sca_poi_select(const double *score, uint64_t d, uint32_t points, uint32_t window, uint32_t *indices, uint32_t *count);
+int sca_trace_add_poi(const char *path, const int32_t *pairs, uint32_t pairCount, uint32_t statistic, uint32_t points, uint32_t window);
+
+//Fixed-vs-random leakage assessment (tvla.h) of rows of d samples up to the given order, updated by n rows of x (ld
+//elements apart) of groups groups[i] (TVLA_FIXED, TVLA_RANDOM, other values skipped) at a time, or by the traces of a
+//container. merge adds the traces of another accumulator. t: the Welch t of an order at every sample (d doubles).
+int sca_tvla_create(uint64_t d, uint32_t order, void **tvla);
+void sca_tvla_close(void *tvla);
+int sca_tvla_add(void *tvla, const float *x, uint64_t n, uint64_t ld, const uint8_t *groups);
+int sca_tvla_add_trace_file(void *tvla, const char *path, const uint8_t *groups);
+int sca_tvla_merge(void *tvla, void *other);
+int sca_tvla_count(void *tvla, uint32_t group, uint64_t *count);
+int sca_tvla_t(void *tvla, uint32_t order, double *out);
+
+//Correlation power analysis (cpa.h) of the first round of CPA_AES or CPA_DES with the CPA_HW or CPA_HD model, on rows
+//of d samples. info: targets (key parts), guesses per target and input bytes per trace. add: n rows of x (ld elements
+//apart) with their inputs (n x inputBytes), or the samples [start, start + d) of the traces of a container.
+//correlation: guesses x d doubles for a target. peaks: targets x guesses largest |correlation| and their samples (may be
+//null). first_round_key: the right guess of every target for a key; ranks: the rank of the right guesses from peaks.
+int sca_cpa_create(uint32_t cipher, uint32_t model, uint64_t d, void **cpa);
+void sca_cpa_close(void *cpa);
+int sca_cpa_info(void *cpa, uint32_t *targets, uint32_t *guesses, uint32_t *inputBytes, uint64_t *count);
+int sca_cpa_add(void *cpa, const float *x, uint64_t n, uint64_t ld, const uint8_t *inputs);
+int sca_cpa_add_trace_file(void *cpa, const char *path, const uint8_t *inputs, uint64_t start);
+int sca_cpa_correlation(void *cpa, uint32_t target, double *out);
+int sca_cpa_peaks(void *cpa, double *peaks, uint32_t *at);
+int sca_cpa_first_round_key(uint32_t cipher, const uint8_t *key, uint32_t *right);
+int sca_cpa_ranks(const double *peaks, uint32_t targets, uint32_t guesses, const uint32_t *right, uint32_t *ranks);
+
+//Standardization and PCA (pca.h): matrices of n rows of d floats, rows ld elements apart; outputs are contiguous
+int sca_scaler_fit(const float *x, uint64_t n, uint64_t d, uint64_t ld, double *mean, double *var, float *scale);
+int sca_standardize(const float *x, uint64_t n, uint64_t d, uint64_t ld, const float *mean, const float *scale, float *out);
+//iterations < 0: scikit-learn's choice. Outputs: mean (d), components (k x d), and k singular values, explained
+//variances and explained variance ratios
+int sca_pca_fit(const float *x, uint64_t n, uint64_t d, uint64_t ld, uint32_t k, int32_t iterations, uint32_t oversamples,
+	uint64_t seed, float *mean, float *components, double *singularValues, double *explainedVariance, double *explainedVarianceRatio);
+int sca_pca_transform(const float *x, uint64_t n, uint64_t d, uint64_t ld, uint32_t k, const float *mean, const float *components, float *out);
+
+//Baseline sketches (pca.h): scaler and PCA of a fixed baseline stacked with m other rows e, fitted many times. Outputs of
+//sca_baseline_pca_fit: the scaler (mean, var, scale) and the PCA of the standardized rows, as sca_pca_fit.
+int sca_baseline_create(const float *x, uint64_t n, uint64_t d, uint64_t ld, uint32_t rank, uint64_t seed, void **baseline);
+void sca_baseline_close(void *baseline);
+int sca_baseline_pca_fit(void *baseline, const float *e, uint64_t m, uint64_t lde, uint32_t k, double *mean, double *var, float *scale,
+	float *components, double *singularValues, double *explainedVariance, double *explainedVarianceRatio);
+
+//Neighbor graph (neighbors.h) of n points of dim doubles, rows ld elements apart, with the k nearest neighbors of every
+//point; it is given to the eps heuristic and to all the clustering functions. kneighbors: the k nearest points of every
+//point (n x k distances and indices, self included), as NearestNeighbors.kneighbors.
+int sca_neighbors_create(const double *x, uint64_t n, uint32_t dim, uint64_t ld, uint32_t k, void **graph);
+void sca_neighbors_close(void *graph);
+int sca_neighbors_kneighbors(void *graph, uint32_t k, double *distances, int64_t *indices);
+
+//Clustering (cluster.h) of the points of a neighbor graph. Labels as scikit-learn, -1 for noise; core[i] is set for the
+//core points (core may be null).
+int sca_dbscan(void *graph, double eps, uint32_t minSamples, int32_t *labels, uint8_t *core);
+//OPTICS ordering (n each: ordering, core distances, reachability, predecessors) and its two cluster extractions. The xi
+//extraction writes up to capacity clusters as (start, end) pairs and sets clusterCount to their total number.
+int sca_optics(void *graph, uint32_t minSamples, double maxEps, int32_t *ordering, double *coreDistances, double *reachability, int32_t *predecessor);
+int sca_optics_dbscan(uint64_t n, const int32_t *ordering, const double *coreDistances, const double *reachability, double eps, int32_t *labels);
+int sca_optics_xi(uint64_t n, const int32_t *ordering, const double *reachability, const int32_t *predecessor, uint32_t minSamples,
+	uint32_t minClusterSize, double xi, int predecessorCorrection, int32_t *labels, uint64_t *clusters, uint64_t capacity, uint64_t *clusterCount);
+//Bandwidth and mean shift. sample: m point indices (null for all the points). centers: room for n rows of dim doubles,
+//clusterCount of them are set.
+int sca_estimate_bandwidth(void *graph, const uint32_t *sample, uint64_t m, double quantile, double *bandwidth);
+int sca_mean_shift(void *graph, double bandwidth, int binSeeding, uint32_t minBinFreq, int clusterAll, uint32_t maxIter, double *centers,
+	uint64_t *clusterCount, int32_t *labels, uint32_t *iterations);
+
+//Clustering scores (metrics.h). silhouette: of the labels of the points of a neighbor graph, n samples (may be null)
+//and their mean. label_scores: normalized mutual information and ROC AUC (NaN unless truth has two values) of the
+//predictions of n points, from one contingency table.
+int sca_silhouette(void *graph, const int32_t *labels, double *samples, double *score);
+int sca_label_scores(uint64_t n, const double *truth, const double *pred, double *nmi, double *auc);
+
+//Monte-Carlo experiments of main.py (experiment.h) on the trace matrix x, rows ld elements apart. A program has the
+//baseline sketch of its baseline program (sca_baseline_create) with the baseline traces, and the rows of x holding its
+//own traces; mean shift runs on the spectra (rows ldSpectra apart) with the sketch of the baseline spectra if it is given.
+//settings: settingCount (components, algorithm bits) pairs. scores and summaries receive experiment_scores and
+//experiment_summary records.
+typedef struct {
+	uint32_t id;
+	void *baseline;
+	const float *baselineTraces;
+	uint64_t baselineLd;
+	const uint64_t *errorTraces;
+	uint64_t errorCount;
+	void *spectralBaseline; //May be null
+	const float *baselineSpectra;
+	uint64_t baselineSpectraLd;
+} sca_experiment_program;
+
+int sca_experiments_run(const float *x, uint64_t ld, const float *spectra, uint64_t ldSpectra, const sca_experiment_program *programs,
+	uint32_t programCount, const uint32_t *settings, uint32_t settingCount, uint32_t executions, uint64_t seed, void *scores, void *summaries);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,306 @@
+//SIMD kernels on float (and a few on double) vectors shared by the analysis engines
+//
+//Each kernel has an AVX-512F, an AVX2+FMA and a scalar version, chosen at compile time (build with -march=native).
+//The matrix tiles are written once on simd_vec, a register of SIMD_WIDTH floats (a plain float without SIMD).
+//Long reductions are accumulated in float registers over blocks of SIMD_BLOCK elements and the block sums are added in
+//double, so the error does not grow with the 50,000-sample traces.
+
+#ifndef __SIMD_H
+#define __SIMD_H
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+#define SIMD_BLOCK 1024 //Elements summed in float before the partial sum is added in double
+
+#if defined(__AVX512F__)
+#define SIMD_WIDTH 16
+typedef __m512 simd_vec;
+static inline simd_vec simd_zero() { return _mm512_setzero_ps(); }
+static inline simd_vec simd_set1(float v) { return _mm512_set1_ps(v); }
+static inline simd_vec simd_load(const float *p) { return _mm512_loadu_ps(p); }
+static inline void simd_store(float *p, simd_vec v) { _mm512_storeu_ps(p, v); }
+static inline simd_vec simd_subv(simd_vec a, simd_vec b) { return _mm512_sub_ps(a, b); }
+static inline simd_vec simd_fmadd(simd_vec a, simd_vec b, simd_vec c) { return _mm512_fmadd_ps(a, b, c); }
+static inline float simd_hsum(simd_vec v) { return _mm512_reduce_add_ps(v); }
+#elif defined(__AVX2__) && defined(__FMA__)
+#define SIMD_WIDTH 8
+typedef __m256 simd_vec;
+static inline simd_vec simd_zero() { return _mm256_setzero_ps(); }
+static inline simd_vec simd_set1(float v) { return _mm256_set1_ps(v); }
+static inline simd_vec simd_load(const float *p) { return _mm256_loadu_ps(p); }
+static inline void simd_store(float *p, simd_vec v) { _mm256_storeu_ps(p, v); }
+static inline simd_vec simd_subv(simd_vec a, simd_vec b) { return _mm256_sub_ps(a, b); }
+static inline simd_vec simd_fmadd(simd_vec a, simd_vec b, simd_vec c) { return _mm256_fmadd_ps(a, b, c); }
+static inline float simd_hsum(simd_vec v) {
+	__m128 h = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+	return _mm_cvtss_f32(_mm_add_ss(h, _mm_movehdup_ps(h)));
+}
+#else
+#define SIMD_WIDTH 1
+typedef float simd_vec;
+static inline simd_vec simd_zero() { return 0.0f; }
+static inline simd_vec simd_set1(float v) { return v; }
+static inline simd_vec simd_load(const float *p) { return *p; }
+static inline void simd_store(float *p, simd_vec v) { *p = v; }
+static inline simd_vec simd_subv(simd_vec a, simd_vec b) { return a - b; }
+static inline simd_vec simd_fmadd(simd_vec a, simd_vec b, simd_vec c) { return a * b + c; }
+static inline float simd_hsum(simd_vec v) { return v; }
+#endif
+
+//Double registers of SIMD_DWIDTH lanes, for the kernels that run the same computation on several series at once, one
+//series per lane (the batched FFT of spectrum.h, the DTW of dtw.h), or on consecutive samples in double (the moments of
+//poi.h). simd_dless is the bit mask of the lanes where a < b; simd_dloadf converts SIMD_DWIDTH floats.
+#if defined(__AVX512F__)
+#define SIMD_DWIDTH 8
+typedef __m512d simd_dvec;
+static inline simd_dvec simd_dset1(double v) { return _mm512_set1_pd(v); }
+static inline simd_dvec simd_dload(const double *p) { return _mm512_loadu_pd(p); }
+static inline simd_dvec simd_dloadf(const float *p) { return _mm512_cvtps_pd(_mm256_loadu_ps(p)); }
+static inline void simd_dstore(double *p, simd_dvec v) { _mm512_storeu_pd(p, v); }
+static inline simd_dvec simd_dadd(simd_dvec a, simd_dvec b) { return _mm512_add_pd(a, b); }
+static inline simd_dvec simd_dsub(simd_dvec a, simd_dvec b) { return _mm512_sub_pd(a, b); }
+static inline simd_dvec simd_dmul(simd_dvec a, simd_dvec b) { return _mm512_mul_pd(a, b); }
+static inline simd_dvec simd_dsqrt(simd_dvec a) { return _mm512_sqrt_pd(a); }
+static inline simd_dvec simd_dmin(simd_dvec a, simd_dvec b) { return _mm512_min_pd(a, b); }
+static inline unsigned simd_dless(simd_dvec a, simd_dvec b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+#elif defined(__AVX2__) && defined(__FMA__)
+#define SIMD_DWIDTH 4
+typedef __m256d simd_dvec;
+static inline simd_dvec simd_dset1(double v) { return _mm256_set1_pd(v); }
+static inline simd_dvec simd_dload(const double *p) { return _mm256_loadu_pd(p); }
+static inline simd_dvec simd_dloadf(const float *p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+static inline void simd_dstore(double *p, simd_dvec v) { _mm256_storeu_pd(p, v); }
+static inline simd_dvec simd_dadd(simd_dvec a, simd_dvec b) { return _mm256_add_pd(a, b); }
+static inline simd_dvec simd_dsub(simd_dvec a, simd_dvec b) { return _mm256_sub_pd(a, b); }
+static inline simd_dvec simd_dmul(simd_dvec a, simd_dvec b) { return _mm256_mul_pd(a, b); }
+static inline simd_dvec simd_dsqrt(simd_dvec a) { return _mm256_sqrt_pd(a); }
+static inline simd_dvec simd_dmin(simd_dvec a, simd_dvec b) { return _mm256_min_pd(a, b); }
+static inline unsigned simd_dless(simd_dvec a, simd_dvec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+#else
+#define SIMD_DWIDTH 1
+typedef double simd_dvec;
+static inline simd_dvec simd_dset1(double v) { return v; }
+static inline simd_dvec simd_dload(const double *p) { return *p; }
+static inline simd_dvec simd_dloadf(const float *p) { return *p; }
+static inline void simd_dstore(double *p, simd_dvec v) { *p = v; }
+static inline simd_dvec simd_dadd(simd_dvec a, simd_dvec b) { return a + b; }
+static inline simd_dvec simd_dsub(simd_dvec a, simd_dvec b) { return a - b; }
+static inline simd_dvec simd_dmul(simd_dvec a, simd_dvec b) { return a * b; }
+static inline simd_dvec simd_dsqrt(simd_dvec a) { return std::sqrt(a); }
+static inline simd_dvec simd_dmin(simd_dvec a, simd_dvec b) { return std::min(a, b); }
+static inline unsigned simd_dless(simd_dvec a, simd_dvec b) { return a < b; }
+#endif
+
+//simd_dot: sum of a[i] * b[i]
+static inline double simd_dot(const float *a, const float *b, size_t n) {
+	double total = 0.0;
+	for (size_t b0 = 0; b0 < n; b0 += SIMD_BLOCK) {
+		const size_t e = b0 + SIMD_BLOCK < n ? b0 + SIMD_BLOCK : n;
+		size_t i = b0;
+		float s = 0.0f;
+#if defined(__AVX512F__)
+		__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+		for (; i + 32 <= e; i += 32) {
+			acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+			acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+		}
+		s = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(__AVX2__) && defined(__FMA__)
+		__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+		for (; i + 16 <= e; i += 16) {
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+		}
+		s = simd_hsum(_mm256_add_ps(acc0, acc1));
+#endif
+		for (; i < e; i++) s += a[i] * b[i];
+		total += s;
+	}
+	return total;
+}
+
+//simd_axpy: y[i] += alpha * x[i]
+static inline void simd_axpy(float alpha, const float *x, float *y, size_t n) {
+	size_t i = 0;
+#if defined(__AVX512F__)
+	const __m512 va = _mm512_set1_ps(alpha);
+	for (; i + 16 <= n; i += 16) _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+#elif defined(__AVX2__) && defined(__FMA__)
+	const __m256 va = _mm256_set1_ps(alpha);
+	for (; i + 8 <= n; i += 8) _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+#endif
+	for (; i < n; i++) y[i] += alpha * x[i];
+}
+
+//simd_add_to_double: sum[i] += x[i], accumulated in double (column sums)
+static inline void simd_add_to_double(const float *x, double *sum, size_t n) {
+	size_t i = 0;
+#if defined(__AVX512F__)
+	for (; i + 8 <= n; i += 8) _mm512_storeu_pd(sum + i, _mm512_add_pd(_mm512_loadu_pd(sum + i), _mm512_cvtps_pd(_mm256_loadu_ps(x + i))));
+#elif defined(__AVX2__) && defined(__FMA__)
+	for (; i + 4 <= n; i += 4) _mm256_storeu_pd(sum + i, _mm256_add_pd(_mm256_loadu_pd(sum + i), _mm256_cvtps_pd(_mm_loadu_ps(x + i))));
+#endif
+	for (; i < n; i++) sum[i] += x[i];
+}
+
+//simd_add_sqdev_to_double: acc[i] += (x[i] - mean[i])^2, in double (column variances)
+static inline void simd_add_sqdev_to_double(const float *x, const double *mean, double *acc, size_t n) {
+	size_t i = 0;
+#if defined(__AVX512F__)
+	for (; i + 8 <= n; i += 8) {
+		__m512d d = _mm512_sub_pd(_mm512_cvtps_pd(_mm256_loadu_ps(x + i)), _mm512_loadu_pd(mean + i));
+		_mm512_storeu_pd(acc + i, _mm512_fmadd_pd(d, d, _mm512_loadu_pd(acc + i)));
+	}
+#elif defined(__AVX2__) && defined(__FMA__)
+	for (; i + 4 <= n; i += 4) {
+		__m256d d = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(x + i)), _mm256_loadu_pd(mean + i));
+		_mm256_storeu_pd(acc + i, _mm256_fmadd_pd(d, d, _mm256_loadu_pd(acc + i)));
+	}
+#endif
+	for (; i < n; i++) {
+		double d = x[i] - mean[i];
+		acc[i] += d * d;
+	}
+}
+
+//simd_add_sqdiff_to_double: acc[i] += (q - x[i])^2 in double, without fused multiply-add, so that summing the
+//dimensions one call at a time rounds exactly as the scalar squared distance (kdtree.h)
+static inline void simd_add_sqdiff_to_double(double q, const double *x, double *acc, size_t n) {
+	size_t i = 0;
+#if defined(__AVX512F__)
+	const __m512d vq = _mm512_set1_pd(q);
+	for (; i + 8 <= n; i += 8) {
+		__m512d d = _mm512_sub_pd(vq, _mm512_loadu_pd(x + i));
+		_mm512_storeu_pd(acc + i, _mm512_add_pd(_mm512_loadu_pd(acc + i), _mm512_mul_pd(d, d)));
+	}
+#elif defined(__AVX2__) && defined(__FMA__)
+	const __m256d vq = _mm256_set1_pd(q);
+	for (; i + 4 <= n; i += 4) {
+		__m256d d = _mm256_sub_pd(vq, _mm256_loadu_pd(x + i));
+		_mm256_storeu_pd(acc + i, _mm256_add_pd(_mm256_loadu_pd(acc + i), _mm256_mul_pd(d, d)));
+	}
+#endif
+	for (; i < n; i++) {
+		const double d = q - x[i];
+		acc[i] += d * d;
+	}
+}
+
+//simd_sqrt_double: x[i] = sqrt(x[i]) in place
+static inline void simd_sqrt_double(double *x, size_t n) {
+	size_t i = 0;
+#if defined(__AVX512F__)
+	for (; i + 8 <= n; i += 8) _mm512_storeu_pd(x + i, _mm512_sqrt_pd(_mm512_loadu_pd(x + i)));
+#elif defined(__AVX2__) && defined(__FMA__)
+	for (; i + 4 <= n; i += 4) _mm256_storeu_pd(x + i, _mm256_sqrt_pd(_mm256_loadu_pd(x + i)));
+#endif
+	for (; i < n; i++) x[i] = std::sqrt(x[i]);
+}
+
+//simd_sub: out[i] = x[i] - y[i]
+static inline void simd_sub(const float *x, const float *y, float *out, size_t n) {
+	size_t i = 0;
+#if defined(__AVX512F__)
+	for (; i + 16 <= n; i += 16) _mm512_storeu_ps(out + i, _mm512_sub_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+#elif defined(__AVX2__) && defined(__FMA__)
+	for (; i + 8 <= n; i += 8) _mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+#endif
+	for (; i < n; i++) out[i] = x[i] - y[i];
+}
+
+//simd_standardize: out[i] = (x[i] - mean[i]) * invScale[i]
+static inline void simd_standardize(const float *x, const float *mean, const float *invScale, float *out, size_t n) {
+	size_t i = 0;
+#if defined(__AVX512F__)
+	for (; i + 16 <= n; i += 16) {
+		_mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(mean + i)), _mm512_loadu_ps(invScale + i)));
+	}
+#elif defined(__AVX2__) && defined(__FMA__)
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(mean + i)), _mm256_loadu_ps(invScale + i)));
+	}
+#endif
+	for (; i < n; i++) out[i] = (x[i] - mean[i]) * invScale[i];
+}
+
+//simd_dot_tile: out[r][c] += a[r] . b[c] for R rows of a (lda apart) and C rows of b (ldb apart) of n elements, out rows
+//ldOut apart. The R x C accumulators stay in registers: R + C loads for R * C multiply-adds. Sums are in float, so n
+//should be a cache block, not a whole trace.
+template <int R, int C>
+static inline void simd_dot_tile(const float *a, size_t lda, const float *b, size_t ldb, size_t n, double *out, size_t ldOut) {
+	simd_vec acc[R][C];
+#pragma GCC unroll 16
+	for (int r = 0; r < R; r++) {
+#pragma GCC unroll 16
+		for (int c = 0; c < C; c++) acc[r][c] = simd_zero();
+	}
+	size_t i = 0;
+	for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH) {
+		simd_vec va[R], vb[C];
+#pragma GCC unroll 16
+		for (int r = 0; r < R; r++) va[r] = simd_load(a + r * lda + i);
+#pragma GCC unroll 16
+		for (int c = 0; c < C; c++) vb[c] = simd_load(b + c * ldb + i);
+#pragma GCC unroll 16
+		for (int r = 0; r < R; r++) {
+#pragma GCC unroll 16
+			for (int c = 0; c < C; c++) acc[r][c] = simd_fmadd(va[r], vb[c], acc[r][c]);
+		}
+	}
+	for (int r = 0; r < R; r++) {
+		for (int c = 0; c < C; c++) {
+			float s = simd_hsum(acc[r][c]);
+			for (size_t j = i; j < n; j++) s += a[r * lda + j] * b[c * ldb + j];
+			out[r * ldOut + c] += s;
+		}
+	}
+}
+
+//simd_combine_tile: out[c][j] += sum over i < n of coef[i][c] * (x[i][j] - mean[j]) for C rows of out (ldOut apart) and
+//j < w, with x rows ldx apart and coef rows ldCoef apart. V vectors of each of the C rows of out are accumulated in
+//registers over all the rows of x (V + C loads for V * C multiply-adds), so x should be a cache block of columns.
+template <int C, int V>
+static inline void simd_combine_tile(const float *x, size_t ldx, size_t n, const float *mean, const float *coef, size_t ldCoef, size_t w, float *out, size_t ldOut) {
+	size_t j = 0;
+	for (; j + V * SIMD_WIDTH <= w; j += V * SIMD_WIDTH) {
+		simd_vec acc[C][V], m[V];
+#pragma GCC unroll 16
+		for (int v = 0; v < V; v++) {
+			m[v] = simd_load(mean + j + v * SIMD_WIDTH);
+#pragma GCC unroll 16
+			for (int c = 0; c < C; c++) acc[c][v] = simd_load(out + c * ldOut + j + v * SIMD_WIDTH);
+		}
+		for (size_t i = 0; i < n; i++) {
+			simd_vec xv[V];
+#pragma GCC unroll 16
+			for (int v = 0; v < V; v++) xv[v] = simd_subv(simd_load(x + i * ldx + j + v * SIMD_WIDTH), m[v]);
+#pragma GCC unroll 16
+			for (int c = 0; c < C; c++) {
+				const simd_vec k = simd_set1(coef[i * ldCoef + c]);
+#pragma GCC unroll 16
+				for (int v = 0; v < V; v++) acc[c][v] = simd_fmadd(k, xv[v], acc[c][v]);
+			}
+		}
+#pragma GCC unroll 16
+		for (int c = 0; c < C; c++) {
+#pragma GCC unroll 16
+			for (int v = 0; v < V; v++) simd_store(out + c * ldOut + j + v * SIMD_WIDTH, acc[c][v]);
+		}
+	}
+	for (; j < w; j++) {
+		for (size_t i = 0; i < n; i++) {
+			const float v = x[i * ldx + j] - mean[j];
+			for (int c = 0; c < C; c++) out[c * ldOut + j] += coef[i * ldCoef + c] * v;
+		}
+	}
+}
+
+#endif
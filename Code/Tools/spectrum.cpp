@@ -0,0 +1,361 @@
+//Magnitude spectra of the traces (see spectrum.h)
+
+#include "spectrum.h"
+#include "parallel.h"
+#include "simd.h"
+#include "trace_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+//Complex register: the same complex value of SIMD_DWIDTH traces
+struct cvec {
+	simd_dvec re, im;
+};
+
+static inline cvec cload(const double *re, const double *im, size_t i) {
+	return { simd_dload(re + i * SIMD_DWIDTH), simd_dload(im + i * SIMD_DWIDTH) };
+}
+static inline void cstore(double *re, double *im, size_t i, cvec a) {
+	simd_dstore(re + i * SIMD_DWIDTH, a.re);
+	simd_dstore(im + i * SIMD_DWIDTH, a.im);
+}
+static inline cvec cadd(cvec a, cvec b) { return { simd_dadd(a.re, b.re), simd_dadd(a.im, b.im) }; }
+static inline cvec csub(cvec a, cvec b) { return { simd_dsub(a.re, b.re), simd_dsub(a.im, b.im) }; }
+//cmul: a * (wr + i wi)
+static inline cvec cmul(cvec a, double wr, double wi) {
+	const simd_dvec r = simd_dset1(wr), i = simd_dset1(wi);
+	return { simd_dsub(simd_dmul(a.re, r), simd_dmul(a.im, i)), simd_dadd(simd_dmul(a.re, i), simd_dmul(a.im, r)) };
+}
+//cmul_negi: a * (-i s)
+static inline cvec cmul_negi(cvec a, double s) {
+	const simd_dvec v = simd_dset1(s);
+	return { simd_dmul(a.im, v), simd_dsub(simd_dset1(0.0), simd_dmul(a.re, v)) };
+}
+static inline cvec cscale(cvec a, double s) {
+	const simd_dvec v = simd_dset1(s);
+	return { simd_dmul(a.re, v), simd_dmul(a.im, v) };
+}
+
+//butterfly: DFT of R points in place (forward, e^(-2 pi i / R))
+template <size_t R>
+static inline void butterfly(cvec *a);
+
+template <>
+inline void butterfly<2>(cvec *a) {
+	const cvec t = a[1];
+	a[1] = csub(a[0], t);
+	a[0] = cadd(a[0], t);
+}
+
+template <>
+inline void butterfly<3>(cvec *a) {
+	const double s = 0.86602540378443864676; //sin(2 pi / 3)
+	const cvec t1 = cadd(a[1], a[2]), t2 = csub(a[0], cscale(t1, 0.5)), t3 = cmul_negi(csub(a[1], a[2]), s);
+	a[0] = cadd(a[0], t1);
+	a[1] = cadd(t2, t3);
+	a[2] = csub(t2, t3);
+}
+
+template <>
+inline void butterfly<4>(cvec *a) {
+	const cvec t0 = cadd(a[0], a[2]), t1 = csub(a[0], a[2]), t2 = cadd(a[1], a[3]), t3 = cmul_negi(csub(a[1], a[3]), 1.0);
+	a[0] = cadd(t0, t2);
+	a[1] = cadd(t1, t3);
+	a[2] = csub(t0, t2);
+	a[3] = csub(t1, t3);
+}
+
+template <>
+inline void butterfly<5>(cvec *a) {
+	const double c1 = 0.30901699437494742410, c2 = -0.80901699437494742410; //cos(2 pi / 5), cos(4 pi / 5)
+	const double s1 = 0.95105651629515357212, s2 = 0.58778525229247312917; //sin(2 pi / 5), sin(4 pi / 5)
+	const cvec b1 = cadd(a[1], a[4]), b2 = cadd(a[2], a[3]), d1 = csub(a[1], a[4]), d2 = csub(a[2], a[3]);
+	const cvec t1 = cadd(a[0], cadd(cscale(b1, c1), cscale(b2, c2)));
+	const cvec t2 = cadd(a[0], cadd(cscale(b1, c2), cscale(b2, c1)));
+	const cvec u1 = cadd(cmul_negi(d1, s1), cmul_negi(d2, s2));
+	const cvec u2 = csub(cmul_negi(d1, s2), cmul_negi(d2, s1));
+	a[0] = cadd(a[0], cadd(b1, b2));
+	a[1] = cadd(t1, u1);
+	a[4] = csub(t1, u1);
+	a[2] = cadd(t2, u2);
+	a[3] = csub(t2, u2);
+}
+
+rfft_plan::rfft_plan(size_t n) : n(n) {
+	if (n == 0) throw std::invalid_argument("rfft: empty transform");
+	m = n % 2 == 0 ? n / 2 : n;
+
+	//Radices: 4 first, then 2, 3, 5 and the other prime factors
+	std::vector<size_t> radices;
+	size_t rest = m;
+	while (rest % 4 == 0) {
+		radices.push_back(4);
+		rest /= 4;
+	}
+	for (size_t p = 2; rest > 1; p++) {
+		if (p * p > rest) p = rest;
+		while (rest % p == 0) {
+			radices.push_back(p);
+			rest /= p;
+		}
+	}
+	size_t span = 1;
+	for (size_t r : radices) {
+		fft_stage s = { r, span, twRe.size(), rootRe.size() };
+		//Twiddles e^(-2 pi i q k / (span r)) for k < span, 1 <= q < r
+		for (size_t k = 0; k < span; k++) {
+			for (size_t q = 1; q < r; q++) {
+				const double a = -2.0 * M_PI * (double) (q * k) / (double) (span * r);
+				twRe.push_back(std::cos(a));
+				twIm.push_back(std::sin(a));
+			}
+		}
+		if (r != 2 && r != 3 && r != 4 && r != 5) {
+			for (size_t j = 0; j < r; j++) {
+				const double a = -2.0 * M_PI * (double) j / (double) r;
+				rootRe.push_back(std::cos(a));
+				rootIm.push_back(std::sin(a));
+			}
+		}
+		stages.push_back(s);
+		span *= r;
+	}
+	if (n % 2 == 0) {
+		for (size_t k = 0; k <= m; k++) {
+			const double a = -2.0 * M_PI * (double) k / (double) n;
+			splitRe.push_back(std::cos(a));
+			splitIm.push_back(std::sin(a));
+		}
+	}
+}
+
+size_t rfft_plan::lanes() {
+	return SIMD_DWIDTH;
+}
+
+size_t rfft_plan::workspace() const {
+	return (4 * m + 3 * bins()) * SIMD_DWIDTH;
+}
+
+//pass: one Stockham stage: the R points j + q (m / R) of the input, twiddled, go to (j - k) R + k + q span of the output
+template <size_t R>
+void rfft_plan::pass(const fft_stage &stage, const double *inRe, const double *inIm, double *outRe, double *outIm) const {
+	const size_t L = stage.span, stride = m / R;
+	const double *tr = twRe.data() + stage.twiddles, *ti = twIm.data() + stage.twiddles;
+	for (size_t j = 0; j < stride; j++) {
+		const size_t k = j % L, dst = (j - k) * R + k;
+		cvec a[R];
+		a[0] = cload(inRe, inIm, j);
+		for (size_t q = 1; q < R; q++) {
+			a[q] = cload(inRe, inIm, j + q * stride);
+			if (k) a[q] = cmul(a[q], tr[k * (R - 1) + q - 1], ti[k * (R - 1) + q - 1]);
+		}
+		butterfly<R>(a);
+		for (size_t q = 0; q < R; q++) cstore(outRe, outIm, dst + q * L, a[q]);
+	}
+}
+
+void rfft_plan::pass_generic(const fft_stage &stage, const double *inRe, const double *inIm, double *outRe, double *outIm) const {
+	const size_t R = stage.radix, L = stage.span, stride = m / R;
+	const double *tr = twRe.data() + stage.twiddles, *ti = twIm.data() + stage.twiddles;
+	const double *wr = rootRe.data() + stage.roots, *wi = rootIm.data() + stage.roots;
+	std::vector<cvec> a(R);
+	for (size_t j = 0; j < stride; j++) {
+		const size_t k = j % L, dst = (j - k) * R + k;
+		a[0] = cload(inRe, inIm, j);
+		for (size_t q = 1; q < R; q++) {
+			a[q] = cload(inRe, inIm, j + q * stride);
+			if (k) a[q] = cmul(a[q], tr[k * (R - 1) + q - 1], ti[k * (R - 1) + q - 1]);
+		}
+		for (size_t q = 0; q < R; q++) {
+			cvec y = a[0];
+			for (size_t r = 1; r < R; r++) {
+				const size_t e = r * q % R;
+				y = cadd(y, cmul(a[r], wr[e], wi[e]));
+			}
+			cstore(outRe, outIm, dst + q * L, y);
+		}
+	}
+}
+
+//transform: complex FFT of the m points of (re, im), the other two buffers being scratch; re and im point to the result
+void rfft_plan::transform(double *&re, double *&im, double *re2, double *im2) const {
+	for (const fft_stage &s : stages) {
+		switch (s.radix) {
+			case 2: pass<2>(s, re, im, re2, im2); break;
+			case 3: pass<3>(s, re, im, re2, im2); break;
+			case 4: pass<4>(s, re, im, re2, im2); break;
+			case 5: pass<5>(s, re, im, re2, im2); break;
+			default: pass_generic(s, re, im, re2, im2); break;
+		}
+		std::swap(re, re2);
+		std::swap(im, im2);
+	}
+}
+
+void rfft_plan::forward(const float *const *rows, size_t count, size_t samples, const double *window, bool detrend, double *outRe, double *outIm,
+	double *work) const {
+	if (count > SIMD_DWIDTH) throw std::invalid_argument("rfft: too many traces for one transform");
+	if (samples > n) throw std::invalid_argument("rfft: more samples than the transform");
+	const size_t W = SIMD_DWIDTH;
+	double *re = work, *im = work + m * W;
+	std::fill(work, work + 2 * m * W, 0.0);
+	const bool even = n % 2 == 0;
+	for (size_t l = 0; l < count; l++) {
+		const float *x = rows[l];
+		double mean = 0.0;
+		if (detrend && samples) {
+			for (size_t t = 0; t < samples; t++) mean += x[t];
+			mean /= samples;
+		}
+		//Sample t goes to the real part of point t / 2 (even n) or t
+		for (size_t t = 0; t < samples; t++) {
+			const double v = window ? (x[t] - mean) * window[t] : x[t] - mean;
+			if (!even) re[t * W + l] = v;
+			else if (t % 2 == 0) re[t / 2 * W + l] = v;
+			else im[t / 2 * W + l] = v;
+		}
+	}
+	transform(re, im, work + 2 * m * W, work + 3 * m * W);
+
+	//Bins of the real transform: X[k] = E[k] + e^(-2 pi i k / n) O[k], with E and O the transforms of the even and odd
+	//samples, E[k] = (Z[k] + conj(Z[m - k])) / 2 and O[k] = -i (Z[k] - conj(Z[m - k])) / 2
+	const size_t nb = bins();
+	for (size_t k = 0; k < nb; k++) {
+		cvec x;
+		if (even) {
+			const cvec z = cload(re, im, k % m), c = cload(re, im, (m - k) % m);
+			const cvec e = cscale({ simd_dadd(z.re, c.re), simd_dsub(z.im, c.im) }, 0.5);
+			const cvec o = cscale({ simd_dadd(z.im, c.im), simd_dsub(c.re, z.re) }, 0.5);
+			x = cadd(e, cmul(o, splitRe[k], splitIm[k]));
+		} else {
+			x = cload(re, im, k);
+		}
+		cstore(outRe, outIm, k, x);
+	}
+}
+
+void rfft_plan::inverse(const double *inRe, const double *inIm, double *out, double *work) const {
+	const size_t W = SIMD_DWIDTH, nb = bins();
+	double *re = work, *im = work + m * W;
+	const simd_dvec zero = simd_dset1(0.0);
+	//The inverse transform is the conjugate of the forward transform of the conjugate
+	if (n % 2 == 0) {
+		//Z[k] = E[k] + i O[k], E[k] = (X[k] + conj(X[m - k])) / 2, O[k] = e^(2 pi i k / n) (X[k] - conj(X[m - k])) / 2
+		for (size_t k = 0; k < m; k++) {
+			const cvec a = cload(inRe, inIm, k), c = cload(inRe, inIm, m - k);
+			const cvec b = { c.re, simd_dsub(zero, c.im) };
+			const cvec e = cscale(cadd(a, b), 0.5), o = cmul(cscale(csub(a, b), 0.5), splitRe[k], -splitIm[k]);
+			cstore(re, im, k, { simd_dsub(e.re, o.im), simd_dsub(simd_dsub(zero, e.im), o.re) });
+		}
+	} else {
+		for (size_t k = 0; k < nb; k++) {
+			const cvec x = cload(inRe, inIm, k);
+			cstore(re, im, k, { x.re, simd_dsub(zero, x.im) });
+			if (k) cstore(re, im, n - k, x);
+		}
+	}
+	transform(re, im, work + 2 * m * W, work + 3 * m * W);
+	const simd_dvec scale = simd_dset1(1.0 / m);
+	for (size_t t = 0; t < m; t++) {
+		if (n % 2 == 0) {
+			simd_dstore(out + 2 * t * W, simd_dmul(simd_dload(re + t * W), scale));
+			simd_dstore(out + (2 * t + 1) * W, simd_dsub(zero, simd_dmul(simd_dload(im + t * W), scale)));
+		} else {
+			simd_dstore(out + t * W, simd_dmul(simd_dload(re + t * W), scale));
+		}
+	}
+}
+
+void rfft_plan::power(const float *const *rows, size_t count, const double *window, bool detrend, double *out, double *work) const {
+	const size_t W = SIMD_DWIDTH, nb = bins();
+	double *re = work + 4 * m * W, *im = re + nb * W;
+	forward(rows, count, n, window, detrend, re, im, work);
+	for (size_t k = 0; k < nb; k++) {
+		const simd_dvec r = simd_dload(re + k * W), i = simd_dload(im + k * W);
+		simd_dstore(out + k * W, simd_dadd(simd_dmul(r, r), simd_dmul(i, i)));
+	}
+}
+
+void rfft_plan::magnitudes(const float *const *rows, size_t count, float *const *out, double *work) const {
+	const size_t W = SIMD_DWIDTH, nb = bins();
+	double *power = work + (4 * m + 2 * nb) * W;
+	this->power(rows, count, nullptr, false, power, work);
+	for (size_t k = 0; k < nb; k++) simd_dstore(power + k * W, simd_dsqrt(simd_dload(power + k * W)));
+	for (size_t l = 0; l < count; l++) {
+		for (size_t k = 0; k < nb; k++) out[l][k] = (float) power[k * W + l];
+	}
+}
+
+size_t rfft_length(size_t n) {
+	for (size_t len = std::max<size_t>(n + n % 2, 2);; len += 2) {
+		size_t r = len / 2;
+		for (size_t p : { 2, 3, 5 }) {
+			while (r % p == 0) r /= p;
+		}
+		if (r == 1) return len;
+	}
+}
+
+void magnitude_spectra(const float *x, size_t count, size_t n, size_t ld, float *out, size_t ldOut) {
+	const rfft_plan plan(n);
+	const size_t W = rfft_plan::lanes(), batches = (count + W - 1) / W;
+	parallel_for(batches, 1, [&](size_t b, size_t e) {
+		std::vector<double> work(plan.workspace());
+		const float *rows[SIMD_DWIDTH];
+		float *outs[SIMD_DWIDTH];
+		for (size_t t = b; t < e; t++) {
+			const size_t c = std::min(W, count - t * W);
+			for (size_t l = 0; l < c; l++) {
+				rows[l] = x + (t * W + l) * ld;
+				outs[l] = out + (t * W + l) * ldOut;
+			}
+			plan.magnitudes(rows, c, outs, work.data());
+		}
+	});
+}
+
+void trace_file_add_spectra(const std::string &path, size_t samples) {
+	const trace_file file(path);
+	if (samples == 0) samples = file.length();
+	if (samples > file.length()) throw std::invalid_argument(path + ": the traces have fewer samples than the spectra");
+	const rfft_plan plan(samples);
+	const size_t count = file.count(), W = rfft_plan::lanes();
+
+	trace_spectra_header sh = trace_spectra_header();
+	sh.samples = samples;
+	sh.bins = plan.bins();
+	sh.rowStride = (sh.bins * sizeof(float) + TRACE_FILE_ALIGN - 1) / TRACE_FILE_ALIGN * TRACE_FILE_ALIGN;
+	sh.binWidth = file.header().sampleRate / samples;
+	trace_file_appender out(path);
+	const uint64_t offset = out.reserve(TRACE_SECTION_SPECTRA, TRACE_FILE_ALIGN + count * sh.rowStride);
+	uint8_t first[TRACE_FILE_ALIGN] = {};
+	memcpy(first, &sh, sizeof(sh));
+	out.write(offset, first, sizeof(first));
+
+	const size_t ld = sh.rowStride / sizeof(float);
+	std::vector<float> block(TRACE_FILE_BLOCK * ld);
+	file.for_each_block([&](size_t b0, size_t nt) {
+		std::fill(block.begin(), block.end(), 0.0f);
+		parallel_for((nt + W - 1) / W, 1, [&](size_t b, size_t e) {
+			std::vector<double> work(plan.workspace());
+			std::vector<float> physical(W * file.length());
+			const float *rows[SIMD_DWIDTH];
+			float *outs[SIMD_DWIDTH];
+			for (size_t t = b; t < e; t++) {
+				const size_t c = std::min(W, nt - t * W);
+				for (size_t l = 0; l < c; l++) {
+					file.read_trace(b0 + t * W + l, physical.data() + l * file.length());
+					rows[l] = physical.data() + l * file.length();
+					outs[l] = block.data() + (t * W + l) * ld;
+				}
+				plan.magnitudes(rows, c, outs, work.data());
+			}
+		});
+		out.write(offset + TRACE_FILE_ALIGN + b0 * sh.rowStride, block.data(), nt * sh.rowStride);
+	});
+	out.commit();
+}
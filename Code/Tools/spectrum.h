@@ -0,0 +1,78 @@
+//Magnitude spectra of the traces, for the frequency-domain analysis of main.py (numpy.abs(scipy.fft.rfft(x)))
+//
+//rfft_plan is the real FFT of one length n, planned once. For even n, the even and odd samples are the real and
+//imaginary parts of a complex sequence of n / 2 points, whose FFT is split into the n / 2 + 1 bins of the real
+//transform; odd lengths are transformed as complex sequences. The complex FFT is a mixed-radix Stockham FFT (radices 4,
+//2, 3 and 5, and a direct DFT for other prime factors, slow for large ones) that leaves the bins in natural order
+//without a bit-reversal pass; the twiddles of every stage are tabulated by the plan. It runs in double on several traces
+//at once (SIMD_DWIDTH, simd.h): every value is a register holding the same sample of several traces, so all the
+//butterflies are vertical SIMD operations whatever the radix.
+//
+//The inverse transform (used by the cross-correlations of align.h) is the same FFT on conjugated values.
+//
+//magnitude_spectra spreads the batches of traces over the threads. trace_file_add_spectra stores the spectra of all the
+//traces of a container in it (TRACE_SECTION_SPECTRA, trace_file.h), so that they are computed once.
+
+#ifndef __SPECTRUM_H
+#define __SPECTRUM_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+class rfft_plan {
+public:
+	explicit rfft_plan(size_t n);
+
+	size_t size() const { return n; }
+	size_t bins() const { return n / 2 + 1; }
+	static size_t lanes(); //Traces transformed at once
+	size_t workspace() const; //Doubles of the work buffer of the transforms
+
+	//forward: X[k] of count <= lanes() traces into re[k * lanes() + i] and im (bins() x lanes() doubles each). rows[i]
+	//holds samples <= size() values, zero-padded to size(); they are centered on their mean first if detrend is set,
+	//then multiplied by window (samples values) if it is not null.
+	void forward(const float *const *rows, size_t count, size_t samples, const double *window, bool detrend, double *re, double *im,
+		double *work) const;
+	//inverse: the size() real values whose transform is (re, im) (bins() x lanes()), into out[t * lanes() + i]
+	void inverse(const double *re, const double *im, double *out, double *work) const;
+	//power: |X[k]|^2 of count <= lanes() traces into out[k * lanes() + i] (bins() x lanes() doubles). rows[i] holds
+	//size() samples; they are centered on their mean first if detrend is set, then multiplied by window (size() values)
+	//if it is not null.
+	void power(const float *const *rows, size_t count, const double *window, bool detrend, double *out, double *work) const;
+	//magnitudes: |X[k]| of count <= lanes() traces: rows[i] holds size() samples, out[i] receives bins() magnitudes
+	void magnitudes(const float *const *rows, size_t count, float *const *out, double *work) const;
+
+private:
+	struct fft_stage {
+		size_t radix;
+		size_t span; //Product of the radices of the previous stages
+		size_t twiddles; //Offset of the span x (radix - 1) twiddles in twRe and twIm
+		size_t roots; //Offset of the radix roots of unity in rootRe and rootIm (generic radix)
+	};
+
+	void transform(double *&re, double *&im, double *re2, double *im2) const;
+	template <size_t R>
+	void pass(const fft_stage &stage, const double *inRe, const double *inIm, double *outRe, double *outIm) const;
+	void pass_generic(const fft_stage &stage, const double *inRe, const double *inIm, double *outRe, double *outIm) const;
+
+	size_t n;
+	size_t m; //Points of the complex FFT: n / 2 for even n, n for odd n
+	std::vector<fft_stage> stages;
+	std::vector<double> twRe, twIm;
+	std::vector<double> rootRe, rootIm;
+	std::vector<double> splitRe, splitIm; //e^(-2 pi i k / n) for k <= m (even n)
+};
+
+//rfft_length: smallest even length of at least n samples whose half has no prime factor above 5 (a fast plan)
+size_t rfft_length(size_t n);
+
+//magnitude_spectra: spectra of the first n samples of count traces (rows ld floats apart) into out (rows ldOut apart)
+void magnitude_spectra(const float *x, size_t count, size_t n, size_t ld, float *out, size_t ldOut);
+
+//trace_file_add_spectra: adds to the container at path the spectra of the first samples samples (0 for all) of all its
+//traces, in physical units, replacing the spectra it may have
+void trace_file_add_spectra(const std::string &path, size_t samples = 0);
+
+#endif
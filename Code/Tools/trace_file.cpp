@@ -0,0 +1,401 @@
+//Binary trace container: memory-mapped reader and writer (see trace_file.h)
+
+#include "trace_file.h"
+#include "parallel.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+static uint64_t align_up(uint64_t v, uint64_t a) {
+	return (v + a - 1) / a * a;
+}
+
+static void pwrite_all(int fd, const std::string &path, const void *data, size_t size, uint64_t offset) {
+	const uint8_t *p = (const uint8_t *) data;
+	while (size > 0) {
+		ssize_t w = pwrite(fd, p, size, (off_t) offset);
+		if (w <= 0) throw std::runtime_error("write error on " + path);
+		p += w;
+		size -= w;
+		offset += w;
+	}
+}
+
+/////////////
+//  READER //
+/////////////
+
+trace_file::trace_file(const std::string &path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("cannot open " + path);
+	struct stat st;
+	fstat(fd, &st);
+	mapSize = (size_t) st.st_size;
+	if (mapSize < TRACE_FILE_HEADER_SIZE) {
+		close(fd);
+		throw std::runtime_error(path + ": not a trace container");
+	}
+	void *p = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) throw std::runtime_error("cannot map " + path);
+	base = (const uint8_t *) p;
+	hdr = (const trace_file_header *) base;
+
+	std::string error;
+	size_t dataSize = 0;
+	const void *data = section(TRACE_SECTION_DATA, &dataSize);
+	size_t recSize = 0;
+	recs = (const trace_record *) section(TRACE_SECTION_RECORDS, &recSize);
+	if (memcmp(hdr->magic, TRACE_FILE_MAGIC, 8) != 0) error = "not a trace container";
+	else if (hdr->version != TRACE_FILE_VERSION) error = "unsupported version " + std::to_string(hdr->version);
+	else if (hdr->headerSize != TRACE_FILE_HEADER_SIZE || hdr->sectionCount > TRACE_FILE_MAX_SECTIONS) error = "bad header";
+	else if (trace_dtype_size(hdr->dtype) == 0 || hdr->traceStride % TRACE_FILE_ALIGN != 0
+		|| hdr->traceStride < hdr->traceLength * trace_dtype_size(hdr->dtype)) error = "bad sample type or stride";
+	else if (!data || dataSize < hdr->traceCount * hdr->traceStride) error = "truncated data section";
+	else if (!recs || recSize != hdr->traceCount * sizeof(trace_record)) error = "missing trace records";
+	if (!error.empty()) {
+		munmap((void *) base, mapSize);
+		throw std::runtime_error(path + ": " + error);
+	}
+	dataOffset = (const uint8_t *) data - base;
+
+	size_t indexSize = 0;
+	ranges = (const trace_program_range *) section(TRACE_SECTION_PROGRAM_INDEX, &indexSize);
+	if (ranges) {
+		rangeCount = indexSize / sizeof(trace_program_range);
+	} else {
+		builtRanges = build_program_index(recs, hdr->traceCount);
+		ranges = builtRanges.data();
+		rangeCount = builtRanges.size();
+	}
+
+	size_t spectraSize = 0;
+	spectraHdr = (const trace_spectra_header *) section(TRACE_SECTION_SPECTRA, &spectraSize);
+	if (spectraHdr && (spectraHdr->rowStride % TRACE_FILE_ALIGN != 0 || spectraHdr->rowStride < spectraHdr->bins * sizeof(float)
+		|| spectraSize < TRACE_FILE_ALIGN + hdr->traceCount * spectraHdr->rowStride)) {
+		munmap((void *) base, mapSize);
+		throw std::runtime_error(path + ": truncated spectra section");
+	}
+
+	size_t featuresSize = 0;
+	featuresHdr = (const trace_features_header *) section(TRACE_SECTION_FEATURES, &featuresSize);
+	if (featuresHdr && (featuresSize < sizeof(trace_features_header) || featuresHdr->rowStride % TRACE_FILE_ALIGN != 0
+		|| featuresHdr->features != (uint64_t) featuresHdr->segments * featuresHdr->bands || featuresHdr->rowStride < featuresHdr->features * sizeof(float)
+		|| featuresHdr->rowsOffset % TRACE_FILE_ALIGN != 0 || featuresHdr->rowsOffset < sizeof(trace_features_header) + featuresHdr->bands * 2 * sizeof(double)
+		|| featuresSize < featuresHdr->rowsOffset + hdr->traceCount * featuresHdr->rowStride)) {
+		munmap((void *) base, mapSize);
+		throw std::runtime_error(path + ": truncated features section");
+	}
+
+	size_t shiftsSize = 0;
+	shiftsHdr = (const trace_shifts_header *) section(TRACE_SECTION_SHIFTS, &shiftsSize);
+	if (shiftsHdr && shiftsSize < sizeof(trace_shifts_header) + hdr->traceCount * sizeof(trace_shift)) {
+		munmap((void *) base, mapSize);
+		throw std::runtime_error(path + ": truncated shifts section");
+	}
+
+	size_t decimatedSize = 0;
+	decimatedHdr = (const trace_decimated_header *) section(TRACE_SECTION_DECIMATED, &decimatedSize);
+	if (decimatedHdr && (decimatedHdr->rowStride % TRACE_FILE_ALIGN != 0 || decimatedHdr->rowStride < decimatedHdr->samples * sizeof(float)
+		|| decimatedSize < TRACE_FILE_ALIGN + hdr->traceCount * decimatedHdr->rowStride)) {
+		munmap((void *) base, mapSize);
+		throw std::runtime_error(path + ": truncated decimated section");
+	}
+
+	size_t poiSize = 0;
+	poiHdr = (const trace_poi_header *) section(TRACE_SECTION_POI, &poiSize);
+	bool poiValid = !poiHdr || (poiSize >= sizeof(trace_poi_header) && poiSize - sizeof(trace_poi_header) >= (uint64_t) poiHdr->programs * sizeof(trace_poi_program));
+	if (poiHdr && poiValid) {
+		const size_t indices = (poiSize - sizeof(trace_poi_header) - poiHdr->programs * sizeof(trace_poi_program)) / sizeof(uint32_t);
+		for (uint32_t p = 0; p < poiHdr->programs && poiValid; p++) {
+			const trace_poi_program &program = poi_programs()[p];
+			poiValid = program.first <= indices && program.count <= indices - program.first;
+		}
+	}
+	if (!poiValid) {
+		munmap((void *) base, mapSize);
+		throw std::runtime_error(path + ": truncated points of interest section");
+	}
+}
+
+trace_file::~trace_file() {
+	if (base) munmap((void *) base, mapSize);
+}
+
+const void *trace_file::section(uint32_t id, size_t *size) const {
+	for (uint32_t i = 0; i < hdr->sectionCount && i < TRACE_FILE_MAX_SECTIONS; i++) {
+		const trace_section &s = hdr->sections[i];
+		if (s.id == id) {
+			if (s.offset > mapSize || s.size > mapSize - s.offset) return nullptr; //Truncated file
+			if (size) *size = s.size;
+			return base + s.offset;
+		}
+	}
+	return nullptr;
+}
+
+const trace_program_range *trace_file::program_index(size_t *n) const {
+	*n = rangeCount;
+	return ranges;
+}
+
+const trace_program_range *trace_file::program_ranges(int32_t label, size_t *n) const {
+	auto lo = std::lower_bound(ranges, ranges + rangeCount, label,
+		[](const trace_program_range &r, int32_t l) { return r.label < l; });
+	auto hi = std::upper_bound(lo, ranges + rangeCount, label,
+		[](int32_t l, const trace_program_range &r) { return l < r.label; });
+	*n = hi - lo;
+	return lo;
+}
+
+std::vector<size_t> trace_file::program_traces(int32_t label) const {
+	size_t n;
+	const trace_program_range *r = program_ranges(label, &n);
+	std::vector<size_t> out;
+	for (size_t i = 0; i < n; i++) {
+		for (uint64_t k = 0; k < r[i].count; k++) out.push_back(r[i].first + k);
+	}
+	return out;
+}
+
+std::vector<trace_program_range> build_program_index(const trace_record *records, size_t n) {
+	std::vector<trace_program_range> out;
+	for (size_t i = 0; i < n; ) {
+		size_t j = i + 1;
+		while (j < n && records[j].label == records[i].label) j++;
+		trace_program_range r = trace_program_range();
+		r.label = records[i].label;
+		r.cmd = records[i].cmd;
+		r.first = i;
+		r.count = j - i;
+		out.push_back(r);
+		i = j;
+	}
+	std::stable_sort(out.begin(), out.end(),
+		[](const trace_program_range &a, const trace_program_range &b) { return a.label < b.label; });
+	return out;
+}
+
+void trace_file::read_trace(size_t i, float *out) const {
+	const size_t n = hdr->traceLength;
+	const float scale = hdr->scale, offset = hdr->offset;
+	switch (hdr->dtype) {
+		case TRACE_INT8: {
+			const int8_t *s = trace_as<int8_t>(i);
+			for (size_t k = 0; k < n; k++) out[k] = s[k] * scale + offset;
+			break;
+		}
+		case TRACE_INT16: {
+			const int16_t *s = trace_as<int16_t>(i);
+			for (size_t k = 0; k < n; k++) out[k] = s[k] * scale + offset;
+			break;
+		}
+		default:
+			memcpy(out, trace(i), n * sizeof(float));
+			break;
+	}
+}
+
+void trace_file::prefetch(size_t first, size_t n) const {
+	if (n == 0 || first >= count()) return;
+	n = std::min(n, count() - first);
+	uint64_t start = dataOffset + first * hdr->traceStride;
+	uint64_t end = dataOffset + (first + n) * hdr->traceStride;
+	start -= start % TRACE_FILE_CHUNK_ALIGN;
+	madvise((void *) (base + start), end - start, MADV_WILLNEED);
+}
+
+void trace_file::read_traces(size_t first, size_t n, float *out) const {
+	const size_t length = hdr->traceLength;
+	parallel_for(n, 16, [&](size_t begin, size_t end) {
+		for (size_t r = begin; r < end; r++) read_trace(first + r, out + r * length);
+	});
+}
+
+void trace_file::read_traces(const size_t *rows, size_t n, float *out) const {
+	const size_t length = hdr->traceLength;
+	parallel_for(n, 16, [&](size_t begin, size_t end) {
+		for (size_t r = begin; r < end; r++) read_trace(rows[r], out + r * length);
+	});
+}
+
+/////////////
+//  WRITER //
+/////////////
+
+trace_file_writer::trace_file_writer(const std::string &path, const trace_file_header &layout) : path(path) {
+	const size_t itemSize = trace_dtype_size(layout.dtype);
+	if (itemSize == 0) throw std::runtime_error(path + ": unknown sample type");
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, TRACE_FILE_MAGIC, 8);
+	hdr.version = TRACE_FILE_VERSION;
+	hdr.headerSize = TRACE_FILE_HEADER_SIZE;
+	hdr.sampleRate = layout.sampleRate;
+	hdr.traceCount = layout.traceCount;
+	hdr.traceLength = layout.traceLength;
+	hdr.traceStride = (uint32_t) align_up(layout.traceLength * itemSize, TRACE_FILE_ALIGN);
+	hdr.dtype = layout.dtype;
+	hdr.scale = layout.dtype == TRACE_FLOAT32 ? 1.0f : layout.scale;
+	hdr.offset = layout.dtype == TRACE_FLOAT32 ? 0.0f : layout.offset;
+	memcpy(hdr.description, layout.description, sizeof(hdr.description) - 1);
+
+	//Chunks must stay page aligned without gaps, so chunkTraces * traceStride is rounded to a page multiple
+	uint32_t chunk = layout.chunkTraces ? layout.chunkTraces : TRACE_FILE_CHUNK_TRACES;
+	const uint32_t pageTraces = TRACE_FILE_CHUNK_ALIGN / TRACE_FILE_ALIGN; //Always enough, whatever the stride
+	hdr.chunkTraces = (uint32_t) align_up(chunk, pageTraces);
+
+	dataOffset = TRACE_FILE_HEADER_SIZE;
+	hdr.sections[0] = { TRACE_SECTION_DATA, 0, dataOffset, hdr.traceCount * hdr.traceStride };
+	hdr.sectionCount = 1;
+	records.assign(hdr.traceCount, trace_record{ -1, 0xFF, { 0, 0, 0 }, 0, 0 });
+
+	fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) throw std::runtime_error("cannot create " + path);
+	//Sized up front so that the traces can be written in any order; unwritten traces read as zeros
+	if (ftruncate(fd, (off_t) align_up(dataOffset + hdr.sections[0].size, TRACE_FILE_CHUNK_ALIGN)) != 0) {
+		close(fd);
+		throw std::runtime_error("cannot size " + path);
+	}
+}
+
+trace_file_writer::~trace_file_writer() {
+	if (fd >= 0) close(fd);
+	if (!finished) unlink(path.c_str()); //An unfinished file has no valid header
+}
+
+void trace_file_writer::write_traces(size_t first, size_t n, const void *samples) {
+	if (first + n > hdr.traceCount) throw std::runtime_error(path + ": trace index out of range");
+	const size_t rowBytes = hdr.traceLength * trace_dtype_size(hdr.dtype);
+	std::vector<uint8_t> buf(n * hdr.traceStride, 0);
+	for (size_t i = 0; i < n; i++) {
+		memcpy(&buf[i * hdr.traceStride], (const uint8_t *) samples + i * rowBytes, rowBytes);
+	}
+	pwrite_all(fd, path, buf.data(), buf.size(), dataOffset + first * hdr.traceStride);
+}
+
+//quantize: nearest integer sample of a physical value, saturated to the range of T
+template <typename T>
+static void quantize(const float *src, T *dst, size_t n, float scale, float offset, float lo, float hi) {
+	const float inv = 1.0f / scale;
+	for (size_t k = 0; k < n; k++) {
+		float v = nearbyintf((src[k] - offset) * inv);
+		dst[k] = (T) std::min(std::max(v, lo), hi);
+	}
+}
+
+void trace_file_writer::convert(const float *src, void *dst, size_t n) const {
+	switch (hdr.dtype) {
+		case TRACE_INT8: quantize(src, (int8_t *) dst, n, hdr.scale, hdr.offset, -128.0f, 127.0f); break;
+		case TRACE_INT16: quantize(src, (int16_t *) dst, n, hdr.scale, hdr.offset, -32768.0f, 32767.0f); break;
+		default: memcpy(dst, src, n * sizeof(float)); break;
+	}
+}
+
+void trace_file_writer::write_float_traces(size_t first, size_t n, const float *samples, size_t srcStride) {
+	if (first + n > hdr.traceCount) throw std::runtime_error(path + ": trace index out of range");
+	std::vector<uint8_t> buf(n * hdr.traceStride, 0);
+	for (size_t i = 0; i < n; i++) convert(samples + i * srcStride, &buf[i * hdr.traceStride], hdr.traceLength);
+	pwrite_all(fd, path, buf.data(), buf.size(), dataOffset + first * hdr.traceStride);
+}
+
+void trace_file_writer::write_float_samples(size_t trace, size_t firstSample, size_t n, const float *samples) {
+	if (trace >= hdr.traceCount || firstSample + n > hdr.traceLength) throw std::runtime_error(path + ": sample index out of range");
+	const size_t itemSize = trace_dtype_size(hdr.dtype);
+	std::vector<uint8_t> buf(n * itemSize);
+	convert(samples, buf.data(), n);
+	pwrite_all(fd, path, buf.data(), buf.size(), dataOffset + trace * hdr.traceStride + firstSample * itemSize);
+}
+
+void trace_file_writer::set_records(size_t first, size_t n, const trace_record *r) {
+	if (first + n > hdr.traceCount) throw std::runtime_error(path + ": trace index out of range");
+	std::copy(r, r + n, records.begin() + first);
+}
+
+void trace_file_writer::add_section(uint32_t id, const void *data, size_t size) {
+	if (hdr.sectionCount + 2 + extra.size() >= TRACE_FILE_MAX_SECTIONS) throw std::runtime_error(path + ": too many sections");
+	const uint8_t *p = (const uint8_t *) data;
+	extra.emplace_back(id, std::vector<uint8_t>(p, p + size));
+}
+
+void trace_file_writer::finish() {
+	uint64_t offset = align_up(dataOffset + hdr.sections[0].size, TRACE_FILE_CHUNK_ALIGN);
+	const size_t recBytes = records.size() * sizeof(trace_record);
+	pwrite_all(fd, path, records.data(), recBytes, offset);
+	hdr.sections[hdr.sectionCount++] = { TRACE_SECTION_RECORDS, 0, offset, recBytes };
+	offset = align_up(offset + recBytes, TRACE_FILE_ALIGN);
+
+	const std::vector<trace_program_range> index = build_program_index(records.data(), records.size());
+	const size_t indexBytes = index.size() * sizeof(trace_program_range);
+	pwrite_all(fd, path, index.data(), indexBytes, offset);
+	hdr.sections[hdr.sectionCount++] = { TRACE_SECTION_PROGRAM_INDEX, 0, offset, indexBytes };
+	offset = align_up(offset + indexBytes, TRACE_FILE_ALIGN);
+
+	for (const auto &s : extra) {
+		pwrite_all(fd, path, s.second.data(), s.second.size(), offset);
+		hdr.sections[hdr.sectionCount++] = { s.first, 0, offset, s.second.size() };
+		offset = align_up(offset + s.second.size(), TRACE_FILE_ALIGN);
+	}
+	if (ftruncate(fd, (off_t) offset) != 0) throw std::runtime_error("cannot size " + path);
+
+	//The header goes last: a file interrupted before this point is never taken for a valid container
+	std::vector<uint8_t> page(TRACE_FILE_HEADER_SIZE, 0);
+	memcpy(page.data(), &hdr, sizeof(hdr));
+	pwrite_all(fd, path, page.data(), page.size(), 0);
+	if (fsync(fd) != 0) throw std::runtime_error("cannot sync " + path);
+	close(fd);
+	fd = -1;
+	finished = true;
+}
+
+//////////////
+// APPENDER //
+//////////////
+
+trace_file_appender::trace_file_appender(const std::string &path) : path(path) {
+	fd = open(path.c_str(), O_RDWR);
+	if (fd < 0) throw std::runtime_error("cannot open " + path);
+	struct stat st;
+	fstat(fd, &st);
+	if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr) || memcmp(hdr.magic, TRACE_FILE_MAGIC, 8) != 0
+		|| hdr.version != TRACE_FILE_VERSION || hdr.sectionCount > TRACE_FILE_MAX_SECTIONS) {
+		close(fd);
+		fd = -1;
+		throw std::runtime_error(path + ": not a trace container");
+	}
+	end = align_up((uint64_t) st.st_size, TRACE_FILE_CHUNK_ALIGN);
+}
+
+trace_file_appender::~trace_file_appender() {
+	if (fd >= 0) close(fd);
+}
+
+uint64_t trace_file_appender::reserve(uint32_t id, uint64_t size) {
+	uint32_t i = 0;
+	while (i < hdr.sectionCount && hdr.sections[i].id != id) i++;
+	if (i == TRACE_FILE_MAX_SECTIONS) throw std::runtime_error(path + ": too many sections");
+	const uint64_t offset = end;
+	hdr.sections[i] = { id, 0, offset, size };
+	if (i == hdr.sectionCount) hdr.sectionCount++;
+	end = align_up(offset + size, TRACE_FILE_ALIGN);
+	if (ftruncate(fd, (off_t) end) != 0) throw std::runtime_error("cannot size " + path);
+	return offset;
+}
+
+void trace_file_appender::write(uint64_t offset, const void *data, size_t size) {
+	pwrite_all(fd, path, data, size, offset);
+}
+
+void trace_file_appender::commit() {
+	//The sections must be on disk before the header that points to them
+	if (fsync(fd) != 0) throw std::runtime_error("cannot sync " + path);
+	pwrite_all(fd, path, &hdr, sizeof(hdr), 0);
+	if (fsync(fd) != 0) throw std::runtime_error("cannot sync " + path);
+}
@@ -0,0 +1,368 @@
+//Binary trace container (.trc)
+//
+//Layout of a file:
+//  header      TRACE_FILE_HEADER_SIZE bytes: acquisition parameters and the section table
+//  data        traceCount traces of traceLength samples, traceStride bytes apart, in chunks of chunkTraces traces;
+//              every trace starts at a TRACE_FILE_ALIGN boundary and every chunk at a TRACE_FILE_CHUNK_ALIGN boundary,
+//              and the chunks are contiguous, so the whole data section is one strided array
+//  sections    per-trace records and any other section listed in the header, each at a TRACE_FILE_ALIGN boundary
+//
+//All values are little-endian. trace_file maps a file read-only and gives direct pointers into the mapping;
+//trace_file_writer creates a file for a known number of traces, which can be written from several threads;
+//trace_file_appender adds sections computed later (the spectra of spectrum.h, the band features of psd.h, the shifts of
+//align.h, the decimated traces of decimate.h, the points of interest of poi.h) to a finished file.
+
+#ifndef __TRACEFILE_H
+#define __TRACEFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#define TRACE_FILE_MAGIC "PINTRACE"
+#define TRACE_FILE_VERSION 1
+#define TRACE_FILE_HEADER_SIZE 4096
+#define TRACE_FILE_ALIGN 64 //Trace and section alignment: cache line and widest SIMD load
+#define TRACE_FILE_CHUNK_ALIGN 4096 //Chunk alignment: page size, unit of madvise/prefetch
+#define TRACE_FILE_CHUNK_TRACES 64 //Default chunk size; 64 traces of a 64-byte multiple are always page aligned
+#define TRACE_FILE_MAX_SECTIONS 16
+#define TRACE_FILE_BLOCK 256 //Traces of a block of for_each_block and read_blocks
+
+//Sample types
+#define TRACE_INT8 0
+#define TRACE_INT16 1
+#define TRACE_FLOAT32 2
+
+//Section identifiers
+#define TRACE_SECTION_DATA 1
+#define TRACE_SECTION_RECORDS 2 //trace_record for every trace
+#define TRACE_SECTION_PROGRAM_INDEX 3 //trace_program_range for every run of traces of the same program, by label
+#define TRACE_SECTION_SPECTRA 4 //trace_spectra_header and the magnitude spectrum of every trace
+#define TRACE_SECTION_FEATURES 5 //trace_features_header, its bands and the band features of every trace
+#define TRACE_SECTION_SHIFTS 6 //trace_shifts_header and the trace_shift of every trace
+#define TRACE_SECTION_DECIMATED 7 //trace_decimated_header and the decimated samples of every trace
+#define TRACE_SECTION_POI 8 //trace_poi_header, its trace_poi_program entries and their sample indices
+
+//trace_features_header flags
+#define TRACE_FEATURES_SPECTROGRAM 1 //Band powers of every segment, else of the Welch PSD
+#define TRACE_FEATURES_DECIBELS 2
+#define TRACE_FEATURES_DETRENDED 4 //Every segment centered on its mean
+
+struct trace_section {
+	uint32_t id;
+	uint32_t reserved;
+	uint64_t offset; //From the start of the file
+	uint64_t size; //In bytes
+};
+
+struct trace_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	double sampleRate; //Samples per second
+	uint64_t traceCount;
+	uint32_t traceLength; //Samples per trace
+	uint32_t traceStride; //Bytes from one trace to the next, multiple of TRACE_FILE_ALIGN
+	uint32_t chunkTraces; //Traces per chunk
+	uint8_t dtype; //TRACE_INT8, TRACE_INT16 or TRACE_FLOAT32
+	uint8_t reserved0[3];
+	float scale; //Physical value = sample * scale + offset (1 and 0 for TRACE_FLOAT32)
+	float offset;
+	uint32_t sectionCount;
+	uint32_t reserved1;
+	trace_section sections[TRACE_FILE_MAX_SECTIONS];
+	char description[128]; //Free text, zero terminated
+};
+
+//Per-trace record (TRACE_SECTION_RECORDS)
+struct trace_record {
+	int32_t label; //Program label, index in PROGRAMS (programs.h), -1 if unknown
+	uint8_t cmd; //Command byte of the program (commands.h), CMD_UNKNOWN if unknown
+	uint8_t reserved0[3];
+	uint32_t acquisition; //Index of the trace in its capture file
+	uint32_t source; //Index of the capture file in the ingestion
+};
+
+static_assert(sizeof(trace_record) == 16, "trace_record is part of the file format");
+
+//Run of consecutive traces with the same label (TRACE_SECTION_PROGRAM_INDEX), sorted by label and first trace
+struct trace_program_range {
+	int32_t label;
+	uint8_t cmd;
+	uint8_t reserved0[3];
+	uint64_t first;
+	uint64_t count;
+};
+
+static_assert(sizeof(trace_program_range) == 24, "trace_program_range is part of the file format");
+
+//Magnitude spectra (TRACE_SECTION_SPECTRA): this header, then traceCount rows of bins floats from TRACE_FILE_ALIGN bytes
+//after the start of the section, rowStride bytes apart
+struct trace_spectra_header {
+	uint32_t samples; //Samples of every trace transformed, from the first
+	uint32_t bins; //samples / 2 + 1
+	uint32_t rowStride; //Bytes, multiple of TRACE_FILE_ALIGN
+	uint32_t reserved;
+	double binWidth; //Hz, sampleRate / samples
+};
+
+static_assert(sizeof(trace_spectra_header) == 24, "trace_spectra_header is part of the file format");
+
+//Band features (TRACE_SECTION_FEATURES, psd.h): this header, then the bands as (low, high) pairs of doubles in Hz, then
+//traceCount rows of features floats from rowsOffset bytes after the start of the section, rowStride bytes apart
+struct trace_features_header {
+	uint32_t features; //segments x bands, segment-major
+	uint32_t segments; //1 for the band powers of the Welch PSD
+	uint32_t bands;
+	uint32_t rowStride; //Bytes, multiple of TRACE_FILE_ALIGN
+	uint32_t samples; //Samples of every trace analyzed, from the first
+	uint32_t segment; //Samples per segment
+	uint32_t overlap; //Samples shared by consecutive segments
+	uint32_t window; //PSD_BOXCAR, PSD_HANN, ... (psd.h)
+	uint32_t flags; //TRACE_FEATURES_SPECTROGRAM, TRACE_FEATURES_DECIBELS, TRACE_FEATURES_DETRENDED
+	uint32_t reserved;
+	uint64_t rowsOffset; //Multiple of TRACE_FILE_ALIGN
+	double sampleRate; //Hz, of the traces analyzed
+};
+
+static_assert(sizeof(trace_features_header) == 56, "trace_features_header is part of the file format");
+
+//Alignment (TRACE_SECTION_SHIFTS, align.h): this header, then a trace_shift for every trace
+struct trace_shifts_header {
+	uint32_t start; //Reference window, in samples
+	uint32_t length;
+	uint32_t maxShift;
+	uint32_t iterations;
+};
+
+static_assert(sizeof(trace_shifts_header) == 16, "trace_shifts_header is part of the file format");
+
+struct trace_shift {
+	float shift; //Samples: the trace at t + shift matches the reference of its program at t
+	float correlation; //With the reference, at that shift
+};
+
+static_assert(sizeof(trace_shift) == 8, "trace_shift is part of the file format");
+
+//Decimated traces (TRACE_SECTION_DECIMATED, decimate.h): this header, then traceCount rows of samples floats in
+//physical units from TRACE_FILE_ALIGN bytes after the start of the section, rowStride bytes apart
+struct trace_decimated_header {
+	uint32_t factor; //One sample kept in factor
+	uint32_t samples; //ceil(traceLength / factor)
+	uint32_t taps; //Of the anti-aliasing filter
+	uint32_t rowStride; //Bytes, multiple of TRACE_FILE_ALIGN
+	double sampleRate; //Hz, sampleRate / factor
+};
+
+static_assert(sizeof(trace_decimated_header) == 24, "trace_decimated_header is part of the file format");
+
+//Points of interest (TRACE_SECTION_POI, poi.h): this header, then a trace_poi_program for every program, then the
+//sample indices (uint32) of all the programs
+struct trace_poi_header {
+	uint32_t programs;
+	uint32_t statistic; //POI_SNR, POI_SOST, POI_TTEST (poi.h)
+	uint32_t points; //Requested per program
+	uint32_t window; //Samples per selected window, 1 for single samples
+	uint32_t samples; //traceLength when the points were computed
+	uint32_t reserved;
+};
+
+static_assert(sizeof(trace_poi_header) == 24, "trace_poi_header is part of the file format");
+
+struct trace_poi_program {
+	int32_t baseline; //Label of the traces the program was compared with
+	int32_t program; //Label
+	uint32_t first; //Of its indices, in increasing order
+	uint32_t count;
+};
+
+static_assert(sizeof(trace_poi_program) == 16, "trace_poi_program is part of the file format");
+
+//trace_dtype_size: bytes per sample, 0 for an unknown type
+static inline size_t trace_dtype_size(uint8_t dtype) {
+	return dtype == TRACE_INT8 ? 1 : dtype == TRACE_INT16 ? 2 : dtype == TRACE_FLOAT32 ? 4 : 0;
+}
+
+//Read-only memory-mapped container. Pointers returned are valid while the object exists.
+class trace_file {
+public:
+	explicit trace_file(const std::string &path); //Throws std::runtime_error if the file is not a valid container
+	~trace_file();
+	trace_file(const trace_file &) = delete;
+	trace_file &operator=(const trace_file &) = delete;
+
+	const trace_file_header &header() const { return *hdr; }
+	size_t count() const { return hdr->traceCount; }
+	size_t length() const { return hdr->traceLength; }
+	size_t stride() const { return hdr->traceStride; }
+	uint8_t dtype() const { return hdr->dtype; }
+
+	const void *data() const { return base + dataOffset; }
+	const void *trace(size_t i) const { return base + dataOffset + i * hdr->traceStride; }
+	template <typename T> const T *trace_as(size_t i) const { return (const T *) trace(i); }
+	const trace_record *records() const { return recs; }
+
+	//program_index: every range of the index, sorted by label
+	const trace_program_range *program_index(size_t *n) const;
+
+	//program_ranges: ranges of the traces of one label, n = 0 if there are none
+	const trace_program_range *program_ranges(int32_t label, size_t *n) const;
+
+	//program_traces: indices of the traces of one label, in file order
+	std::vector<size_t> program_traces(int32_t label) const;
+
+	//section: start of a section and its size, nullptr if the file does not have it
+	const void *section(uint32_t id, size_t *size = nullptr) const;
+
+	//spectra: header of the magnitude spectra, nullptr if the file has none; spectrum: the bins of trace i
+	const trace_spectra_header *spectra() const { return spectraHdr; }
+	const float *spectrum(size_t i) const { return (const float *) ((const uint8_t *) spectraHdr + TRACE_FILE_ALIGN + i * spectraHdr->rowStride); }
+	//features: header of the band features, nullptr if the file has none; feature_bands: their (low, high) bands;
+	//feature_row: the features of trace i
+	const trace_features_header *features() const { return featuresHdr; }
+	const double *feature_bands() const { return (const double *) (featuresHdr + 1); }
+	const float *feature_row(size_t i) const { return (const float *) ((const uint8_t *) featuresHdr + featuresHdr->rowsOffset + i * featuresHdr->rowStride); }
+	//shifts: header of the alignment, nullptr if the file has none; shift_rows: the shift of every trace
+	const trace_shifts_header *shifts() const { return shiftsHdr; }
+	const trace_shift *shift_rows() const { return (const trace_shift *) (shiftsHdr + 1); }
+	//decimated: header of the decimated traces, nullptr if the file has none; decimated_trace: the samples of trace i
+	const trace_decimated_header *decimated() const { return decimatedHdr; }
+	const float *decimated_trace(size_t i) const { return (const float *) ((const uint8_t *) decimatedHdr + TRACE_FILE_ALIGN + i * decimatedHdr->rowStride); }
+	//poi: header of the points of interest, nullptr if the file has none; poi_programs: their programs; poi_indices: the
+	//samples, from poi_programs()[p].first for poi_programs()[p].count
+	const trace_poi_header *poi() const { return poiHdr; }
+	const trace_poi_program *poi_programs() const { return (const trace_poi_program *) (poiHdr + 1); }
+	const uint32_t *poi_indices() const { return (const uint32_t *) (poi_programs() + poiHdr->programs); }
+
+	//read_trace: copies trace i converted to physical values (scale and offset applied) into out[length()]
+	void read_trace(size_t i, float *out) const;
+
+	//prefetch: asks the kernel to read ahead the chunks holding traces [first, first + n)
+	void prefetch(size_t first, size_t n) const;
+
+	//read_traces: read_trace of traces [first, first + n), or of rows[0, n), into out, length() floats apart, in parallel
+	void read_traces(size_t first, size_t n, float *out) const;
+	void read_traces(const size_t *rows, size_t n, float *out) const;
+
+	//for_each_block: fn(first, n) for the blocks [first, first + n) of TRACE_FILE_BLOCK traces (fewer for the last one),
+	//in order, each one prefetched before; the way the engines stream a container
+	template <typename F>
+	void for_each_block(F fn) const {
+		for (size_t first = 0; first < count(); first += TRACE_FILE_BLOCK) {
+			const size_t n = count() - first < TRACE_FILE_BLOCK ? count() - first : TRACE_FILE_BLOCK;
+			prefetch(first, n);
+			fn(first, n);
+		}
+	}
+
+	//read_blocks: for_each_block reading the traces i of every block with keep(i) (in physical units, in parallel):
+	//fn(block, rows, n) gets the n traces kept, length() floats apart, and their indices rows[0, n). Blocks without a trace
+	//kept are skipped.
+	template <typename K, typename F>
+	void read_blocks(K keep, F fn) const {
+		std::vector<float> block(TRACE_FILE_BLOCK * length());
+		std::vector<size_t> rows;
+		for (size_t first = 0; first < count(); first += TRACE_FILE_BLOCK) {
+			const size_t n = count() - first < TRACE_FILE_BLOCK ? count() - first : TRACE_FILE_BLOCK;
+			rows.clear();
+			for (size_t i = first; i < first + n; i++) {
+				if (keep(i)) rows.push_back(i);
+			}
+			if (rows.empty()) continue;
+			prefetch(first, n);
+			read_traces(rows.data(), rows.size(), block.data());
+			fn((const float *) block.data(), (const size_t *) rows.data(), rows.size());
+		}
+	}
+
+private:
+	const uint8_t *base = nullptr;
+	size_t mapSize = 0;
+	const trace_file_header *hdr = nullptr;
+	size_t dataOffset = 0;
+	const trace_record *recs = nullptr;
+	const trace_program_range *ranges = nullptr;
+	size_t rangeCount = 0;
+	const trace_spectra_header *spectraHdr = nullptr;
+	const trace_features_header *featuresHdr = nullptr;
+	const trace_shifts_header *shiftsHdr = nullptr;
+	const trace_decimated_header *decimatedHdr = nullptr;
+	const trace_poi_header *poiHdr = nullptr;
+	std::vector<trace_program_range> builtRanges; //Index built from the records when the file has no index section
+};
+
+//build_program_index: runs of equal labels of records[0, n), sorted by label
+std::vector<trace_program_range> build_program_index(const trace_record *records, size_t n);
+
+//Writer for a container with a known number of traces. write_* can be called from several threads for disjoint traces.
+class trace_file_writer {
+public:
+	//layout: sampleRate, traceCount, traceLength, dtype, scale, offset, description (chunkTraces optional);
+	//the other fields are computed. Throws std::runtime_error on I/O errors.
+	trace_file_writer(const std::string &path, const trace_file_header &layout);
+	~trace_file_writer();
+	trace_file_writer(const trace_file_writer &) = delete;
+	trace_file_writer &operator=(const trace_file_writer &) = delete;
+
+	const trace_file_header &header() const { return hdr; }
+
+	//write_traces: n traces already in the file sample type, packed (traceLength samples each)
+	void write_traces(size_t first, size_t n, const void *samples);
+
+	//write_float_traces: n traces of physical values, srcStride floats apart, converted to the file sample type
+	void write_float_traces(size_t first, size_t n, const float *samples, size_t srcStride);
+
+	//write_float_samples: samples [firstSample, firstSample + n) of one trace, for ingestion by blocks of samples
+	void write_float_samples(size_t trace, size_t firstSample, size_t n, const float *samples);
+
+	//set_records: records of traces [first, first + n)
+	void set_records(size_t first, size_t n, const trace_record *r);
+
+	//add_section: extra section written after the records by finish()
+	void add_section(uint32_t id, const void *data, size_t size);
+
+	//finish: writes the records, the program index, the extra sections and the header; the file is not valid before
+	void finish();
+
+private:
+	void convert(const float *src, void *dst, size_t n) const; //Physical values to the file sample type
+
+	int fd = -1;
+	std::string path;
+	trace_file_header hdr;
+	uint64_t dataOffset = 0;
+	std::vector<trace_record> records;
+	std::vector<std::pair<uint32_t, std::vector<uint8_t>>> extra;
+	bool finished = false;
+};
+
+//Adds sections to a finished container. reserve places a section after the end of the file, write fills it (from
+//several threads), and commit lists the reserved sections in the header, which is written last: a container whose
+//append is interrupted stays as it was. A reserved section replaces the section with the same id, whose bytes stay in
+//the file unreferenced.
+class trace_file_appender {
+public:
+	explicit trace_file_appender(const std::string &path); //Throws std::runtime_error if the file is not a valid container
+	~trace_file_appender();
+	trace_file_appender(const trace_file_appender &) = delete;
+	trace_file_appender &operator=(const trace_file_appender &) = delete;
+
+	const trace_file_header &header() const { return hdr; }
+
+	//reserve: offset in the file of a new section of size bytes
+	uint64_t reserve(uint32_t id, uint64_t size);
+	//write: size bytes at offset (within reserved sections)
+	void write(uint64_t offset, const void *data, size_t size);
+	//commit: writes the header with the reserved sections
+	void commit();
+
+private:
+	int fd = -1;
+	std::string path;
+	trace_file_header hdr;
+	uint64_t end; //End of the last reserved section
+};
+
+#endif
@@ -0,0 +1,629 @@
+//Merges the scope CSV files of a campaign into one labeled dataset (replaces the transpose and append steps of
+//csv_all_programs.py).
+//
+//Each scope CSV has one row per sample: the time in the first column and one column per trace. The last row holds the
+//program label of every column (appended by add_cluster_to_traces.py). The output has one line per trace: its samples
+//followed by its label, i.e. the transpose of every CSV without the time column, concatenated in file name order.
+//Values are copied as text, so the output is value-identical to the one of the Python script (LF line endings instead
+//of the CRLF of csv.writer, without blank lines).
+//
+//The files are processed in two passes over the memory-mapped input, both parallel across files:
+//  1. index: start of the first trace column and end of the kept columns of every row, and size of the output of the file
+//  2. transpose: blocks of TRANSPOSE_BLOCK traces are assembled row by row (cache-blocked transpose) and written with
+//     pwrite at the offset of the file in the output, so no temporary files are needed and the files can finish in any order
+//
+//With --labels name, the label is taken from the file name instead (a program name of programs.h or the numeric label),
+//so the files need no label row and add_cluster_to_traces.py is not needed; the files are then merged by label.
+//--label-map NAME=LABEL gives the label of the files whose name starts with NAME, e.g. SUT0208=E0208_2nd.
+//
+//When OUTPUT ends with .trc, a binary trace container (trace_file.h) is written instead: the values are parsed
+//(csv_scan.h) from a structural index of the separators built in one SIMD pass over each tile of rows, in blocks of
+//rows, so large exports are split across threads as well, and
+//every trace gets a record with its label, the command byte of its program (programs.h), its index in the capture file
+//and the index of the file; the container also gets the program index, to find the traces of a program without a scan.
+//With --spectra N, the magnitude spectra of the first N samples of the traces (spectrum.h) are then added to it; with
+//--decimate Q, the traces decimated by Q (decimate.h).
+//
+//Usage: trace_merge [--max-traces N] [--skip-rows N] [--threads N] [--labels row|name] [--label-map NAME=LABEL]
+//                   [container options] OUTPUT INPUT...
+//INPUT is a CSV file or a directory, whose *.csv files are taken in name order.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "csv_scan.h"
+#include "decimate.h"
+#include "programs.h"
+#include "spectrum.h"
+#include "trace_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+#define TRANSPOSE_BLOCK 32 //Traces assembled at a time: TRANSPOSE_BLOCK tokens of a row are contiguous in the input
+#define CONTAINER_LINE_CHUNK (64 << 20) //Bytes of a file scanned for lines by one thread
+#define CONTAINER_ROW_BLOCK 4096 //Rows (samples) of a file parsed by one thread
+#define CONTAINER_TILE 16 //Rows parsed before the transpose: 16 floats, one cache line per trace
+
+struct merge_options {
+	size_t maxTraces = 0; //0 = every column; csv_all_programs.py kept the first 200 EM traces
+	size_t skipRows = 0; //Header rows of the scope export
+	unsigned threads = 0; //0 = all cores
+	bool labelsFromName = false; //Label from the file name instead of the last row
+	std::vector<std::pair<std::string, int32_t>> labelMap; //--label-map NAME=LABEL: label of the files whose name starts with NAME
+	std::string output;
+	std::vector<std::string> inputs;
+
+	//Container output
+	uint8_t dtype = TRACE_FLOAT32;
+	float scale = 1.0f, offset = 0.0f; //Quantization of TRACE_INT8/TRACE_INT16: value = sample * scale + offset
+	double sampleRate = 1e9; //Scope sample rate, 1 GS/s
+	size_t samples = 0; //Samples kept per trace, 0 = all (every file must then have the same number)
+	std::string description;
+	bool spectra = false; //Add the magnitude spectra of the traces
+	size_t spectraSamples = 0; //Samples of the traces transformed, 0 = all
+	size_t decimation = 0; //Factor of the decimated traces to add, 0 = none
+};
+
+//Memory-mapped input file
+class mapped_file {
+public:
+	explicit mapped_file(const std::string &path) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("cannot open " + path);
+		struct stat st;
+		fstat(fd, &st);
+		len = (size_t) st.st_size;
+		if (len > 0) {
+			void *p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED) {
+				close(fd);
+				throw std::runtime_error("cannot map " + path);
+			}
+			base = (const char *) p;
+		}
+		close(fd);
+	}
+	~mapped_file() {
+		if (base) munmap((void *) base, len);
+	}
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	const char *data() const { return base; }
+	size_t size() const { return len; }
+
+private:
+	const char *base = nullptr;
+	size_t len = 0;
+};
+
+//Result of the index pass for one input file
+struct file_index {
+	std::string path;
+	std::vector<const char *> rowStart; //First trace column of every kept row (after the time column)
+	std::vector<const char *> rowEnd; //End of the last kept column of every row (CSV output) or of the row (container output)
+	size_t traces = 0;
+	size_t outSize = 0; //Bytes this file adds to the output
+	size_t outOffset = 0;
+	size_t firstTrace = 0; //Index of the first trace of the file in the container
+	int32_t label = -1; //Label of every trace with --labels name, -1 when the last row holds the labels
+	size_t samples() const { return rowStart.size() - (label < 0 ? 1 : 0); }
+};
+
+//label_value: label of a --label-map value, the numeric label or a program name of programs.h; -1 if neither
+static int32_t label_value(const std::string &value) {
+	int32_t label;
+	auto r = std::from_chars(value.data(), value.data() + value.size(), label);
+	if (r.ec == std::errc() && r.ptr == value.data() + value.size()) return label;
+	return program_label(value.c_str());
+}
+
+//label_from_name: label of a capture file from its name: the label of the longest --label-map name the name starts
+//with, the numeric label ("12.csv"), or the longest program name of programs.h the name starts with, not followed by a
+//digit ("E0208_1st_power.csv" is E0208_1st); -1 if none matches. Error codes captured twice (E0208, E0209) given
+//without _1st or _2nd are read as the first capture and reported in note.
+static int32_t label_from_name(const std::string &path, const std::vector<std::pair<std::string, int32_t>> &labelMap, std::string &note) {
+	const std::string stem = fs::path(path).stem().string();
+	int32_t best = -1;
+	size_t bestLen = 0;
+	for (const auto &m : labelMap) {
+		if (m.first.size() > bestLen && stem.compare(0, m.first.size(), m.first) == 0) {
+			best = m.second;
+			bestLen = m.first.size();
+		}
+	}
+	if (best >= 0) return best;
+
+	int32_t label;
+	auto r = std::from_chars(stem.data(), stem.data() + stem.size(), label);
+	if (r.ec == std::errc() && r.ptr == stem.data() + stem.size()) return label;
+
+	for (int i = 0; i < PROGRAM_COUNT; i++) {
+		const size_t len = strlen(PROGRAMS[i].name);
+		if (len > bestLen && stem.compare(0, len, PROGRAMS[i].name) == 0 && !(stem.size() > len && isdigit((unsigned char) stem[len]))) {
+			best = i;
+			bestLen = len;
+		}
+	}
+	if (best >= 0) return best;
+
+	//Error code alone: E<code>, or SUT<code> in the Raspberry Pi EM exports ("SUT0104_Chain + StatCorrect.csv" is E0104)
+	const size_t prefix = stem.compare(0, 3, "SUT") == 0 ? 3 : stem.compare(0, 1, "E") == 0 ? 1 : 0;
+	if (prefix == 0 || stem.size() < prefix + 4 || (stem.size() > prefix + 4 && isdigit((unsigned char) stem[prefix + 4]))
+		|| !std::all_of(stem.begin() + prefix, stem.begin() + prefix + 4, [](char ch) { return isdigit((unsigned char) ch) != 0; })) {
+		return -1;
+	}
+	const std::string code = "E" + stem.substr(prefix, 4);
+	best = program_label(code.c_str());
+	if (best < 0) {
+		best = program_label((code + "_1st").c_str());
+		if (best >= 0) note = code + " read as " + code + "_1st (--label-map " + stem.substr(0, prefix + 4) + "=" + code + "_2nd for the second capture)";
+	}
+	return best;
+}
+
+//index_file: finds the kept part of every row and checks that all rows have the same number of columns
+static void index_file(const mapped_file &map, size_t skipRows, size_t maxTraces, file_index &idx) {
+	const char *p = map.data();
+	const char *end = p + map.size();
+	size_t row = 0, columns = 0, tokenBytes = 0;
+
+	while (p < end) {
+		const char *eol = (const char *) memchr(p, '\n', end - p);
+		if (!eol) eol = end;
+		const char *next = eol < end ? eol + 1 : end;
+		while (eol > p && (eol[-1] == '\r' || eol[-1] == ' ')) eol--;
+		if (eol == p || row++ < skipRows) { //Blank lines (Windows csv writer) and header rows
+			p = next;
+			continue;
+		}
+
+		//Skip the time column, then count the trace columns up to maxTraces
+		const char *c = (const char *) memchr(p, ',', eol - p);
+		if (!c) throw std::runtime_error(idx.path + ": row " + std::to_string(row) + " has no trace columns");
+		const char *start = c + 1;
+		size_t n = 1;
+		c = start;
+		while ((c = (const char *) memchr(c, ',', eol - c)) != NULL) {
+			if (maxTraces && n == maxTraces) break;
+			c++;
+			n++;
+		}
+		const char *stop = c ? c : eol;
+
+		if (columns == 0) columns = n;
+		else if (n != columns) {
+			throw std::runtime_error(idx.path + ": row " + std::to_string(row) + " has " + std::to_string(n)
+				+ " trace columns, expected " + std::to_string(columns));
+		}
+		idx.rowStart.push_back(start);
+		idx.rowEnd.push_back(stop);
+		tokenBytes += (stop - start) - (n - 1); //Column separators are not copied
+		p = next;
+	}
+
+	idx.traces = columns;
+	//Every trace line: its tokens, a comma between them and a newline, and the label from the file name
+	idx.outSize = tokenBytes + columns * idx.rowStart.size();
+	if (idx.label >= 0) idx.outSize += columns * (1 + std::to_string(idx.label).size());
+}
+
+//transpose_file: writes the traces of one file at its offset in the output
+static void transpose_file(const file_index &idx, int outFd) {
+	const size_t rows = idx.rowStart.size();
+	std::vector<const char *> cursor(idx.rowStart);
+	std::vector<std::string> lines(TRANSPOSE_BLOCK);
+	std::string block;
+	size_t offset = idx.outOffset;
+	const std::string suffix = idx.label >= 0 ? "," + std::to_string(idx.label) + "\n" : "\n";
+
+	for (size_t t0 = 0; t0 < idx.traces; t0 += TRANSPOSE_BLOCK) {
+		const size_t n = std::min((size_t) TRANSPOSE_BLOCK, idx.traces - t0);
+		for (size_t b = 0; b < n; b++) lines[b].clear();
+
+		for (size_t r = 0; r < rows; r++) {
+			const char *c = cursor[r];
+			const char *eol = idx.rowEnd[r];
+			const bool last = r + 1 == rows;
+			for (size_t b = 0; b < n; b++) {
+				const char *e = (const char *) memchr(c, ',', eol - c);
+				if (!e) e = eol;
+				lines[b].append(c, e - c);
+				if (last) lines[b] += suffix;
+				else lines[b].push_back(',');
+				c = e < eol ? e + 1 : eol;
+			}
+			cursor[r] = c;
+		}
+
+		block.clear();
+		for (size_t b = 0; b < n; b++) block += lines[b];
+		for (size_t done = 0; done < block.size(); ) {
+			ssize_t w = pwrite(outFd, block.data() + done, block.size() - done, offset + done);
+			if (w <= 0) throw std::runtime_error("write error on the output file");
+			done += w;
+		}
+		offset += block.size();
+	}
+}
+
+//parse_label: label row value, either the numeric label or a program name of programs.h
+static int32_t parse_label(const char *b, const char *e) {
+	while (b < e && *b == ' ') b++;
+	while (e > b && e[-1] == ' ') e--;
+	int32_t label;
+	auto r = std::from_chars(b, e, label);
+	if (r.ec == std::errc() && r.ptr == e) return label;
+	return program_label(std::string(b, e).c_str());
+}
+
+//index_lines: start and end of the kept rows of a file for the container output; rowStart skips the time column.
+//The lines of [begin, end) chunks of the file have been found in parallel, in order.
+static void index_lines(file_index &idx, size_t skipRows, std::vector<std::vector<const char *>> &starts, std::vector<std::vector<const char *>> &ends) {
+	size_t row = 0;
+	for (size_t c = 0; c < starts.size(); c++) {
+		for (size_t i = 0; i < starts[c].size(); i++) {
+			if (row++ < skipRows) continue;
+			const char *comma = (const char *) memchr(starts[c][i], ',', ends[c][i] - starts[c][i]);
+			if (!comma) throw std::runtime_error(idx.path + ": row " + std::to_string(row) + " has no trace columns");
+			idx.rowStart.push_back(comma + 1);
+			idx.rowEnd.push_back(ends[c][i]);
+		}
+	}
+}
+
+//bad_row: error for data row r of a file, whose values are [b, e): its first value that is not a number, or its
+//number of values
+static std::runtime_error bad_row(const file_index &idx, size_t r) {
+	const char *b = idx.rowStart[r], *e = idx.rowEnd[r];
+	size_t values = 0;
+	for (const char *v = b; v <= e; values++) {
+		const char *c = (const char *) memchr(v, ',', e - v);
+		if (!c) c = e;
+		float x;
+		if (values < idx.traces && !csv_parse_float(v, c, x)) {
+			return std::runtime_error(idx.path + ": bad value '" + std::string(v, c) + "' in data row " + std::to_string(r + 1));
+		}
+		v = c + 1;
+	}
+	return std::runtime_error(idx.path + ": data row " + std::to_string(r + 1) + " has " + std::to_string(values)
+		+ " trace columns, expected " + std::to_string(idx.traces));
+}
+
+//parse_block: parses rows [r0, r1) of one file and writes them as samples [r0, r1) of its traces. Rows are parsed
+//CONTAINER_TILE at a time into a row-major tile, which is transposed into per-trace runs of samples (cache-blocked
+//transpose), and each run is written to its trace. The rows of a tile are contiguous in the file: they are scanned in
+//one pass into a structural index of their separators (csv_index), and the values of a row are parsed between its
+//consecutive entries, once the entries of the row are checked to be as many as its columns.
+static void parse_block(const file_index &idx, size_t r0, size_t r1, bool exactColumns, trace_file_writer &out) {
+	const size_t traces = idx.traces, rows = r1 - r0;
+	std::vector<float> tile(CONTAINER_TILE * traces);
+	std::vector<float> runs(traces * rows);
+	size_t maxBytes = 0;
+	for (size_t t0 = r0; t0 < r1; t0 += CONTAINER_TILE) {
+		maxBytes = std::max(maxBytes, (size_t) (idx.rowEnd[std::min(r1, t0 + CONTAINER_TILE) - 1] - idx.rowStart[t0]));
+	}
+	std::unique_ptr<uint32_t[]> seps(new uint32_t[maxBytes + CSV_INDEX_SLACK]); //Only the used entries are touched
+
+	for (size_t t0 = r0; t0 < r1; t0 += CONTAINER_TILE) {
+		const size_t n = std::min((size_t) CONTAINER_TILE, r1 - t0);
+		const char *base = idx.rowStart[t0];
+		const size_t count = csv_index(base, idx.rowEnd[t0 + n - 1], seps.get());
+
+		size_t j = 0; //First separator of the row
+		for (size_t k = 0; k < n; k++) {
+			const size_t r = t0 + k;
+			const uint32_t rowStart = (uint32_t) (idx.rowStart[r] - base), rowEnd = (uint32_t) (idx.rowEnd[r] - base);
+			while (j < count && seps[j] < rowStart) j++; //'\n' of the previous row, blank lines and the time column
+			//The row has traces - 1 commas, or more without exactColumns
+			const size_t last = j + traces - 1;
+			if (traces > 1 && (last - 1 >= count || seps[last - 1] >= rowEnd)) throw bad_row(idx, r);
+			if (exactColumns && last < count && seps[last] < rowEnd) throw bad_row(idx, r);
+
+			float *values = &tile[k * traces];
+			const char *start = idx.rowStart[r];
+			for (size_t i = 0; i + 1 < traces; i++) {
+				const char *sep = base + seps[j + i];
+				if (!csv_parse_float(start, sep, values[i])) throw bad_row(idx, r);
+				start = sep + 1;
+			}
+			const char *end = last < count && seps[last] < rowEnd ? base + seps[last] : idx.rowEnd[r];
+			if (!csv_parse_float(start, end, values[traces - 1])) throw bad_row(idx, r);
+			j = last;
+		}
+
+		for (size_t t = 0; t < traces; t++) {
+			float *run = &runs[t * rows + (t0 - r0)];
+			for (size_t i = 0; i < n; i++) run[i] = tile[i * traces + t];
+		}
+	}
+
+	for (size_t t = 0; t < traces; t++) out.write_float_samples(idx.firstTrace + t, r0, rows, &runs[t * rows]);
+}
+
+//run_parallel: calls fn(i) for i in [0, count) on the given number of threads
+template <typename F>
+static void run_parallel(size_t count, unsigned threads, F fn) {
+	std::atomic<size_t> next(0);
+	std::vector<std::string> errors(threads);
+	std::vector<std::thread> pool;
+	for (unsigned t = 0; t < threads; t++) {
+		pool.emplace_back([&, t]() {
+			size_t i;
+			while ((i = next++) < count) {
+				try {
+					fn(i);
+				} catch (const std::exception &e) {
+					errors[t] = e.what();
+					next = count;
+				}
+			}
+		});
+	}
+	for (auto &th : pool) th.join();
+	for (auto &e : errors) {
+		if (!e.empty()) throw std::runtime_error(e);
+	}
+}
+
+static bool is_container(const std::string &path) {
+	return path.size() > 4 && path.compare(path.size() - 4, 4, ".trc") == 0;
+}
+
+static merge_options parse_options(int argc, char **argv) {
+	merge_options o;
+	std::vector<std::string> positional;
+	for (int i = 1; i < argc; i++) {
+		std::string a = argv[i];
+		auto value = [&]() -> const char * {
+			if (i + 1 >= argc) throw std::runtime_error("missing value for " + a);
+			return argv[++i];
+		};
+		if (a == "--max-traces") o.maxTraces = strtoul(value(), NULL, 0);
+		else if (a == "--skip-rows") o.skipRows = strtoul(value(), NULL, 0);
+		else if (a == "--threads") o.threads = (unsigned) strtoul(value(), NULL, 0);
+		else if (a == "--labels") {
+			std::string l = value();
+			if (l != "row" && l != "name") throw std::runtime_error("--labels must be row or name");
+			o.labelsFromName = l == "name";
+		}
+		else if (a == "--label-map") {
+			const std::string m = value();
+			const size_t eq = m.find('=');
+			const int32_t label = eq == std::string::npos ? -1 : label_value(m.substr(eq + 1));
+			if (eq == 0 || label < 0) throw std::runtime_error("--label-map takes NAME=LABEL, LABEL a number or a program name: " + m);
+			o.labelMap.push_back({ m.substr(0, eq), label });
+		}
+		else if (a == "--dtype") {
+			std::string t = value();
+			if (t == "int8") o.dtype = TRACE_INT8;
+			else if (t == "int16") o.dtype = TRACE_INT16;
+			else if (t == "float32") o.dtype = TRACE_FLOAT32;
+			else throw std::runtime_error("unknown sample type " + t);
+		}
+		else if (a == "--scale") o.scale = strtof(value(), NULL);
+		else if (a == "--offset") o.offset = strtof(value(), NULL);
+		else if (a == "--sample-rate") o.sampleRate = atof(value());
+		else if (a == "--samples") o.samples = strtoul(value(), NULL, 0);
+		else if (a == "--description") o.description = value();
+		else if (a == "--spectra") {
+			o.spectra = true;
+			o.spectraSamples = strtoul(value(), NULL, 0);
+		}
+		else if (a == "--decimate") o.decimation = strtoul(value(), NULL, 0);
+		else if (a.size() > 1 && a[0] == '-') throw std::runtime_error("unknown option " + a);
+		else positional.push_back(a);
+	}
+	if (positional.size() < 2) throw std::runtime_error("expected OUTPUT and at least one INPUT");
+	o.output = positional[0];
+
+	//Directories are expanded to their CSV files in name order (os.listdir order is not defined)
+	for (size_t i = 1; i < positional.size(); i++) {
+		if (fs::is_directory(positional[i])) {
+			std::vector<std::string> files;
+			for (const auto &e : fs::directory_iterator(positional[i])) {
+				if (e.is_regular_file() && e.path().extension() == ".csv") files.push_back(e.path().string());
+			}
+			std::sort(files.begin(), files.end());
+			o.inputs.insert(o.inputs.end(), files.begin(), files.end());
+		} else {
+			o.inputs.push_back(positional[i]);
+		}
+	}
+	if (o.threads == 0) o.threads = std::max(1u, std::thread::hardware_concurrency());
+	if (o.dtype != TRACE_FLOAT32 && !(o.scale > 0.0f)) throw std::runtime_error("--scale must be positive");
+	if (o.spectra && !is_container(o.output)) throw std::runtime_error("--spectra needs a .trc output");
+	if (o.decimation && !is_container(o.output)) throw std::runtime_error("--decimate needs a .trc output");
+	return o;
+}
+
+//merge_to_csv: one text line per trace, every file written at its offset in the output
+static void merge_to_csv(const merge_options &opt, std::vector<file_index> &index, std::vector<std::unique_ptr<mapped_file>> &maps, unsigned threads) {
+	size_t total = 0;
+	for (auto &idx : index) {
+		idx.outOffset = total;
+		total += idx.outSize;
+	}
+
+	int outFd = open(opt.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (outFd < 0) throw std::runtime_error("cannot create " + opt.output);
+	if (ftruncate(outFd, (off_t) total) != 0) {
+		close(outFd);
+		throw std::runtime_error("cannot size " + opt.output);
+	}
+	try {
+		run_parallel(index.size(), threads, [&](size_t i) {
+			transpose_file(index[i], outFd);
+			maps[i].reset();
+		});
+	} catch (...) {
+		close(outFd);
+		throw;
+	}
+	close(outFd);
+}
+
+//merge_to_container: traces of every file parsed and written at their position in the container. Both passes are split
+//into chunks of CONTAINER_LINE_CHUNK bytes and CONTAINER_ROW_BLOCK rows, so a single large export uses every thread.
+static void merge_to_container(const merge_options &opt, std::vector<file_index> &index, std::vector<std::unique_ptr<mapped_file>> &maps, unsigned threads) {
+	const size_t files = index.size();
+
+	//Line pass: every file cut into chunks that start at a line start
+	struct line_chunk { size_t file; const char *begin, *end; std::vector<const char *> starts, ends; };
+	std::vector<line_chunk> chunks;
+	for (size_t f = 0; f < files; f++) {
+		const char *p = maps[f]->data(), *end = p + maps[f]->size();
+		while (p < end) {
+			const char *q = end - p > CONTAINER_LINE_CHUNK ? p + CONTAINER_LINE_CHUNK : end;
+			if (q < end) {
+				const char *nl = (const char *) memchr(q, '\n', end - q);
+				q = nl ? nl + 1 : end;
+			}
+			chunks.push_back(line_chunk{ f, p, q, { }, { } });
+			p = q;
+		}
+	}
+	run_parallel(chunks.size(), threads, [&](size_t i) {
+		csv_find_lines(chunks[i].begin, chunks[i].end, chunks[i].starts, chunks[i].ends);
+	});
+	for (size_t f = 0, c = 0; f < files; f++) {
+		std::vector<std::vector<const char *>> starts, ends;
+		for (; c < chunks.size() && chunks[c].file == f; c++) {
+			starts.push_back(std::move(chunks[c].starts));
+			ends.push_back(std::move(chunks[c].ends));
+		}
+		index_lines(index[f], opt.skipRows, starts, ends);
+	}
+
+	//Layout: trace count from the first row, the label row (if any) is the last one
+	size_t total = 0, samples = opt.samples;
+	for (auto &idx : index) {
+		if (idx.label < 0 && idx.rowStart.size() < 2) throw std::runtime_error(idx.path + ": no data rows before the label row");
+		if (idx.rowStart.empty()) throw std::runtime_error(idx.path + ": no data rows");
+		const size_t columns = 1 + csv_count(idx.rowStart[0], idx.rowEnd[0], ',');
+		idx.traces = opt.maxTraces ? std::min(columns, opt.maxTraces) : columns;
+
+		const size_t fileSamples = idx.samples();
+		if (opt.samples == 0 && samples == 0) samples = fileSamples;
+		if (opt.samples == 0 ? fileSamples != samples : fileSamples < samples) {
+			throw std::runtime_error(idx.path + ": " + std::to_string(fileSamples) + " samples per trace, expected "
+				+ std::to_string(samples) + " (use --samples to shorten the traces)");
+		}
+		idx.firstTrace = total;
+		total += idx.traces;
+	}
+
+	trace_file_header layout;
+	memset(&layout, 0, sizeof(layout));
+	layout.sampleRate = opt.sampleRate;
+	layout.traceCount = total;
+	layout.traceLength = (uint32_t) samples;
+	layout.dtype = opt.dtype;
+	layout.scale = opt.scale;
+	layout.offset = opt.offset;
+	strncpy(layout.description, opt.description.c_str(), sizeof(layout.description) - 1);
+	trace_file_writer out(opt.output, layout);
+
+	//Records: label from the file name or from the label row
+	for (size_t f = 0; f < files; f++) {
+		const file_index &idx = index[f];
+		std::vector<trace_record> records(idx.traces);
+		const char *c = idx.rowStart.back(), *eol = idx.rowEnd.back();
+		for (size_t t = 0; t < idx.traces; t++) {
+			trace_record &rec = records[t];
+			rec.label = idx.label;
+			if (idx.label < 0) {
+				const char *e = (const char *) memchr(c, ',', eol - c);
+				if (!e) e = eol;
+				rec.label = parse_label(c, e);
+				c = e < eol ? e + 1 : eol;
+			}
+			rec.cmd = program_cmd(rec.label);
+			rec.acquisition = (uint32_t) t;
+			rec.source = (uint32_t) f;
+		}
+		out.set_records(idx.firstTrace, idx.traces, records.data());
+	}
+
+	//Sample pass: blocks of rows of every file
+	struct row_block { size_t file, r0, r1; };
+	std::vector<row_block> blocks;
+	for (size_t f = 0; f < files; f++) {
+		for (size_t r = 0; r < samples; r += CONTAINER_ROW_BLOCK) blocks.push_back(row_block{ f, r, std::min(samples, r + CONTAINER_ROW_BLOCK) });
+	}
+	run_parallel(blocks.size(), threads, [&](size_t i) {
+		parse_block(index[blocks[i].file], blocks[i].r0, blocks[i].r1, opt.maxTraces == 0, out);
+	});
+	out.finish();
+}
+
+int main(int argc, char **argv) {
+	merge_options opt;
+	try {
+		opt = parse_options(argc, argv);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "trace_merge: %s\n", e.what());
+		fprintf(stderr, "usage: trace_merge [--max-traces N] [--skip-rows N] [--threads N] [--labels row|name] [--label-map NAME=LABEL]\n"
+			"                   [--dtype int8|int16|float32] [--scale S] [--offset O] [--sample-rate HZ] [--samples N] [--description TEXT]\n"
+			"                   [--spectra N] [--decimate Q] OUTPUT INPUT...\n");
+		return 2;
+	}
+
+	try {
+		const size_t count = opt.inputs.size();
+		std::vector<std::unique_ptr<mapped_file>> maps(count);
+		std::vector<file_index> index(count);
+		const unsigned threads = (unsigned) std::min<size_t>(opt.threads, std::max<size_t>(count, 1));
+
+		for (size_t i = 0; i < count; i++) {
+			index[i].path = opt.inputs[i];
+			if (opt.labelsFromName) {
+				std::string note;
+				index[i].label = label_from_name(opt.inputs[i], opt.labelMap, note);
+				if (index[i].label < 0) throw std::runtime_error(opt.inputs[i] + ": the file name does not give a program (see --label-map)");
+				if (!note.empty()) fprintf(stderr, "trace_merge: %s: %s\n", opt.inputs[i].c_str(), note.c_str());
+			}
+		}
+		//Traces of the same program end up together, so the program index has one range per program
+		std::stable_sort(index.begin(), index.end(), [](const file_index &a, const file_index &b) { return a.label < b.label; });
+
+		for (size_t i = 0; i < count; i++) maps[i].reset(new mapped_file(index[i].path));
+
+		if (is_container(opt.output)) {
+			merge_to_container(opt, index, maps, opt.threads);
+			if (opt.spectra) trace_file_add_spectra(opt.output, opt.spectraSamples);
+			if (opt.decimation) trace_file_add_decimated(opt.output, opt.decimation);
+		} else {
+			run_parallel(count, threads, [&](size_t i) {
+				index_file(*maps[i], opt.skipRows, opt.maxTraces, index[i]);
+			});
+			merge_to_csv(opt, index, maps, threads);
+		}
+
+		for (const auto &idx : index) {
+			printf("%s: %zu traces of %zu samples", idx.path.c_str(), idx.traces, idx.samples());
+			if (idx.label >= 0) printf(", label %d (%s)", idx.label, idx.label < PROGRAM_COUNT ? PROGRAMS[idx.label].name : "?");
+			printf("\n");
+		}
+	} catch (const std::exception &e) {
+		fprintf(stderr, "trace_merge: %s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
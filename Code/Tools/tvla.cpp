@@ -0,0 +1,151 @@
+//Fixed-vs-random Welch t-test of any order in one pass (see tvla.h)
+
+#include "tvla.h"
+#include "parallel.h"
+#include "simd.h"
+#include "trace_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#define TVLA_MAX_MOMENT (2 * TVLA_MAX_ORDER)
+
+//binomial: C(p, k) for p <= TVLA_MAX_MOMENT
+static double binomial(size_t p, size_t k) {
+	double c = 1.0;
+	for (size_t i = 1; i <= k; i++) c = c * (double) (p - k + i) / (double) i;
+	return c;
+}
+
+tvla_accumulator::tvla_accumulator(size_t samples, size_t order) : d(samples), maxOrder(order) {
+	if (samples == 0) throw std::invalid_argument("tvla: no samples");
+	if (order < 1 || order > TVLA_MAX_ORDER) throw std::invalid_argument("tvla: the order must be between 1 and " + std::to_string(TVLA_MAX_ORDER));
+	//Rows padded to a register, so the last samples take the SIMD path on zero-padded traces
+	stride = (d + SIMD_DWIDTH - 1) / SIMD_DWIDTH * SIMD_DWIDTH;
+	sums.assign(2 * 2 * maxOrder * stride, 0.0);
+}
+
+void tvla_accumulator::add(const float *x, size_t count, size_t ld, const uint8_t *groups) {
+	const size_t P = 2 * maxOrder, W = SIMD_DWIDTH;
+	double C[TVLA_MAX_MOMENT + 1][TVLA_MAX_MOMENT + 1];
+	for (size_t p = 0; p <= P; p++) {
+		for (size_t k = 0; k <= p; k++) C[p][k] = binomial(p, k);
+	}
+	parallel_for((d + TVLA_BLOCK - 1) / TVLA_BLOCK, 1, [&](size_t begin, size_t end) {
+		uint64_t seen[2] = { n[0], n[1] };
+		const size_t j0 = begin * TVLA_BLOCK, j1 = std::min(d, end * TVLA_BLOCK);
+		simd_dvec pa[TVLA_MAX_MOMENT + 1], pb[TVLA_MAX_MOMENT + 1];
+		float tail[SIMD_DWIDTH];
+		for (size_t i = 0; i < count; i++) {
+			const uint8_t g = groups[i];
+			if (g > TVLA_RANDOM) continue;
+			const double old = (double) seen[g]++, inv = 1.0 / (old + 1.0);
+			const simd_dvec va = simd_dset1(-inv), vb = simd_dset1(old * inv), vn = simd_dset1(old);
+			const float *trace = x + i * ld;
+			double *rows = sums.data() + g * P * stride;
+			for (size_t j = j0; j < j1; j += W) {
+				const float *v = trace + j;
+				if (j + W > j1) {
+					std::fill(tail, tail + W, 0.0f);
+					std::copy(trace + j, trace + j1, tail);
+					v = tail;
+				}
+				const simd_dvec value = simd_dloadf(v), mean = simd_dload(rows + j), delta = simd_dsub(value, mean);
+				pa[1] = simd_dmul(delta, va);
+				pb[1] = simd_dmul(delta, vb);
+				for (size_t k = 2; k <= P; k++) {
+					pa[k] = simd_dmul(pa[k - 1], pa[1]);
+					pb[k] = simd_dmul(pb[k - 1], pb[1]);
+				}
+				//From the highest moment down, so that the lower ones still hold the sums before the trace
+				for (size_t p = P; p >= 2; p--) {
+					double *m = rows + (p - 1) * stride + j;
+					simd_dvec acc = simd_dadd(simd_dload(m), simd_dadd(pb[p], simd_dmul(vn, pa[p])));
+					for (size_t k = 1; k + 2 <= p; k++) {
+						acc = simd_dadd(acc, simd_dmul(simd_dset1(C[p][k]), simd_dmul(pa[k], simd_dload(rows + (p - k - 1) * stride + j))));
+					}
+					simd_dstore(m, acc);
+				}
+				simd_dstore(rows + j, simd_dsub(mean, pa[1]));
+			}
+		}
+	});
+	for (size_t i = 0; i < count; i++) {
+		if (groups[i] <= TVLA_RANDOM) n[groups[i]]++;
+	}
+}
+
+void tvla_accumulator::merge(const tvla_accumulator &other) {
+	if (other.d != d || other.maxOrder != maxOrder) throw std::invalid_argument("tvla: merging accumulators of different samples or order");
+	const size_t P = 2 * maxOrder;
+	for (size_t g = 0; g < 2; g++) {
+		const double na = (double) n[g], nb = (double) other.n[g], total = na + nb;
+		if (nb == 0.0) continue;
+		double *rows = sums.data() + g * P * stride;
+		const double *orows = other.sums.data() + g * P * stride;
+		parallel_for(d, TVLA_BLOCK, [&](size_t begin, size_t end) {
+			double pa[TVLA_MAX_MOMENT + 1], pb[TVLA_MAX_MOMENT + 1];
+			for (size_t j = begin; j < end; j++) {
+				//As add with a = -nb delta / n and b = na delta / n, the other sums weighted by b
+				const double delta = orows[j] - rows[j];
+				pa[0] = pb[0] = 1.0;
+				for (size_t k = 1; k <= P; k++) {
+					pa[k] = pa[k - 1] * (-nb * delta / total);
+					pb[k] = pb[k - 1] * (na * delta / total);
+				}
+				for (size_t p = P; p >= 2; p--) {
+					double acc = rows[(p - 1) * stride + j] + orows[(p - 1) * stride + j] + nb * pb[p] + na * pa[p];
+					for (size_t k = 1; k + 2 <= p; k++) {
+						acc += binomial(p, k) * (pa[k] * rows[(p - k - 1) * stride + j] + pb[k] * orows[(p - k - 1) * stride + j]);
+					}
+					rows[(p - 1) * stride + j] = acc;
+				}
+				rows[j] += delta * nb / total;
+			}
+		});
+		n[g] += other.n[g];
+	}
+}
+
+void tvla_accumulator::t(size_t order, double *out) const {
+	if (order < 1 || order > maxOrder) throw std::invalid_argument("tvla: the order must be between 1 and " + std::to_string(maxOrder));
+	if (n[0] < 2 || n[1] < 2) throw std::invalid_argument("tvla: a group has fewer than 2 traces");
+	for (size_t j = 0; j < d; j++) {
+		double mu[2], var[2];
+		for (size_t g = 0; g < 2; g++) {
+			const double count = (double) n[g];
+			//Central moments CM_p = M_p / n
+			auto cm = [&](size_t p) { return row(g, p - 1)[j] / count; };
+			if (order == 1) {
+				mu[g] = row(g, 0)[j];
+				var[g] = row(g, 1)[j] / (count - 1.0);
+			} else if (order == 2) {
+				mu[g] = cm(2);
+				var[g] = cm(4) - mu[g] * mu[g];
+			} else {
+				const double cm2 = cm(2), cmd = cm(order);
+				const double scale = std::pow(cm2, (double) order);
+				mu[g] = scale > 0.0 ? cmd / std::sqrt(scale) : 0.0;
+				var[g] = scale > 0.0 ? (cm(2 * order) - cmd * cmd) / scale : 0.0;
+			}
+		}
+		const double se = var[0] / (double) n[0] + var[1] / (double) n[1];
+		out[j] = se > 0.0 ? (mu[0] - mu[1]) / std::sqrt(se) : 0.0;
+	}
+}
+
+void trace_file_tvla(const std::string &path, const uint8_t *groups, tvla_accumulator &acc) {
+	const trace_file file(path);
+	const size_t length = file.length();
+	if (length != acc.samples()) throw std::invalid_argument(path + ": the traces have " + std::to_string(length) + " samples, not " + std::to_string(acc.samples()));
+
+	//Blocks of the traces of both groups, read in physical units
+	std::vector<uint8_t> blockGroups;
+	file.read_blocks([&](size_t i) { return groups[i] <= TVLA_RANDOM; }, [&](const float *block, const size_t *rows, size_t n) {
+		blockGroups.resize(n);
+		for (size_t r = 0; r < n; r++) blockGroups[r] = groups[rows[r]];
+		acc.add(block, n, length, blockGroups.data());
+	});
+}
@@ -0,0 +1,67 @@
+//Test vector leakage assessment (TVLA): the fixed-vs-random Welch t-test of the software AES of the firmware
+//(CMD_SWAES128_ENC, CMD_SWAES128_ENC_MASKED and the FROM_INSPECTOR masked variants) at every sample, to any order up to
+//TVLA_MAX_ORDER, in one pass over traces that are streamed and never held
+//
+//tvla_accumulator keeps, for the fixed (group 0) and random (group 1) traces, the count, mean and central sums
+//M_p = sum (x - mean)^p, p = 2 .. 2 order, of every sample in double. A trace is merged into them by the update of
+//Pebay (the one-point case of merge), a generalization of Welford's that stays stable at any order:
+//  M_p += sum_{k=1}^{p-2} C(p, k) M_{p-k} a^k + b^p + n a^p,  a = -(x - mean) / (n + 1), b = n (x - mean) / (n + 1)
+//applied from the highest p down, SIMD_DWIDTH consecutive samples at once (simd.h). Every thread owns a slice of the
+//samples, so the shards need no merge; merge combines the accumulators of separate streams (several acquisitions,
+//processes or machines) by the same formulas.
+//
+//The t of order d compares, as Schneider and Moradi, the mean of (x - mean)^d over the traces of each group: the mean
+//itself with the unbiased variance for d = 1 (scipy.stats.ttest_ind(fixed, random, equal_var=False)), the central
+//moment CM_2 with variance CM_4 - CM_2^2 for d = 2, and the standardized moment CM_d / CM_2^(d/2) with variance
+//(CM_2d - CM_d^2) / CM_2^d for d >= 3. |t| above TVLA_THRESHOLD is a leak.
+
+#ifndef __TVLA_H
+#define __TVLA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#define TVLA_MAX_ORDER 5 //Central sums up to M_10
+#define TVLA_FIXED 0 //Groups of the traces; any other value is skipped
+#define TVLA_RANDOM 1
+#define TVLA_BLOCK 512 //Samples per task of tvla_accumulator::add, whose sums of both groups stay in the L2 cache
+#define TVLA_THRESHOLD 4.5
+
+class tvla_accumulator {
+public:
+	tvla_accumulator(size_t samples, size_t order);
+
+	size_t samples() const { return d; }
+	size_t order() const { return maxOrder; }
+	uint64_t count(size_t group) const { return n[group]; }
+	const double *mean(size_t group) const { return row(group, 0); }
+	//central_sum: M_p of every sample, 2 <= p <= 2 order()
+	const double *central_sum(size_t group, size_t p) const { return row(group, p - 1); }
+
+	//add: the count traces of x (samples() floats each, rows ld floats apart) to the sums of their group (groups[i],
+	//TVLA_FIXED or TVLA_RANDOM; traces of other groups are skipped)
+	void add(const float *x, size_t count, size_t ld, const uint8_t *groups);
+
+	//merge: adds the traces of other (same samples and order) as if they had been added to this one
+	void merge(const tvla_accumulator &other);
+
+	//t: the Welch t of the given order (1 .. order()) of the fixed against the random traces at every sample into out;
+	//throws std::invalid_argument if a group has fewer than 2 traces. A sample constant in both groups has a t of 0.
+	void t(size_t order, double *out) const;
+
+private:
+	size_t d, stride, maxOrder;
+	uint64_t n[2] = { 0, 0 };
+	std::vector<double> sums; //2 groups x 2 order rows of stride doubles: the mean, then M_2 .. M_2order
+
+	const double *row(size_t group, size_t r) const { return sums.data() + (group * 2 * maxOrder + r) * stride; }
+};
+
+//trace_file_tvla: adds the traces of the container at path, in physical units, to acc by blocks, groups giving the group
+//of every trace; the container traces must have acc.samples() samples
+void trace_file_tvla(const std::string &path, const uint8_t *groups, tvla_accumulator &acc);
+
+#endif
@@ -1,3 +1,4 @@
+import os
 import random
 import warnings
 import numpy as np
@@ -6,15 +7,22 @@ import matplotlib.pyplot as plt
 import statistics
 from sklearn.cluster import DBSCAN
 from sklearn.preprocessing import StandardScaler
-from sklearn import metrics
-from sklearn.metrics import confusion_matrix
+from sklearn.metrics import confusion_matrix, silhouette_score, roc_auc_score
 from sklearn.decomposition import PCA
 from sklearn.cluster import OPTICS
 from sklearn.cluster import MeanShift, estimate_bandwidth
 import scipy.cluster.hierarchy as shc
 from sklearn.neighbors import NearestNeighbors
-from scipy.fft import rfft, rfftfreq
+from scipy.fft import rfft
+from scipy.signal import decimate
 from sklearn.metrics.cluster import normalized_mutual_info_score
+try:
+    #Native scaler, PCA and clustering of Tools/libsca.so (build it as explained in Tools/README.md)
+    import sca_native
+    from sca_native import DBSCAN, OPTICS, MeanShift, estimate_bandwidth
+    from sca_native import silhouette_score, normalized_mutual_info_score, roc_auc_score
+except OSError:
+    sca_native = None
 
 #from sklearn.naive_bayes import GaussianNB
 #from sklearn.neighbors import KNeighborsClassifier
@@ -35,6 +43,29 @@ sca = sca[0]
 #To analize  data in temporal domain use domains[0] and to do in frequencial domain use domains[1] 
 domain = domains[0]
 proportion = proportion[2]
+#With Tools/libsca.so, all the executions run at once on all the cores (Tools/experiment.h), every one with its own random
+#stream; set it to False to run them one by one with Python's random samples
+parallel = True
+#With Tools/libsca.so, OPTICS and DBSCAN cluster the band powers of a spectrogram (Tools/psd.h) around the clock
+#frequencies (sca_native.CLOCK_BANDS) instead of the samples; they are read from the container when
+#sca_native.add_band_features stored them in it
+band_features = False
+#With Tools/libsca.so, the traces are first aligned on the mean trace of their program (Tools/align.h) against the
+#trigger jitter; the shifts are read from the container when sca_native.add_alignment stored them in it
+align = False
+#With Tools/libsca.so, the traces of these programs (data-dependent phase lengths, e.g. 'E0207', 'E0208_1st',
+#'E0209_1st') are warped onto the mean trace of their program by dynamic time warping (Tools/dtw.h)
+dtw_programs = []
+#Decimation factor of the traces before the spectra, the scaler and the PCA (Tools/decimate.h, as
+#scipy.signal.decimate(X, decimation, ftype='fir')): the STM32F4 runs at 168 MHz at most, so most of the 1 GS/s band
+#is redundant and 4 to 8 shrinks the following stages as much; the decimated traces are read from the container when
+#sca_native.add_decimated stored them in it
+decimation = 1
+#With Tools/libsca.so, number of points of interest of every error program (Tools/poi.h): the samples of largest SNR
+#against its baseline program, computed in one pass over the traces, so that the scaler and the PCA see a few hundred
+#samples instead of 50,000; 0 keeps all the samples. The points are read from the container when sca_native.add_poi
+#stored them in it
+poi = 0
 
 
 #This function returns the number of clusters and the coeficients 
@@ -46,7 +77,7 @@ def clustering(X, Y, cluster):
         n_noise_ = list(labels).count(-1)
         # print("     Estimated number of noise points = %d" % n_noise_)
 
-    silhouette = metrics.silhouette_score(X, labels)
+    silhouette = silhouette_score(X, labels)
     mutual_info = normalized_mutual_info_score(Y, labels)
     '''print("     Silhouette Coefficient           = %0.3f" % silhouette)
     print("     Normalized_mutual_info           = %0.3f" % mutual_info)'''
@@ -67,11 +98,31 @@ def clfmetrics(Y, y_pred):
     fpr = fp / (fp + tn) if (fp + tn) != 0 else 0
     acc = (tp + tn) / (tp + tn + fp + fn)'''
 
-    auc = metrics.roc_auc_score(Y, y_pred)
+    auc = roc_auc_score(Y, y_pred)
 
     return auc
 
 
+#Mean and deviation of the scores of the executions, None if there are fewer than two
+def summary(values):
+    if len(values) < 2:
+        return None
+    return statistics.mean(values), statistics.stdev(values)
+
+
+#It draws the results of an algorithm in screen: the most frequent numbers of clusters and the average and deviation
+#(summary) of the coefficients
+def report(name, n_clusters, executions, sil, mutual, auc):
+    n_clusters, counts_clusters = np.unique(n_clusters, return_counts=True)
+    print(f"     Number of clusters {name}    : " + str(n_clusters[[c for c, count in enumerate(counts_clusters) if count == max(counts_clusters)]]) + str(
+        max(counts_clusters) * 100 / executions) + " %")
+    print(f"     Silhouette Coefficient {name:10}:  = {np.around(sil[0], 4)} +- {np.around(sil[1], 4)}")
+    print(f"     Normalized Mutual Information {name:10}:  = {np.around(mutual[0], 4)} +- {np.around(mutual[1], 4)}")
+    if auc is not None:
+        print(f"     Area Under Curve {name:10}:  = {np.around(auc[0], 4)} +- {np.around(auc[1], 4)}")
+    print(" ")
+
+
 if __name__ == '__main__':
     print(" ")
     print(">> IKERLAN Industrial Cybersecurity Team")
@@ -125,15 +176,104 @@ if __name__ == '__main__':
         print(" Error: Select a correct data file")
 
     fqfn_w_labels = workDir + file_w_labels
-    print("   > Filename   : " + "\"" + fqfn_w_labels + "\"")
-    dataset_w_labels = np.genfromtxt(fqfn_w_labels, delimiter=",")
-
-    X = dataset_w_labels[:, 0:50000]
-    Y = dataset_w_labels[:, 50000]
-    values, traces = np.unique(Y, return_counts=True)
+    #The binary trace container written by Tools/trace_merge (same name, .trc) is memory-mapped if it exists
+    fqfn_container = os.path.splitext(fqfn_w_labels)[0] + '.trc'
+    if os.path.exists(fqfn_container):
+        import sca_native
+        print("   > Filename   : " + "\"" + fqfn_container + "\"")
+        traces_file = sca_native.TraceFile(fqfn_container)
+        X = traces_file.physical()[:, 0:50000]
+        Y = traces_file.labels
+        #Programs, their number of traces and their trace positions come from the program index of the container
+        program_traces = {int(v): traces_file.program_indices(int(v)) for v in np.unique(traces_file.program_index['label'])}
+        values = np.array(sorted(program_traces))
+        traces = np.array([len(program_traces[v]) for v in values])
+    else:
+        print("   > Filename   : " + "\"" + fqfn_w_labels + "\"")
+        dataset_w_labels = np.genfromtxt(fqfn_w_labels, delimiter=",")
+
+        X = dataset_w_labels[:, 0:50000]
+        Y = dataset_w_labels[:, 50000]
+        values, traces = np.unique(Y, return_counts=True)
+        program_traces = {int(v): np.flatnonzero(Y == v) for v in values}
+        traces_file = None
+
+    if align and sca_native is not None:
+        if traces_file is not None and traces_file.shifts is not None:
+            shifts = traces_file.shifts['shift']
+        else:
+            shifts, _ = sca_native.align(X, Y, iterations=2)
+        X = sca_native.apply_shifts(X, shifts)
+        print("   > Aligned    : " + "%.1f" % np.abs(shifts).max() + " samples at most")
+    if dtw_programs and sca_native is not None:
+        rows = np.concatenate([program_traces.get(sca_native.PROGRAMS.index(p), np.zeros(0, dtype=np.int64)) for p in dtw_programs])
+        X = np.array(X)
+        X[rows] = sca_native.dtw_warp(X[rows], Y[rows])[0]
+        print("   > Warped     : " + str(len(rows)) + " traces of " + ", ".join(dtw_programs))
+
+    #What the container holds is computed from the traces as stored, so it is not used after an alignment or a warping
+    stored = traces_file is not None and not align and not dtw_programs
+    if decimation > 1:
+        if stored and traces_file.decimated is not None and traces_file.decimation == decimation and traces_file.length == X.shape[1]:
+            X = traces_file.decimated
+        elif sca_native is not None:
+            X = sca_native.decimate(X, decimation)
+        else:
+            X = decimate(X, decimation, ftype='fir')
+        print("   > Decimated  : " + str(X.shape[1]) + " samples per trace")
+    sample_rate = (traces_file.sample_rate if traces_file is not None else 1.0e9) / decimation
+
+    #Magnitude spectra of the traces for the frequency domain of Mean Shift, computed once for all the executions: read
+    #from the container if sca_native.add_spectra stored them in it, else computed natively or with scipy
+    if stored and decimation == 1 and traces_file.spectra is not None and traces_file.spectrum_samples == X.shape[1]:
+        F = traces_file.spectra
+    elif sca_native is not None:
+        F = sca_native.magnitude_spectra(X)
+    else:
+        F = np.vstack([np.abs(rfft(X[i:i + 256])) for i in range(0, len(X), 256)])
+    if band_features and sca_native is not None:
+        #The clock bands above the Nyquist frequency of the decimated traces are left out
+        bands = [b for b in sca_native.CLOCK_BANDS if b[1] <= sample_rate / 2]
+        #Stored features are used only if they were computed with the same bands, PSD options and sample rate
+        if stored and decimation == 1 and traces_file.features_match(bands=bands, fs=sample_rate, samples=X.shape[1]):
+            X = traces_file.features
+        else:
+            X = sca_native.band_features(X, bands=bands, fs=sample_rate)
+        print("   > Features   : " + str(X.shape[1]) + " band powers")
+    if poi and sca_native is not None:
+        pairs = [(1 if program in [4, 5, 6] else 0, int(program)) for program in values[2:]]
+        if (stored and decimation == 1 and not band_features and traces_file.poi is not None and traces_file.poi_statistic == 'snr'
+                and traces_file.poi_points == poi and traces_file.poi_window == 1 and traces_file.poi_samples == X.shape[1]
+                and all(traces_file.poi_baselines.get(program) == LB for LB, program in pairs)):
+            masks = traces_file.poi
+        else:
+            masks = sca_native.poi_masks(X, Y, pairs, points=poi)
+        #All the executions share one trace matrix, so it keeps the points of every program
+        X = X[:, np.unique(np.concatenate([masks[program] for _, program in pairs]))]
+        print("   > POI        : " + str(X.shape[1]) + " samples per trace")
     n_programs = 20
-
-    for program, name, n_traces in zip(values[2:], names[2:], traces[2:]):
+    #Scaler and PCA statistics of the baseline programs (traces and spectra), computed once and shared by all the executions
+    baselines = {}
+    spectral_baselines = {}
+    executions = 100
+    #Algorithms run for every number of PCA components
+    settings = [(8, ['optics']), (10, ['dbscan', 'mean_shift'])]
+    algorithm_names = {'optics': 'OPTICS', 'dbscan': 'DBSCAN', 'mean_shift': 'Mean Shift'}
+    experiments = sca_native is not None and parallel
+
+    if experiments:
+        #All the executions of all the programs at once, spread over the cores; every execution samples its error traces
+        #from its own random stream, so the results are reproducible
+        plan = []
+        for program in values[2:]:
+            LB = 1 if program in [4, 5, 6] else 0
+            if LB not in baselines:
+                baselines[LB] = sca_native.BaselinePCA(X[program_traces[LB]])
+                spectral_baselines[LB] = sca_native.BaselinePCA(F[program_traces[LB]])
+            plan.append((int(program), baselines[LB], program_traces[int(program)], spectral_baselines[LB]))
+        scores, summaries = sca_native.run_experiments(X, plan, settings, executions=executions, spectra=F)
+
+    for p, (program, name, n_traces) in enumerate(zip(values[2:], names[2:], traces[2:])):
 
         print(" ")
         LB = 1 if program in [4, 5, 6] else 0
@@ -141,7 +281,7 @@ if __name__ == '__main__':
         program = int(program)
         print("   > Programs   : " + str(names[LB]) + ", " + str(name))
 
-        for component in [8, 10]:
+        for component in [c for c, _ in settings]:
             n_clusters1, n_clusters2, n_clusters3 = [], [], []
             sil1, sil2, sil3 = [], [], []
             mutual1, mutual2, mutual3 = [], [], []
@@ -154,15 +294,24 @@ if __name__ == '__main__':
             print("   > Domain     : DBSCAN, OPTICS --> Temporary")
             print(" ")
 
-            executions = 100
+            if experiments:
+                s = [c for c, _ in settings].index(component)
+                for a, algorithm in enumerate(sca_native.EXPERIMENT_ALGORITHMS):
+                    if algorithm in settings[s][1]:
+                        r = summaries[p, s, a]
+                        report(algorithm_names[algorithm], scores[p, s, :, a]['clusters'], executions,
+                               (r['silhouette_mean'], r['silhouette_stdev']), (r['mutual_info_mean'], r['mutual_info_stdev']),
+                               (r['auc_mean'], r['auc_stdev']) if r['auc_runs'] > 1 else None)
+                continue
+
             for execution in np.arange(executions):
                 #print("   > Errors     : 1:100")
                 n_errors = round(0.01 * LB_traces)
-                positions = [i for i in range(len(Y)) if Y[i] == LB]
+                positions = list(program_traces[LB])
                 e = 0
                 while e < min(n_errors, 30):
-                    trace = random.randint(sum(traces[:program]), sum(traces[:program + 1]) - 1)
-                    if Y[trace] == program and trace not in positions:
+                    trace = random.choice(program_traces[program])
+                    if trace not in positions:
                         positions.append(trace)
                         e = e + 1
 
@@ -197,14 +346,20 @@ if __name__ == '__main__':
 
                 # print(" ")
                 # print(">> STAGE 2: PCA ")
-                Xx = pd.DataFrame(X_new).values
-                scaler = StandardScaler(with_mean=True, with_std=True)
-                scaler.fit(Xx)
-                XF_scaled = scaler.transform(Xx)
-
-                pca = PCA(n_components=component)
-                pca.fit(XF_scaled)
-                XF_pca = pca.transform(XF_scaled)
+                if sca_native is not None:
+                    #Only the sampled error traces (after the baseline traces in positions) are read at every execution
+                    if LB not in baselines:
+                        baselines[LB] = sca_native.BaselinePCA(X[program_traces[LB]])
+                    XF_pca = baselines[LB].fit_transform(X_new[len(program_traces[LB]):], component)
+                else:
+                    Xx = pd.DataFrame(X_new).values
+                    scaler = StandardScaler(with_mean=True, with_std=True)
+                    scaler.fit(Xx)
+                    XF_scaled = scaler.transform(Xx)
+
+                    pca = PCA(n_components=component)
+                    pca.fit(XF_scaled)
+                    XF_pca = pca.transform(XF_scaled)
 
                 # ---------------------------------------------
                 # ------- STAGE 3: Clustering -----------------
@@ -213,8 +368,14 @@ if __name__ == '__main__':
                 '''print(" ")
                 print(">> STAGE 3: Clustering")'''
 
-                neighbors = NearestNeighbors(n_neighbors=n_errors).fit(XF_pca)
-                distances, indices = neighbors.kneighbors(XF_pca)
+                if sca_native is not None:
+                    #One neighbor graph of XF_pca for the eps heuristic and all the clustering algorithms
+                    points = sca_native.NeighborGraph(XF_pca, n_neighbors=n_errors)
+                    distances, indices = points.kneighbors()
+                else:
+                    points = XF_pca
+                    neighbors = NearestNeighbors(n_neighbors=n_errors).fit(XF_pca)
+                    distances, indices = neighbors.kneighbors(XF_pca)
                 distances = np.sort(distances, axis=0)
                 distances = distances[:, 1]
                 eps = distances[instances - n_errors - 1]
@@ -225,9 +386,9 @@ if __name__ == '__main__':
                     '''print(" ")
                     print("  >   Components : " + str(component))
                     print("       > Algorithm  : OPTICS")'''
-                    opt = OPTICS(cluster_method='dbscan', max_eps=eps*1.5, min_samples=min_samples).fit(XF_pca)
+                    opt = OPTICS(cluster_method='dbscan', max_eps=eps*1.5, min_samples=min_samples).fit(points)
                     # print("     " + str(opt))
-                    y_opt, n_clusters, silhouette, mutual_info = clustering(XF_pca, Y_new, opt)
+                    y_opt, n_clusters, silhouette, mutual_info = clustering(points, Y_new, opt)
                     n_clusters2.append(n_clusters)
                     sil2.append(silhouette)
                     mutual2.append(mutual_info)
@@ -241,9 +402,9 @@ if __name__ == '__main__':
                     '''print(" ")
                     print("  >   Components : " + str(component))
                     print("      > Algorithm  : DBSCAN")'''
-                    db = DBSCAN(eps=eps, min_samples=min_samples).fit(XF_pca)
+                    db = DBSCAN(eps=eps, min_samples=min_samples).fit(points)
                     # print("     " + str(db))
-                    y_db, n_clusters, silhouette, mutual_info = clustering(XF_pca, Y_new, db)
+                    y_db, n_clusters, silhouette, mutual_info = clustering(points, Y_new, db)
                     n_clusters1.append(n_clusters)
                     sil1.append(silhouette)
                     mutual1.append(mutual_info)
@@ -257,22 +418,25 @@ if __name__ == '__main__':
                     # ms in FREQUENCY DOMAIN 
                     # ----------
 
-                    N = 50000
-                    SAMPLE_RATE = 1.0e9  # Hertz
-                    DURATION = N / SAMPLE_RATE  # Seconds
-                    yf = rfft(X_new)
-                    xf = rfftfreq(N, 1 / SAMPLE_RATE)
-                    X_new = np.abs(yf)
+                    #PCA of the precomputed spectra of the same traces
+                    if sca_native is not None:
+                        if LB not in spectral_baselines:
+                            spectral_baselines[LB] = sca_native.BaselinePCA(F[program_traces[LB]])
+                        FF_pca = spectral_baselines[LB].fit_transform(F[positions[len(program_traces[LB]):]], component)
+                        spectral_points = sca_native.NeighborGraph(FF_pca)
+                    else:
+                        FF_scaled = StandardScaler(with_mean=True, with_std=True).fit_transform(F[positions])
+                        spectral_points = PCA(n_components=component).fit_transform(FF_scaled)
 
                     '''print(" ")
                     print("  >   Components : " + str(component))
                     print("       > Algorithm  : Mean Shift")'''
-                    bandwidth = estimate_bandwidth(XF_pca, quantile=q, n_samples=n_samples)
+                    bandwidth = estimate_bandwidth(spectral_points, quantile=q, n_samples=n_samples)
                     if bandwidth == 0:
                         bandwidth = 1
-                    ms = MeanShift(bandwidth=bandwidth, bin_seeding=True, cluster_all=True).fit(XF_pca)
+                    ms = MeanShift(bandwidth=bandwidth, bin_seeding=True, cluster_all=True).fit(spectral_points)
                     # print("     " + str(ms))
-                    y_ms, n_clusters, silhouette, mutual_info = clustering(XF_pca, Y_new, ms)
+                    y_ms, n_clusters, silhouette, mutual_info = clustering(spectral_points, Y_new, ms)
                     n_clusters3.append(n_clusters)
                     sil3.append(silhouette)
                     mutual3.append(mutual_info)
@@ -284,33 +448,11 @@ if __name__ == '__main__':
 
             #It draws the results in screen and measure the average and deviation 
             if component == 8 :
-                n_clusters2, counts_clusters2 = np.unique(n_clusters2, return_counts=True)
-                print("     Number of clusters OPTICS    : " + str(n_clusters2[[c for c, count in enumerate(counts_clusters2) if count == max(counts_clusters2)]]) + str(
-                    max(counts_clusters2) * 100 / executions) + " %")
-                print(f"     Silhouette Coefficient OPTICS    :  = {np.around(statistics.mean(sil2), 4)} +- {np.around(statistics.stdev(sil2), 4)}")
-                print(f"     Normalized Mutual Information OPTICS    :  = {np.around(statistics.mean(mutual2), 4)} +- {np.around(statistics.stdev(mutual2), 4)}")
-                if len(auc2) > 1:
-                    print(f"     Area Under Curve OPTICS    :  = {np.around(statistics.mean(auc2), 4)} +- {np.around(statistics.stdev(auc2), 4)}")
-                print(" ")
+                report('OPTICS', n_clusters2, executions, summary(sil2), summary(mutual2), summary(auc2))
 
             elif component == 10:
-                n_clusters1, counts_clusters1 = np.unique(n_clusters1, return_counts=True)
-                print("     Number of clusters DBSCAN    : " + str(n_clusters1[[c for c, count in enumerate(counts_clusters1) if count == max(counts_clusters1)]]) + str(
-                    max(counts_clusters1)*100/executions) + " %")
-                print(f"     Silhouette Coefficient DBSCAN    :  = {np.around(statistics.mean(sil1), 4)} +- {np.around(statistics.stdev(sil1), 4)}")
-                print(f"     Normalized Mutual Information DBSCAN    :  = {np.around(statistics.mean(mutual1), 4)} +- {np.around(statistics.stdev(mutual1), 4)}")
-                if len(auc1) > 1:
-                    print(f"     Area Under Curve DBSCAN    :  = {np.around(statistics.mean(auc1), 4)} +- {np.around(statistics.stdev(auc1), 4)}")
-                print(" ")
-
-                n_clusters3, counts_clusters3 = np.unique(n_clusters3, return_counts=True)
-                print("     Number of clusters Mean Shift    : " + str(n_clusters3[[c for c, count in enumerate(counts_clusters3) if count == max(counts_clusters3)]]) + str(
-                    max(counts_clusters3)*100/executions) + " %")
-                print(f"     Silhouette Coefficient Mean Shift:  = {np.around(statistics.mean(sil3),4)} +- {np.around(statistics.stdev(sil3),4)}")
-                print(f"     Normalized Mutual Information Mean Shift:  = {np.around(statistics.mean(mutual3),4)} +- {np.around(statistics.stdev(mutual3),4)}")
-                if len(auc3) > 1:
-                    print(f"     Area Under Curve Mean Shift:  = {np.around(statistics.mean(auc3),4)} +- {np.around(statistics.stdev(auc3),4)}")
-                print(" ")
+                report('DBSCAN', n_clusters1, executions, summary(sil1), summary(mutual1), summary(auc1))
+                report('Mean Shift', n_clusters3, executions, summary(sil3), summary(mutual3), summary(auc3))
 
 
 
@@ -0,0 +1,1251 @@
+#! /usr/bin/python
+
+#Python binding of the native tools (Tools/libsca.so, build it as explained in Tools/README.md)
+
+import os
+import ctypes
+import numpy as np
+
+_lib = ctypes.CDLL(os.path.join(os.path.dirname(os.path.abspath(__file__)), 'Tools', 'libsca.so'))
+_lib.sca_last_error.restype = ctypes.c_char_p
+
+
+def _check(ret):
+    if ret != 0:
+        raise RuntimeError(_lib.sca_last_error().decode())
+
+
+#### TRACE CONTAINER ####----------------
+
+TRACE_DTYPES = {0: np.int8, 1: np.int16, 2: np.float32}
+
+#Same layout as trace_record in Tools/trace_file.h
+TRACE_RECORD = np.dtype([('label', '<i4'), ('cmd', 'u1'), ('reserved0', 'u1', 3), ('acquisition', '<u4'), ('source', '<u4')])
+
+#Same layout as trace_program_range in Tools/trace_file.h
+TRACE_PROGRAM_RANGE = np.dtype([('label', '<i4'), ('cmd', 'u1'), ('reserved0', 'u1', 3), ('first', '<u8'), ('count', '<u8')])
+
+#Same layout as trace_shift in Tools/trace_file.h
+TRACE_SHIFT = np.dtype([('shift', '<f4'), ('correlation', '<f4')])
+
+#Same layout as trace_poi_program in Tools/trace_file.h
+TRACE_POI_PROGRAM = np.dtype([('baseline', '<i4'), ('program', '<i4'), ('first', '<u4'), ('count', '<u4')])
+
+#Statistics of the points of interest, by their value in Tools/poi.h
+POI_STATISTICS = ['snr', 'sost', 't']
+
+#Program names in label order (Tools/programs.h)
+PROGRAMS = ["SUT00F", "SUT00I", "E0101", "E0102", "E0103", "E0104", "E0105", "E0106", "E0201", "E0202", "E0203",
+            "E0204", "E0205", "E0206", "E0207", "E0208_1st", "E0208_2nd", "E0209_1st", "E0209_2nd", "E0210"]
+
+
+class _TraceInfo(ctypes.Structure):
+    _fields_ = [('traceCount', ctypes.c_uint64),
+                ('traceLength', ctypes.c_uint32),
+                ('traceStride', ctypes.c_uint32),
+                ('chunkTraces', ctypes.c_uint32),
+                ('dtype', ctypes.c_uint32),
+                ('sampleRate', ctypes.c_double),
+                ('scale', ctypes.c_float),
+                ('offset', ctypes.c_float),
+                ('data', ctypes.c_void_p),
+                ('records', ctypes.c_void_p),
+                ('programIndex', ctypes.c_void_p),
+                ('programCount', ctypes.c_uint64),
+                ('description', ctypes.c_char * 128),
+                ('spectra', ctypes.c_void_p),
+                ('spectraBins', ctypes.c_uint32),
+                ('spectraStride', ctypes.c_uint32),
+                ('spectraSamples', ctypes.c_uint32),
+                ('binWidth', ctypes.c_double),
+                ('features', ctypes.c_void_p),
+                ('featureBands', ctypes.c_void_p),
+                ('featureCount', ctypes.c_uint32),
+                ('featureStride', ctypes.c_uint32),
+                ('featureSegments', ctypes.c_uint32),
+                ('featureBandCount', ctypes.c_uint32),
+                ('featureFlags', ctypes.c_uint32),
+                ('featureSamples', ctypes.c_uint32),
+                ('featureSegment', ctypes.c_uint32),
+                ('featureOverlap', ctypes.c_uint32),
+                ('featureWindow', ctypes.c_uint32),
+                ('featureSampleRate', ctypes.c_double),
+                ('shifts', ctypes.c_void_p),
+                ('alignStart', ctypes.c_uint32),
+                ('alignLength', ctypes.c_uint32),
+                ('alignMaxShift', ctypes.c_uint32),
+                ('alignIterations', ctypes.c_uint32),
+                ('decimated', ctypes.c_void_p),
+                ('decimatedFactor', ctypes.c_uint32),
+                ('decimatedSamples', ctypes.c_uint32),
+                ('decimatedStride', ctypes.c_uint32),
+                ('decimatedTaps', ctypes.c_uint32),
+                ('decimatedSampleRate', ctypes.c_double),
+                ('poiPrograms', ctypes.c_void_p),
+                ('poiIndices', ctypes.c_void_p),
+                ('poiProgramCount', ctypes.c_uint32),
+                ('poiStatistic', ctypes.c_uint32),
+                ('poiPoints', ctypes.c_uint32),
+                ('poiWindow', ctypes.c_uint32),
+                ('poiSamples', ctypes.c_uint32)]
+
+
+_lib.sca_trace_open.argtypes = [ctypes.c_char_p, ctypes.POINTER(ctypes.c_void_p)]
+_lib.sca_trace_close.argtypes = [ctypes.c_void_p]
+_lib.sca_trace_close.restype = None
+_lib.sca_trace_get_info.argtypes = [ctypes.c_void_p, ctypes.POINTER(_TraceInfo)]
+_lib.sca_trace_prefetch.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64]
+_lib.sca_trace_add_spectra.argtypes = [ctypes.c_char_p, ctypes.c_uint32]
+_lib.sca_trace_add_decimated.argtypes = [ctypes.c_char_p, ctypes.c_uint32]
+
+
+class _Mapping(object):
+    #Owns the native handle; the numpy views keep it alive, so the file stays mapped while a view exists
+    def __init__(self, path):
+        self.handle = ctypes.c_void_p()
+        _check(_lib.sca_trace_open(path.encode(), ctypes.byref(self.handle)))
+
+    def __del__(self):
+        if self.handle:
+            _lib.sca_trace_close(self.handle)
+            self.handle = None
+
+
+def _view(mapping, address, nbytes):
+    buf = (ctypes.c_char * nbytes).from_address(address)
+    buf._owner = mapping
+    return buf
+
+
+class TraceFile(object):
+    #Memory-mapped trace container (.trc). The arrays are read-only views of the file, nothing is copied:
+    #   samples      (traces, length) array in the file sample type
+    #   records      per-trace structured array (label, cmd, acquisition, source)
+    #   labels, cmds views of the records fields
+    #   program_index runs of consecutive traces of the same program, sorted by label
+    #   spectra      (traces, bins) magnitude spectra of the first spectrum_samples samples, None if the file has none
+    #                (add_spectra); bin k is at k * bin_width Hz
+    #   features     (traces, features) band features, None if the file has none (add_band_features): the powers of
+    #                the feature_bands (low, high Hz), for each of the feature_segments segments of a spectrogram;
+    #                features_match tells whether they were computed with given band_features settings
+    #   shifts       per-trace structured array (shift, correlation), None if the file has none (add_alignment): the
+    #                trace at t + shift matches the reference of its program at t; align_window is (start, length,
+    #                max_shift) of the reference window
+    #   decimated    (traces, samples) float32 traces in physical units decimated by decimation (one sample in
+    #                decimation kept, at decimated_rate Hz), None if the file has none (add_decimated)
+    #   poi          {program label: sample indices} of the points of interest of every program against the baseline
+    #                of poi_baselines[program], None if the file has none (add_poi); poi_statistic, poi_points,
+    #                poi_window and poi_samples are the settings they were selected with
+    def __init__(self, path):
+        self.path = path
+        mapping = _Mapping(path)
+        info = _TraceInfo()
+        _check(_lib.sca_trace_get_info(mapping.handle, ctypes.byref(info)))
+        self._mapping = mapping
+        self.count = info.traceCount
+        self.length = info.traceLength
+        self.sample_rate = info.sampleRate
+        self.scale = info.scale
+        self.offset = info.offset
+        self.chunk_traces = info.chunkTraces
+        self.description = info.description.decode(errors='replace')
+
+        dtype = np.dtype(TRACE_DTYPES[info.dtype])
+        nbytes = max(int(info.traceCount) * info.traceStride, 1)
+        self.samples = np.ndarray(shape=(self.count, self.length), dtype=dtype,
+                                  buffer=_view(mapping, info.data, nbytes),
+                                  strides=(info.traceStride, dtype.itemsize))
+        self.samples.flags.writeable = False
+        self.records = np.ndarray(shape=(self.count,), dtype=TRACE_RECORD,
+                                  buffer=_view(mapping, info.records, max(int(info.traceCount) * TRACE_RECORD.itemsize, 1)))
+        self.records.flags.writeable = False
+        self.labels = self.records['label']
+        self.cmds = self.records['cmd']
+        self.program_index = np.ndarray(shape=(info.programCount,), dtype=TRACE_PROGRAM_RANGE,
+                                        buffer=_view(mapping, info.programIndex, max(int(info.programCount) * TRACE_PROGRAM_RANGE.itemsize, 1)))
+        self.spectra = None
+        self.spectrum_samples = info.spectraSamples
+        self.bin_width = info.binWidth
+        if info.spectra:
+            self.spectra = np.ndarray(shape=(self.count, info.spectraBins), dtype=np.float32,
+                                      buffer=_view(mapping, info.spectra, max(int(info.traceCount) * info.spectraStride, 1)),
+                                      strides=(info.spectraStride, 4))
+            self.spectra.flags.writeable = False
+        self.features = None
+        self.feature_bands = np.zeros((0, 2))
+        self.feature_segments = info.featureSegments
+        self.feature_samples = info.featureSamples
+        self.feature_decibels = bool(info.featureFlags & _FEATURES_DECIBELS)
+        self._feature_settings = (info.featureFlags, info.featureSegment, info.featureOverlap, info.featureWindow,
+                                  info.featureSampleRate)
+        if info.features:
+            self.features = np.ndarray(shape=(self.count, info.featureCount), dtype=np.float32,
+                                       buffer=_view(mapping, info.features, max(int(info.traceCount) * info.featureStride, 1)),
+                                       strides=(info.featureStride, 4))
+            self.features.flags.writeable = False
+            self.feature_bands = np.ndarray(shape=(info.featureBandCount, 2), dtype=np.float64,
+                                            buffer=_view(mapping, info.featureBands, info.featureBandCount * 16))
+        self.shifts = None
+        self.align_window = (info.alignStart, info.alignLength, info.alignMaxShift)
+        if info.shifts:
+            self.shifts = np.ndarray(shape=(self.count,), dtype=TRACE_SHIFT,
+                                     buffer=_view(mapping, info.shifts, max(int(info.traceCount) * TRACE_SHIFT.itemsize, 1)))
+            self.shifts.flags.writeable = False
+        self.decimated = None
+        self.decimation = info.decimatedFactor
+        self.decimated_rate = info.decimatedSampleRate
+        if info.decimated:
+            self.decimated = np.ndarray(shape=(self.count, info.decimatedSamples), dtype=np.float32,
+                                        buffer=_view(mapping, info.decimated, max(int(info.traceCount) * info.decimatedStride, 1)),
+                                        strides=(info.decimatedStride, 4))
+            self.decimated.flags.writeable = False
+        self.poi = None
+        self.poi_baselines = None
+        self.poi_statistic = POI_STATISTICS[info.poiStatistic] if info.poiPrograms else None
+        self.poi_points = info.poiPoints
+        self.poi_window = info.poiWindow
+        self.poi_samples = info.poiSamples
+        if info.poiPrograms:
+            programs = np.ndarray(shape=(info.poiProgramCount,), dtype=TRACE_POI_PROGRAM,
+                                  buffer=_view(mapping, info.poiPrograms, max(info.poiProgramCount * TRACE_POI_PROGRAM.itemsize, 1)))
+            total = int(max(programs['first'] + programs['count'], default=0))
+            indices = np.ndarray(shape=(total,), dtype=np.uint32, buffer=_view(mapping, info.poiIndices, max(total * 4, 1)))
+            indices.flags.writeable = False
+            self.poi = {int(p['program']): indices[p['first']:p['first'] + p['count']] for p in programs}
+            self.poi_baselines = {int(p['program']): int(p['baseline']) for p in programs}
+
+    def __len__(self):
+        return self.count
+
+    #Label of a program given by label or by name
+    @staticmethod
+    def label_of(program):
+        return PROGRAMS.index(program) if isinstance(program, str) else int(program)
+
+    #Indices of the traces of a program (label or name), without scanning the labels
+    def program_indices(self, program):
+        label = self.label_of(program)
+        ranges = self.program_index[self.program_index['label'] == label]
+        if len(ranges) == 0:
+            return np.zeros(0, dtype=np.int64)
+        return np.concatenate([np.arange(r['first'], r['first'] + r['count'], dtype=np.int64) for r in ranges])
+
+    #Traces of a program (label or name): a view when they are stored together, a copy otherwise
+    def program(self, program):
+        label = self.label_of(program)
+        ranges = self.program_index[self.program_index['label'] == label]
+        if len(ranges) == 1:
+            first = int(ranges[0]['first'])
+            return self.samples[first:first + int(ranges[0]['count'])]
+        return self.samples[self.program_indices(label)]
+
+    #Traces [first, last) in physical units (scale and offset applied), as a float32 array
+    def physical(self, first=0, last=None):
+        x = self.samples[first:last]
+        if x.dtype == np.float32:
+            return x
+        return x.astype(np.float32) * np.float32(self.scale) + np.float32(self.offset)
+
+    #Asks the kernel to read ahead the chunks of traces [first, first + count)
+    def prefetch(self, first, count):
+        _check(_lib.sca_trace_prefetch(self._mapping.handle, first, count))
+
+    #Whether the stored features are those band_features computes from the samples with these settings (bands defaults
+    #to CLOCK_BANDS, fs to the sample rate of the container, samples to all of them)
+    def features_match(self, bands=None, fs=None, window='hann', nperseg=1024, noverlap=None, detrend='constant',
+                       spectrogram=True, decibels=True, samples=None):
+        if self.features is None:
+            return False
+        options = _psd_options(self.sample_rate if fs is None else fs, window, nperseg, noverlap, detrend)
+        flags = _flags(spectrogram, decibels) | (_FEATURES_DETRENDED if options.detrend else 0)
+        bands = _bands(CLOCK_BANDS if bands is None else bands)
+        return (self._feature_settings == (flags, options.segment, options.overlap, options.window, options.sampleRate)
+                and self.feature_samples == (samples or self.length) and np.array_equal(self.feature_bands, bands))
+
+
+def add_spectra(path, samples=None):
+    #Computes the magnitude spectra of the first samples samples (all by default) of the traces of a container and stores
+    #them in it (Tools/spectrum.h), replacing those it may have; open TraceFile objects do not see them
+    _check(_lib.sca_trace_add_spectra(path.encode(), samples or 0))
+
+
+def add_decimated(path, q):
+    #Decimates the traces of a container by q (Tools/decimate.h) and stores them in it (TraceFile.decimated), replacing
+    #those it may have; open TraceFile objects do not see them
+    _check(_lib.sca_trace_add_decimated(path.encode(), q))
+
+
+#### STANDARDIZATION AND PCA ####----------------
+
+_matrix_args = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_uint64]
+_lib.sca_scaler_fit.argtypes = _matrix_args + [ctypes.c_void_p] * 3
+_lib.sca_standardize.argtypes = _matrix_args + [ctypes.c_void_p] * 3
+_lib.sca_pca_fit.argtypes = _matrix_args + [ctypes.c_uint32, ctypes.c_int32, ctypes.c_uint32, ctypes.c_uint64] + [ctypes.c_void_p] * 5
+_lib.sca_pca_transform.argtypes = _matrix_args + [ctypes.c_uint32] + [ctypes.c_void_p] * 3
+_lib.sca_baseline_create.argtypes = _matrix_args + [ctypes.c_uint32, ctypes.c_uint64, ctypes.POINTER(ctypes.c_void_p)]
+_lib.sca_baseline_close.argtypes = [ctypes.c_void_p]
+_lib.sca_baseline_close.restype = None
+_lib.sca_baseline_pca_fit.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_uint32] + [ctypes.c_void_p] * 7
+
+
+def _matrix(X):
+    #(traces, samples) float32 matrix with contiguous rows, as the native functions take it, and its row stride in
+    #elements; strided views (a window of TraceFile.physical()) are used without copying
+    X = np.asarray(X)
+    if X.ndim != 2:
+        raise ValueError("expected a 2D array of traces, got shape " + str(X.shape))
+    if X.dtype != np.float32 or X.strides[1] != 4 or X.strides[0] < 0 or X.strides[0] % 4 != 0:
+        X = np.ascontiguousarray(X, dtype=np.float32)
+    return X, X.strides[0] // 4 if X.shape[0] > 1 else X.shape[1]
+
+
+def _seed(random_state):
+    if random_state is None:
+        return int(np.random.randint(0, 2 ** 31))
+    if isinstance(random_state, np.random.RandomState):
+        return int(random_state.randint(0, 2 ** 31))
+    return int(random_state)
+
+
+class StandardScaler(object):
+    #Replacement of sklearn.preprocessing.StandardScaler for (traces, samples) matrices (Tools/pca.h): SIMD column mean
+    #and variance accumulated in double; transform returns float32
+    def __init__(self, with_mean=True, with_std=True):
+        self.with_mean = with_mean
+        self.with_std = with_std
+
+    def fit(self, X, y=None):
+        X, ld = _matrix(X)
+        n, d = X.shape
+        self.mean_ = np.empty(d)
+        self.var_ = np.empty(d)
+        scale = np.empty(d, dtype=np.float32)
+        _check(_lib.sca_scaler_fit(X.ctypes.data, n, d, ld, self.mean_.ctypes.data, self.var_.ctypes.data, scale.ctypes.data))
+        self.scale_ = scale.astype(np.float64) if self.with_std else None
+        self.n_samples_seen_ = n
+        self.n_features_in_ = d
+        return self
+
+    def transform(self, X):
+        X, ld = _matrix(X)
+        n, d = X.shape
+        mean = self.mean_.astype(np.float32) if self.with_mean else np.zeros(d, dtype=np.float32)
+        scale = self.scale_.astype(np.float32) if self.with_std else np.ones(d, dtype=np.float32)
+        out = np.empty((n, d), dtype=np.float32)
+        _check(_lib.sca_standardize(X.ctypes.data, n, d, ld, mean.ctypes.data, scale.ctypes.data, out.ctypes.data))
+        return out
+
+    def fit_transform(self, X, y=None):
+        return self.fit(X).transform(X)
+
+
+class PCA(object):
+    #Replacement of sklearn.decomposition.PCA(n_components=k) for (traces, samples) matrices (Tools/pca.h): only the
+    #top k components, by randomized truncated SVD with scikit-learn's defaults (10 extra sketch columns, 'auto' power
+    #iterations) and sign convention; float32 results
+    def __init__(self, n_components, iterated_power='auto', n_oversamples=10, random_state=None):
+        self.n_components = n_components
+        self.iterated_power = iterated_power
+        self.n_oversamples = n_oversamples
+        self.random_state = random_state
+
+    def fit(self, X, y=None):
+        X, ld = _matrix(X)
+        n, d = X.shape
+        k = self.n_components
+        iterations = -1 if self.iterated_power == 'auto' else self.iterated_power
+        self.mean_ = np.empty(d, dtype=np.float32)
+        self.components_ = np.empty((k, d), dtype=np.float32)
+        self.singular_values_ = np.empty(k)
+        self.explained_variance_ = np.empty(k)
+        self.explained_variance_ratio_ = np.empty(k)
+        _check(_lib.sca_pca_fit(X.ctypes.data, n, d, ld, k, iterations, self.n_oversamples, _seed(self.random_state),
+                                self.mean_.ctypes.data, self.components_.ctypes.data, self.singular_values_.ctypes.data,
+                                self.explained_variance_.ctypes.data, self.explained_variance_ratio_.ctypes.data))
+        self.n_components_ = k
+        self.n_samples_ = n
+        self.n_features_in_ = d
+        return self
+
+    def transform(self, X):
+        X, ld = _matrix(X)
+        n, d = X.shape
+        out = np.empty((n, self.n_components_), dtype=np.float32)
+        _check(_lib.sca_pca_transform(X.ctypes.data, n, d, ld, self.n_components_, self.mean_.ctypes.data,
+                                      self.components_.ctypes.data, out.ctypes.data))
+        return out
+
+    def fit_transform(self, X, y=None):
+        return self.fit(X).transform(X)
+
+
+class BaselinePCA(object):
+    #StandardScaler followed by PCA of a fixed baseline (traces, samples) matrix stacked with a few other traces, fitted
+    #many times, as main.py does for every Monte-Carlo execution (Tools/pca.h, baseline_sketch). The baseline statistics
+    #and a sketch of its covariance of the given rank are computed once; each fit then only reads the extra traces.
+    #The scaler is exact, the components lose only the baseline spectrum beyond the sketch rank.
+    def __init__(self, baseline, rank=64, random_state=None):
+        X, ld = _matrix(baseline)
+        n, d = X.shape
+        self.baseline = X
+        self.rank = rank
+        self._handle = ctypes.c_void_p()
+        _check(_lib.sca_baseline_create(X.ctypes.data, n, d, ld, rank, _seed(random_state), ctypes.byref(self._handle)))
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            _lib.sca_baseline_close(self._handle)
+            self._handle = None
+
+    #Scaler (mean_, var_, scale_) and PCA (components_, explained_variance_, ...) of the baseline stacked with X
+    def fit(self, X, n_components):
+        X, ld = _matrix(X)
+        m, d = X.shape
+        k = n_components
+        self.mean_ = np.empty(d)
+        self.var_ = np.empty(d)
+        scale = np.empty(d, dtype=np.float32)
+        self.components_ = np.empty((k, d), dtype=np.float32)
+        self.singular_values_ = np.empty(k)
+        self.explained_variance_ = np.empty(k)
+        self.explained_variance_ratio_ = np.empty(k)
+        _check(_lib.sca_baseline_pca_fit(self._handle, X.ctypes.data, m, ld, k, self.mean_.ctypes.data,
+                                         self.var_.ctypes.data, scale.ctypes.data, self.components_.ctypes.data,
+                                         self.singular_values_.ctypes.data, self.explained_variance_.ctypes.data,
+                                         self.explained_variance_ratio_.ctypes.data))
+        self.scale_ = scale.astype(np.float64)
+        self.n_components_ = k
+        #Scaler folded into the components: one pass over the raw traces in transform
+        self._mean = self.mean_.astype(np.float32)
+        self._components = np.ascontiguousarray(self.components_ / scale)
+        return self
+
+    #PCA coordinates of raw traces (standardized with the fitted scaler)
+    def transform(self, X):
+        X, ld = _matrix(X)
+        n, d = X.shape
+        out = np.empty((n, self.n_components_), dtype=np.float32)
+        _check(_lib.sca_pca_transform(X.ctypes.data, n, d, ld, self.n_components_, self._mean.ctypes.data,
+                                      self._components.ctypes.data, out.ctypes.data))
+        return out
+
+    #PCA coordinates of the baseline traces followed by those of X
+    def fit_transform(self, X, n_components):
+        self.fit(X, n_components)
+        return np.vstack((self.transform(self.baseline), self.transform(X)))
+
+
+#### SPECTRA ####----------------
+
+_lib.sca_magnitude_spectra.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint32, ctypes.c_uint64, ctypes.c_void_p]
+
+
+def magnitude_spectra(X):
+    #numpy.abs(scipy.fft.rfft(X)) of (traces, samples) matrices (Tools/spectrum.h): real FFT in double of several traces
+    #at once on all the cores, float32 magnitudes
+    X, ld = _matrix(X)
+    n, d = X.shape
+    out = np.empty((n, d // 2 + 1), dtype=np.float32)
+    _check(_lib.sca_magnitude_spectra(X.ctypes.data, n, d, ld, out.ctypes.data))
+    return out
+
+
+_lib.sca_decimate.argtypes = _matrix_args + [ctypes.c_uint32, ctypes.c_void_p]
+
+
+def decimate(X, q):
+    #scipy.signal.decimate(X, q, ftype='fir') of (traces, samples) matrices (Tools/decimate.h): 20 q + 1 taps Hamming
+    #windowed-sinc low-pass, one sample in q kept, float32
+    X, ld = _matrix(X)
+    n, d = X.shape
+    if q < 1:
+        raise ValueError("q must be positive")
+    out = np.empty((n, (d + q - 1) // q), dtype=np.float32)
+    _check(_lib.sca_decimate(X.ctypes.data, n, d, ld, q, out.ctypes.data))
+    return out
+
+
+#Windows of Tools/psd.h, by scipy.signal.get_window name
+PSD_WINDOWS = ['boxcar', 'hann', 'hamming', 'blackman']
+_FEATURES_SPECTROGRAM = 1
+_FEATURES_DECIBELS = 2
+_FEATURES_DETRENDED = 4
+#Bands of the clocks of setClockSpeed (../ErrorCode/main.c), +-2 MHz around 30, 84 and 168 MHz and their second harmonics
+CLOCK_BANDS = [(f - 2e6, f + 2e6) for f in (30e6, 60e6, 84e6, 168e6, 336e6)]
+
+
+class _PsdOptions(ctypes.Structure):
+    _fields_ = [('segment', ctypes.c_uint32),
+                ('overlap', ctypes.c_uint32),
+                ('window', ctypes.c_uint32),
+                ('detrend', ctypes.c_uint32),
+                ('sampleRate', ctypes.c_double)]
+
+
+_lib.sca_welch.argtypes = _matrix_args + [ctypes.POINTER(_PsdOptions), ctypes.c_void_p]
+_lib.sca_band_features.argtypes = _matrix_args + [ctypes.POINTER(_PsdOptions), ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32,
+                                                  ctypes.c_void_p]
+_lib.sca_trace_add_band_features.argtypes = [ctypes.c_char_p, ctypes.c_uint32, ctypes.POINTER(_PsdOptions), ctypes.c_void_p,
+                                             ctypes.c_uint32, ctypes.c_uint32]
+
+
+def _psd_options(fs, window, nperseg, noverlap, detrend):
+    if window not in PSD_WINDOWS:
+        raise ValueError("window must be one of " + ", ".join(PSD_WINDOWS))
+    if detrend not in ('constant', False):
+        raise ValueError("detrend must be 'constant' or False")
+    return _PsdOptions(nperseg, nperseg // 2 if noverlap is None else noverlap, PSD_WINDOWS.index(window), detrend == 'constant', fs)
+
+
+def _bands(bands):
+    bands = np.ascontiguousarray(bands, dtype=np.float64).reshape(-1, 2)
+    if len(bands) == 0:
+        raise ValueError("no bands")
+    return bands
+
+
+def _flags(spectrogram, decibels):
+    return (_FEATURES_SPECTROGRAM if spectrogram else 0) | (_FEATURES_DECIBELS if decibels else 0)
+
+
+def welch(X, fs=1.0e9, window='hann', nperseg=256, noverlap=None, detrend='constant'):
+    #scipy.signal.welch(X, fs, window, nperseg, noverlap, detrend=detrend) of (traces, samples) matrices (Tools/psd.h):
+    #one-sided densities averaged over the segments, float32. Returns the bin frequencies and the (traces, bins) PSD.
+    X, ld = _matrix(X)
+    n, d = X.shape
+    options = _psd_options(fs, window, nperseg, noverlap, detrend)
+    out = np.empty((n, nperseg // 2 + 1), dtype=np.float32)
+    _check(_lib.sca_welch(X.ctypes.data, n, d, ld, ctypes.byref(options), out.ctypes.data))
+    return np.arange(nperseg // 2 + 1) * (fs / nperseg), out
+
+
+def band_features(X, bands=CLOCK_BANDS, fs=1.0e9, window='hann', nperseg=1024, noverlap=None, detrend='constant',
+                  spectrogram=True, decibels=True):
+    #Band powers of (traces, samples) matrices (Tools/psd.h): the PSD integrated over every (low, high) band in Hz, per
+    #segment of the spectrogram (segment-major, segments x bands features) or of the Welch PSD (one per band)
+    X, ld = _matrix(X)
+    n, d = X.shape
+    options = _psd_options(fs, window, nperseg, noverlap, detrend)
+    bands = _bands(bands)
+    segments = (d - options.overlap) // (nperseg - options.overlap) if spectrogram and nperseg <= d and options.overlap < nperseg else 1
+    out = np.empty((n, segments * len(bands)), dtype=np.float32)
+    _check(_lib.sca_band_features(X.ctypes.data, n, d, ld, ctypes.byref(options), bands.ctypes.data, len(bands),
+                                  _flags(spectrogram, decibels), out.ctypes.data))
+    return out
+
+
+def add_band_features(path, bands=CLOCK_BANDS, window='hann', nperseg=1024, noverlap=None, detrend='constant',
+                      spectrogram=True, decibels=True, samples=None):
+    #Computes the band features of the first samples samples (all by default) of the traces of a container, at its
+    #sample rate, and stores them in it (TraceFile.features), replacing those it may have
+    options = _psd_options(1.0, window, nperseg, noverlap, detrend)
+    bands = _bands(bands)
+    _check(_lib.sca_trace_add_band_features(path.encode(), samples or 0, ctypes.byref(options), bands.ctypes.data, len(bands),
+                                            _flags(spectrogram, decibels)))
+
+
+#### ALIGNMENT ####----------------
+
+class _AlignOptions(ctypes.Structure):
+    _fields_ = [('start', ctypes.c_uint32),
+                ('length', ctypes.c_uint32),
+                ('maxShift', ctypes.c_uint32),
+                ('iterations', ctypes.c_uint32)]
+
+
+_lib.sca_align.argtypes = _matrix_args + [ctypes.c_void_p, ctypes.POINTER(_AlignOptions), ctypes.c_void_p, ctypes.c_void_p]
+_lib.sca_apply_shifts.argtypes = _matrix_args + [ctypes.c_void_p, ctypes.c_void_p]
+_lib.sca_trace_add_alignment.argtypes = [ctypes.c_char_p, ctypes.POINTER(_AlignOptions)]
+
+
+def _align_options(max_shift, start, length, iterations):
+    if max_shift < 1 or iterations < 1:
+        raise ValueError("max_shift and iterations must be positive")
+    return _AlignOptions(start or 0, length or 0, max_shift, iterations)
+
+
+def align(X, groups, max_shift=64, start=None, length=None, iterations=1):
+    #Shifts of the rows of a (traces, samples) matrix relative to the mean trace of their group (e.g. the program labels)
+    #(Tools/align.h): the lag of the best normalized cross-correlation over the window [start, start + length) (by default
+    #all but max_shift samples at both ends), to a fraction of a sample. Returns the float64 shifts and correlations;
+    #apply_shifts aligns the traces.
+    X, ld = _matrix(X)
+    n, d = X.shape
+    groups = np.ascontiguousarray(groups).astype(np.int32)
+    if len(groups) != n:
+        raise ValueError("one group per trace")
+    options = _align_options(max_shift, start, length, iterations)
+    shifts = np.empty(n)
+    correlations = np.empty(n)
+    _check(_lib.sca_align(X.ctypes.data, n, d, ld, groups.ctypes.data, ctypes.byref(options), shifts.ctypes.data,
+                          correlations.ctypes.data))
+    return shifts, correlations
+
+
+def apply_shifts(X, shifts):
+    #Rows of a (traces, samples) matrix resampled at t + shift (cubic interpolation, end samples repeated), float32
+    X, ld = _matrix(X)
+    n, d = X.shape
+    shifts = np.ascontiguousarray(shifts, dtype=np.float64)
+    if len(shifts) != n:
+        raise ValueError("one shift per trace")
+    out = np.empty((n, d), dtype=np.float32)
+    _check(_lib.sca_apply_shifts(X.ctypes.data, n, d, ld, shifts.ctypes.data, out.ctypes.data))
+    return out
+
+
+def add_alignment(path, max_shift=64, start=None, length=None, iterations=1):
+    #Aligns the traces of a container on the mean trace of their program and stores the shifts in it (TraceFile.shifts),
+    #replacing those it may have
+    options = _align_options(max_shift, start, length, iterations)
+    _check(_lib.sca_trace_add_alignment(path.encode(), ctypes.byref(options)))
+
+
+class _DtwOptions(ctypes.Structure):
+    _fields_ = [('start', ctypes.c_uint32),
+                ('length', ctypes.c_uint32),
+                ('radius', ctypes.c_uint32),
+                ('iterations', ctypes.c_uint32)]
+
+
+_lib.sca_dtw_warp.argtypes = _matrix_args + [ctypes.c_void_p, ctypes.POINTER(_DtwOptions), ctypes.c_void_p, ctypes.c_void_p]
+
+
+def dtw_warp(X, groups, radius=32, start=0, length=None, iterations=1):
+    #Dynamic time warping of the rows of a (traces, samples) matrix onto the mean trace of their group (Tools/dtw.h),
+    #within radius samples of the diagonal, over the window [start, start + length) (to the end by default). Returns the
+    #(traces, length) float32 warped traces, on the time axis of the template, and the float64 path costs.
+    X, ld = _matrix(X)
+    n, d = X.shape
+    groups = np.ascontiguousarray(groups).astype(np.int32)
+    if len(groups) != n:
+        raise ValueError("one group per trace")
+    if iterations < 1:
+        raise ValueError("iterations must be positive")
+    length = length or max(d - start, 0)
+    options = _DtwOptions(start, length, radius, iterations)
+    out = np.empty((n, length), dtype=np.float32)
+    distances = np.empty(n)
+    _check(_lib.sca_dtw_warp(X.ctypes.data, n, d, ld, groups.ctypes.data, ctypes.byref(options), out.ctypes.data,
+                             distances.ctypes.data))
+    return out, distances
+
+
+#### POINTS OF INTEREST ####----------------
+
+_lib.sca_moments_create.argtypes = [ctypes.c_uint64, ctypes.c_uint32, ctypes.POINTER(ctypes.c_void_p)]
+_lib.sca_moments_close.argtypes = [ctypes.c_void_p]
+_lib.sca_moments_close.restype = None
+_lib.sca_moments_add.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_void_p]
+_lib.sca_moments_count.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.c_uint64)]
+_lib.sca_poi_statistic.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_void_p]
+_lib.sca_poi_select.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_void_p,
+                                ctypes.POINTER(ctypes.c_uint32)]
+_lib.sca_trace_add_poi.argtypes = [ctypes.c_char_p, ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32]
+
+
+def _statistic(statistic):
+    if statistic not in POI_STATISTICS:
+        raise ValueError("statistic must be one of " + ", ".join(POI_STATISTICS))
+    return POI_STATISTICS.index(statistic)
+
+
+class ClassMoments(object):
+    #Mean and variance of every sample of (traces, samples) matrices for every class of traces (Tools/poi.h), updated
+    #by Welford's method: the traces can be added in chunks and are not kept
+    def __init__(self, samples, classes):
+        self.samples = samples
+        self.classes = classes
+        self._handle = ctypes.c_void_p()
+        _check(_lib.sca_moments_create(samples, classes, ctypes.byref(self._handle)))
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            _lib.sca_moments_close(self._handle)
+            self._handle = None
+
+    #Adds the rows of X, of classes classes (integers from 0 to classes - 1)
+    def add(self, X, classes):
+        X, ld = _matrix(X)
+        n, d = X.shape
+        if d != self.samples:
+            raise ValueError("the traces must have %d samples" % self.samples)
+        classes = np.ascontiguousarray(classes).astype(np.uint32)
+        if len(classes) != n:
+            raise ValueError("one class per trace")
+        _check(_lib.sca_moments_add(self._handle, X.ctypes.data, n, ld, classes.ctypes.data))
+        return self
+
+    #Traces added to class c
+    def count(self, c):
+        n = ctypes.c_uint64()
+        _check(_lib.sca_moments_count(self._handle, c, ctypes.byref(n)))
+        return n.value
+
+    #'snr', 'sost' or 't' (Welch) of class b against class a at every sample, float64
+    def statistic(self, a, b, statistic='snr'):
+        out = np.empty(self.samples)
+        _check(_lib.sca_poi_statistic(self._handle, a, b, _statistic(statistic), out.ctypes.data))
+        return out
+
+
+def select_poi(score, points, window=1):
+    #Sample indices, in increasing order, of the points largest absolute scores, or of the points // window
+    #non-overlapping windows of window samples of largest summed absolute score
+    score = np.ascontiguousarray(score, dtype=np.float64)
+    indices = np.empty(max(points, window, 1), dtype=np.uint32)
+    count = ctypes.c_uint32()
+    _check(_lib.sca_poi_select(score.ctypes.data, len(score), points, window, indices.ctypes.data, ctypes.byref(count)))
+    return indices[:count.value].astype(np.int64)
+
+
+def poi_masks(X, labels, pairs, points=200, statistic='snr', window=1, chunk=256):
+    #{program: sample indices} of the points of interest of the traces of every (baseline, program) label pair of a
+    #(traces, samples) matrix, from one pass over its rows by chunks of chunk traces
+    labels = np.asarray(labels).astype(np.int64)
+    classes = {}
+    for pair in pairs:
+        for label in pair:
+            classes.setdefault(int(label), len(classes))
+    codes = np.array([classes.get(int(v), -1) for v in labels], dtype=np.int64)
+    moments = ClassMoments(X.shape[1], len(classes))
+    for first in range(0, len(X), chunk):
+        rows = np.flatnonzero(codes[first:first + chunk] >= 0) + first
+        if len(rows):
+            moments.add(X[rows], codes[rows])
+    return {int(program): select_poi(moments.statistic(classes[int(baseline)], classes[int(program)], statistic), points, window)
+            for baseline, program in pairs}
+
+
+def add_poi(path, pairs, points=200, statistic='snr', window=1):
+    #Selects the points of interest of every (baseline, program) label pair of the traces of a container, in one pass,
+    #and stores them in it (TraceFile.poi), replacing those it may have
+    pairs = np.ascontiguousarray(pairs, dtype=np.int32).reshape(-1, 2)
+    _check(_lib.sca_trace_add_poi(path.encode(), pairs.ctypes.data, len(pairs), _statistic(statistic), points, window))
+
+
+#### LEAKAGE ASSESSMENT ####----------------
+
+TVLA_THRESHOLD = 4.5
+
+_lib.sca_tvla_create.argtypes = [ctypes.c_uint64, ctypes.c_uint32, ctypes.POINTER(ctypes.c_void_p)]
+_lib.sca_tvla_close.argtypes = [ctypes.c_void_p]
+_lib.sca_tvla_close.restype = None
+_lib.sca_tvla_add.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_void_p]
+_lib.sca_tvla_add_trace_file.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_void_p]
+_lib.sca_tvla_merge.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_lib.sca_tvla_count.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.c_uint64)]
+_lib.sca_tvla_t.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_void_p]
+
+
+def _groups(groups, n):
+    #Group of every trace: 0 fixed, 1 random (booleans: True for random), any other value skipped
+    groups = np.asarray(groups)
+    if len(groups) != n:
+        raise ValueError("one group per trace")
+    return np.ascontiguousarray(np.where((groups >= 0) & (groups <= 1), groups, 255).astype(np.uint8))
+
+
+class TVLA(object):
+    #Fixed-vs-random Welch t-test of (traces, samples) matrices at every sample, up to the given order (Tools/tvla.h).
+    #The traces are added in chunks, or from a container, and are not kept; accumulators of separate streams can be
+    #merged. t(1) is scipy.stats.ttest_ind(fixed, random, equal_var=False), t(2) and t(3) the tests on the centered
+    #squared and the standardized cubed traces.
+    def __init__(self, samples, order=2):
+        self.samples = samples
+        self.order = order
+        self._handle = ctypes.c_void_p()
+        _check(_lib.sca_tvla_create(samples, order, ctypes.byref(self._handle)))
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            _lib.sca_tvla_close(self._handle)
+            self._handle = None
+
+    #Adds the rows of X, of groups groups (0 fixed, 1 random, others skipped)
+    def add(self, X, groups):
+        X, ld = _matrix(X)
+        n, d = X.shape
+        if d != self.samples:
+            raise ValueError("the traces must have %d samples" % self.samples)
+        groups = _groups(groups, n)
+        _check(_lib.sca_tvla_add(self._handle, X.ctypes.data, n, ld, groups.ctypes.data))
+        return self
+
+    #Adds the traces of a container (in physical units), of groups groups (one per trace of the container)
+    def add_trace_file(self, path, groups):
+        groups = _groups(groups, TraceFile(path).count)
+        _check(_lib.sca_tvla_add_trace_file(self._handle, path.encode(), groups.ctypes.data))
+        return self
+
+    #Adds the traces of another TVLA of the same samples and order
+    def merge(self, other):
+        _check(_lib.sca_tvla_merge(self._handle, other._handle))
+        return self
+
+    #Traces added to a group
+    def count(self, group):
+        n = ctypes.c_uint64()
+        _check(_lib.sca_tvla_count(self._handle, group, ctypes.byref(n)))
+        return n.value
+
+    #Welch t of an order at every sample, float64
+    def t(self, order=1):
+        out = np.empty(self.samples)
+        _check(_lib.sca_tvla_t(self._handle, order, out.ctypes.data))
+        return out
+
+    #Samples where |t| of an order exceeds the threshold
+    def leaks(self, order=1, threshold=TVLA_THRESHOLD):
+        return np.flatnonzero(np.abs(self.t(order)) > threshold)
+
+
+#### CORRELATION POWER ANALYSIS ####----------------
+
+CPA_CIPHERS = ['aes', 'des']
+CPA_MODELS = ['hw', 'hd']
+
+#Fixed keys of the firmware (Code/ErrorCode/main.c)
+DEFAULT_KEY_DES = bytes([0xca, 0xfe, 0xba, 0xbe, 0xde, 0xad, 0xbe, 0xef])
+DEFAULT_KEY_AES = bytes([0xca, 0xfe, 0xba, 0xbe, 0xde, 0xad, 0xbe, 0xef, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07])
+DEFAULT_KEY_AES256 = DEFAULT_KEY_AES + bytes([0xda, 0xba, 0xda, 0xba, 0xd0, 0x00, 0x00, 0xc0, 0x00, 0x01, 0xc0, 0xff, 0xee, 0x55, 0xde, 0xad])
+
+#Cipher and key of the first round of the commands CPA attacks (AES-256 starts with the first 16 key bytes)
+CPA_COMMANDS = {'SWAES128_ENC': ('aes', DEFAULT_KEY_AES), 'SWAES128TTABLES_ENC': ('aes', DEFAULT_KEY_AES),
+                'SWAES256_ENC': ('aes', DEFAULT_KEY_AES256[:16]), 'SWDES_ENC': ('des', DEFAULT_KEY_DES)}
+
+_lib.sca_cpa_create.argtypes = [ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint64, ctypes.POINTER(ctypes.c_void_p)]
+_lib.sca_cpa_close.argtypes = [ctypes.c_void_p]
+_lib.sca_cpa_close.restype = None
+_lib.sca_cpa_info.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint32), ctypes.POINTER(ctypes.c_uint32),
+                              ctypes.POINTER(ctypes.c_uint32), ctypes.POINTER(ctypes.c_uint64)]
+_lib.sca_cpa_add.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_void_p]
+_lib.sca_cpa_add_trace_file.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_void_p, ctypes.c_uint64]
+_lib.sca_cpa_correlation.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_void_p]
+_lib.sca_cpa_peaks.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+_lib.sca_cpa_first_round_key.argtypes = [ctypes.c_uint32, ctypes.c_void_p, ctypes.c_void_p]
+_lib.sca_cpa_ranks.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_void_p, ctypes.c_void_p]
+
+
+def first_round_key(cipher, key):
+    #Right guess of every key part CPA attacks for a key: its 16 bytes for AES, the 6-bit subkeys of the 8 S-boxes of
+    #the first DES round
+    key = np.frombuffer(bytes(key), dtype=np.uint8)
+    if len(key) != (16 if cipher == 'aes' else 8):
+        raise ValueError("AES takes 16 key bytes and DES 8")
+    right = np.empty(16 if cipher == 'aes' else 8, dtype=np.uint32)
+    _check(_lib.sca_cpa_first_round_key(CPA_CIPHERS.index(cipher), key.ctypes.data, right.ctypes.data))
+    return right
+
+
+class CPA(object):
+    #Correlation power analysis of the first round of the software AES or DES (Tools/cpa.h) with the Hamming weight
+    #('hw') or Hamming distance ('hd') of the S-box outputs, on (traces, samples) matrices of the window of the first
+    #round. The traces are added in chunks, with their plaintexts ((traces, 16) or (traces, 8) uint8), and are not kept;
+    #the correlations of every guess follow from the sums at any time.
+    def __init__(self, samples, cipher='aes', model='hw'):
+        if cipher not in CPA_CIPHERS or model not in CPA_MODELS:
+            raise ValueError("cipher must be 'aes' or 'des' and model 'hw' or 'hd'")
+        self.samples = samples
+        self.cipher = cipher
+        self.model = model
+        self._handle = ctypes.c_void_p()
+        _check(_lib.sca_cpa_create(CPA_CIPHERS.index(cipher), CPA_MODELS.index(model), samples, ctypes.byref(self._handle)))
+        targets, guesses, input_bytes, count = ctypes.c_uint32(), ctypes.c_uint32(), ctypes.c_uint32(), ctypes.c_uint64()
+        _check(_lib.sca_cpa_info(self._handle, ctypes.byref(targets), ctypes.byref(guesses), ctypes.byref(input_bytes),
+                                 ctypes.byref(count)))
+        self.targets = targets.value
+        self.guesses = guesses.value
+        self.input_bytes = input_bytes.value
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            _lib.sca_cpa_close(self._handle)
+            self._handle = None
+
+    def _inputs(self, inputs, n):
+        inputs = np.ascontiguousarray(inputs, dtype=np.uint8)
+        if inputs.shape != (n, self.input_bytes):
+            raise ValueError("expected (%d, %d) inputs" % (n, self.input_bytes))
+        return inputs
+
+    #Traces added
+    @property
+    def count(self):
+        targets, guesses, input_bytes, count = ctypes.c_uint32(), ctypes.c_uint32(), ctypes.c_uint32(), ctypes.c_uint64()
+        _check(_lib.sca_cpa_info(self._handle, ctypes.byref(targets), ctypes.byref(guesses), ctypes.byref(input_bytes),
+                                 ctypes.byref(count)))
+        return count.value
+
+    #Adds the rows of X with their plaintexts
+    def add(self, X, inputs):
+        X, ld = _matrix(X)
+        n, d = X.shape
+        if d != self.samples:
+            raise ValueError("the traces must have %d samples" % self.samples)
+        inputs = self._inputs(inputs, n)
+        _check(_lib.sca_cpa_add(self._handle, X.ctypes.data, n, ld, inputs.ctypes.data))
+        return self
+
+    #Adds the samples [start, start + samples) of the traces of a container (in physical units), with the plaintexts of
+    #all its traces
+    def add_trace_file(self, path, inputs, start=0):
+        inputs = self._inputs(inputs, TraceFile(path).count)
+        _check(_lib.sca_cpa_add_trace_file(self._handle, path.encode(), inputs.ctypes.data, start))
+        return self
+
+    #(guesses, samples) correlations of every guess of a key part
+    def correlation(self, target):
+        out = np.empty((self.guesses, self.samples))
+        _check(_lib.sca_cpa_correlation(self._handle, target, out.ctypes.data))
+        return out
+
+    #(targets, guesses) largest |correlation| of every guess over the samples, and the sample where it is reached
+    def peaks(self):
+        peaks = np.empty((self.targets, self.guesses))
+        at = np.empty((self.targets, self.guesses), dtype=np.uint32)
+        _check(_lib.sca_cpa_peaks(self._handle, peaks.ctypes.data, at.ctypes.data))
+        return peaks, at
+
+    #Most likely guess of every key part
+    def best_guesses(self):
+        return self.peaks()[0].argmax(axis=1)
+
+    #Rank of the right guess of every key part for a key (first_round_key), 0 when it is recovered
+    def ranks(self, key, peaks=None):
+        right = first_round_key(self.cipher, key)
+        if peaks is None:
+            peaks = self.peaks()[0]
+        peaks = np.ascontiguousarray(peaks, dtype=np.float64)
+        ranks = np.empty(self.targets, dtype=np.uint32)
+        _check(_lib.sca_cpa_ranks(peaks.ctypes.data, self.targets, self.guesses, right.ctypes.data, ranks.ctypes.data))
+        return ranks
+
+
+def rank_evolution(cpa, X, inputs, key, step=1000):
+    #Adds the traces of X to a CPA step traces at a time and returns the number of traces after every step and the
+    #(steps, targets) ranks of the right guesses of key then, as the key-rank evolution of the attack
+    counts, ranks = [], []
+    for first in range(0, len(X), step):
+        cpa.add(X[first:first + step], inputs[first:first + step])
+        counts.append(cpa.count)
+        ranks.append(cpa.ranks(key))
+    return np.array(counts), np.array(ranks)
+
+
+#### CLUSTERING ####----------------
+
+_lib.sca_neighbors_create.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint32, ctypes.c_uint64, ctypes.c_uint32,
+                                      ctypes.POINTER(ctypes.c_void_p)]
+_lib.sca_neighbors_close.argtypes = [ctypes.c_void_p]
+_lib.sca_neighbors_close.restype = None
+_lib.sca_neighbors_kneighbors.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_void_p, ctypes.c_void_p]
+_lib.sca_dbscan.argtypes = [ctypes.c_void_p, ctypes.c_double, ctypes.c_uint32, ctypes.c_void_p, ctypes.c_void_p]
+_lib.sca_optics.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+                            ctypes.c_void_p]
+_lib.sca_optics_dbscan.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_double, ctypes.c_void_p]
+_lib.sca_optics_xi.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32,
+                               ctypes.c_double, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64,
+                               ctypes.POINTER(ctypes.c_uint64)]
+_lib.sca_estimate_bandwidth.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.c_double, ctypes.POINTER(ctypes.c_double)]
+_lib.sca_mean_shift.argtypes = [ctypes.c_void_p, ctypes.c_double, ctypes.c_int, ctypes.c_uint32, ctypes.c_int, ctypes.c_uint32,
+                                ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint64), ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint32)]
+
+
+def _points(X):
+    #(points, dims) float64 matrix with contiguous rows, and its row stride in elements: the clustering works in double
+    #as scikit-learn's KD-tree, float32 PCA projections are converted exactly
+    X = np.ascontiguousarray(X, dtype=np.float64)
+    if X.ndim != 2:
+        raise ValueError("expected a 2D array of points, got shape " + str(X.shape))
+    return X, X.shape[1]
+
+
+class NeighborGraph(object):
+    #Neighbor graph of a (points, dims) matrix with the n_neighbors nearest neighbors of every point (Tools/neighbors.h),
+    #built once and given in place of the points to DBSCAN, OPTICS, estimate_bandwidth and MeanShift, so that they do
+    #not search the neighbors again. All the distances are kept for small matrices.
+    def __init__(self, X, n_neighbors=0):
+        X, ld = _points(X)
+        n, dim = X.shape
+        self.points = X
+        self.n_neighbors = n_neighbors
+        self._handle = ctypes.c_void_p()
+        _check(_lib.sca_neighbors_create(X.ctypes.data, n, dim, ld, n_neighbors, ctypes.byref(self._handle)))
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            _lib.sca_neighbors_close(self._handle)
+            self._handle = None
+
+    #(distances, indices) of the n_neighbors nearest points of every point, itself included, as
+    #NearestNeighbors(n_neighbors).fit(X).kneighbors(X)
+    def kneighbors(self, n_neighbors=None):
+        k = self.n_neighbors if n_neighbors is None else n_neighbors
+        n = len(self.points)
+        distances = np.empty((n, k))
+        indices = np.empty((n, k), dtype=np.int64)
+        _check(_lib.sca_neighbors_kneighbors(self._handle, k, distances.ctypes.data, indices.ctypes.data))
+        return distances, indices
+
+
+def _graph(X, n_neighbors=0):
+    return X if isinstance(X, NeighborGraph) else NeighborGraph(X, n_neighbors)
+
+
+class DBSCAN(object):
+    #Replacement of sklearn.cluster.DBSCAN (euclidean metric) with parallel neighborhood queries on a neighbor graph
+    #(Tools/cluster.h): same labels, -1 for noise
+    def __init__(self, eps=0.5, min_samples=5):
+        self.eps = eps
+        self.min_samples = min_samples
+
+    def fit(self, X, y=None):
+        graph = _graph(X)
+        n = len(graph.points)
+        self.labels_ = np.empty(n, dtype=np.int32)
+        core = np.empty(n, dtype=np.uint8)
+        _check(_lib.sca_dbscan(graph._handle, self.eps, self.min_samples, self.labels_.ctypes.data, core.ctypes.data))
+        self.core_sample_indices_ = np.flatnonzero(core)
+        self.components_ = graph.points[self.core_sample_indices_]
+        return self
+
+    def fit_predict(self, X, y=None):
+        return self.fit(X).labels_
+
+
+def _size(size, n):
+    #min_samples and min_cluster_size of OPTICS: a count, or a fraction of the points (at least 2) as scikit-learn
+    if isinstance(size, float) and size <= 1:
+        return max(2, int(size * n))
+    return int(size)
+
+
+class OPTICS(object):
+    #Replacement of sklearn.cluster.OPTICS (euclidean metric) with an indexed priority queue and bounded radius queries
+    #(Tools/cluster.h): same ordering_, reachability_, core_distances_, predecessor_ and labels_
+    def __init__(self, min_samples=5, max_eps=np.inf, cluster_method='xi', eps=None, xi=0.05,
+                 predecessor_correction=True, min_cluster_size=None):
+        self.min_samples = min_samples
+        self.max_eps = max_eps
+        self.cluster_method = cluster_method
+        self.eps = eps
+        self.xi = xi
+        self.predecessor_correction = predecessor_correction
+        self.min_cluster_size = min_cluster_size
+
+    def fit(self, X, y=None):
+        n = len(X.points if isinstance(X, NeighborGraph) else X)
+        min_samples = _size(self.min_samples, n)
+        graph = _graph(X, min_samples)
+        self.ordering_ = np.empty(n, dtype=np.int32)
+        self.core_distances_ = np.empty(n)
+        self.reachability_ = np.empty(n)
+        self.predecessor_ = np.empty(n, dtype=np.int32)
+        _check(_lib.sca_optics(graph._handle, min_samples, self.max_eps, self.ordering_.ctypes.data,
+                               self.core_distances_.ctypes.data, self.reachability_.ctypes.data,
+                               self.predecessor_.ctypes.data))
+        self.labels_ = np.empty(n, dtype=np.int32)
+        if self.cluster_method == 'xi':
+            min_cluster_size = min_samples if self.min_cluster_size is None else _size(self.min_cluster_size, n)
+            clusters = np.empty((n, 2), dtype=np.uint64)
+            count = ctypes.c_uint64()
+            while True:
+                _check(_lib.sca_optics_xi(n, self.ordering_.ctypes.data, self.reachability_.ctypes.data,
+                                          self.predecessor_.ctypes.data, min_samples, min_cluster_size, self.xi,
+                                          int(self.predecessor_correction), self.labels_.ctypes.data,
+                                          clusters.ctypes.data, len(clusters), ctypes.byref(count)))
+                if count.value <= len(clusters):
+                    break
+                clusters = np.empty((count.value, 2), dtype=np.uint64)
+            self.cluster_hierarchy_ = clusters[:count.value].astype(np.int64)
+        elif self.cluster_method == 'dbscan':
+            eps = self.max_eps if self.eps is None else self.eps
+            if eps > self.max_eps:
+                raise ValueError("Specify an epsilon smaller than %s. Got %s." % (self.max_eps, eps))
+            _check(_lib.sca_optics_dbscan(n, self.ordering_.ctypes.data, self.core_distances_.ctypes.data,
+                                          self.reachability_.ctypes.data, eps, self.labels_.ctypes.data))
+        else:
+            raise ValueError("unknown cluster_method " + str(self.cluster_method))
+        return self
+
+    def fit_predict(self, X, y=None):
+        return self.fit(X).labels_
+
+
+def estimate_bandwidth(X, quantile=0.3, n_samples=None, random_state=0):
+    #Replacement of sklearn.cluster.estimate_bandwidth: same value, same subsample for the same random_state
+    graph = _graph(X)
+    n = len(graph.points)
+    sample = None
+    if n_samples is not None:
+        if random_state is None:
+            random_state = np.random.mtrand._rand
+        elif not isinstance(random_state, np.random.RandomState):
+            random_state = np.random.RandomState(random_state)
+        sample = np.ascontiguousarray(random_state.permutation(n)[:n_samples], dtype=np.uint32)
+    bandwidth = ctypes.c_double()
+    _check(_lib.sca_estimate_bandwidth(graph._handle, None if sample is None else sample.ctypes.data,
+                                       n if sample is None else len(sample), quantile, ctypes.byref(bandwidth)))
+    return bandwidth.value
+
+
+class MeanShift(object):
+    #Replacement of sklearn.cluster.MeanShift with the seeds climbing in parallel on a KD-tree (Tools/cluster.h). The
+    #bandwidth, if not given, is estimated on the same neighbor graph as estimate_bandwidth does by default
+    def __init__(self, bandwidth=None, bin_seeding=False, min_bin_freq=1, cluster_all=True, max_iter=300):
+        self.bandwidth = bandwidth
+        self.bin_seeding = bin_seeding
+        self.min_bin_freq = min_bin_freq
+        self.cluster_all = cluster_all
+        self.max_iter = max_iter
+
+    def fit(self, X, y=None):
+        graph = _graph(X)
+        n, dim = graph.points.shape
+        bandwidth = estimate_bandwidth(graph) if self.bandwidth is None else self.bandwidth
+        centers = np.empty((n, dim))
+        count = ctypes.c_uint64()
+        iterations = ctypes.c_uint32()
+        self.labels_ = np.empty(n, dtype=np.int32)
+        _check(_lib.sca_mean_shift(graph._handle, bandwidth, int(self.bin_seeding), self.min_bin_freq, int(self.cluster_all),
+                                   self.max_iter, centers.ctypes.data, ctypes.byref(count), self.labels_.ctypes.data,
+                                   ctypes.byref(iterations)))
+        self.cluster_centers_ = centers[:count.value].copy()
+        self.n_iter_ = iterations.value
+        return self
+
+    def fit_predict(self, X, y=None):
+        return self.fit(X).labels_
+
+
+#### METRICS ####----------------
+
+_lib.sca_silhouette.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.POINTER(ctypes.c_double)]
+_lib.sca_label_scores.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.POINTER(ctypes.c_double),
+                                  ctypes.POINTER(ctypes.c_double)]
+
+
+def _codes(labels, dtype):
+    #labels as increasing codes of their distinct values: any label type, same order
+    return np.ascontiguousarray(np.unique(np.asarray(labels).ravel(), return_inverse=True)[1].ravel(), dtype=dtype)
+
+
+def _silhouette(X, labels, samples):
+    graph = _graph(X)
+    codes = _codes(labels, np.int32)
+    if len(codes) != len(graph.points):
+        raise ValueError("expected %d labels, got %d" % (len(graph.points), len(codes)))
+    score = ctypes.c_double()
+    _check(_lib.sca_silhouette(graph._handle, codes.ctypes.data, None if samples is None else samples.ctypes.data,
+                               ctypes.byref(score)))
+    return score.value
+
+
+def silhouette_samples(X, labels):
+    #Replacement of sklearn.metrics.silhouette_samples (euclidean metric) on the points or a neighbor graph, whose
+    #distance matrix is reused when it is kept (Tools/metrics.h)
+    samples = np.empty(len(X.points if isinstance(X, NeighborGraph) else X))
+    _silhouette(X, labels, samples)
+    return samples
+
+
+def silhouette_score(X, labels):
+    #Replacement of sklearn.metrics.silhouette_score (euclidean metric, no sampling)
+    return _silhouette(X, labels, None)
+
+
+def label_scores(labels_true, labels_pred):
+    #(normalized mutual information, ROC AUC) of the predictions, from one contingency table; the AUC is nan unless
+    #labels_true has two values
+    t = _codes(labels_true, np.float64)
+    p = np.ascontiguousarray(np.asarray(labels_pred).ravel(), dtype=np.float64) \
+        if np.issubdtype(np.asarray(labels_pred).dtype, np.number) else _codes(labels_pred, np.float64)
+    if len(t) != len(p):
+        raise ValueError("expected %d predictions, got %d" % (len(t), len(p)))
+    nmi = ctypes.c_double()
+    auc = ctypes.c_double()
+    _check(_lib.sca_label_scores(len(t), t.ctypes.data, p.ctypes.data, ctypes.byref(nmi), ctypes.byref(auc)))
+    return nmi.value, auc.value
+
+
+def normalized_mutual_info_score(labels_true, labels_pred):
+    #Replacement of sklearn.metrics.normalized_mutual_info_score (arithmetic mean)
+    return label_scores(labels_true, labels_pred)[0]
+
+
+def roc_auc_score(y_true, y_score):
+    #Replacement of sklearn.metrics.roc_auc_score for binary labels
+    auc = label_scores(y_true, y_score)[1]
+    if np.isnan(auc):
+        raise ValueError("Only one class present in y_true. ROC AUC score is not defined in that case.")
+    return auc
+
+
+#### EXPERIMENTS ####----------------
+
+#Same layout as experiment_scores and experiment_summary in Tools/experiment.h
+EXPERIMENT_SCORES = np.dtype([('clusters', '<u4'), ('reserved0', 'u1', 4), ('silhouette', '<f8'), ('mutual_info', '<f8'),
+                              ('auc', '<f8')])
+EXPERIMENT_SUMMARY = np.dtype([('runs', '<u8'), ('silhouette_mean', '<f8'), ('silhouette_stdev', '<f8'),
+                               ('mutual_info_mean', '<f8'), ('mutual_info_stdev', '<f8'), ('auc_runs', '<u8'),
+                               ('auc_mean', '<f8'), ('auc_stdev', '<f8')])
+#Algorithms of the experiments, in the order of the last axis of the results
+EXPERIMENT_ALGORITHMS = ['optics', 'dbscan', 'mean_shift']
+
+
+class _ExperimentProgram(ctypes.Structure):
+    _fields_ = [('id', ctypes.c_uint32),
+                ('baseline', ctypes.c_void_p),
+                ('baselineTraces', ctypes.c_void_p),
+                ('baselineLd', ctypes.c_uint64),
+                ('errorTraces', ctypes.c_void_p),
+                ('errorCount', ctypes.c_uint64),
+                ('spectralBaseline', ctypes.c_void_p),
+                ('baselineSpectra', ctypes.c_void_p),
+                ('baselineSpectraLd', ctypes.c_uint64)]
+
+
+_lib.sca_experiments_run.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_void_p, ctypes.c_uint64,
+                                     ctypes.POINTER(_ExperimentProgram), ctypes.c_uint32, ctypes.c_void_p, ctypes.c_uint32,
+                                     ctypes.c_uint32, ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p]
+
+
+def run_experiments(X, programs, settings, executions=100, seed=0, spectra=None):
+    #Monte-Carlo executions of main.py for every program and setting, on all the cores (Tools/experiment.h): a sample of
+    #1% of the baseline traces (at most 30) taken among the traces of the program, PCA with the baseline, clustering and
+    #scores. programs: (label, BaselinePCA of its baseline program, rows of X holding its traces) triples, or quadruples
+    #with the BaselinePCA of the spectra of the baseline program, for mean shift on the PCA of the rows of spectra;
+    #settings: (components, algorithm names) pairs. Returns the scores (programs, settings, executions, algorithms) and
+    #their summaries (programs, settings, algorithms); the same seed gives the same results with any number of threads.
+    X, ld = _matrix(X)
+    spectra_ld = 0
+    if spectra is not None:
+        spectra, spectra_ld = _matrix(spectra)
+        if spectra.shape[0] != X.shape[0]:
+            raise ValueError("%d spectra for %d traces" % (spectra.shape[0], X.shape[0]))
+    rows = [np.ascontiguousarray(p[2], dtype=np.uint64) for p in programs]
+    array = (_ExperimentProgram * len(programs))()
+    for p, (program, r) in enumerate(zip(programs, rows)):
+        label, baseline = program[0], program[1]
+        if baseline.baseline.shape[1] != X.shape[1]:
+            raise ValueError("the baseline of program %d has %d samples, X has %d" % (label, baseline.baseline.shape[1], X.shape[1]))
+        _, baseline_ld = _matrix(baseline.baseline)
+        array[p] = _ExperimentProgram(int(label), baseline._handle, baseline.baseline.ctypes.data, baseline_ld,
+                                      r.ctypes.data, len(r))
+        if len(program) > 3 and program[3] is not None:
+            spectral = program[3]
+            if spectra is None or spectral.baseline.shape[1] != spectra.shape[1]:
+                raise ValueError("the spectral baseline of program %d does not match the spectra" % label)
+            _, spectral_ld = _matrix(spectral.baseline)
+            array[p].spectralBaseline = spectral._handle
+            array[p].baselineSpectra = spectral.baseline.ctypes.data
+            array[p].baselineSpectraLd = spectral_ld
+    plan = np.array([(components, sum(1 << EXPERIMENT_ALGORITHMS.index(a) for a in algorithms))
+                     for components, algorithms in settings], dtype=np.uint32).reshape(-1, 2)
+    scores = np.zeros((len(programs), len(settings), executions, len(EXPERIMENT_ALGORITHMS)), dtype=EXPERIMENT_SCORES)
+    summaries = np.zeros((len(programs), len(settings), len(EXPERIMENT_ALGORITHMS)), dtype=EXPERIMENT_SUMMARY)
+    _check(_lib.sca_experiments_run(X.ctypes.data, ld, None if spectra is None else spectra.ctypes.data, spectra_ld, array,
+                                    len(programs), plan.ctypes.data, len(plan), executions, seed, scores.ctypes.data,
+                                    summaries.ctypes.data))
+    return scores, summaries